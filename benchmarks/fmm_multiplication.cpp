@@ -16,6 +16,8 @@
 
 #include "Excitation.h"
 #include "Geometry.h"
+#include "Memory.h"
+#include "Roofline.h"
 #include "Tools.h"
 #include "Types.h"
 #include "mpi/FastMatrixMultiply.h"
@@ -24,7 +26,10 @@
 #endif
 #include <chrono>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace {
 constexpr optimet::t_real default_wavelength() { return 750e-9; }
@@ -59,6 +64,16 @@ int main(int argc, char *const argv[]) {
   auto const nobjects = find_arg<t_int>(argc, argv, "nobjects", 100);
   auto const radius = find_arg<t_real>(argc, argv, "radius", 0.25);
   auto const nMax = find_arg<t_int>(argc, argv, "nharmonics", 10);
+  auto const explain = find_arg<bool>(argc, argv, "explain", false);
+  auto const rotations = find_arg<std::string>(argc, argv, "rotations", "dense");
+  if(rotations != "dense" and rotations != "factored")
+    throw std::runtime_error("--rotations should be one of dense or factored");
+  auto const storage =
+      rotations == "factored" ? Rotation::Storage::factored : Rotation::Storage::dense;
+  // bytes of co-axial translations stored by each process, the others are recomputed
+  auto const budget = find_arg<std::string>(argc, argv, "translations", "");
+  auto const translations =
+      budget.empty() ? std::numeric_limits<t_real>::infinity() : memory::parse_bytes(budget);
   ElectroMagnetic const elmag{13.1, 1.0};
   auto const length = (radius + 0.5) * default_length();
   Scatterer const scatterer = {{0, 0, 0}, elmag, radius * default_length(), nMax};
@@ -96,10 +111,17 @@ int main(int argc, char *const argv[]) {
   mpi::Communicator const world;
   auto const subdiagonals = std::max<int>(1, geometry->objects.size() / 2 - 2);
   mpi::FastMatrixMultiply const fmm(geometry->bground, excitation->wavenumber(), geometry->objects,
-                                    subdiagonals, world);
+                                    subdiagonals, world, OperatorData(), storage,
+                                    translations);
 #else
-  FastMatrixMultiply const fmm(geometry->bground, excitation->wavenumber(), geometry->objects);
+  FastMatrixMultiply const fmm(
+      geometry->bground, excitation->wavenumber(), geometry->objects,
+      Matrix<bool>::Ones(geometry->objects.size(), geometry->objects.size()), storage,
+      translations);
 #endif
+  // rotations held by this process, including the flips shared by factored rotations
+  auto const rotation_bytes = memory::current(memory::Component::rotations);
+  auto const translation_bytes = memory::current(memory::Component::translations);
 
   Vector<t_complex> const input = Vector<t_complex>::Random(fmm.cols());
 
@@ -120,6 +142,20 @@ int main(int argc, char *const argv[]) {
 #endif
   }
 
+  // Roofline model of the multiplication, kernel by kernel
+  roofline::Profile profile;
+  roofline::Machine machine{0, 0};
+  if(explain) {
+    for(int i(0); i < iterations; ++i)
+      profile += fmm.explain(input, result);
+#if defined(OPTIMET_MPI) && !defined(OPTIMET_JUST_DO_SERIAL)
+    profile = profile.reduce(world);
+    machine = roofline::probe(world);
+#else
+    machine = roofline::probe(mpi::Communicator());
+#endif
+  }
+
 #if defined(OPTIMET_MPI) && !defined(OPTIMET_JUST_DO_SERIAL)
   if(world.is_root()) {
 #endif
@@ -147,8 +183,13 @@ int main(int argc, char *const argv[]) {
     std::cout << "    nharmonics: " << nMax << "\n";
     std::cout << "    nobjects: " << nobjects << "\n";
     std::cout << "    iterations: " << iterations << "\n";
+    std::cout << "    rotations: " << rotations << "\n";
+    std::cout << "    rotation memory: " << memory::format_bytes(rotation_bytes) << "\n";
+    std::cout << "    translation memory: " << memory::format_bytes(translation_bytes) << "\n";
     std::cout << "    Total time: " << elapsed << " seconds\n";
     std::cout << "    Timing: " << elapsed / iterations << " seconds\n";
+    if(explain)
+      roofline::write(std::cout, profile, machine);
     std::cout << "---\n";
 #if defined(OPTIMET_MPI) && !defined(OPTIMET_JUST_DO_SERIAL)
   }
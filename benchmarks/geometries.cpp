@@ -0,0 +1,237 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "geometries.h"
+#include "constants.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <random>
+#include <stdexcept>
+
+namespace optimet {
+namespace geometries {
+namespace {
+typedef Eigen::Matrix<t_real, 3, 1> Point;
+//! Maximum number of random trials per sphere before giving up
+constexpr t_uint max_trials() { return 100000; }
+
+//! \brief Spheres added so far, binned on a grid for fast overlap checks
+//! \details The cells are as wide as the largest exclusion diameter, so that only neighbouring
+//! cells need be checked.
+class Packing {
+public:
+  Packing(t_real max_radius, t_real separation)
+      : width_(2 * max_radius * separation), separation_(separation) {}
+
+  //! Whether a sphere fits without coming closer than the separation to any other
+  bool fits(Point const &position, t_real radius) const {
+    auto const cell = cell_of(position);
+    for(t_int i(-1); i <= 1; ++i)
+      for(t_int j(-1); j <= 1; ++j)
+        for(t_int k(-1); k <= 1; ++k) {
+          auto const found = cells_.find({{cell[0] + i, cell[1] + j, cell[2] + k}});
+          if(found == cells_.end())
+            continue;
+          for(auto const index : found->second)
+            if((positions_[index] - position).norm() < separation_ * (radii_[index] + radius))
+              return false;
+        }
+    return true;
+  }
+  //! Adds a sphere, without checking it fits
+  void add(Point const &position, t_real radius) {
+    cells_[cell_of(position)].push_back(positions_.size());
+    positions_.push_back(position);
+    radii_.push_back(radius);
+  }
+
+  std::vector<Point> const &positions() const { return positions_; }
+  std::vector<t_real> const &radii() const { return radii_; }
+
+  //! Spheres as scatterers
+  std::vector<Scatterer> scatterers(Options const &options) const {
+    std::vector<Scatterer> result;
+    result.reserve(positions_.size());
+    for(std::size_t i(0); i < positions_.size(); ++i)
+      result.emplace_back(positions_[i], options.elmag, radii_[i], options.nMax);
+    return result;
+  }
+
+private:
+  std::array<t_int, 3> cell_of(Point const &position) const {
+    return {{static_cast<t_int>(std::floor(position(0) / width_)),
+             static_cast<t_int>(std::floor(position(1) / width_)),
+             static_cast<t_int>(std::floor(position(2) / width_))}};
+  }
+
+  t_real width_;
+  t_real separation_;
+  std::map<std::array<t_int, 3>, std::vector<t_uint>> cells_;
+  std::vector<Point> positions_;
+  std::vector<t_real> radii_;
+};
+
+//! Radii of all spheres, largest first
+std::vector<t_real> lognormal_radii(Options const &options, std::mt19937_64 &engine) {
+  std::lognormal_distribution<t_real> distribution(std::log(options.radius), options.spread);
+  std::vector<t_real> result(options.nobjects);
+  for(auto &radius : result)
+    radius = std::min(3 * options.radius, std::max(options.radius / 3, distribution(engine)));
+  std::sort(result.begin(), result.end(), std::greater<t_real>());
+  return result;
+}
+
+t_real volume(std::vector<t_real> const &radii) {
+  t_real result(0);
+  for(auto const radius : radii)
+    result += 4e0 / 3e0 * constant::pi * radius * radius * radius;
+  return result;
+}
+
+//! \brief Random sequential addition of spheres in a box
+//! \details Spheres are placed in the order given, each at the first random position where it
+//! fits. Placing the largest first makes it easier to reach higher volume fractions.
+std::vector<Scatterer> random_box(Options const &options, std::vector<t_real> const &radii,
+                                  Point const &box, std::mt19937_64 &engine) {
+  if(options.fraction <= 0 or options.fraction >= 0.4)
+    throw std::runtime_error("Random packings need a volume fraction between 0 and 0.4");
+  Packing packing(*std::max_element(radii.begin(), radii.end()), options.separation);
+  std::uniform_real_distribution<t_real> uniform(0, 1);
+  for(auto const radius : radii) {
+    t_uint trial(0);
+    for(; trial < max_trials(); ++trial) {
+      Point const position(radius + uniform(engine) * std::max<t_real>(box(0) - 2 * radius, 0),
+                           radius + uniform(engine) * std::max<t_real>(box(1) - 2 * radius, 0),
+                           radius + uniform(engine) * std::max<t_real>(box(2) - 2 * radius, 0));
+      if(packing.fits(position, radius)) {
+        packing.add(position, radius);
+        break;
+      }
+    }
+    if(trial == max_trials())
+      throw std::runtime_error("Could not pack " + std::to_string(radii.size()) +
+                               " spheres, try a lower volume fraction");
+  }
+  return packing.scatterers(options);
+}
+
+//! Uniformly distributed random direction
+Point random_direction(std::mt19937_64 &engine) {
+  std::normal_distribution<t_real> normal;
+  Point result(normal(engine), normal(engine), normal(engine));
+  while(result.norm() == 0)
+    result = Point(normal(engine), normal(engine), normal(engine));
+  return result.normalized();
+}
+} // namespace
+
+std::vector<Scatterer> fcc(Options const &options) {
+  Eigen::Matrix<t_real, 3, 3> cell = Eigen::Matrix<t_real, 3, 3>::Ones() * 0.5;
+  cell.diagonal().fill(0);
+  auto const length = 2 * options.radius * options.separation * std::sqrt(2e0);
+  t_uint n = std::ceil(std::pow(options.nobjects, 1e0 / 3e0));
+  std::vector<Scatterer> result;
+  result.reserve(options.nobjects);
+  for(t_uint i(0); i < n; ++i)
+    for(t_uint j(0); j < n; ++j)
+      for(t_uint k(0); k < n and result.size() < options.nobjects; ++k) {
+        Point const position = cell * Point(i, j, k) * length;
+        result.emplace_back(position, options.elmag, options.radius, options.nMax);
+      }
+  return result;
+}
+
+std::vector<Scatterer> random_packing(Options const &options) {
+  std::mt19937_64 engine(options.seed);
+  std::vector<t_real> const radii(options.nobjects, options.radius);
+  auto const side = std::cbrt(volume(radii) / options.fraction);
+  return random_box(options, radii, Point::Constant(side), engine);
+}
+
+std::vector<Scatterer> polydisperse(Options const &options) {
+  std::mt19937_64 engine(options.seed);
+  auto const radii = lognormal_radii(options, engine);
+  auto const side = std::cbrt(volume(radii) / options.fraction);
+  return random_box(options, radii, Point::Constant(side), engine);
+}
+
+std::vector<Scatterer> thin_film(Options const &options) {
+  if(options.layers == 0)
+    throw std::runtime_error("Thin films should be at least one layer thick");
+  std::mt19937_64 engine(options.seed);
+  std::vector<t_real> const radii(options.nobjects, options.radius);
+  auto const thickness = 2 * options.radius * options.separation * options.layers;
+  auto const side = std::sqrt(volume(radii) / options.fraction / thickness);
+  return random_box(options, radii, Point(side, side, thickness), engine);
+}
+
+std::vector<Scatterer> aggregate(Options const &options) {
+  std::mt19937_64 engine(options.seed);
+  Packing packing(options.radius, options.separation);
+  if(options.nobjects == 0)
+    return {};
+  packing.add(Point::Zero(), options.radius);
+  // Distance from the origin beyond which there are no spheres
+  auto cluster = options.radius;
+  // Walkers stick once within contact distance plus this step
+  auto const step = 0.5 * options.radius;
+  auto const contact = 2 * options.radius * options.separation;
+  for(t_uint n(1); n < options.nobjects; ++n) {
+    auto const launch = cluster + contact + step;
+    Point position = launch * random_direction(engine);
+    t_uint trial(0);
+    for(; trial < max_trials(); ++trial) {
+      auto const distance = position.norm();
+      if(distance > 4 * launch) {
+        // Lost walker: start again from the launch shell
+        position = launch * random_direction(engine);
+        continue;
+      }
+      // Far from the cluster, jumps can be as large as the gap to it
+      auto const gap = distance - cluster - contact;
+      Point const next = position + std::max(gap, step) * random_direction(engine);
+      if(gap > step or packing.fits(next, options.radius)) {
+        position = next;
+        continue;
+      }
+      packing.add(position, options.radius);
+      cluster = std::max(cluster, distance + options.radius);
+      break;
+    }
+    if(trial == max_trials())
+      throw std::runtime_error("Random walk did not reach the aggregate");
+  }
+  return packing.scatterers(options);
+}
+
+std::vector<Scatterer> generate(std::string const &name, Options const &options) {
+  if(name == "fcc")
+    return fcc(options);
+  if(name == "random")
+    return random_packing(options);
+  if(name == "polydisperse")
+    return polydisperse(options);
+  if(name == "aggregate")
+    return aggregate(options);
+  if(name == "film")
+    return thin_film(options);
+  throw std::runtime_error("Unknown geometry " + name +
+                           ": should be fcc, random, polydisperse, aggregate or film");
+}
+} // namespace geometries
+} // namespace optimet
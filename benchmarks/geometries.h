@@ -0,0 +1,72 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_BENCHMARK_GEOMETRIES_H
+#define OPTIMET_BENCHMARK_GEOMETRIES_H
+
+#include "ElectroMagnetic.h"
+#include "Scatterer.h"
+#include "Types.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace optimet {
+//! \brief Sphere ensembles for benchmarking
+//! \details Unlike perfect lattices, these ensembles have irregular neighbourhoods and uneven
+//! densities, and so exercise the load balance of the parallel solvers. All generators are
+//! deterministic for a given seed, so that each process can build the same geometry.
+namespace geometries {
+//! Parameters common to all generators
+struct Options {
+  //! Number of spheres
+  t_uint nobjects = 100;
+  //! Radius of the spheres, or their median radius for polydisperse ensembles
+  t_real radius = 500e-9;
+  //! Fraction of the bounding box filled by spheres, for packings and films
+  t_real fraction = 0.2;
+  //! Standard deviation of the logarithm of the radii, for polydisperse ensembles
+  t_real spread = 0.3;
+  //! Thickness of thin films, in sphere diameters
+  t_uint layers = 2;
+  //! Minimum distance between two spheres, relative to the sum of their radii
+  t_real separation = 1.05;
+  //! Seed of the random number generator
+  std::uint64_t seed = 0;
+  //! Maximum degree of the harmonics of each sphere
+  t_int nMax = 5;
+  //! Material of the spheres
+  ElectroMagnetic elmag = {13.1, 1.0};
+};
+
+//! Face centered cubic lattice of identical spheres, as in the other benchmarks
+std::vector<Scatterer> fcc(Options const &options);
+//! Identical spheres placed randomly in a cube, up to the given volume fraction
+std::vector<Scatterer> random_packing(Options const &options);
+//! Random packing of spheres with log-normally distributed radii
+std::vector<Scatterer> polydisperse(Options const &options);
+//! \brief Clustered aggregate grown by diffusion-limited aggregation
+//! \details Spheres perform random walks from a distant shell until they stick to the cluster.
+std::vector<Scatterer> aggregate(Options const &options);
+//! Random packing in a thin slab, a few diameters thick and wide in the other two directions
+std::vector<Scatterer> thin_film(Options const &options);
+
+//! \brief Generator given by name
+//! \details One of "fcc", "random", "polydisperse", "aggregate" or "film".
+std::vector<Scatterer> generate(std::string const &name, Options const &options);
+} // namespace geometries
+} // namespace optimet
+#endif
@@ -0,0 +1,621 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Microbenchmarks for the kernels computing and applying the coefficients.
+//! \details Each benchmark takes two arguments: the maximum degree nMax of the harmonics and the
+//! number of independent particle pairs (or spheres) processed per iteration. Alongside the time,
+//! each benchmark reports the floating point operations and bytes moved per second, derived from
+//! the operation counts given by the helper functions below. Throughputs for kernels where the
+//! flop count is not meaningful, e.g. recurrences and special functions, are reported as
+//! coefficients per second only. The ranges can be changed with --nmax=1_5_10 and --batch=1_8.
+//! coaxial_sweep gives the cost of the co-axial translations recomputed during each
+//! multiplication, against coaxial_functor for those that are stored.
+//!
+//! The fmm_* benchmarks apply the kernels as the fast matrix multiplication does, on views of its
+//! work matrices, either with the generic implementation or with the instance specialised for the
+//! degree. Comparing the two at the same nMax, e.g. with --nmax=3_4_5_6_7_8_9_10_11_12, gives the
+//! speedup of the specialised kernels. fmm_rotation/factored applies the rotations stored as
+//! phases and flips shared by all pairs, trading memory for flops.
+//!
+//! The fmm_traversal benchmarks run the translation loop of the FMM over all pairs of a lattice of
+//! spheres, visiting pairs either row by row or in Morton order as the FMM does. Where the Linux
+//! performance counters are available, they also report L1 and last-level cache misses per pair.
+#include "AuxCoefficients.h"
+#include "Bessel.h"
+#include "CoAxialTranslationCoefficients.h"
+#include "Coupling.h"
+#include "FixedKernels.h"
+#include "RotationCoaxialDecomposition.h"
+#include "RotationCoefficients.h"
+#include "Scatterer.h"
+#include "Traversal.h"
+#include "Types.h"
+#include "constants.h"
+#ifndef BENCHMARK_HAS_CXX11
+#define BENCHMARK_HAS_CXX11
+#endif
+#include <benchmark/benchmark.h>
+#include <random>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace optimet {
+namespace {
+//! Floating point operations of a complex multiply-add
+constexpr t_real complex_fma_flops() { return 8; }
+//! Wavenumber used throughout: the value is irrelevant to the speed of the kernels
+t_real wavenumber() { return 2 * constant::pi / 750e-9; }
+
+std::vector<t_int> nharmonics = {1, 2, 5, 10, 20, 40};
+std::vector<t_int> batches = {1, 8};
+
+//! Number of (n, m) harmonics from n = 1 to nMax
+t_int nfunctions(t_int nMax) { return nMax * (nMax + 2); }
+
+//! Number of rotation matrix elements, summed over all degrees
+t_real rotation_elements(t_int nMax) {
+  t_real result(0);
+  for(t_int n(1); n <= nMax; ++n)
+    result += (2 * n + 1) * (2 * n + 1);
+  return result;
+}
+
+//! Products by co-axial coefficients from n = 0 to nMax, those of m also applying to -m
+t_real coaxial_products(t_int nMax) {
+  t_real result(0);
+  for(t_int n(0); n <= nMax; ++n)
+    for(t_int m(-n); m <= n; ++m)
+      result += nMax - std::abs(m) + 1;
+  return result;
+}
+
+//! Pseudo-random distances and directions, so that each pair in a batch is different
+class PairGenerator {
+public:
+  PairGenerator() : engine(0), distance(600e-9, 2400e-9), angle(0, constant::pi) {}
+  t_real operator()() { return distance(engine); }
+  Eigen::Matrix<t_real, 3, 1> direction() {
+    auto const theta = angle(engine), phi = 2 * angle(engine);
+    return {std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)};
+  }
+  Spherical<t_real> spherical() { return {operator()(), angle(engine), 2 * angle(engine)}; }
+
+private:
+  std::mt19937_64 engine;
+  std::uniform_real_distribution<t_real> distance;
+  std::uniform_real_distribution<t_real> angle;
+};
+
+//! Input potentials (Φ, Ψ) for each pair in the batch
+std::vector<Matrix<t_complex>> random_potentials(t_int nMax, t_int batch) {
+  std::vector<Matrix<t_complex>> result;
+  for(t_int i(0); i < batch; ++i)
+    result.emplace_back(Matrix<t_complex>::Random(nfunctions(nMax), 2));
+  return result;
+}
+
+//! Sets throughput counters, given operations and bytes per iteration
+void set_throughput(benchmark::State &state, t_real items, t_real flops, t_real bytes) {
+  auto const iterations = static_cast<t_real>(state.iterations());
+  state.SetItemsProcessed(static_cast<int64_t>(items * iterations));
+  state.SetBytesProcessed(static_cast<int64_t>(bytes * iterations));
+  if(flops > 0)
+    state.counters["flops"] = benchmark::Counter(flops * iterations, benchmark::Counter::kIsRate);
+}
+
+void rotation(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<Rotation> rotations;
+  for(t_int i(0); i < batch; ++i)
+    rotations.emplace_back(generator.direction(), nMax);
+  auto const input = random_potentials(nMax, batch);
+  Matrix<t_complex> output(nfunctions(nMax), 2);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      rotations[i](input[i], output);
+      benchmark::DoNotOptimize(output.data());
+    }
+
+  auto const elements = rotation_elements(nMax);
+  set_throughput(state, batch * nfunctions(nMax), batch * 2 * elements * complex_fma_flops(),
+                 batch * sizeof(t_complex) * (elements + 4 * nfunctions(nMax)));
+}
+
+void coaxial_functor_construction(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<t_real> distances;
+  for(t_int i(0); i < batch; ++i)
+    distances.push_back(generator());
+  t_uint ncoeffs(0);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      auto const functor =
+          CachedCoAxialRecurrence(distances[i], wavenumber(), false).functor(nMax);
+      ncoeffs = functor.data().size();
+      benchmark::DoNotOptimize(functor.data().data());
+    }
+
+  set_throughput(state, batch * ncoeffs, 0, batch * ncoeffs * sizeof(t_complex));
+}
+
+//! Same coefficients as coaxial_functor_construction, recomputed in a single sweep as in the FMM
+void coaxial_sweep(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<t_real> distances;
+  for(t_int i(0); i < batch; ++i)
+    distances.push_back(generator());
+  CoAxialSweep sweep;
+  t_uint ncoeffs(0);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      auto const &functor = sweep(distances[i], wavenumber(), nMax, false);
+      ncoeffs = functor.data().size();
+      benchmark::DoNotOptimize(functor.data().data());
+    }
+
+  set_throughput(state, batch * ncoeffs, 0, batch * ncoeffs * sizeof(t_complex));
+}
+
+//! Applies the coaxial functor directly or transposed
+template <bool TRANSPOSE> void coaxial_functor(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<CachedCoAxialRecurrence::Functor> functors;
+  for(t_int i(0); i < batch; ++i)
+    functors.push_back(CachedCoAxialRecurrence(generator(), wavenumber(), false).functor(nMax));
+  auto const input = random_potentials(nMax, batch);
+  Matrix<t_complex> output(nfunctions(nMax), 2);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      if(TRANSPOSE)
+        functors[i].transpose(input[i], output);
+      else
+        functors[i](input[i], output);
+      benchmark::DoNotOptimize(output.data());
+    }
+
+  // coefficients with n = 0 are skipped when the input starts at n = 1
+  auto const ncoeffs = static_cast<t_real>(functors.front().data().size() - (nMax + 1));
+  auto const products = coaxial_products(nMax) - (nMax + 1);
+  set_throughput(state, batch * nfunctions(nMax), batch * 2 * products * complex_fma_flops(),
+                 batch * sizeof(t_complex) * (ncoeffs + 4 * nfunctions(nMax)));
+}
+
+void decomposition(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<t_real> distances;
+  for(t_int i(0); i < batch; ++i)
+    distances.push_back(generator());
+  auto const input = random_potentials(nMax, batch);
+  Matrix<t_complex> output(nfunctions(nMax), 2);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      rotation_coaxial_decomposition(wavenumber(), distances[i], input[i], output);
+      benchmark::DoNotOptimize(output.data());
+    }
+
+  // per output: one complex product, two real-complex products and three complex additions
+  set_throughput(state, batch * nfunctions(nMax), batch * 2 * 16 * nfunctions(nMax),
+                 batch * sizeof(t_complex) * 4 * nfunctions(nMax));
+}
+
+//! Input potentials (Φ, Ψ) from n = 0, interleaved as the FMM packs them
+std::vector<kernels::Interleaved> random_potentials_with_n0(t_int nMax, t_int batch) {
+  std::vector<kernels::Interleaved> result;
+  for(t_int i(0); i < batch; ++i)
+    result.emplace_back(kernels::Interleaved::Random(nfunctions(nMax) + 1, 2));
+  return result;
+}
+
+//! Rotation as in the FMM, generic or specialised for the degree
+template <bool SPECIALISED> void fmm_rotation(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<Rotation> rotations;
+  for(t_int i(0); i < batch; ++i)
+    rotations.emplace_back(generator.direction(), nMax);
+  auto const input = random_potentials_with_n0(nMax, batch);
+  kernels::Interleaved output(nfunctions(nMax), 2);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      // rotations skip the n = 0 term
+      auto const in = kernels::view(input[i].bottomRows(nfunctions(nMax)));
+      if(SPECIALISED)
+        kernels::rotation(rotations[i], kernels::Rotate::direct, in, kernels::mutable_view(output));
+      else
+        rotations[i](in, kernels::mutable_view(output));
+      benchmark::DoNotOptimize(output.data());
+    }
+
+  auto const elements = rotation_elements(nMax);
+  set_throughput(state, batch * nfunctions(nMax), batch * 2 * elements * complex_fma_flops(),
+                 batch * sizeof(t_complex) * (elements + 4 * nfunctions(nMax)));
+}
+
+//! \brief Rotation as in the FMM, with the phases and the flips shared by all pairs
+//! \details The operator_bytes counter gives the bytes held per pair, against the dense matrices of
+//! fmm_rotation. Only the three angles are specific to each pair.
+void fmm_factored_rotation(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<Rotation> rotations;
+  for(t_int i(0); i < batch; ++i)
+    rotations.emplace_back(generator.direction(), nMax, Rotation::Storage::factored);
+  auto const input = random_potentials_with_n0(nMax, batch);
+  kernels::Interleaved output(nfunctions(nMax), 2);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      auto const in = kernels::view(input[i].bottomRows(nfunctions(nMax)));
+      kernels::rotation(rotations[i], kernels::Rotate::direct, in, kernels::mutable_view(output));
+      benchmark::DoNotOptimize(output.data());
+    }
+
+  // two real-complex products with the flips and three complex products with the phases
+  auto const elements = rotation_elements(nMax);
+  set_throughput(state, batch * nfunctions(nMax),
+                 batch * 2 * (2 * 4 * elements + 3 * 6 * nfunctions(nMax)),
+                 batch *
+                     (2 * sizeof(t_real) * elements + 4 * sizeof(t_complex) * nfunctions(nMax)));
+  state.counters["operator_bytes"] = 3 * sizeof(t_real);
+}
+
+//! Co-axial translation as in the FMM, generic or specialised for the degree
+template <bool SPECIALISED, bool TRANSPOSE> void fmm_coaxial(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<CachedCoAxialRecurrence::Functor> functors;
+  for(t_int i(0); i < batch; ++i)
+    functors.push_back(CachedCoAxialRecurrence(generator(), wavenumber(), false).functor(nMax));
+  auto const input = random_potentials_with_n0(nMax, batch);
+  kernels::Interleaved output(nfunctions(nMax) + 1, 2);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      auto const in = kernels::view(input[i]);
+      if(SPECIALISED and TRANSPOSE)
+        kernels::coaxial_transpose(functors[i], in, kernels::mutable_view(output));
+      else if(SPECIALISED)
+        kernels::coaxial(functors[i], in, kernels::mutable_view(output));
+      else if(TRANSPOSE)
+        functors[i].transpose(in, kernels::mutable_view(output));
+      else
+        functors[i](in, kernels::mutable_view(output));
+      benchmark::DoNotOptimize(output.data());
+    }
+
+  auto const ncoeffs = static_cast<t_real>(functors.front().data().size());
+  set_throughput(state, batch * (nfunctions(nMax) + 1),
+                 batch * 2 * coaxial_products(nMax) * complex_fma_flops(),
+                 batch * sizeof(t_complex) * (ncoeffs + 4 * (nfunctions(nMax) + 1)));
+}
+
+//! Rotation-coaxial decomposition as in the FMM, generic or specialised for the degree
+template <bool SPECIALISED, bool TRANSPOSE> void fmm_decomposition(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<t_real> distances;
+  for(t_int i(0); i < batch; ++i)
+    distances.push_back(generator());
+  auto const input = random_potentials_with_n0(nMax, batch);
+  kernels::Interleaved output(nfunctions(nMax) + 1, 2);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      auto const in = kernels::view(input[i]);
+      auto out = kernels::mutable_view(output);
+      if(SPECIALISED and TRANSPOSE)
+        kernels::decomposition_transpose(wavenumber(), distances[i], in, out);
+      else if(SPECIALISED)
+        kernels::decomposition(wavenumber(), distances[i], in, out);
+      else if(TRANSPOSE)
+        rotation_coaxial_decomposition_transpose(wavenumber(), distances[i], in, out);
+      else
+        rotation_coaxial_decomposition(wavenumber(), distances[i], in, out);
+      benchmark::DoNotOptimize(output.data());
+    }
+
+  set_throughput(state, batch * nfunctions(nMax), batch * 2 * 16 * nfunctions(nMax),
+                 batch * sizeof(t_complex) * 4 * nfunctions(nMax));
+}
+
+//! \brief Counts misses in a cache level while alive
+//! \details Uses the Linux performance counters. `valid` is false where they are not available,
+//! e.g. in containers or when perf_event_paranoid forbids it.
+class CacheMisses {
+public:
+#ifdef __linux__
+  //! Misses in the L1 data cache, or in the last-level cache
+  CacheMisses(bool last_level) : descriptor(-1) {
+    t_uint const cache = last_level ? PERF_COUNT_HW_CACHE_LL : PERF_COUNT_HW_CACHE_L1D;
+    perf_event_attr attributes = {};
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    descriptor = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+    if(valid()) {
+      ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+      ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  ~CacheMisses() {
+    if(valid())
+      close(descriptor);
+  }
+  bool valid() const { return descriptor >= 0; }
+  //! Misses since creation
+  t_real count() const {
+    long long result(0);
+    if(not valid() or read(descriptor, &result, sizeof(result)) != sizeof(result))
+      return 0;
+    return static_cast<t_real>(result);
+  }
+
+private:
+  int descriptor;
+#else
+  CacheMisses(bool) {}
+  bool valid() const { return false; }
+  t_real count() const { return 0; }
+#endif
+};
+
+//! \brief Translation loop of the FMM over all pairs of a cubic lattice of spheres
+//! \details The second argument is the number of spheres along each side. Rotations and co-axial
+//! translations are allocated in traversal order, as in the FMM. Reports the number of L1 and
+//! last-level cache read misses per pair, where the performance counters are available.
+template <bool MORTON> void fmm_traversal(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const side = state.range(1);
+  ElectroMagnetic const silicon{13.1, 1.0};
+  std::vector<Scatterer> scatterers;
+  for(t_int k(0); k < side; ++k)
+    for(t_int j(0); j < side; ++j)
+      for(t_int i(0); i < side; ++i) {
+        Eigen::Matrix<t_real, 3, 1> const position(1.5e-6 * i, 1.5e-6 * j, 1.5e-6 * k);
+        scatterers.emplace_back(position, silicon, 500e-9, nMax);
+      }
+  Matrix<bool> couplings = Matrix<bool>::Ones(scatterers.size(), scatterers.size());
+  couplings.diagonal().fill(false);
+  auto const pairs = MORTON ? traversal::morton(scatterers, couplings) :
+                              traversal::row_major(couplings);
+
+  std::vector<Rotation> rotations;
+  std::vector<CachedCoAxialRecurrence::Functor> functors;
+  for(auto const &pair : pairs) {
+    auto const &out = scatterers[pair.first], &in = scatterers[pair.second];
+    Eigen::Matrix<t_real, 3, 1> const separation =
+        out.vR.toEigenCartesian() - in.vR.toEigenCartesian();
+    rotations.emplace_back(separation.normalized(), nMax);
+    functors.push_back(
+        CachedCoAxialRecurrence(separation.norm(), wavenumber(), false).functor(nMax + 1));
+  }
+  auto const stride = 2 * (nfunctions(nMax) + 1);
+  Vector<t_complex> const input = Vector<t_complex>::Random(stride * scatterers.size());
+  Vector<t_complex> output = Vector<t_complex>::Zero(stride * scatterers.size());
+  auto const rows = nfunctions(nMax + 1) + 1;
+  kernels::Interleaved alpha = kernels::Interleaved::Zero(rows, 2), beta = alpha;
+
+  CacheMisses const l1(false), llc(true);
+  auto const l1_start = l1.count(), llc_start = llc.count();
+  while(state.KeepRunning())
+    for(std::size_t i(0); i < pairs.size(); ++i) {
+      kernels::ConstPotentials const in(input.data() + stride * pairs[i].second + 2,
+                                        nfunctions(nMax), 2);
+      kernels::Potentials out(output.data() + stride * pairs[i].first + 2, nfunctions(nMax), 2);
+      kernels::rotation(rotations[i], kernels::Rotate::direct, in,
+                        kernels::mutable_view(beta.middleRows(1, nfunctions(nMax))));
+      kernels::coaxial(functors[i], kernels::view(beta), kernels::mutable_view(alpha));
+      kernels::decomposition(wavenumber(), 1e-6, kernels::view(alpha), kernels::mutable_view(beta));
+      kernels::rotation(rotations[i], kernels::Rotate::adjoint,
+                        kernels::view(beta.middleRows(1, nfunctions(nMax))),
+                        kernels::mutable_view(alpha.middleRows(1, nfunctions(nMax))));
+      out -= alpha.middleRows(1, nfunctions(nMax));
+    }
+  benchmark::DoNotOptimize(output.data());
+
+  auto const visits = static_cast<t_real>(pairs.size()) * state.iterations();
+  if(l1.valid())
+    state.counters["l1_misses_per_pair"] = (l1.count() - l1_start) / visits;
+  if(llc.valid())
+    state.counters["llc_misses_per_pair"] = (llc.count() - llc_start) / visits;
+  auto const operators = 2 * rotation_elements(nMax) + functors.front().data().size();
+  set_throughput(state, pairs.size(), 0, pairs.size() * operators * sizeof(t_complex));
+}
+
+//! Spherical Bessel or Hankel functions and their derivatives, from order 0 to nMax
+template <BESSEL_TYPE TYPE> void bessel_functions(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<t_complex> arguments;
+  for(t_int i(0); i < batch; ++i)
+    arguments.emplace_back(wavenumber() * generator(), 0);
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      auto const result = bessel<TYPE>(arguments[i], nMax);
+      benchmark::DoNotOptimize(std::get<0>(result).data());
+    }
+
+  set_throughput(state, batch * (nMax + 1), 0, batch * 2 * (nMax + 1) * sizeof(t_complex));
+}
+
+void aux_coefficients(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<Spherical<t_real>> points;
+  for(t_int i(0); i < batch; ++i)
+    points.push_back(generator.spherical());
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      AuxCoefficients const aux(points[i], wavenumber(), false, nMax);
+      benchmark::DoNotOptimize(&aux.M(0));
+    }
+
+  set_throughput(state, batch * nfunctions(nMax), 0,
+                 batch * 4 * nfunctions(nMax) * sizeof(SphericalP<t_complex>));
+}
+
+void coupling(benchmark::State &state) {
+  auto const nMax = state.range(0);
+  auto const batch = state.range(1);
+  PairGenerator generator;
+  std::vector<Spherical<t_real>> separations;
+  for(t_int i(0); i < batch; ++i)
+    separations.push_back(generator.spherical());
+
+  while(state.KeepRunning())
+    for(t_int i(0); i < batch; ++i) {
+      Coupling const coupling(separations[i], wavenumber(), nMax, false);
+      benchmark::DoNotOptimize(coupling.diagonal.data());
+    }
+
+  auto const elements = static_cast<t_real>(nfunctions(nMax)) * nfunctions(nMax);
+  set_throughput(state, batch * elements, 0, batch * 2 * elements * sizeof(t_complex));
+}
+
+//! Product of the nMax and batch ranges
+void kernel_arguments(benchmark::internal::Benchmark *b) {
+  for(auto const nMax : nharmonics)
+    for(auto const batch : batches)
+      b->Args({nMax, batch});
+}
+
+//! \brief Degrees up to 10 and lattices of 4³ and 5³ spheres
+//! \details Larger problems hold too many operators in memory for a benchmark.
+void traversal_arguments(benchmark::internal::Benchmark *b) {
+  for(auto const nMax : nharmonics)
+    if(nMax <= 10)
+      for(auto const side : {4, 5})
+        b->Args({nMax, side});
+}
+
+//! \brief Parses --nmax=... and --batch=... and removes them from the command-line
+//! \details Values are separated by underscores or commas, e.g. --nmax=1_5_10.
+void parse_ranges(int &argc, char **argv) {
+  auto const parse = [](std::string const &input) {
+    std::string replaced(input);
+    for(auto &c : replaced)
+      if(c == '_' or c == ',')
+        c = ' ';
+    std::istringstream sstr(replaced);
+    std::vector<t_int> result;
+    t_int value;
+    while(sstr >> value)
+      result.push_back(value);
+    if(result.size() == 0)
+      throw std::runtime_error("Could not parse range " + input);
+    return result;
+  };
+  int j(1);
+  for(int i(1); i < argc; ++i) {
+    std::string const arg(argv[i]);
+    if(arg.find("--nmax=") == 0)
+      nharmonics = parse(arg.substr(7));
+    else if(arg.find("--batch=") == 0)
+      batches = parse(arg.substr(8));
+    else
+      argv[j++] = argv[i];
+  }
+  argc = j;
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace optimet;
+  parse_ranges(argc, argv);
+
+  ::benchmark::RegisterBenchmark("rotation", rotation)->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("coaxial_functor_construction", coaxial_functor_construction)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("coaxial_sweep", coaxial_sweep)->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("coaxial_functor", coaxial_functor<false>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("coaxial_functor_transpose", coaxial_functor<true>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("rotation_coaxial_decomposition", decomposition)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_rotation/generic", fmm_rotation<false>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_rotation/specialised", fmm_rotation<true>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_rotation/factored", fmm_factored_rotation)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_coaxial/generic", fmm_coaxial<false, false>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_coaxial/specialised", fmm_coaxial<true, false>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_coaxial_transpose/generic", fmm_coaxial<false, true>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_coaxial_transpose/specialised", fmm_coaxial<true, true>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_decomposition/generic", fmm_decomposition<false, false>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_decomposition/specialised", fmm_decomposition<true, false>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_decomposition_transpose/generic",
+                                 fmm_decomposition<false, true>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_decomposition_transpose/specialised",
+                                 fmm_decomposition<true, true>)
+      ->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("fmm_traversal/row_major", fmm_traversal<false>)
+      ->Apply(traversal_arguments);
+  ::benchmark::RegisterBenchmark("fmm_traversal/morton", fmm_traversal<true>)
+      ->Apply(traversal_arguments);
+  ::benchmark::RegisterBenchmark("bessel", bessel_functions<Bessel>)->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("hankel", bessel_functions<Hankel1>)->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("aux_coefficients", aux_coefficients)->Apply(kernel_arguments);
+  ::benchmark::RegisterBenchmark("coupling", coupling)->Apply(kernel_arguments);
+
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,235 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Strong and weak scaling of the solvers on irregular geometries
+//! \details Each invocation sets up and solves one problem on the processes it is launched with,
+//! and appends one row to a CSV file and/or one line to a JSON-lines file. A scaling study is a
+//! loop over process counts, e.g. on a single node with oversubscription:
+//!
+//!     for n in 1 2 4; do
+//!       mpirun --oversubscribe -np $n ./scaling --geometry aggregate --csv scaling.csv
+//!     done
+//!
+//! In weak scaling mode, --nobjects is the number of spheres per process.
+#include "Excitation.h"
+#include "Geometry.h"
+#include "Result.h"
+#include "Run.h"
+#include "Solver.h"
+#include "Timing.h"
+#include "Tools.h"
+#include "Types.h"
+#include "constants.h"
+#include "geometries.h"
+#if defined(OPTIMET_MPI)
+#include "mpi/Session.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+constexpr optimet::t_real default_wavelength() { return 750e-9; }
+constexpr optimet::t_real default_length() { return 2000e-9; }
+//! Phases reported individually, in addition to setup and solve
+std::vector<optimet::timing::Phase> const reported_phases = {
+    optimet::timing::Phase::t_matrix,     optimet::timing::Phase::rotations,
+    optimet::timing::Phase::translations, optimet::timing::Phase::sources,
+    optimet::timing::Phase::matvec,       optimet::timing::Phase::communication};
+
+template <class T>
+T find_arg(int argc, char *const argv[], std::string const &arg, T const &default_) {
+  for(int i(0); i < argc - 1; ++i)
+    if(std::string(argv[i]) == ("--" + arg)) {
+      std::istringstream sstr(argv[i + 1]);
+      T result;
+      sstr >> result;
+      return result;
+    }
+  return default_;
+}
+
+//! Times of each phase on this process, followed by the setup and solve times
+optimet::Vector<optimet::t_real> local_times(optimet::t_real setup) {
+  optimet::Vector<optimet::t_real> result(reported_phases.size() + 2);
+  for(std::size_t i(0); i < reported_phases.size(); ++i)
+    result(i) = optimet::timing::seconds(reported_phases[i]);
+  result(reported_phases.size()) = setup;
+  result(reported_phases.size() + 1) = optimet::timing::seconds(optimet::timing::Phase::solve);
+  return result;
+}
+
+//! A single row of the report, as pairs of column names and values
+typedef std::vector<std::pair<std::string, std::string>> Record;
+
+template <class T> void add(Record &record, std::string const &name, T const &value) {
+  std::ostringstream sstr;
+  sstr << value;
+  record.emplace_back(name, sstr.str());
+}
+
+void write_csv(std::string const &filename, Record const &record) {
+  bool const empty = std::ifstream(filename).peek() == std::ifstream::traits_type::eof();
+  std::ofstream file(filename, std::ios::app);
+  if(not file)
+    throw std::runtime_error("Could not open " + filename);
+  if(empty)
+    for(std::size_t i(0); i < record.size(); ++i)
+      file << record[i].first << (i + 1 == record.size() ? "\n" : ",");
+  for(std::size_t i(0); i < record.size(); ++i)
+    file << record[i].second << (i + 1 == record.size() ? "\n" : ",");
+}
+
+void write_json(std::string const &filename, Record const &record) {
+  std::ofstream file(filename, std::ios::app);
+  if(not file)
+    throw std::runtime_error("Could not open " + filename);
+  file << "{";
+  for(std::size_t i(0); i < record.size(); ++i) {
+    auto const &value = record[i].second;
+    auto const is_number = value.find_first_not_of("0123456789.e+-") == std::string::npos;
+    file << (i == 0 ? "" : ", ") << "\"" << record[i].first << "\": "
+         << (is_number ? value : "\"" + value + "\"");
+  }
+  file << "}\n";
+}
+}
+
+int main(int argc, char *argv[]) {
+  using namespace optimet;
+#ifdef OPTIMET_MPI
+  mpi::init(argc, const_cast<const char **>(argv));
+#endif
+  mpi::Communicator const world;
+  bool const is_root = world.rank() == world.root_id();
+
+  auto const mode = find_arg<std::string>(argc, argv, "mode", "strong");
+  auto const geometry_name = find_arg<std::string>(argc, argv, "geometry", "random");
+  auto const solver_name = find_arg<std::string>(argc, argv, "solver", "fmm");
+  auto const repeats = find_arg<t_int>(argc, argv, "repeats", 1);
+  auto const threads = find_arg<t_int>(argc, argv, "threads", 0);
+  auto const tolerance = find_arg<t_real>(argc, argv, "tolerance", 1e-8);
+  auto const csv = find_arg<std::string>(argc, argv, "csv", "");
+  auto const json = find_arg<std::string>(argc, argv, "json", "");
+  if(mode != "strong" and mode != "weak")
+    throw std::runtime_error("Scaling mode should be strong or weak");
+  if(solver_name != "fmm" and solver_name != "dense")
+    throw std::runtime_error("Solver should be fmm or dense");
+#ifndef OPTIMET_MPI
+  if(solver_name == "fmm")
+    throw std::runtime_error("Serial builds only provide the dense solver");
+#endif
+  if(threads > 0)
+    Eigen::setNbThreads(threads);
+
+  geometries::Options options;
+  auto const nobjects = find_arg<t_uint>(argc, argv, "nobjects", 64);
+  options.nobjects = mode == "weak" ? nobjects * world.size() : nobjects;
+  options.nMax = find_arg<t_int>(argc, argv, "nharmonics", 5);
+  options.radius = find_arg<t_real>(argc, argv, "radius", 0.25) * default_length();
+  options.fraction = find_arg<t_real>(argc, argv, "fraction", options.fraction);
+  options.spread = find_arg<t_real>(argc, argv, "spread", options.spread);
+  options.layers = find_arg<t_uint>(argc, argv, "layers", options.layers);
+  options.seed = find_arg<std::uint64_t>(argc, argv, "seed", options.seed);
+
+  // Every process generates the same geometry from the same seed
+  auto const geometry = std::make_shared<Geometry>();
+  geometry->pushObjects(geometries::generate(geometry_name, options));
+
+  Spherical<t_real> const vKinc{2 * consPi / default_wavelength(), 90 * consPi / 180.0,
+                                90 * consPi / 180.0};
+  SphericalP<t_complex> const Eaux{0e0, 1e0, 0e0};
+  auto const excitation =
+      std::make_shared<Excitation>(0, Tools::toProjection(vKinc, Eaux), vKinc, options.nMax);
+  excitation->populate();
+  geometry->update(excitation);
+
+  Run input;
+  input.geometry = geometry;
+  input.excitation = excitation;
+  input.do_fmm = solver_name == "fmm";
+  input.fmm_subdiagonals = find_arg<t_int>(
+      argc, argv, "fmm_subdiagonals", std::max<int>(1, geometry->objects.size() / 2 - 2));
+#ifdef OPTIMET_BELOS
+  input.belos_params = Teuchos::rcp(new Teuchos::ParameterList);
+  input.belos_params->set("Solver", input.do_fmm ? "GMRES" : "scalapack");
+  input.belos_params->set("Convergence Tolerance", tolerance);
+  input.belos_params->set("Maximum Iterations",
+                          find_arg<t_int>(argc, argv, "max_iterations", 1000));
+#endif
+
+  timing::reset();
+  auto const start = std::chrono::steady_clock::now();
+  auto const solver = solver::factory(input);
+  std::chrono::duration<t_real> const setup = std::chrono::steady_clock::now() - start;
+
+  Result result(input.geometry, input.excitation);
+  for(t_int i(0); i < repeats; ++i) {
+    result.scatter_coef.fill(0);
+    result.internal_coef.fill(0);
+    timing::Timer const timer(timing::Phase::solve);
+    solver->solve(result.scatter_coef, result.internal_coef);
+  }
+
+  // Load imbalance shows up as the ratio of the slowest process to the mean
+  auto const local = local_times(setup.count());
+#ifdef OPTIMET_MPI
+  Vector<t_real> const maximum = world.all_reduce(local, MPI_MAX);
+  Vector<t_real> const mean = world.all_reduce(local, MPI_SUM) / world.size();
+  auto const iterations = world.all_reduce(timing::calls(timing::Phase::iterations), MPI_MAX);
+#else
+  auto const &maximum = local, &mean = local;
+  auto const iterations = timing::calls(timing::Phase::iterations);
+#endif
+
+  if(is_root) {
+    Record record;
+    add(record, "mode", mode);
+    add(record, "geometry", geometry_name);
+    add(record, "solver", solver_name);
+    add(record, "nprocs", world.size());
+    add(record, "nthreads", Eigen::nbThreads());
+    add(record, "nobjects", geometry->objects.size());
+    add(record, "nharmonics", options.nMax);
+    add(record, "repeats", repeats);
+    add(record, "tolerance", tolerance);
+    add(record, "iterations", static_cast<t_real>(iterations) / repeats);
+    add(record, "setup", maximum(reported_phases.size()));
+    add(record, "solve", maximum(reported_phases.size() + 1) / repeats);
+    for(std::size_t i(0); i < reported_phases.size(); ++i)
+      add(record, timing::name(reported_phases[i]), maximum(i));
+    auto const matvec = std::find(reported_phases.begin(), reported_phases.end(),
+                                  timing::Phase::matvec) -
+                        reported_phases.begin();
+    add(record, "matvec_imbalance", mean(matvec) > 0 ? maximum(matvec) / mean(matvec) : 1);
+
+    std::cout << "scaling:\n";
+    for(auto const &item : record)
+      std::cout << "    " << item.first << ": " << item.second << "\n";
+    std::cout << "---\n";
+    if(not csv.empty())
+      write_csv(csv, record);
+    if(not json.empty())
+      write_json(json, record);
+  }
+
+#ifdef OPTIMET_MPI
+  mpi::finalize();
+#endif
+  return 0;
+}
@@ -0,0 +1,117 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "CompoundIterator.h"
+#include "ElectroMagnetic.h"
+#include "Scatterer.h"
+#include "Symbol.h"
+#include "Types.h"
+#include "constants.h"
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+constexpr optimet::t_real default_wavelength() { return 750e-9; }
+constexpr optimet::t_real default_length() { return 2000e-9; }
+}
+
+template <class T>
+T find_arg(int argc, char *const argv[], std::string const &arg, T const &default_) {
+  for(int i(0); i < argc - 1; ++i)
+    if(std::string(argv[i]) == ("--" + arg)) {
+      std::istringstream sstr(argv[i + 1]);
+      T result;
+      sstr >> result;
+      return result;
+    }
+  return default_;
+}
+
+int main(int argc, char *const argv[]) {
+  using namespace optimet;
+  auto const iterations = find_arg<t_int>(argc, argv, "iterations", 10);
+  auto const warmup = find_arg<t_int>(argc, argv, "warmup", 1);
+  auto const nobjects = find_arg<t_int>(argc, argv, "nobjects", 10);
+  auto const radius = find_arg<t_real>(argc, argv, "radius", 0.25);
+  auto const nmin = find_arg<t_int>(argc, argv, "nmin", 2);
+  auto const nmax = find_arg<t_int>(argc, argv, "nmax", 10);
+
+  ElectroMagnetic elmag{13.1, 1.0};
+  elmag.b_SH = {1, 0};
+  elmag.a_SH = {1, 0};
+  elmag.d_SH = {1, 0};
+  elmag.epsilon_SH = 13.1 * consEpsilon0;
+  ElectroMagnetic const bground;
+  // frequency of the second harmonic, as passed by the simulation
+  auto const omega = 4 * consPi * consC / default_wavelength();
+
+  for(t_int nMax(nmin); nMax <= nmax; ++nMax) {
+    std::vector<Scatterer> objects;
+    for(t_int i(0); i < nobjects; ++i)
+      objects.emplace_back(Spherical<t_real>{0, 0, 0}, elmag,
+                           radius * default_length() * (1 + 0.1 * i / nobjects), nMax);
+    auto const pMax = CompoundIterator::max(nMax);
+    Vector<t_complex> const input = Vector<t_complex>::Random(2 * pMax * nobjects);
+
+    // Building the coupling table happens once per nMax
+    auto start = std::chrono::high_resolution_clock::now();
+    auto const table = symbol::CouplingTable::get(nMax);
+    auto end = std::chrono::high_resolution_clock::now();
+    auto const setup = std::chrono::duration_cast<std::chrono::duration<double>>(end - start);
+
+    for(int i(0); i < warmup; ++i)
+      for(t_int j(0); j < nobjects; ++j)
+        symbol::source_coefficients(input.segment(2 * pMax * j, 2 * pMax), omega, objects[j],
+                                    bground, nMax);
+    t_real elapsed(0);
+    for(int i(0); i < iterations; ++i) {
+      start = std::chrono::high_resolution_clock::now();
+      for(t_int j(0); j < nobjects; ++j)
+        symbol::source_coefficients(input.segment(2 * pMax * j, 2 * pMax), omega, objects[j],
+                                    bground, nMax);
+      end = std::chrono::high_resolution_clock::now();
+      elapsed += std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+    }
+
+    std::cout << "sh sources:\n";
+#ifdef __APPLE__
+    std::cout << "    os: Apple\n";
+#else
+    std::cout << "    os: Unix\n";
+#endif
+#ifdef __INTEL_COMPILER
+    std::cout << "    compiler: intel " << __VERSION__ << "\n";
+#elif defined(__APPLE_CC__)
+    std::cout << "    compiler: clang " << __VERSION__ << "\n";
+#elif defined(__GNUC__)
+    std::cout << "    compiler: gnu " << __VERSION__ << "\n";
+#else
+    std::cout << "    compiler: unknown " << __VERSION__ << "\n";
+#endif
+    std::cout << "    program: " << argv[0] << "\n";
+    std::cout << "    nharmonics: " << nMax << "\n";
+    std::cout << "    nobjects: " << nobjects << "\n";
+    std::cout << "    iterations: " << iterations << "\n";
+    std::cout << "    table entries: " << table->size() << "\n";
+    std::cout << "    Table time: " << setup.count() << " seconds\n";
+    std::cout << "    Total time: " << elapsed << " seconds\n";
+    std::cout << "    Timing: " << elapsed / iterations << " seconds\n";
+    std::cout << "---\n";
+  }
+  return 0;
+}
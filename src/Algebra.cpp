@@ -53,21 +53,6 @@ void Algebra::multiplyMatrixMatrix(std::complex<double> **A, int rows_A_,
   delete[] C_cblas;
 }
 
-void Algebra::multiplyVectorMatrix(std::complex<double> **A, int rows_A_,
-                                   int cols_A_, std::complex<double> const *X,
-                                   std::complex<double> *Y,
-                                   std::complex<double> alpha_,
-                                   std::complex<double> beta_) {
-  std::complex<double> *A_cblas = new std::complex<double>[rows_A_ * cols_A_];
-
-  matrixToVector(rows_A_, cols_A_, A, A_cblas);
-
-  cblas_zgemv(CblasRowMajor, CblasNoTrans, rows_A_, cols_A_, &alpha_, A_cblas,
-              rows_A_, X, 1, &beta_, Y, 1);
-
-  delete[] A_cblas;
-}
-
 void Algebra::matrixToVector(long rows_, long columns_,
                              std::complex<double> **T_,
                              std::complex<double> *V_) {
@@ -56,22 +56,6 @@ public:
                                    std::complex<double> alpha_,
                                    std::complex<double> beta_);
 
-  /**
-   * Implements the multiplication Y = alpha*A*X + beta*Y
-   * @param A the A matrix.
-   * @param rows_A_ the number of rows of A.
-   * @param cols_A_ the number of columns of A.
-   * @param X the X vector.
-   * @param Y the Y vector (return vector).
-   * @param alpha_ the scalar alpha.
-   * @param beta_ the scalar beta.
-   */
-  static void multiplyVectorMatrix(std::complex<double> **A, int rows_A_,
-                                   int cols_A_, std::complex<double> const *X,
-                                   std::complex<double> *Y,
-                                   std::complex<double> alpha_,
-                                   std::complex<double> beta_);
-
   /**
    * Convert a Matrix into a Vector.
    * @param rows_ the number of rows of the matrix.
@@ -0,0 +1,348 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Autotune.h"
+#include "Memory.h"
+#include "Result.h"
+#include "Run.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace optimet {
+namespace autotune {
+namespace {
+//! Number of unknowns targeted by the calibration trials
+constexpr t_real trial_unknowns() { return 1200; }
+//! Block sizes tried with Scalapack
+constexpr t_uint block_sizes[] = {32, 64, 128};
+//! Restart lengths of GMRES, the longest that fits is used
+constexpr t_int restart_lengths[] = {300, 100, 50};
+
+bool is_iterative(solver::Kind kind) {
+  return kind == solver::Kind::belos or kind == solver::Kind::fmm;
+}
+
+//! Configuration as integers, e.g. to broadcast it
+Vector<t_int> pack(Configuration const &configuration) {
+  Vector<t_int> result(5);
+  result << static_cast<t_int>(configuration.kind), configuration.subdiagonals,
+      static_cast<t_int>(configuration.block_size), configuration.num_blocks,
+      configuration.threads;
+  return result;
+}
+
+Configuration unpack(Vector<t_int> const &data) {
+  return {static_cast<solver::Kind>(data(0)), data(1), static_cast<t_uint>(data(2)), data(3),
+          data(4)};
+}
+
+//! Same run restricted to its first objects, with its own parameters
+Run subset(Run const &run, t_uint nobjects) {
+  Run result = run;
+  result.geometry = std::make_shared<Geometry>(*run.geometry);
+  auto &objects = result.geometry->objects;
+  if(nobjects < objects.size())
+    objects.erase(objects.begin() + nobjects, objects.end());
+#ifdef OPTIMET_BELOS
+  if(not run.belos_params.is_null())
+    result.belos_params = Teuchos::rcp(new Teuchos::ParameterList(*run.belos_params));
+#endif
+  // trials should neither read nor fill the cache of the actual problem
+  result.cache = OperatorCache();
+  result.cache_coefficients = false;
+  return result;
+}
+
+//! Times a function, maximum over processes
+template <class FUNCTOR> t_real time(FUNCTOR &&functor, mpi::Communicator const &comm) {
+  auto const start = std::chrono::steady_clock::now();
+  functor();
+  std::chrono::duration<t_real> const elapsed = std::chrono::steady_clock::now() - start;
+#ifdef OPTIMET_MPI
+  return comm.all_reduce(elapsed.count(), MPI_MAX);
+#else
+  (void)comm;
+  return elapsed.count();
+#endif
+}
+} // namespace
+
+std::string to_string(Configuration const &configuration) {
+  std::ostringstream sstr;
+  sstr << "solver=" << solver::name(configuration.kind)
+       << " subdiagonals=" << configuration.subdiagonals
+       << " block_size=" << configuration.block_size
+       << " num_blocks=" << configuration.num_blocks << " threads=" << configuration.threads;
+  return sstr.str();
+}
+
+Configuration configuration(std::string const &string) {
+  std::map<std::string, std::string> values;
+  std::istringstream sstr(string);
+  std::string pair;
+  while(sstr >> pair) {
+    auto const equal = pair.find('=');
+    if(equal != std::string::npos)
+      values[pair.substr(0, equal)] = pair.substr(equal + 1);
+  }
+  for(auto const key : {"solver", "subdiagonals", "block_size", "num_blocks", "threads"})
+    if(values.count(key) == 0)
+      throw std::runtime_error("Missing " + std::string(key) + " in configuration " + string);
+
+  Configuration result;
+  bool found = false;
+  for(auto const kind : {solver::Kind::eigen, solver::Kind::scalapack, solver::Kind::belos,
+                         solver::Kind::fmm})
+    if(values["solver"] == solver::name(kind)) {
+      result.kind = kind;
+      found = true;
+    }
+  if(not found)
+    throw std::runtime_error("Unknown solver " + values["solver"]);
+  result.subdiagonals = std::stoi(values["subdiagonals"]);
+  result.block_size = std::stoi(values["block_size"]);
+  result.num_blocks = std::stoi(values["num_blocks"]);
+  result.threads = std::stoi(values["threads"]);
+  return result;
+}
+
+std::string problem_class(Run const &run, t_uint nprocs) {
+  t_uint objects = 1;
+  while(objects < run.geometry->objects.size())
+    objects *= 2;
+  std::ostringstream sstr;
+  sstr << "objects<=" << objects << " nmax=" << run.geometry->nMax() << " processes=" << nprocs;
+  return sstr.str();
+}
+
+void apply(Configuration const &configuration, Run &run) {
+  run.parallel_params.block_size = configuration.block_size;
+  run.do_fmm = configuration.kind == solver::Kind::fmm;
+  if(run.do_fmm)
+    run.fmm_subdiagonals = configuration.subdiagonals;
+#ifdef OPTIMET_BELOS
+  if(run.belos_params.is_null())
+    run.belos_params = Teuchos::rcp(new Teuchos::ParameterList);
+  auto const current = run.belos_params->get<std::string>("Solver", "scalapack");
+  if(configuration.kind == solver::Kind::eigen)
+    run.belos_params->set<std::string>("Solver", "eigen");
+  else if(configuration.kind == solver::Kind::scalapack)
+    run.belos_params->set<std::string>("Solver", "scalapack");
+  else {
+    // keeps the Belos solver chosen by the user, if any
+    if(current == "eigen" or current == "scalapack")
+      run.belos_params->set<std::string>("Solver", "GMRES");
+    run.belos_params->set("Num Blocks", configuration.num_blocks);
+  }
+#endif
+}
+
+std::vector<Configuration> candidates(Run const &run, t_uint nprocs, t_real budget) {
+  auto const nobjects = static_cast<t_int>(run.geometry->objects.size());
+  auto const fits = [&run, nprocs, budget](Configuration const &configuration) {
+    if(budget <= 0)
+      return true;
+    auto tried = run;
+    apply(configuration, tried);
+    return memory::predict(configuration.kind, tried, nprocs).total() <= budget;
+  };
+
+  std::vector<Configuration> result;
+  for(auto const kind : solver::available()) {
+    Configuration configuration{kind, 1, run.parallel_params.block_size, restart_lengths[0], 0};
+    switch(kind) {
+    case solver::Kind::eigen:
+      // multi-threading only matters for the dense factorization
+      for(auto const threads : {1, Eigen::nbThreads()}) {
+        configuration.threads = threads;
+        if(fits(configuration))
+          result.push_back(configuration);
+        if(Eigen::nbThreads() == 1)
+          break;
+      }
+      break;
+    case solver::Kind::scalapack:
+      for(auto const block_size : block_sizes) {
+        configuration.block_size = block_size;
+        if(fits(configuration))
+          result.push_back(configuration);
+      }
+      break;
+    case solver::Kind::belos:
+    case solver::Kind::fmm: {
+      std::vector<t_int> subdiagonals = {1};
+      if(kind == solver::Kind::fmm)
+        subdiagonals = {1, std::max(1, nobjects / 4), std::max(1, nobjects / 2 - 2), nobjects};
+      std::sort(subdiagonals.begin(), subdiagonals.end());
+      subdiagonals.erase(std::unique(subdiagonals.begin(), subdiagonals.end()), subdiagonals.end());
+      for(auto const diagonals : subdiagonals) {
+        configuration.subdiagonals = diagonals;
+        // longer restarts converge in fewer iterations, so use the longest that fits
+        for(auto const num_blocks : restart_lengths) {
+          configuration.num_blocks = num_blocks;
+          if(fits(configuration)) {
+            result.push_back(configuration);
+            break;
+          }
+        }
+      }
+      break;
+    }
+    }
+  }
+  return result;
+}
+
+std::vector<Trial> calibrate(Run const &run, std::vector<Configuration> const &candidates,
+                             t_uint nobjects, mpi::Communicator const &comm) {
+  auto const trial_run = subset(run, nobjects);
+  auto const ratio = static_cast<t_real>(run.geometry->objects.size()) /
+                     std::max<t_real>(1, trial_run.geometry->objects.size());
+  auto const unknowns = static_cast<t_real>(run.geometry->scatterer_size()) /
+                        std::max<t_real>(1, trial_run.geometry->scatterer_size());
+  auto const threads = Eigen::nbThreads();
+
+  std::vector<Trial> result;
+  for(auto const &candidate : candidates) {
+    auto tried = trial_run;
+    apply(candidate, tried);
+    // subdiagonals are relative to the number of objects
+    tried.fmm_subdiagonals =
+        std::max<t_int>(1, std::lround(candidate.subdiagonals / ratio));
+    if(candidate.threads > 0)
+      Eigen::setNbThreads(candidate.threads);
+
+    std::shared_ptr<solver::AbstractSolver> solver;
+    auto const setup = time([&solver, &tried]() { solver = solver::factory(tried); }, comm);
+    Result solution(tried.geometry, tried.excitation);
+    t_int converged = true;
+    auto const solve = time(
+        [&solver, &solution, &converged]() {
+          try {
+            solver->solve(solution.scatter_coef, solution.internal_coef);
+          } catch(std::runtime_error const &) {
+            // a trial that does not converge is as slow as its maximum number of iterations
+            converged = false;
+          }
+        },
+        comm);
+    Eigen::setNbThreads(threads);
+#ifdef OPTIMET_MPI
+    converged = comm.all_reduce(converged, MPI_MIN);
+#endif
+
+    Trial trial;
+    trial.configuration = candidate;
+    trial.converged = converged;
+    trial.setup = setup * ratio * ratio;
+    trial.solve = is_iterative(candidate.kind) ? solve * ratio * ratio :
+                                                 solve * unknowns * unknowns * unknowns;
+    auto full = run;
+    apply(candidate, full);
+    trial.footprint = memory::predict(candidate.kind, full, comm.size()).total();
+    result.push_back(trial);
+  }
+  return result;
+}
+
+bool load(std::string const &filename, std::string const &problem, Configuration &configuration) {
+  std::ifstream file(filename);
+  if(not file)
+    return false;
+  bool found = false;
+  std::string line;
+  while(std::getline(file, line)) {
+    if(line.empty() or line[0] == '#' or line.compare(0, problem.size(), problem) != 0)
+      continue;
+    auto const rest = line.substr(problem.size());
+    if(rest.empty() or rest[0] != ':')
+      continue;
+    configuration = autotune::configuration(rest.substr(1));
+    found = true;
+  }
+  return found;
+}
+
+void save(std::string const &filename, std::string const &problem,
+          std::vector<Trial> const &trials, Configuration const &decision) {
+  std::ofstream file(filename, std::ios::app);
+  if(not file)
+    throw std::runtime_error("Could not open autotune file " + filename);
+  for(auto const &trial : trials)
+    file << "# " << problem << ": " << to_string(trial.configuration) << " setup=" << trial.setup
+         << "s solve=" << trial.solve << "s memory=" << memory::format_bytes(trial.footprint)
+         << (trial.converged ? "" : " not converged") << "\n";
+  file << problem << ": " << to_string(decision) << "\n";
+}
+
+Configuration tune(Run &run, mpi::Communicator const &comm) {
+  bool const is_root = comm.rank() == comm.root_id();
+  auto const problem = problem_class(run, comm.size());
+
+  Configuration decision;
+  t_int loaded = is_root and load(run.autotune_file, problem, decision);
+#ifdef OPTIMET_MPI
+  loaded = comm.broadcast(loaded);
+  if(loaded)
+    decision = unpack(is_root ? comm.broadcast(pack(decision)) : comm.broadcast<Vector<t_int>>());
+#endif
+
+  if(not loaded) {
+    auto const budget = memory::budget(run, comm);
+    auto const tried = candidates(run, comm.size(), budget);
+    if(tried.empty())
+      throw std::runtime_error("Autotune: no solver fits in " + memory::format_bytes(budget) +
+                               " per process");
+    auto const nmax = run.geometry->nMax();
+    auto const automatic = std::max<t_int>(std::max<t_int>(2, comm.size()),
+                                           std::ceil(trial_unknowns() / (2 * nmax * (nmax + 2))));
+    auto const nobjects = run.autotune_objects > 0 ? run.autotune_objects : automatic;
+    auto const trials = calibrate(run, tried, nobjects, comm);
+    // configurations that do not converge on the trial problem are never chosen
+    auto const best = std::min_element(trials.begin(), trials.end(),
+                                       [](Trial const &a, Trial const &b) {
+                                         if(a.converged != b.converged)
+                                           return a.converged;
+                                         return a.total() < b.total();
+                                       });
+    if(not best->converged)
+      throw std::runtime_error("Autotune: no candidate solver converged on the trial problem");
+    decision = best->configuration;
+    if(is_root) {
+      save(run.autotune_file, problem, trials, decision);
+      for(auto const &trial : trials)
+        std::cout << "Autotune trial " << to_string(trial.configuration) << ": "
+                  << (trial.converged ? std::to_string(trial.total()) + " seconds predicted" :
+                                        std::string("did not converge"))
+                  << "\n";
+    }
+  }
+
+  apply(decision, run);
+  if(decision.threads > 0)
+    Eigen::setNbThreads(decision.threads);
+  if(is_root)
+    std::cout << "Autotune " << (loaded ? "read " : "chose ") << to_string(decision) << "\n";
+  return decision;
+}
+} // namespace autotune
+} // namespace optimet
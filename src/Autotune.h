@@ -0,0 +1,99 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_AUTOTUNE_H
+#define OPTIMET_AUTOTUNE_H
+
+#include "Solver.h"
+#include "Types.h"
+#include "mpi/Communicator.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace optimet {
+class Run;
+
+//! \brief Choice of solver and parameters from short calibration trials
+//! \details Each candidate configuration is set up and solved on a subset of the objects. Setup
+//! times are extrapolated quadratically in the number of objects, direct solves cubically in the
+//! number of unknowns and iterative solves quadratically in the number of objects, at the same
+//! number of iterations. Candidates predicted not to fit in the memory budget are skipped. The
+//! decision is appended to a file, so that later runs of the same class of problem skip the
+//! trials.
+namespace autotune {
+//! Solver and parameters of a run
+struct Configuration {
+  //! Which solver to use
+  solver::Kind kind;
+  //! Number of subdiagonals computed locally by the FMM
+  t_int subdiagonals;
+  //! Block size of the Scalapack distribution
+  t_uint block_size;
+  //! Restart length of GMRES
+  t_int num_blocks;
+  //! Number of threads used by Eigen, or zero to leave it unchanged
+  t_int threads;
+};
+//! Formats a configuration as space separated key=value pairs
+std::string to_string(Configuration const &configuration);
+//! \brief Parses the output of `to_string`
+//! \details Throws if the string is not a configuration.
+Configuration configuration(std::string const &string);
+
+//! Timings of a configuration, extrapolated to the full problem
+struct Trial {
+  Configuration configuration;
+  //! Seconds to set up the solver
+  t_real setup;
+  //! Seconds to solve
+  t_real solve;
+  //! Predicted memory per process, in bytes
+  t_real footprint;
+  //! Whether the trial solve converged
+  bool converged;
+
+  t_real total() const { return setup + solve; }
+};
+
+//! \brief Runs sharing a class share their tuning decisions
+//! \details Same maximum degree, same number of processes, and numbers of objects rounded up to
+//! the same power of two.
+std::string problem_class(Run const &run, t_uint nprocs);
+//! Sets the solver and parameters of a run
+void apply(Configuration const &configuration, Run &run);
+//! Configurations available in this build which fit in the budget, or all if the budget is zero
+std::vector<Configuration> candidates(Run const &run, t_uint nprocs, t_real budget);
+//! \brief Times each candidate on the first `nobjects` objects of the run
+//! \details Collective. Times are the maximum over processes. Trials that do not converge are
+//! timed to their maximum number of iterations and flagged as such.
+std::vector<Trial> calibrate(Run const &run, std::vector<Configuration> const &candidates,
+                             t_uint nobjects, mpi::Communicator const &comm);
+
+//! \brief Last decision recorded for a class of problem
+//! \returns false if the file does not exist or holds no decision for this class
+bool load(std::string const &filename, std::string const &problem, Configuration &configuration);
+//! Appends the trials, as comments, and the decision to a file
+void save(std::string const &filename, std::string const &problem,
+          std::vector<Trial> const &trials, Configuration const &decision);
+
+//! \brief Chooses the solver and parameters of a run, then applies them
+//! \details Reads the decision from the autotune file of the run if it has one for this class of
+//! problem, otherwise runs calibration trials and records the decision. Collective.
+Configuration tune(Run &run, mpi::Communicator const &comm);
+} // namespace autotune
+} // namespace optimet
+#endif
@@ -118,9 +118,63 @@ CachedCoAxialRecurrence::Functor CachedCoAxialRecurrence::functor(t_int N) {
   // now assign them
   std::vector<t_complex> coefficients;
   for(auto n = 0; n <= N; ++n)
-    for(auto m = -n; m <= n; ++m)
-      for(auto l = std::abs(m); l <= N; ++l)
+    for(auto m = 0; m <= n; ++m)
+      for(auto l = m; l <= N; ++l)
         coefficients.push_back(operator()(n, m, l));
   return Functor(N, std::move(coefficients));
 }
+
+CachedCoAxialRecurrence::Functor const &CoAxialSweep::
+operator()(t_real distance, t_complex waveK, t_int N, bool regular) {
+  using coefficient::a;
+  using coefficient::b;
+  assert(N >= 0);
+  functor_.coefficients.resize(CachedCoAxialRecurrence::Functor::offset(N, N + 1, 0));
+  functor_.N = N;
+
+  // degree n of order m is needed up to l = 2N - n, for the recurrences of higher degrees
+  t_int const L = 2 * N + 1;
+  lower_.resize((N + 1) * L);
+  level_.resize((N + 1) * L);
+  auto const level = [this, L](t_int n, t_int l) -> Complex & { return level_[n * L + l]; };
+  auto const lower = [this, L](t_int n, t_int l) -> Complex const & { return lower_[n * L + l]; };
+
+  // values from the tables, with the coefficients of l < n from those of l > n
+  auto const output = [this, N, &level](t_int m) {
+    for(t_int n(m); n <= N; ++n)
+      for(t_int l(m); l <= N; ++l) {
+        Complex const factor = static_cast<Complex>((l + n) % 2 == 0 ? 1 : -1);
+        auto const value = static_cast<t_complex>(l >= n ? level(n, l) : level(l, n) * factor);
+        functor_.coefficients[CachedCoAxialRecurrence::Functor::offset(N, n, m) + l - m] = value;
+      }
+  };
+
+  // m = 0: initial values and zonal recurrence
+  Complex const wave = static_cast<Real>(distance) * static_cast<Complex>(waveK);
+  auto const bessel = regular ? optimet::bessel<Bessel> : optimet::bessel<Hankel1>;
+  auto const functions = std::get<0>(bessel(static_cast<t_complex>(wave), 2 * N));
+  for(t_int l(0); l < L; ++l)
+    level(0, l) = static_cast<Real>(std::sqrt(2 * l + 1) * (l % 2 == 0 ? 1 : -1)) *
+                  static_cast<Complex>(functions[l]);
+  for(t_int n(1); n <= N; ++n)
+    for(t_int l(n); l < L - n; ++l)
+      level(n, l) = (level(n - 1, l - 1) * a<Real>(l - 1, 0) +
+                     (n >= 2 ? level(n - 2, l) * a<Real>(n - 2, 0) : Complex(0)) -
+                     level(n - 1, l + 1) * a<Real>(l, 0)) /
+                    a<Real>(n - 1, 0);
+  output(0);
+
+  // m > 0: sectorial and off-diagonal recurrences, from order m - 1
+  for(t_int m(1); m <= N; ++m) {
+    std::swap(lower_, level_);
+    for(t_int n(m); n <= N; ++n)
+      for(t_int l(n); l < L - n; ++l)
+        level(n, l) = (lower(n - 1, l - 1) * b<Real>(l, -m) +
+                       (n - 2 >= m ? level(n - 2, l) * b<Real>(n - 1, m - 1) : Complex(0)) -
+                       lower(n - 1, l + 1) * b<Real>(l + 1, m - 1)) /
+                      b<Real>(n, -m);
+    output(m);
+  }
+  return functor_;
+}
 }
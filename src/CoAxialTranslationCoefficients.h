@@ -26,12 +26,27 @@
 #include "Spherical.h"
 
 namespace optimet {
+class CoAxialSweep;
+
 class CachedCoAxialRecurrence {
 public:
   class Functor {
+    friend class CoAxialSweep;
+
   public:
     //! Creates from coefficients that are moved here
     Functor(t_int N, std::vector<t_complex> &&coeffs) : N(N), coefficients(std::move(coeffs)) {}
+    //! Maximum degree of the translation
+    t_int nmax() const { return N; }
+    //! \brief Coefficients of the translation, in the order they are applied
+    //! \details Stored for n from 0 to N, m from 0 to n, l from m to N. The coefficients of -m are
+    //! those of m, Gumerov (4.81), and both orders are applied together.
+    std::vector<t_complex> const &data() const { return coefficients; }
+    //! Position of the coefficient (n, |m|, l = |m|) in a functor of degree N
+    static constexpr t_int offset(t_int N, t_int n, t_int m) {
+      return m < 0 ? offset(N, n, -m) : (N + 1) * n * (n + 1) / 2 - (n - 1) * n * (n + 1) / 6 +
+                                            m * (N + 1) - m * (m - 1) / 2;
+    }
     //! Applies direct functor
     template <class T0, class T1>
     typename std::enable_if<std::is_same<typename T0::Scalar, t_complex>::value>::type
@@ -111,6 +126,32 @@ protected:
   Complex coeff(t_int n, t_int m, t_int l);
 };
 
+//! \brief Co-axial translation coefficients computed in a single sweep, without a cache
+//! \details Same recurrences, in the same order of operations, as
+//! `CachedCoAxialRecurrence::functor`. The sweep goes through the orders m, keeping only two dense
+//! tables of degrees (n, l) for the orders m - 1 and m, e.g. about 30kB at nMax = 15. The
+//! spherical Bessel or Hankel functions are computed once for all degrees. Tables and
+//! coefficients are reused from one call to the next, so that recomputing the translations of
+//! many pairs does not allocate.
+class CoAxialSweep {
+public:
+  typedef CachedCoAxialRecurrence::Real Real;
+  typedef CachedCoAxialRecurrence::Complex Complex;
+
+  CoAxialSweep() : functor_(0, std::vector<t_complex>()) {}
+
+  //! \brief Coefficients of a translation by `distance`, up to degree N
+  //! \details The functor is overwritten by the next call.
+  CachedCoAxialRecurrence::Functor const &
+  operator()(t_real distance, t_complex waveK, t_int N, bool regular = true);
+
+private:
+  //! Coefficients of the last call
+  CachedCoAxialRecurrence::Functor functor_;
+  //! Coefficients of orders m - 1 and m, for degrees n from 0 to N and l from 0 to 2N
+  std::vector<Complex> lower_, level_;
+};
+
 template <class T0, class T1>
 typename std::enable_if<std::is_same<typename T0::Scalar, t_complex>::value>::type
 CachedCoAxialRecurrence::
@@ -163,16 +204,18 @@ operator()(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &out)
   assert(index(N, N) + 1 == input.rows());
   const_cast<Eigen::MatrixBase<T1> &>(out).resize(input.rows(), input.cols());
   const_cast<Eigen::MatrixBase<T1> &>(out).fill(0);
-  auto i_coeff = with_n0 ? coefficients.begin() : (coefficients.begin() + N + 1);
-  for(auto n = min_n, i = 0; n <= N; ++n)
-    for(auto m = -n; m <= n; ++m, ++i)
-      for(auto l = std::abs(m); l <= N; ++l, ++i_coeff) {
-        assert(i_coeff != coefficients.end());
-        auto const i_out = index(l, m);
-        assert(i < input.rows());
-        if(i_out >= 0 and i_out < out.rows())
-          const_cast<Eigen::MatrixBase<T1> &>(out).row(i_out) += (*i_coeff) * input.row(i);
+  auto &result = const_cast<Eigen::MatrixBase<T1> &>(out);
+  // m and -m share their coefficients, and each row of the output only sees its own order
+  for(auto n = min_n; n <= N; ++n)
+    for(auto m = 0; m <= n; ++m) {
+      auto const c = coefficients.begin() + offset(this->N, n, m) - m;
+      assert(c + N + 1 <= coefficients.end());
+      for(auto l = std::max(m, min_n); l <= N; ++l) {
+        result.row(index(l, m)) += c[l] * input.row(index(n, m));
+        if(m != 0)
+          result.row(index(l, -m)) += c[l] * input.row(index(n, -m));
       }
+    }
 }
 
 template <class T0, class T1>
@@ -193,16 +236,18 @@ CachedCoAxialRecurrence::Functor::transpose(Eigen::MatrixBase<T0> const &input,
   assert(index(N, N) + 1 == input.rows());
   const_cast<Eigen::MatrixBase<T1> &>(out).resize(input.rows(), input.cols());
   const_cast<Eigen::MatrixBase<T1> &>(out).fill(0);
-  auto i_coeff = with_n0 ? coefficients.begin() : (coefficients.begin() + N + 1);
-  for(auto n = min_n, i = 0; n <= N; ++n)
-    for(auto m = -n; m <= n; ++m, ++i)
-      for(auto l = std::abs(m); l <= N; ++l, ++i_coeff) {
-        assert(i_coeff != coefficients.end());
-        assert(i < out.rows());
-        auto const i_in = index(l, m);
-        if(i_in >= 0 and i_in < input.rows())
-          const_cast<Eigen::MatrixBase<T1> &>(out).row(i) += (*i_coeff) * input.row(i_in);
+  auto &result = const_cast<Eigen::MatrixBase<T1> &>(out);
+  // m and -m share their coefficients
+  for(auto n = min_n; n <= N; ++n)
+    for(auto m = 0; m <= n; ++m) {
+      auto const c = coefficients.begin() + offset(this->N, n, m) - m;
+      assert(c + N + 1 <= coefficients.end());
+      for(auto l = std::max(m, min_n); l <= N; ++l) {
+        result.row(index(n, m)) += c[l] * input.row(index(l, m));
+        if(m != 0)
+          result.row(index(n, -m)) += c[l] * input.row(index(l, -m));
       }
+    }
 }
 
 template <class T>
@@ -0,0 +1,132 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "CoefficientsFile.h"
+#include <stdexcept>
+
+namespace optimet {
+namespace {
+std::string group_name(std::string const &kind, std::string const &hash) {
+  return kind + "_" + hash;
+}
+
+void write_attribute(hid_t location, std::string const &name, hid_t type, void const *value) {
+  auto const space = H5Screate(H5S_SCALAR);
+  auto const attribute = H5Acreate(location, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attribute, type, value);
+  H5Aclose(attribute);
+  H5Sclose(space);
+}
+
+void write_dataset(hid_t location, std::string const &name, Vector<t_complex> const &data) {
+  // complex numbers are stored as contiguous pairs of doubles
+  hsize_t const dims[2] = {static_cast<hsize_t>(data.size()), 2};
+  auto const space = H5Screate_simple(2, dims, nullptr);
+  auto const dataset = H5Dcreate(location, name.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT,
+                                 H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data());
+  H5Dclose(dataset);
+  H5Sclose(space);
+}
+
+Vector<t_complex> read_dataset(hid_t location, std::string const &name) {
+  auto const dataset = H5Dopen(location, name.c_str(), H5P_DEFAULT);
+  if(dataset < 0)
+    throw std::runtime_error("Missing dataset " + name + " in coefficients file");
+  auto const space = H5Dget_space(dataset);
+  hsize_t dims[2] = {0, 0};
+  if(H5Sget_simple_extent_ndims(space) != 2 or
+     H5Sget_simple_extent_dims(space, dims, nullptr) < 0 or dims[1] != 2) {
+    H5Sclose(space);
+    H5Dclose(dataset);
+    throw std::runtime_error("Unexpected shape of dataset " + name + " in coefficients file");
+  }
+  Vector<t_complex> result(dims[0]);
+  H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, result.data());
+  H5Sclose(space);
+  H5Dclose(dataset);
+  return result;
+}
+} // namespace
+
+CoefficientsFile::CoefficientsFile(std::string const &filename, bool write)
+    : filename_(filename),
+      file_(write ? H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT) :
+                    H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT)) {
+  if(file_ < 0)
+    throw std::runtime_error("Could not open coefficients file " + filename);
+}
+
+CoefficientsFile::~CoefficientsFile() { H5Fclose(file_); }
+
+void CoefficientsFile::write(std::string const &kind, std::string const &hash, t_real wavelength,
+                             t_uint nMax, t_uint nobjects, Vector<t_complex> const &scatter_coef,
+                             Vector<t_complex> const &internal_coef) {
+  auto const name = group_name(kind, hash);
+  if(H5Lexists(file_, name.c_str(), H5P_DEFAULT) > 0)
+    return;
+  auto const group = H5Gcreate(file_, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  int const n = nMax, N = nobjects;
+  write_attribute(group, "wavelength", H5T_NATIVE_DOUBLE, &wavelength);
+  write_attribute(group, "nMax", H5T_NATIVE_INT, &n);
+  write_attribute(group, "nobjects", H5T_NATIVE_INT, &N);
+  write_dataset(group, "scatter", scatter_coef);
+  write_dataset(group, "internal", internal_coef);
+  H5Gclose(group);
+  H5Fflush(file_, H5F_SCOPE_GLOBAL);
+}
+
+void CoefficientsFile::write(std::string const &kind, std::string const &hash, t_real wavelength,
+                             ConvergenceHistory const &history) {
+  auto const name = "convergence_" + group_name(kind, hash);
+  if(H5Lexists(file_, name.c_str(), H5P_DEFAULT) > 0)
+    return;
+  auto const &iterations = history.iterations();
+  Eigen::Matrix<t_real, Eigen::Dynamic, 5, Eigen::RowMajor> data(iterations.size(), 5);
+  for(std::size_t i(0); i < iterations.size(); ++i)
+    data.row(i) << iterations[i].iteration, iterations[i].residual, iterations[i].seconds,
+        iterations[i].matvecs, iterations[i].communication;
+  hsize_t const dims[2] = {static_cast<hsize_t>(data.rows()), 5};
+  auto const space = H5Screate_simple(2, dims, nullptr);
+  auto const dataset = H5Dcreate(file_, name.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT,
+                                 H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data());
+  int const converged = history.converged();
+  write_attribute(dataset, "wavelength", H5T_NATIVE_DOUBLE, &wavelength);
+  write_attribute(dataset, "converged", H5T_NATIVE_INT, &converged);
+  H5Dclose(dataset);
+  H5Sclose(space);
+  H5Fflush(file_, H5F_SCOPE_GLOBAL);
+}
+
+bool CoefficientsFile::read(std::string const &kind, std::string const &hash,
+                            Vector<t_complex> &scatter_coef,
+                            Vector<t_complex> &internal_coef) const {
+  auto const name = group_name(kind, hash);
+  if(H5Lexists(file_, name.c_str(), H5P_DEFAULT) <= 0)
+    return false;
+  auto const group = H5Gopen(file_, name.c_str(), H5P_DEFAULT);
+  try {
+    scatter_coef = read_dataset(group, "scatter");
+    internal_coef = read_dataset(group, "internal");
+  } catch(...) {
+    H5Gclose(group);
+    throw;
+  }
+  H5Gclose(group);
+  return true;
+}
+}
@@ -0,0 +1,67 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_COEFFICIENTS_FILE_H
+#define OPTIMET_COEFFICIENTS_FILE_H
+
+#include "Convergence.h"
+#include "Types.h"
+#include <hdf5.h>
+#include <string>
+
+namespace optimet {
+//! \brief Solved coefficients stored in HDF5
+//! \details Fields and cross sections can then be recomputed from the file without solving again.
+//! Each solution is a group named after its kind ("FF" or "SH") and a content hash of the
+//! geometry and excitation (see coefficients_hash). The group holds the "scatter" and "internal"
+//! coefficients as n x 2 datasets of real and imaginary parts, and the wavelength, nMax and
+//! number of objects as attributes. Several solutions, e.g. from a scan, can share a file.
+//! Iterative solves also store their convergence history, including those that failed.
+class CoefficientsFile {
+public:
+  //! Creates (and truncates) a file for writing, or opens an existing file for reading
+  CoefficientsFile(std::string const &filename, bool write);
+  CoefficientsFile(CoefficientsFile const &) = delete;
+  CoefficientsFile &operator=(CoefficientsFile const &) = delete;
+  //! Closes the file
+  ~CoefficientsFile();
+
+  //! Name of the file
+  std::string const &filename() const { return filename_; }
+
+  //! Stores a solution, unless one with the same kind and hash is already there
+  void write(std::string const &kind, std::string const &hash, t_real wavelength, t_uint nMax,
+             t_uint nobjects, Vector<t_complex> const &scatter_coef,
+             Vector<t_complex> const &internal_coef);
+  //! \brief Stores the convergence history of a solve, unless already there
+  //! \details The dataset "convergence_<kind>_<hash>" has one row per iteration: iteration,
+  //! relative residual, seconds, matrix-vector products and seconds waiting on communications.
+  //! Its attributes are the wavelength and whether the solve converged.
+  void write(std::string const &kind, std::string const &hash, t_real wavelength,
+             ConvergenceHistory const &history);
+  //! \brief Reads a solution
+  //! \returns false if there are no solution for this kind and hash
+  bool read(std::string const &kind, std::string const &hash, Vector<t_complex> &scatter_coef,
+            Vector<t_complex> &internal_coef) const;
+
+private:
+  //! Name of the file
+  std::string filename_;
+  //! Handle to the HDF5 file
+  hid_t file_;
+};
+}
+#endif
@@ -0,0 +1,53 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Convergence.h"
+#include "Timing.h"
+
+namespace optimet {
+void ConvergenceHistory::start() {
+  iterations_.clear();
+  converged_ = false;
+  ++nsolves_;
+  start_ = std::chrono::steady_clock::now();
+  matvecs_start_ = timing::calls(timing::Phase::matvec);
+  communication_start_ = timing::seconds(timing::Phase::communication);
+  if(stream_)
+    *stream_ << "# solve " << nsolves_ << ": iteration residual seconds matvecs communication"
+             << std::endl;
+}
+
+void ConvergenceHistory::record(t_uint iteration, t_real residual) {
+  std::chrono::duration<t_real> const elapsed = std::chrono::steady_clock::now() - start_;
+  Iteration const current{iteration, residual, elapsed.count(),
+                          timing::calls(timing::Phase::matvec) - matvecs_start_,
+                          timing::seconds(timing::Phase::communication) - communication_start_};
+  if(not iterations_.empty() and iterations_.back().iteration == iteration)
+    iterations_.back() = current;
+  else
+    iterations_.push_back(current);
+  if(stream_)
+    *stream_ << current.iteration << " " << current.residual << " " << current.seconds << " "
+             << current.matvecs << " " << current.communication << std::endl;
+}
+
+void ConvergenceHistory::finish(bool converged) {
+  converged_ = converged;
+  if(stream_)
+    *stream_ << "# solve " << nsolves_ << (converged ? " converged" : " did not converge")
+             << std::endl;
+}
+} // namespace optimet
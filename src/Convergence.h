@@ -0,0 +1,80 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_CONVERGENCE_H
+#define OPTIMET_CONVERGENCE_H
+
+#include "Types.h"
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace optimet {
+//! \brief Residual, time and work of each iteration of an iterative solve
+//! \details Times, matrix-vector products and communication are measured from the start of the
+//! solve, using the counters of `timing`. Direct solvers leave the history empty.
+class ConvergenceHistory {
+public:
+  //! State of the solver after one iteration
+  struct Iteration {
+    //! Iteration number, as reported by the solver
+    t_uint iteration;
+    //! Residual norm relative to the norm of the right-hand side
+    t_real residual;
+    //! Time since the start of the solve
+    t_real seconds;
+    //! Matrix-vector products since the start of the solve
+    t_uint matvecs;
+    //! Time waiting on communications since the start of the solve
+    t_real communication;
+  };
+
+  ConvergenceHistory()
+      : converged_(false), nsolves_(0), matvecs_start_(0), communication_start_(0) {}
+
+  //! Clears the history and starts timing a new solve
+  void start();
+  //! \brief Records an iteration
+  //! \details An iteration recorded twice, e.g. by the solver and by a restart, is overwritten.
+  void record(t_uint iteration, t_real residual);
+  //! Records whether the solve converged
+  void finish(bool converged);
+
+  //! Iterations of the last solve
+  std::vector<Iteration> const &iterations() const { return iterations_; }
+  //! Whether the last solve converged
+  bool converged() const { return converged_; }
+  //! Whether the history holds any iteration
+  bool empty() const { return iterations_.empty(); }
+
+  //! \brief Writes each iteration to a stream as soon as it is recorded
+  //! \details One line per iteration, preceded by a comment line for each solve. Unset with a
+  //! null pointer.
+  void stream(std::shared_ptr<std::ostream> const &stream) { stream_ = stream; }
+
+private:
+  std::vector<Iteration> iterations_;
+  bool converged_;
+  //! Number of solves started, to label the stream
+  t_uint nsolves_;
+  std::chrono::steady_clock::time_point start_;
+  t_uint matvecs_start_;
+  t_real communication_start_;
+  std::shared_ptr<std::ostream> stream_;
+};
+} // namespace optimet
+#endif
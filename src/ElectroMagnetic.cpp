@@ -129,6 +129,20 @@ void ElectroMagnetic::populateDrudeModel() {
 }
 
 void ElectroMagnetic::update(double lambda_) {
+  if (modelType == 1 || modelType == 2) // Dispersive models
+  {
+    // Second harmonic values are those at half the wavelength
+    lambda = 0.5 * lambda_;
+    if (modelType == 1)
+      populateSellmeier();
+    else
+      populateDrudeModel();
+    epsilon_SH = epsilon;
+    epsilon_r_SH = epsilon_r;
+    mu_SH = mu;
+    mu_r_SH = mu_r;
+  }
+
   lambda = lambda_;
 
   if (modelType == 0) // Static model
@@ -136,6 +136,8 @@ public:
 
   /**
    * Updates the ElectroMagnetic object to a new wavelength.
+   * For dispersive models, the second harmonic values are updated to half the
+   * wavelength.
    * @param lambda_ the new wavelength.
    */
   void update(double lambda_);
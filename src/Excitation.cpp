@@ -16,7 +16,6 @@
 
 #include "Excitation.h"
 
-#include "Algebra.h"
 #include "AuxCoefficients.h"
 #include "CompoundIterator.h"
 #include "Coupling.h"
@@ -74,40 +73,14 @@ int Excitation::getIncLocal(Spherical<double> point_, std::complex<double> *Inc_
   Spherical<double> Rrel = point_ - Spherical<double>(0.0, 0.0, 0.0);
   optimet::Coupling const coupling(Rrel, waveK, nMax_, false);
 
-  CompoundIterator p, q;
+  auto const pMax = CompoundIterator::max(nMax_);
+  auto const Ap = dataIncAp.head(pMax);
+  auto const Bp = dataIncBp.head(pMax);
 
-  int pMax = p.max(nMax_);
-  int qMax = q.max(nMax_);
-
-  std::complex<double> *Inc_direct = new std::complex<double>[2 * pMax];
-  std::complex<double> **T_AB = new std::complex<double> *[2 * (p.max(nMax))];
-  for(p = 0; p < (int)(2 * p.max(nMax)); p++) {
-    T_AB[p] = new std::complex<double>[2 * p.max(nMax)];
-  }
-
-  for(p = 0; p < pMax; p++) {
-    Inc_direct[p] = dataIncAp[p];
-    Inc_direct[p + pMax] = dataIncBp[p];
-  }
-
-  for(p = 0; p < pMax; p++) {
-    for(q = 0; q < qMax; q++) {
-      T_AB[p][q] = coupling.diagonal(q, p);
-      T_AB[p + pMax][q + qMax] = coupling.diagonal(q, p);
-      T_AB[p + pMax][q] = coupling.offdiagonal(q, p);
-      T_AB[p][q + qMax] = coupling.offdiagonal(q, p);
-    }
-  }
-
-  Algebra::multiplyVectorMatrix(T_AB, 2 * pMax, 2 * pMax, Inc_direct, Inc_local_, consC1, consC0);
-
-  delete[] Inc_direct;
-
-  for(p = 0; p < 2 * pMax; p++) {
-    delete[] T_AB[p];
-  }
-
-  delete[] T_AB;
+  // The translation acts through the transpose of the coupling blocks
+  Eigen::Map<Vector<t_complex>> Inc_local(Inc_local_, 2 * pMax);
+  Inc_local.head(pMax) = coupling.diagonal.transpose() * Ap + coupling.offdiagonal.transpose() * Bp;
+  Inc_local.tail(pMax) = coupling.offdiagonal.transpose() * Ap + coupling.diagonal.transpose() * Bp;
 
   return 0;
 }
@@ -16,10 +16,18 @@
 
 #include "FMMBelosSolver.h"
 #include "PreconditionedMatrix.h"
+#include "Timing.h"
 #include "scalapack/LinearSystemSolver.h"
 #include <Kokkos_View.hpp>
 #include <Teuchos_RCP.hpp>
+#include <BelosIteration.hpp>
+#include <BelosStatusTest.hpp>
+#include <BelosStatusTestCombo.hpp>
 #include <BelosTypes.hpp>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <sstream>
 
 namespace optimet {
 namespace solver {
@@ -70,6 +78,52 @@ tpetra_vector(t_uint nglobals, Vector<t_complex> &x,
 Teuchos::RCP<Tpetra::MultiVector<t_complex>>
 tpetra_vector(t_uint nglobals, Vector<t_complex> const &x,
               Teuchos::RCP<const Teuchos::Comm<int>> const &comm);
+
+//! Records the residual of each iteration, without taking part in the convergence decision
+class ConvergenceMonitor : public Belos::StatusTest<t_complex, TpetraVector, FMMOperator> {
+public:
+  ConvergenceMonitor(ConvergenceHistory &history, t_real rhs_norm)
+      : history_(history), rhs_norm_(rhs_norm) {}
+
+  Belos::StatusType
+  checkStatus(Belos::Iteration<t_complex, TpetraVector, FMMOperator> *iteration) override {
+    std::vector<t_real> norms(1, 0);
+    iteration->getNativeResiduals(&norms);
+    history_.record(iteration->getNumIters(), rhs_norm_ > 0 ? norms[0] / rhs_norm_ : norms[0]);
+    return Belos::Undefined;
+  }
+  Belos::StatusType getStatus() const override { return Belos::Undefined; }
+  void reset() override {}
+  void print(std::ostream &os, int indent = 0) const override {
+    os << std::string(indent, ' ') << "Convergence history: " << history_.iterations().size()
+       << " iterations\n";
+  }
+
+private:
+  ConvergenceHistory &history_;
+  t_real rhs_norm_;
+};
+
+//! Relative residual reached by the solver, if it can tell
+t_real
+achieved_tolerance(Belos::SolverManager<t_complex, TpetraVector, FMMOperator> const &solver) {
+  try {
+    return solver.achievedTol();
+  } catch(std::exception const &) {
+    return std::numeric_limits<t_real>::quiet_NaN();
+  }
+}
+}
+
+void FMMBelos::stream_convergence() {
+  if(belos_params_.is_null() or not belos_params_->isParameter("Convergence History File") or
+     communicator().rank() != communicator().root_id())
+    return;
+  auto const filename = belos_params_->get<std::string>("Convergence History File");
+  auto const stream = std::make_shared<std::ofstream>(filename);
+  if(not *stream)
+    throw std::runtime_error("Could not open convergence history file " + filename);
+  convergence_.stream(stream);
 }
 
 void FMMBelos::update() {
@@ -77,24 +131,61 @@ void FMMBelos::update() {
     auto const diags = subdiagonals == std::numeric_limits<t_int>::max() ?
                            std::max<int>(1, geometry->objects.size() / 2 - 2) :
                            subdiagonals;
+    // each process caches the store of its share of the operator, in traversal order
+    auto const hash = operator_hash(*geometry, incWave->wavenumber());
+    std::ostringstream kind;
+    kind << "fmm-store-" << diags << "-"
+         << (rotations == Rotation::Storage::factored ? "factored-" : "");
+    // which pairs are stored depends on the budget
+    if(translations_budget != std::numeric_limits<t_real>::infinity())
+      kind << static_cast<std::int64_t>(translations_budget) << "B-";
+    kind << communicator().rank() << "of" << communicator().size();
+    OperatorData data;
+    t_int const loaded = cache().load(hash, kind.str(), data);
+    // all or none of the processes should read from the cache, otherwise the data is recomputed
+    if(not communicator().all_reduce(loaded, MPI_MIN))
+      data = OperatorData();
     fmm_ = std::make_shared<mpi::FastMatrixMultiply>(geometry->bground, incWave->wavenumber(),
-                                                     geometry->objects, diags, communicator());
-    auto const distribution =
-        mpi::details::vector_distribution(geometry->objects.size(), communicator().size());
-    auto const first = std::find(distribution.data(), distribution.data() + distribution.size(),
-                                 communicator().rank()) -
-                       distribution.data();
-    auto const last =
-        std::find_if(distribution.data() + first, distribution.data() + distribution.size(),
-                     [this](t_int value) { return value != communicator().rank(); }) -
-        distribution.data();
-    Q = source_vector(geometry->objects.begin() + first, geometry->objects.begin() + last, incWave);
+                                                     geometry->objects, diags, communicator(),
+                                                     data, rotations, translations_budget);
+    if(data.empty())
+      cache().save(hash, kind.str(), fmm_->operator_data());
+    auto const range = local_objects();
+    Q = sources(range.first, range.second);
   } else {
     fmm_ = nullptr;
     Q = Vector<t_complex>::Zero(0);
   }
 }
 
+void FMMBelos::update(std::shared_ptr<Geometry> geometry_,
+                      std::shared_ptr<Excitation const> incWave_,
+                      Vector<t_complex> const &sources) {
+  if(not(fmm_ and geometry_ and incWave_ and communicator().is_valid()))
+    return AbstractSolver::update(geometry_, incWave_, sources);
+  geometry = geometry_;
+  incWave = incWave_;
+  sources_ = sources;
+  // scatterers have not moved: only the frequency-dependent data is recomputed
+  fmm_ = std::make_shared<mpi::FastMatrixMultiply>(*fmm_, geometry->bground, incWave->wavenumber(),
+                                                   geometry->objects);
+  auto const range = local_objects();
+  Q = AbstractSolver::sources(range.first, range.second);
+}
+
+std::pair<t_uint, t_uint> FMMBelos::local_objects() const {
+  auto const distribution =
+      mpi::details::vector_distribution(geometry->objects.size(), communicator().size());
+  auto const first = std::find(distribution.data(), distribution.data() + distribution.size(),
+                               communicator().rank()) -
+                     distribution.data();
+  auto const last =
+      std::find_if(distribution.data() + first, distribution.data() + distribution.size(),
+                   [this](t_int value) { return value != communicator().rank(); }) -
+      distribution.data();
+  return {first, last};
+}
+
 void FMMBelos::solve(Vector<t_complex> &X_sca_, Vector<t_complex> &X_int_) const {
   auto const distribution =
       mpi::details::vector_distribution(geometry->objects.size(), communicator().size());
@@ -120,6 +211,17 @@ void FMMBelos::solve(Vector<t_complex> &X_sca_, Vector<t_complex> &X_int_) const
   auto solver = BelosSolverFactory().create(belos_params_->get("Solver", "GMRES"), belos_params_);
   solver->setProblem(problem);
 
+  // Record each iteration alongside the solver's own convergence test
+  convergence_.start();
+  auto const rhs_norm = std::sqrt(communicator().all_reduce(Q.squaredNorm(), MPI_SUM));
+  try {
+    solver->setUserConvergenceTest(
+        Teuchos::rcp(new ConvergenceMonitor(convergence_, rhs_norm)),
+        Belos::StatusTestCombo<t_complex, TpetraVector, FMMOperator>::OR);
+  } catch(std::logic_error const &) {
+    // solvers without user tests only get their last iteration recorded
+  }
+
   // Print out parameters for given verbosity
   if(belos_params_->get<int>("Verbosity", 0) & Belos::MsgType::FinalSummary) {
     auto const out = belos_params_->get<Teuchos::RCP<std::ostream>>(
@@ -128,8 +230,18 @@ void FMMBelos::solve(Vector<t_complex> &X_sca_, Vector<t_complex> &X_int_) const
       solver->getCurrentParameters()->print(*out);
   }
 
-  if(solver->solve() != Belos::Converged)
-    throw std::runtime_error("Belos optimizer did not converge");
+  auto const converged = solver->solve() == Belos::Converged;
+  auto const iterations = static_cast<t_uint>(solver->getNumIters());
+  timing::count(timing::Phase::iterations, iterations);
+  if(convergence_.empty() or convergence_.iterations().back().iteration != iterations)
+    convergence_.record(iterations, achieved_tolerance(*solver));
+  convergence_.finish(converged);
+  if(not converged) {
+    std::ostringstream message;
+    message << "Belos optimizer did not converge after " << iterations
+            << " iterations, relative residual " << convergence_.iterations().back().residual;
+    throw std::runtime_error(message.str());
+  }
 
   X_sca_ = Eigen::Map<Vector<t_complex> const>(x->getData(0).getRawPtr(), x->getLocalLength());
   X_sca_ = communicator().all_gather(X_sca_);
@@ -37,13 +37,21 @@ public:
       Teuchos::RCP<Teuchos::ParameterList> belos_params = Teuchos::rcp(new Teuchos::ParameterList),
       t_int subdiagonals = std::numeric_limits<t_int>::max())
       : AbstractSolver(geometry, incWave, comm), fmm_(nullptr), belos_params_(belos_params),
-        subdiagonals(subdiagonals) {
+        subdiagonals(subdiagonals), rotations(Rotation::Storage::dense),
+        translations_budget(std::numeric_limits<t_real>::infinity()) {
     update();
+    stream_convergence();
   }
 
   FMMBelos(Run const &run)
-      : FMMBelos(run.geometry, run.excitation, run.communicator, run.belos_params,
-                 run.fmm_subdiagonals) {}
+      : AbstractSolver(run), fmm_(nullptr), belos_params_(run.belos_params),
+        subdiagonals(run.fmm_subdiagonals),
+        rotations(run.fmm_factored_rotations ? Rotation::Storage::factored :
+                                               Rotation::Storage::dense),
+        translations_budget(run.fmm_translations_budget) {
+    update();
+    stream_convergence();
+  }
 
   ~FMMBelos(){};
 
@@ -58,6 +66,12 @@ public:
   //! \brief Update after internal parameters changed externally
   //! \details Because that's how the original implementation rocked.
   virtual void update() override;
+  //! \brief Update to a second harmonic problem
+  //! \details The fast matrix multiply operator of the current problem is reused for geometry-only
+  //! data (distribution, couplings and rotations).
+  void update(std::shared_ptr<Geometry> geometry_, std::shared_ptr<Excitation const> incWave_,
+              Vector<t_complex> const &sources) override;
+  using AbstractSolver::update;
 
   //! \brief Parameters for Belos/Trilinos solvers
   //! \note Mere access to the parameters requires the Teuchos::ParameterList to be modifiable. So
@@ -73,6 +87,16 @@ protected:
   Vector<t_complex> Q;
   //! The number of subdiagonals when distributing calculations
   t_int subdiagonals;
+  //! Whether the rotations of the fast matrix multiply are dense or factored
+  Rotation::Storage rotations;
+  //! Bytes of co-axial translation coefficients stored by each process
+  t_real translations_budget;
+
+  //! Range of objects owned by this process
+  std::pair<t_uint, t_uint> local_objects() const;
+  //! \brief Streams each iteration to the "Convergence History File" parameter, if given
+  //! \details Only the root process writes.
+  void stream_convergence();
 };
 #endif
 #endif
@@ -18,10 +18,14 @@
 #include "Coefficients.h"
 #include "FastMatrixMultiply.h"
 #include "RotationCoaxialDecomposition.h"
+#include "Timing.h"
+#include "Traversal.h"
 #include "Types.h"
 #include <Eigen/Dense>
+#include <algorithm>
 #include <boost/math/special_functions/bessel.hpp>
 #include <boost/math/special_functions/spherical_harmonic.hpp>
+#include <set>
 
 namespace optimet {
 namespace {
@@ -33,15 +37,95 @@ void range_sanity(t_int Nscatterers, t_int rows, t_int cols) {
   if(cols != Nscatterers)
     throw std::out_of_range("Size of couplings and scatterers do not match");
 }
+
+//! Floating point operations of a complex multiply-add
+constexpr t_real fma_flops() { return 8; }
+//! Size of a complex number in bytes
+constexpr t_real complex_bytes() { return sizeof(t_complex); }
+//! Number of elements in the rotation matrices of degrees 1 to nmax
+t_real rotation_elements(t_int nmax) {
+  t_real result(0);
+  for(t_int n(1); n <= nmax; ++n)
+    result += (2 * n + 1) * (2 * n + 1);
+  return result;
+}
+//! Floating point operations of a rotation of degrees 1 to nmax, for both potentials
+t_real rotation_flops(Rotation const &rotation, t_int nmax) {
+  if(rotation.storage() == Rotation::Storage::dense)
+    return 2 * rotation_elements(nmax) * fma_flops();
+  // two real-complex products with the flips, and three complex products with the phases
+  return 2 * (2 * 4 * rotation_elements(nmax) + 3 * 6 * nmax * (nmax + 2));
+}
+//! Products by co-axial coefficients of degree nmax, those of m also applying to -m
+t_real coaxial_products(t_int nmax) {
+  t_real result(0);
+  for(t_int n(0); n <= nmax; ++n)
+    for(t_int m(-n); m <= n; ++m)
+      result += nmax - std::abs(m) + 1;
+  return result;
+}
+//! \brief Floating point operations of a co-axial sweep of degree nmax, see CoAxialSweep
+//! \details Three real-complex products, two complex sums and a complex-real division per entry of
+//! the tables, for all orders m.
+t_real sweep_flops(t_int nmax) {
+  t_real entries(0);
+  for(t_int m(0); m <= nmax; ++m)
+    for(t_int n(m); n <= nmax; ++n)
+      entries += 2 * (nmax - n) + 1;
+  return 12 * entries;
+}
+//! Bytes of the rotation operator read for degrees 1 to nmax
+t_real rotation_operator_bytes(Rotation const &rotation, t_int nmax) {
+  if(rotation.storage() == Rotation::Storage::dense)
+    return rotation_elements(nmax) * complex_bytes();
+  return 2 * rotation_elements(nmax) * sizeof(t_real);
+}
 }
 
 std::vector<std::pair<t_uint, t_uint>>
-FastMatrixMultiply::compute_indices(Matrix<bool> const &couplings) {
+FastMatrixMultiply::compute_indices(std::vector<Scatterer> const &scatterers,
+                                    Matrix<bool> const &couplings) {
+  range_sanity(scatterers.size(), couplings.rows(), couplings.cols());
+  return traversal::morton(scatterers, couplings);
+}
+
+Matrix<bool> FastMatrixMultiply::couplings_matrix() const {
+  auto const n = scatterers_.size();
+  Matrix<bool> result = Matrix<bool>::Zero(n, n);
+  for(auto const &index : indices_)
+    result(index.first, index.second) = true;
+  return result;
+}
+
+FastMatrixMultiply::Indices FastMatrixMultiply::compute_stored(Indices const &indices) {
   Indices result;
-  for(t_int i(0); i < couplings.rows(); ++i)
-    for(t_int j(0); j < couplings.rows(); ++j)
-      if(couplings(i, j))
-        result.emplace_back(i, j);
+  std::set<Indices::value_type> seen;
+  for(auto const &pair : indices) {
+    Indices::value_type const stored = std::minmax(pair.first, pair.second);
+    if(seen.insert(stored).second)
+      result.push_back(stored);
+  }
+  return result;
+}
+
+std::vector<t_uint> FastMatrixMultiply::operators(Indices const &stored, Indices const &pairs) {
+  // sorted copy of the store, to look up each pair
+  std::vector<std::pair<Indices::value_type, t_uint>> sorted;
+  sorted.reserve(stored.size());
+  for(Indices::size_type i(0); i < stored.size(); ++i)
+    sorted.emplace_back(stored[i], i);
+  std::sort(sorted.begin(), sorted.end());
+
+  std::vector<t_uint> result;
+  result.reserve(pairs.size());
+  for(auto const &pair : pairs) {
+    Indices::value_type const key = std::minmax(pair.first, pair.second);
+    auto const found =
+        std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(key, t_uint(0)));
+    if(found == sorted.end() or found->first != key)
+      throw std::out_of_range("Pair is not computed by the operator store");
+    result.push_back(found->second);
+  }
   return result;
 }
 
@@ -60,77 +144,138 @@ std::vector<t_uint> FastMatrixMultiply::compute_offsets(std::vector<Scatterer> c
 
 std::vector<Rotation>
 FastMatrixMultiply::compute_rotations(std::vector<Scatterer> const &scatterers,
-                                      Matrix<bool> const &couplings) {
-  range_sanity(scatterers.size(), couplings.rows(), couplings.cols());
+                                      Indices const &indices, Rotation::Storage storage) {
+  timing::Timer const timer(timing::Phase::rotations);
 
   std::vector<Rotation> result;
-  result.reserve(couplings.count());
+  result.reserve(indices.size());
+  // the largest flips first, so that all rotations share them rather than keep smaller tables alive
+  if(storage == Rotation::Storage::factored and not indices.empty()) {
+    t_int nmax(1);
+    for(auto const &index : indices)
+      if(index.first != index.second)
+        nmax = std::max({nmax, scatterers[index.first].nMax, scatterers[index.second].nMax});
+    Rotation::flips(nmax);
+  }
 
   auto const chi = constant::pi;
   Eigen::Matrix<t_real, 3, 1> const z(0, 0, 1);
-  for(t_int i(0); i < couplings.rows(); ++i)
-    for(t_int j(0); j < couplings.rows(); ++j) {
-      if(not couplings(i, j))
-        continue;
-      if(i == j) {
-        result.emplace_back(0, 0, 0, 1);
-        continue;
-      }
-      auto const &in_scatt = scatterers[j];
-      auto const &out_scatt = scatterers[i];
-      auto const a2 =
-          (out_scatt.vR.toEigenCartesian() - in_scatt.vR.toEigenCartesian()).normalized().eval();
-      auto const theta = std::acos(a2(2));
-      auto const phi = std::atan2(a2(1), a2(0));
-      result.emplace_back(theta, phi, chi, std::max(in_scatt.nMax, out_scatt.nMax));
-      assert((result.back().basis_rotation().adjoint() * a2).isApprox(Vector<t_real>::Unit(3, 2)));
-      assert((result.back().basis_rotation() * Vector<t_real>::Unit(3, 2)).isApprox(a2));
+  for(auto const &index : indices) {
+    if(index.first == index.second) {
+      result.emplace_back(0, 0, 0, 1, storage);
+      continue;
     }
+    auto const &in_scatt = scatterers[index.second];
+    auto const &out_scatt = scatterers[index.first];
+    auto const a2 =
+        (out_scatt.vR.toEigenCartesian() - in_scatt.vR.toEigenCartesian()).normalized().eval();
+    auto const theta = std::acos(a2(2));
+    auto const phi = std::atan2(a2(1), a2(0));
+    result.emplace_back(theta, phi, chi, std::max(in_scatt.nMax, out_scatt.nMax), storage);
+    assert((result.back().basis_rotation().adjoint() * a2).isApprox(Vector<t_real>::Unit(3, 2)));
+    assert((result.back().basis_rotation() * Vector<t_real>::Unit(3, 2)).isApprox(a2));
+  }
   return result;
 }
 
 std::vector<CachedCoAxialRecurrence::Functor>
 FastMatrixMultiply::compute_coaxial_translations(t_complex wavenumber,
                                                  std::vector<Scatterer> const &scatterers,
-                                                 Matrix<bool> const &couplings) {
-  range_sanity(scatterers.size(), couplings.rows(), couplings.cols());
+                                                 Indices const &indices,
+                                                 std::vector<bool> const &recomputed) {
+  timing::Timer const timer(timing::Phase::translations);
+  assert(recomputed.size() == indices.size());
   std::vector<CachedCoAxialRecurrence::Functor> result;
-  result.reserve(couplings.count());
-  for(t_int i(0); i < couplings.rows(); ++i)
-    for(t_int j(0); j < couplings.rows(); ++j) {
-      if(not couplings(i, j))
-        continue;
-      if(i == j) {
-        result.push_back(CachedCoAxialRecurrence(0, 10, false).functor(1));
-        continue;
-      }
-      auto const &in_scatt = scatterers[j];
-      auto const &out_scatt = scatterers[i];
-      auto const Orad = in_scatt.vR.toEigenCartesian();
-      auto const Ononrad = out_scatt.vR.toEigenCartesian();
-      CachedCoAxialRecurrence tca((Orad - Ononrad).stableNorm(), wavenumber, false);
-      result.push_back(tca.functor(std::max(in_scatt.nMax, out_scatt.nMax) + nplus));
+  result.reserve(indices.size());
+  for(Indices::size_type i(0); i < indices.size(); ++i) {
+    auto const &index = indices[i];
+    if(index.first == index.second) {
+      result.push_back(CachedCoAxialRecurrence(0, 10, false).functor(1));
+      continue;
+    }
+    auto const &in_scatt = scatterers[index.second];
+    auto const &out_scatt = scatterers[index.first];
+    auto const nmax = std::max(in_scatt.nMax, out_scatt.nMax) + nplus;
+    if(recomputed[i]) {
+      result.emplace_back(nmax, std::vector<t_complex>());
+      continue;
     }
+    auto const Orad = in_scatt.vR.toEigenCartesian();
+    auto const Ononrad = out_scatt.vR.toEigenCartesian();
+    CachedCoAxialRecurrence tca((Orad - Ononrad).stableNorm(), wavenumber, false);
+    result.push_back(tca.functor(nmax));
+  }
+  return result;
+}
+
+std::vector<bool>
+FastMatrixMultiply::recomputed_translations(std::vector<Scatterer> const &scatterers,
+                                            Indices const &indices, t_real budget) {
+  std::vector<bool> result(indices.size(), false);
+  if(budget == std::numeric_limits<t_real>::infinity())
+    return result;
+  std::vector<std::pair<t_real, Indices::size_type>> distances;
+  for(Indices::size_type i(0); i < indices.size(); ++i)
+    if(indices[i].first != indices[i].second)
+      distances.emplace_back((scatterers[indices[i].first].vR.toEigenCartesian() -
+                              scatterers[indices[i].second].vR.toEigenCartesian())
+                                 .stableNorm(),
+                             i);
+  std::sort(distances.begin(), distances.end());
+  t_real bytes(0);
+  for(auto const &distance : distances) {
+    auto const &index = indices[distance.second];
+    bytes += memory::coaxial_bytes(
+        std::max(scatterers[index.first].nMax, scatterers[index.second].nMax) + nplus);
+    result[distance.second] = bytes > budget;
+  }
   return result;
 }
 
+std::vector<bool> FastMatrixMultiply::recomputed_translations(
+    std::vector<CachedCoAxialRecurrence::Functor> const &translations) {
+  std::vector<bool> result;
+  result.reserve(translations.size());
+  for(auto const &translation : translations)
+    result.push_back(translation.data().empty());
+  return result;
+}
+
+std::shared_ptr<memory::Allocation const>
+FastMatrixMultiply::rotations_memory(std::vector<Rotation> const &rotations) {
+  t_real bytes(0);
+  for(auto const &rotation : rotations)
+    for(auto const &matrix : rotation.matrices())
+      bytes += matrix.size() * complex_bytes();
+  return std::make_shared<memory::Allocation const>(memory::Component::rotations, bytes);
+}
+
+std::shared_ptr<memory::Allocation const> FastMatrixMultiply::translations_memory(
+    std::vector<CachedCoAxialRecurrence::Functor> const &translations) {
+  t_real bytes(0);
+  for(auto const &translation : translations)
+    bytes += translation.data().size() * complex_bytes();
+  return std::make_shared<memory::Allocation const>(memory::Component::translations, bytes);
+}
+
 Vector<t_complex>
 FastMatrixMultiply::compute_mie_coefficients(ElectroMagnetic const &background, t_real wavenumber,
                                              std::vector<Scatterer> const &scatterers,
                                              Matrix<bool> const &couplings) {
+  timing::Timer const timer(timing::Phase::t_matrix);
   auto const outs = couplings.colwise().any().eval();
   // First figure out total size
   t_uint total_size = 0;
   for(t_int i(0); i < outs.size(); ++i)
     if(outs(i))
-      total_size += nfunctions(scatterers[i].nMax);
+      total_size += scatterers[i].nMax;
   Vector<t_complex> result(2 * total_size);
 
   // then actually compute vector
   for(t_uint i(0), j(0); i < outs.size(); ++i) {
     if(not outs(i))
       continue;
-    auto const v = scatterers[i].getTLocal(wavenumber * constant::c, background);
+    auto const v = scatterers[i].getTLocalDegrees(wavenumber * constant::c, background);
     assert(result.size() >= j + v.size());
     result.segment(j, v.size()) = v;
     // incrementing here avoids problems with variable incrementation order
@@ -139,6 +284,70 @@ FastMatrixMultiply::compute_mie_coefficients(ElectroMagnetic const &background,
   return result;
 }
 
+OperatorData FastMatrixMultiply::operator_data() const {
+  OperatorData result;
+  for(Indices::size_type i(0); i < stored_->size(); ++i) {
+    auto const &rotation = (*rotations_)[i];
+    auto const &translation = (*coaxial_translations_)[i];
+    Matrix<t_complex> header(1, 6);
+    header << rotation.theta(), rotation.phi(), rotation.chi(),
+        static_cast<t_real>(rotation.nmax()), static_cast<t_real>(rotation.matrices().size()),
+        static_cast<t_real>(translation.nmax());
+    result.push_back(header);
+    result.insert(result.end(), rotation.matrices().begin(), rotation.matrices().end());
+    result.push_back(Vector<t_complex>::Map(translation.data().data(), translation.data().size()));
+  }
+  return result;
+}
+
+namespace {
+//! Checks operator data and returns the position of the header of each coupling
+std::vector<t_uint> operator_data_headers(OperatorData const &data, t_uint ncouplings) {
+  std::vector<t_uint> result;
+  for(t_uint i(0); i < data.size();) {
+    if(data[i].rows() != 1 or data[i].cols() != 6)
+      throw std::runtime_error("Operator data is corrupted");
+    result.push_back(i);
+    i += static_cast<t_uint>(std::real(data[i](4))) + 2;
+  }
+  if(result.size() != ncouplings)
+    throw std::runtime_error("Operator data does not match the couplings");
+  return result;
+}
+}
+
+std::vector<Rotation>
+FastMatrixMultiply::rotations_from_data(OperatorData const &data, t_uint ncouplings) {
+  std::vector<Rotation> result;
+  result.reserve(ncouplings);
+  for(auto const i : operator_data_headers(data, ncouplings)) {
+    auto const &header = data[i];
+    auto const norders = static_cast<t_uint>(std::real(header(4)));
+    // factored rotations are stored without matrices
+    if(norders == 0)
+      result.emplace_back(std::real(header(0)), std::real(header(1)), std::real(header(2)),
+                          static_cast<t_uint>(std::real(header(3))), Rotation::Storage::factored);
+    else
+      result.emplace_back(std::real(header(0)), std::real(header(1)), std::real(header(2)),
+                          std::vector<Matrix<t_complex>>(data.begin() + i + 1,
+                                                         data.begin() + i + 1 + norders));
+  }
+  return result;
+}
+
+std::vector<CachedCoAxialRecurrence::Functor>
+FastMatrixMultiply::coaxial_translations_from_data(OperatorData const &data, t_uint ncouplings) {
+  std::vector<CachedCoAxialRecurrence::Functor> result;
+  result.reserve(ncouplings);
+  for(auto const i : operator_data_headers(data, ncouplings)) {
+    auto const &header = data[i];
+    auto const &coeffs = data[i + static_cast<t_uint>(std::real(header(4))) + 1];
+    result.emplace_back(static_cast<t_int>(std::real(header(5))),
+                        std::vector<t_complex>(coeffs.data(), coeffs.data() + coeffs.size()));
+  }
+  return result;
+}
+
 Eigen::Array<t_real, Eigen::Dynamic, 2>
 FastMatrixMultiply::compute_normalization(std::vector<Scatterer> const &scatterers) {
   if(scatterers.size() == 0)
@@ -159,6 +368,19 @@ FastMatrixMultiply::compute_normalization(std::vector<Scatterer> const &scattere
   return result;
 }
 
+void FastMatrixMultiply::mie_multiply(Vector<t_complex> const &in, Vector<t_complex> &out) const {
+  assert(in.size() == static_cast<t_int>(cols()) and out.size() == static_cast<t_int>(cols()));
+  for(t_uint i(0), j(0); i < scatterers_.size(); ++i) {
+    if(incident_offsets_[i + 1] == incident_offsets_[i])
+      continue;
+    auto const nMax = scatterers_[i].nMax;
+    auto const n = incident_offsets_[i + 1] - incident_offsets_[i];
+    multiply_by_degree(mie_coefficients_.segment(j, 2 * nMax),
+                       in.segment(incident_offsets_[i], n), out.segment(incident_offsets_[i], n));
+    j += 2 * nMax;
+  }
+}
+
 void FastMatrixMultiply::operator()(Vector<t_complex> const &in, Vector<t_complex> &out) const {
   if(in.size() != cols())
     throw std::runtime_error("Incorrect incident vector size");
@@ -176,7 +398,9 @@ void FastMatrixMultiply::operator()(Vector<t_complex> const &in, Vector<t_comple
     }
 
   // Adds right-hand-side of Eq 106 in Gumerov, Duraiswami 2007
-  translation(mie_coefficients_.array() * in.array(), out);
+  Vector<t_complex> scaled(in.size());
+  mie_multiply(in, scaled);
+  translation(scaled, out);
 }
 
 void FastMatrixMultiply::transpose(Vector<t_complex> const &in, Vector<t_complex> &out) const {
@@ -190,7 +414,7 @@ void FastMatrixMultiply::transpose(Vector<t_complex> const &in, Vector<t_complex
   // Adds right-hand-side of Eq 106 in Gumerov, Duraiswami 2007
   translation_transpose(in, out);
   // Adds mie coefficient last when transposing
-  out.array() *= mie_coefficients_.array();
+  mie_multiply(out, out);
 
   // Adds identity component (left-hand-side of Eq 106 in Gumerov, Duraiswami 2007)
   for(Indices::size_type i(0); i < indices_.size(); ++i)
@@ -208,48 +432,367 @@ t_int FastMatrixMultiply::max_nmax() const {
   return nmax + nplus;
 }
 
-void FastMatrixMultiply::translation(Vector<t_complex> const &input, Vector<t_complex> &out) const {
+std::vector<t_uint> FastMatrixMultiply::packed_offsets(std::vector<t_uint> const &offsets) const {
+  std::vector<t_uint> result(1, 0);
+  for(t_uint i(0); i < scatterers_.size(); ++i) {
+    auto const coupled = offsets[i + 1] != offsets[i];
+    result.push_back(result.back() + (coupled ? 2 * (nfunctions(scatterers_[i].nMax) + 1) : 0));
+  }
+  return result;
+}
+
+Vector<t_complex>
+FastMatrixMultiply::pack(Vector<t_complex> const &in, std::vector<t_uint> const &offsets,
+                         std::vector<t_uint> const &packed, bool transposed) const {
   typedef Eigen::Matrix<t_complex, Eigen::Dynamic, 2> Matrixified;
+  Vector<t_complex> result(packed.back());
+  for(t_uint i(0); i < scatterers_.size(); ++i) {
+    if(packed[i + 1] == packed[i])
+      continue;
+    auto const rows = nfunctions(scatterers_[i].nMax);
+    Eigen::Map<const Matrixified> const input(in.data() + offsets[i], rows, 2);
+    kernels::Potentials output(result.data() + packed[i], rows + 1, 2);
+    output.row(0).fill(0);
+    if(transposed)
+      output.bottomRows(rows) = input.array() / normalization_.topRows(rows).array();
+    else
+      output.bottomRows(rows) = input.array() * normalization_.topRows(rows).array();
+  }
+  return result;
+}
+
+void FastMatrixMultiply::unpack(Vector<t_complex> const &in, std::vector<t_uint> const &offsets,
+                                std::vector<t_uint> const &packed, bool transposed,
+                                Vector<t_complex> &out) const {
+  typedef Eigen::Matrix<t_complex, Eigen::Dynamic, 2> Matrixified;
+  for(t_uint i(0); i < scatterers_.size(); ++i) {
+    if(packed[i + 1] == packed[i])
+      continue;
+    auto const rows = nfunctions(scatterers_[i].nMax);
+    kernels::ConstPotentials const input(in.data() + packed[i] + 2, rows, 2);
+    Eigen::Map<Matrixified> output(out.data() + offsets[i], rows, 2);
+    if(transposed)
+      output.array() += input.array() * normalization_.topRows(rows).array();
+    else
+      output.array() += input.array() / normalization_.topRows(rows).array();
+  }
+}
+
+void FastMatrixMultiply::remove_translation(kernels::ConstPotentials const &input,
+                                            kernels::Potentials out, kernels::Interleaved &alpha,
+                                            kernels::Interleaved &beta, CoAxialSweep &sweep,
+                                            Indices::size_type i) const {
+  auto const in_rows = input.rows();
+  auto const out_rows = out.rows();
+  auto const max_rows = nfunctions(std::max(incident_nmax(i), translate_nmax(i)) + nplus) + 1;
+  assert(alpha.rows() >= max_rows and beta.rows() >= max_rows);
+
+  // Rotates the input, already in Gumerov's normalization - without n=0 term
+  // Higher degrees are cleared since the translation reads them
+  beta.row(0).fill(0);
+  beta.middleRows(in_rows + 1, max_rows - in_rows - 1).fill(0);
+  kernels::rotation(pair_rotation(i), kernels::Rotate::direct, input,
+                    kernels::mutable_view(beta.middleRows(1, in_rows)));
+
+  // Then perform co-axial translation - this may create n=0 term
+  // Reversed pairs go along -z, with the same coefficients between two changes of parity
+  if(is_reversed(i))
+    kernels::parity(kernels::mutable_view(beta.topRows(max_rows)));
+  kernels::coaxial(pair_coaxial(i, sweep), kernels::view(beta.topRows(max_rows)),
+                   kernels::mutable_view(alpha.topRows(max_rows)));
+  if(is_reversed(i))
+    kernels::parity(kernels::mutable_view(alpha.topRows(max_rows)));
+
+  // Then apply field-coaxial-tranlation transform thing - n=0 term may be used to create n=1 term.
+  // n=0 term itself becomes zero (thereby choosing a gauge, apparently)
+  kernels::decomposition(wavenumber_, tz(i), kernels::view(alpha.topRows(max_rows)),
+                         kernels::mutable_view(beta.topRows(max_rows)));
+
+  // Rotate back - remove n=0 term since it is zero
+  kernels::rotation(pair_rotation(i), kernels::Rotate::adjoint,
+                    kernels::view(beta.middleRows(1, out_rows)),
+                    kernels::mutable_view(alpha.middleRows(1, out_rows)));
+
+  // Finally, remove from the output, still in Gumerov's normalization
+  out -= alpha.middleRows(1, out_rows);
+}
+
+void FastMatrixMultiply::remove_translation_transpose(kernels::ConstPotentials const &input,
+                                                      kernels::Potentials out,
+                                                      kernels::Interleaved &alpha,
+                                                      kernels::Interleaved &beta,
+                                                      CoAxialSweep &sweep,
+                                                      Indices::size_type i) const {
+  auto const in_rows = input.rows();
+  auto const out_rows = out.rows();
+  auto const max_rows = nfunctions(std::max(incident_nmax(i), translate_nmax(i)) + nplus) + 1;
+  assert(alpha.rows() >= max_rows and beta.rows() >= max_rows);
 
-  // create a work matrix with appropriate size
-  // It should have nplus (degree) more harmonics than the maximum object + the n = 0 term (1
+  // Rotates the input - without n=0 term
+  beta.row(0).fill(0);
+  beta.middleRows(in_rows + 1, max_rows - in_rows - 1).fill(0);
+  kernels::rotation(pair_rotation(i), kernels::Rotate::conjugate, input,
+                    kernels::mutable_view(beta.middleRows(1, in_rows)));
+
+  // Then apply field-coaxial-tranlation transform thing - n=0 term may be used to create n=1 term.
+  kernels::decomposition_transpose(wavenumber_, tz(i), kernels::view(beta.topRows(max_rows)),
+                                   kernels::mutable_view(alpha.topRows(max_rows)));
+
+  // Then perform co-axial translation - this may create n=0 term
+  if(is_reversed(i))
+    kernels::parity(kernels::mutable_view(alpha.topRows(max_rows)));
+  kernels::coaxial_transpose(pair_coaxial(i, sweep), kernels::view(alpha.topRows(max_rows)),
+                             kernels::mutable_view(beta.topRows(max_rows)));
+  if(is_reversed(i))
+    kernels::parity(kernels::mutable_view(beta.topRows(max_rows)));
+
+  // Rotate back - remove n=0 term since it is zero
+  kernels::rotation(pair_rotation(i), kernels::Rotate::transpose,
+                    kernels::view(beta.middleRows(1, out_rows)),
+                    kernels::mutable_view(alpha.middleRows(1, out_rows)));
+
+  // Finally, remove from the output
+  out -= alpha.middleRows(1, out_rows);
+}
+
+void FastMatrixMultiply::prefetch(Indices::size_type i, t_complex const *input) const {
+#ifdef __GNUC__
+  // the start of each block is enough for the hardware prefetcher to stream the rest
+  if(is_self_interaction(i))
+    return;
+  __builtin_prefetch(input);
+  // the other direction of the pair was just visited, and its operators are still in cache
+  if(i > 0 and operators_[i - 1] == operators_[i])
+    return;
+  for(auto const &matrix : pair_rotation(i).matrices())
+    __builtin_prefetch(matrix.data());
+  __builtin_prefetch(pair_coaxial(i).data().data());
+#endif
+}
+
+void FastMatrixMultiply::translation(Vector<t_complex> const &input, Vector<t_complex> &out) const {
+  // Coefficients go to the layout of the kernels once per particle, rather than once per pair
+  auto const incident = packed_offsets(incident_offsets_);
+  auto const translate = packed_offsets(translate_offsets_);
+  auto const packed_input = pack(input, incident_offsets_, incident, false);
+  Vector<t_complex> packed_output = Vector<t_complex>::Zero(translate.back());
+
+  // create work buffers with appropriate size
+  // They should have nplus (degree) more harmonics than the maximum object + the n = 0 term (1
   // element)
-  Eigen::Matrix<t_complex, Eigen::Dynamic, 4> work(nfunctions(max_nmax()) + 1, 4);
+  kernels::Interleaved alpha(nfunctions(max_nmax()) + 1, 2), beta(nfunctions(max_nmax()) + 1, 2);
+  // recomputes the co-axial translations that are not stored
+  CoAxialSweep sweep;
 
   // Adds left-hand-side of Eq 106 in Gumerov, Duraiswami 2007
   // This is done one at a time for each scatterer -> translated location pair
   // e.g. for each scatterer and particle on which the EM field impinges.
   for(Indices::size_type i(0); i < indices_.size(); ++i) {
+    // fetches the next pair while this one is computed
+    if(i + 1 < indices_.size())
+      prefetch(i + 1, packed_input.data() + incident[indices_[i + 1].second]);
     // no self-interaction
     if(is_self_interaction(i))
       continue;
-    auto const in_rows = nfunctions(incident_nmax(i));
-    Eigen::Map<const Matrixified> const incident(input.data() + incident_offset(i), in_rows, 2);
-    auto const out_rows = nfunctions(translate_nmax(i));
-    Eigen::Map<Matrixified> translate(out.data() + translate_offset(i), out_rows, 2);
-    remove_translation(incident, translate, work, i);
+    kernels::ConstPotentials const in(packed_input.data() + incident[indices_[i].second] + 2,
+                                      nfunctions(incident_nmax(i)), 2);
+    kernels::Potentials translated(packed_output.data() + translate[indices_[i].first] + 2,
+                                   nfunctions(translate_nmax(i)), 2);
+    remove_translation(in, translated, alpha, beta, sweep, i);
   }
+  unpack(packed_output, translate_offsets_, translate, false, out);
 }
 
 void FastMatrixMultiply::translation_transpose(Vector<t_complex> const &input,
                                                Vector<t_complex> &out) const {
-  typedef Eigen::Matrix<t_complex, Eigen::Dynamic, 2> Matrixified;
+  auto const incident = packed_offsets(incident_offsets_);
+  auto const translate = packed_offsets(translate_offsets_);
+  auto const packed_input = pack(input, translate_offsets_, translate, true);
+  Vector<t_complex> packed_output = Vector<t_complex>::Zero(incident.back());
 
-  // create a work matrix with appropriate size
-  Eigen::Matrix<t_complex, Eigen::Dynamic, 4> work(nfunctions(max_nmax()) + 1, 4);
+  // create work buffers with appropriate size
+  kernels::Interleaved alpha(nfunctions(max_nmax()) + 1, 2), beta(nfunctions(max_nmax()) + 1, 2);
+  CoAxialSweep sweep;
 
   // Adds left-hand-side of Eq 106 in Gumerov, Duraiswami 2007
   // This is done one at a time for each scatterer -> translated location pair
   // e.g. for each scatterer and particle on which the EM field impinges.
   for(Indices::size_type i(0); i < indices_.size(); ++i) {
+    if(i + 1 < indices_.size())
+      prefetch(i + 1, packed_input.data() + translate[indices_[i + 1].first]);
     if(is_self_interaction(i))
       continue;
-    auto const in_rows = nfunctions(incident_nmax(i));
-    Eigen::Map<Matrixified> const incident(out.data() + incident_offset(i), in_rows, 2);
-    auto const out_rows = nfunctions(translate_nmax(i));
-    Eigen::Map<const Matrixified> translate(input.data() + translate_offset(i), out_rows, 2);
-    remove_translation_transpose(translate, incident, work, i);
+    kernels::ConstPotentials const translated(
+        packed_input.data() + translate[indices_[i].first] + 2, nfunctions(translate_nmax(i)), 2);
+    kernels::Potentials in(packed_output.data() + incident[indices_[i].second] + 2,
+                           nfunctions(incident_nmax(i)), 2);
+    remove_translation_transpose(translated, in, alpha, beta, sweep, i);
   }
+  unpack(packed_output, incident_offsets_, incident, true, out);
+}
+
+roofline::Profile FastMatrixMultiply::explain(Vector<t_complex> const &in, Vector<t_complex> &out,
+                                              bool transposed) const {
+  using roofline::Kernel;
+  using roofline::Section;
+  roofline::Profile profile;
+  if(in.size() != (transposed ? rows() : cols()))
+    throw std::runtime_error("Incorrect incident vector size");
+  out.resize(transposed ? cols() : rows());
+  if(out.size() == 0)
+    return profile;
+  out.fill(0);
+
+  // Multiplication by a complex Mie coefficient, reading and writing each element
+  auto const mie_flops = 6 * cols();
+  auto const mie_bytes = 2 * complex_bytes() * cols();
+  if(not transposed) {
+    {
+      Section const section(profile, Kernel::accumulation, 0, 2 * complex_bytes() * in.size());
+      for(Indices::size_type i(0); i < indices_.size(); ++i)
+        if(is_self_interaction(i)) {
+          auto const n = 2 * nfunctions(incident_nmax(i));
+          out.segment(translate_offset(i), n) = in.segment(incident_offset(i), n);
+        }
+    }
+    Vector<t_complex> scaled(in.size());
+    {
+      Section const section(profile, Kernel::mie, mie_flops, mie_bytes);
+      mie_multiply(in, scaled);
+    }
+    explain_translation(scaled, out, false, profile);
+  } else {
+    explain_translation(in, out, true, profile);
+    {
+      Section const section(profile, Kernel::mie, mie_flops, mie_bytes);
+      mie_multiply(out, out);
+    }
+    Section const section(profile, Kernel::accumulation, 2 * out.size(),
+                          3 * complex_bytes() * out.size());
+    for(Indices::size_type i(0); i < indices_.size(); ++i)
+      if(is_self_interaction(i)) {
+        auto const n = 2 * nfunctions(incident_nmax(i));
+        out.segment(incident_offset(i), n) += in.segment(translate_offset(i), n);
+      }
+  }
+  return profile;
+}
+
+void FastMatrixMultiply::explain_translation(Vector<t_complex> const &input,
+                                             Vector<t_complex> &output, bool transposed,
+                                             roofline::Profile &profile) const {
+  // Follows translation and translation_transpose step by step
+  using roofline::Kernel;
+  using roofline::Section;
+  auto const incident = packed_offsets(incident_offsets_);
+  auto const translate = packed_offsets(translate_offsets_);
+  auto const &in_offsets = transposed ? translate_offsets_ : incident_offsets_;
+  auto const &out_offsets = transposed ? incident_offsets_ : translate_offsets_;
+  auto const &in_packed = transposed ? translate : incident;
+  auto const &out_packed = transposed ? incident : translate;
+
+  Vector<t_complex> packed_input;
+  Vector<t_complex> packed_output;
+  {
+    // scales each element by a real number, once per particle
+    auto const elements = static_cast<t_real>(in_packed.back() / 2);
+    Section const section(profile, Kernel::normalization, 2 * 2 * elements,
+                          2 * elements * (2 * complex_bytes() + sizeof(t_real)) +
+                              out_packed.back() * complex_bytes());
+    packed_input = pack(input, in_offsets, in_packed, transposed);
+    packed_output = Vector<t_complex>::Zero(out_packed.back());
+  }
+
+  kernels::Interleaved alpha(nfunctions(max_nmax()) + 1, 2), beta(nfunctions(max_nmax()) + 1, 2);
+  CoAxialSweep sweep;
+  for(Indices::size_type i(0); i < indices_.size(); ++i) {
+    if(is_self_interaction(i))
+      continue;
+    auto const in_nmax = transposed ? translate_nmax(i) : incident_nmax(i);
+    auto const out_nmax = transposed ? incident_nmax(i) : translate_nmax(i);
+    auto const in_rows = nfunctions(in_nmax);
+    auto const out_rows = nfunctions(out_nmax);
+    auto const max_rows = nfunctions(std::max(in_nmax, out_nmax) + nplus) + 1;
+    auto const in_particle = transposed ? indices_[i].first : indices_[i].second;
+    auto const out_particle = transposed ? indices_[i].second : indices_[i].first;
+    kernels::ConstPotentials const in(packed_input.data() + in_packed[in_particle] + 2, in_rows,
+                                      2);
+    kernels::Potentials out(packed_output.data() + out_packed[out_particle] + 2, out_rows, 2);
+    auto const &rotation = pair_rotation(i);
+    auto const *coaxial = &pair_coaxial(i);
+    if(is_recomputed(i)) {
+      // the tables of the sweep stay in cache, only the coefficients are written out
+      auto const nmax = coaxial->nmax();
+      Section const section(profile, Kernel::recurrence, sweep_flops(nmax),
+                            memory::coaxial_bytes(nmax));
+      coaxial = &pair_coaxial(i, sweep);
+    }
+    auto const ncoeffs = static_cast<t_real>(coaxial->data().size());
+
+    {
+      // clears the higher degrees, then rotates straight from the packed input
+      Section const section(profile, Kernel::rotation, rotation_flops(rotation, in_nmax),
+                            rotation_operator_bytes(rotation, in_nmax) +
+                                (2 * in_rows + 2 * max_rows) * complex_bytes());
+      beta.row(0).fill(0);
+      beta.middleRows(in_rows + 1, max_rows - in_rows - 1).fill(0);
+      auto const which = transposed ? kernels::Rotate::conjugate : kernels::Rotate::direct;
+      kernels::rotation(rotation, which, in, kernels::mutable_view(beta.middleRows(1, in_rows)));
+    }
+    // one complex, two real-complex products and three complex sums per element
+    auto const decomposition_flops = 2 * 16 * (max_rows - 1);
+    auto const decomposition_bytes = 4 * max_rows * complex_bytes();
+    auto const translation_flops = 2 * coaxial_products(coaxial->nmax()) * fma_flops();
+    auto const translation_bytes = (ncoeffs + 4 * max_rows) * complex_bytes();
+    if(transposed) {
+      {
+        Section const section(profile, Kernel::decomposition, decomposition_flops,
+                              decomposition_bytes);
+        kernels::decomposition_transpose(wavenumber_, tz(i), kernels::view(beta.topRows(max_rows)),
+                                         kernels::mutable_view(alpha.topRows(max_rows)));
+      }
+      // changes of parity of reversed pairs are counted with the translation
+      Section const section(profile, Kernel::translation, translation_flops, translation_bytes);
+      if(is_reversed(i))
+        kernels::parity(kernels::mutable_view(alpha.topRows(max_rows)));
+      kernels::coaxial_transpose(*coaxial, kernels::view(alpha.topRows(max_rows)),
+                                 kernels::mutable_view(beta.topRows(max_rows)));
+      if(is_reversed(i))
+        kernels::parity(kernels::mutable_view(beta.topRows(max_rows)));
+    } else {
+      {
+        Section const section(profile, Kernel::translation, translation_flops, translation_bytes);
+        if(is_reversed(i))
+          kernels::parity(kernels::mutable_view(beta.topRows(max_rows)));
+        kernels::coaxial(*coaxial, kernels::view(beta.topRows(max_rows)),
+                         kernels::mutable_view(alpha.topRows(max_rows)));
+        if(is_reversed(i))
+          kernels::parity(kernels::mutable_view(alpha.topRows(max_rows)));
+      }
+      Section const section(profile, Kernel::decomposition, decomposition_flops,
+                            decomposition_bytes);
+      kernels::decomposition(wavenumber_, tz(i), kernels::view(alpha.topRows(max_rows)),
+                             kernels::mutable_view(beta.topRows(max_rows)));
+    }
+    {
+      Section const section(profile, Kernel::back_rotation, rotation_flops(rotation, out_nmax),
+                            rotation_operator_bytes(rotation, out_nmax) +
+                                4 * out_rows * complex_bytes());
+      auto const which = transposed ? kernels::Rotate::transpose : kernels::Rotate::adjoint;
+      kernels::rotation(rotation, which, kernels::view(beta.middleRows(1, out_rows)),
+                        kernels::mutable_view(alpha.middleRows(1, out_rows)));
+    }
+    // subtracts from the packed output
+    Section const section(profile, Kernel::accumulation, 2 * 2 * out_rows,
+                          2 * out_rows * 3 * complex_bytes());
+    out -= alpha.middleRows(1, out_rows);
+  }
+
+  // scales by a real number and adds to the output, once per particle
+  auto const elements = static_cast<t_real>(out_packed.back() / 2);
+  Section const section(profile, Kernel::accumulation, 2 * 4 * elements,
+                        2 * elements * (3 * complex_bytes() + sizeof(t_real)));
+  unpack(packed_output, out_offsets, out_packed, transposed, output);
 }
 
 Vector<t_complex> FastMatrixMultiply::operator()(Vector<t_complex> const &in) const {
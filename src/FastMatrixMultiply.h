@@ -19,10 +19,16 @@
 
 #include "Bessel.h"
 #include "CoAxialTranslationCoefficients.h"
+#include "FixedKernels.h"
+#include "Memory.h"
+#include "OperatorCache.h"
 #include "RotationCoaxialDecomposition.h"
+#include "Roofline.h"
 #include "RotationCoefficients.h"
 #include "Scatterer.h"
 #include "Types.h"
+#include <limits>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -51,17 +57,33 @@ public:
   //!     the
   //!     spherical basis set used to expand the field at the location of the scatterers in this
   //!     range.
+  //! \param[in] storage: Whether the rotations are stored as dense matrices, or factored with
+  //!     flips shared by all pairs. Factored rotations hold much less memory at large nMax.
+  //! \param[in] translations_budget: Bytes available to the co-axial translation coefficients.
+  //!     Pairs are stored nearest first until the budget is exhausted. The coefficients of the
+  //!     other pairs are recomputed during each multiplication.
   FastMatrixMultiply(ElectroMagnetic const &em_background, t_real wavenumber,
-                     std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings)
+                     std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings,
+                     Rotation::Storage storage = Rotation::Storage::dense,
+                     t_real translations_budget = std::numeric_limits<t_real>::infinity())
       : em_background_(em_background), wavenumber_(wavenumber), scatterers_(scatterers),
-        indices_(compute_indices(couplings)),
+        indices_(compute_indices(scatterers, couplings)),
+        stored_(std::make_shared<Indices const>(compute_stored(indices_))),
+        operators_(operators(*stored_, indices_)),
         incident_offsets_(compute_offsets(scatterers, couplings.colwise().any())),
         translate_offsets_(compute_offsets(scatterers, couplings.rowwise().any())),
-        rotations_(compute_rotations(scatterers, couplings)),
+        rotations_(std::make_shared<std::vector<Rotation> const>(
+            compute_rotations(scatterers, *stored_, storage))),
         mie_coefficients_(
             compute_mie_coefficients(em_background, wavenumber, scatterers, couplings)),
-        coaxial_translations_(compute_coaxial_translations(wavenumber, scatterers, couplings)),
-        normalization_(compute_normalization(scatterers)) {}
+        coaxial_translations_(
+            std::make_shared<std::vector<CachedCoAxialRecurrence::Functor> const>(
+                compute_coaxial_translations(
+                    wavenumber, scatterers, *stored_,
+                    recomputed_translations(scatterers, *stored_, translations_budget)))),
+        normalization_(compute_normalization(scatterers)),
+        rotations_memory_(rotations_memory(*rotations_)),
+        translations_memory_(translations_memory(*coaxial_translations_)) {}
   FastMatrixMultiply(t_real wavenumber, std::vector<Scatterer> const &scatterers,
                      Matrix<bool> const &couplings)
       : FastMatrixMultiply(ElectroMagnetic(), wavenumber, scatterers, couplings) {}
@@ -71,6 +93,75 @@ public:
                            Matrix<bool>::Ones(scatterers.size(), scatterers.size())) {}
   FastMatrixMultiply(t_real wavenumber, std::vector<Scatterer> const &scatterers)
       : FastMatrixMultiply(ElectroMagnetic(), wavenumber, scatterers) {}
+  //! \brief Same particle pairs as `other`, at another frequency
+  //! \details The scatterers should be at the same positions and with the same number of
+  //! harmonics as in `other`, e.g. when going from the fundamental frequency to the second
+  //! harmonic. Indices, offsets and rotations only depend on the geometry and are shared with
+  //! `other`. Only the Mie coefficients and co-axial translations are recomputed, for all the
+  //! pairs of the store of `other`. Pairs recomputed during the multiplications of `other` are
+  //! also recomputed here.
+  FastMatrixMultiply(FastMatrixMultiply const &other, ElectroMagnetic const &em_background,
+                     t_real wavenumber, std::vector<Scatterer> const &scatterers)
+      : em_background_(em_background), wavenumber_(wavenumber), scatterers_(scatterers),
+        indices_(other.indices_), stored_(other.stored_), operators_(other.operators_),
+        incident_offsets_(other.incident_offsets_), translate_offsets_(other.translate_offsets_),
+        rotations_(other.rotations_),
+        mie_coefficients_(compute_mie_coefficients(em_background, wavenumber, scatterers,
+                                                   other.couplings_matrix())),
+        coaxial_translations_(
+            std::make_shared<std::vector<CachedCoAxialRecurrence::Functor> const>(
+                compute_coaxial_translations(
+                    wavenumber, scatterers, *stored_,
+                    recomputed_translations(*other.coaxial_translations_)))),
+        normalization_(other.normalization_), rotations_memory_(other.rotations_memory_),
+        translations_memory_(translations_memory(*coaxial_translations_)) {}
+  //! \brief Subset of the particle pairs of `store`, sharing its operators
+  //! \details `couplings` should only contain pairs stored by `store`, in either direction. The
+  //! rotations and co-axial translations of each pair are found by index in those of `store`
+  //! rather than copied, so that several instances applying overlapping sets of pairs hold a
+  //! single copy.
+  FastMatrixMultiply(FastMatrixMultiply const &store, Matrix<bool> const &couplings)
+      : em_background_(store.em_background_), wavenumber_(store.wavenumber_),
+        scatterers_(store.scatterers_), indices_(compute_indices(scatterers_, couplings)),
+        stored_(store.stored_), operators_(operators(*stored_, indices_)),
+        incident_offsets_(compute_offsets(scatterers_, couplings.colwise().any())),
+        translate_offsets_(compute_offsets(scatterers_, couplings.rowwise().any())),
+        rotations_(store.rotations_),
+        mie_coefficients_(compute_mie_coefficients(em_background_, wavenumber_, scatterers_,
+                                                   couplings)),
+        coaxial_translations_(store.coaxial_translations_), normalization_(store.normalization_),
+        rotations_memory_(store.rotations_memory_),
+        translations_memory_(store.translations_memory_) {}
+
+  //! \brief Creates the operator from the output of `operator_data`
+  //! \details Arguments are the same as for the main constructor. Rotations and co-axial
+  //! translations are read from `data` rather than computed, with the storage they had.
+  FastMatrixMultiply(ElectroMagnetic const &em_background, t_real wavenumber,
+                     std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings,
+                     OperatorData const &data)
+      : em_background_(em_background), wavenumber_(wavenumber), scatterers_(scatterers),
+        indices_(compute_indices(scatterers, couplings)),
+        stored_(std::make_shared<Indices const>(compute_stored(indices_))),
+        operators_(operators(*stored_, indices_)),
+        incident_offsets_(compute_offsets(scatterers, couplings.colwise().any())),
+        translate_offsets_(compute_offsets(scatterers, couplings.rowwise().any())),
+        rotations_(std::make_shared<std::vector<Rotation> const>(
+            rotations_from_data(data, stored_->size()))),
+        mie_coefficients_(
+            compute_mie_coefficients(em_background, wavenumber, scatterers, couplings)),
+        coaxial_translations_(
+            std::make_shared<std::vector<CachedCoAxialRecurrence::Functor> const>(
+                coaxial_translations_from_data(data, stored_->size()))),
+        normalization_(compute_normalization(scatterers)),
+        rotations_memory_(rotations_memory(*rotations_)),
+        translations_memory_(translations_memory(*coaxial_translations_)) {}
+
+  //! \brief Geometry-dependent data, e.g. to store in an operator cache
+  //! \details For each coupling: the rotation angles and degrees, the rotation matrices unless they
+  //! are factored, and the co-axial translation coefficients of each stored pair. The Mie
+  //! coefficients are cheap and not included. Instances sharing operators with a store give the
+  //! data of all the pairs of the store.
+  OperatorData operator_data() const;
 
   //! Total size of the problem
   t_uint size() const { return rows() * cols(); }
@@ -87,6 +178,12 @@ public:
   //! \brief Applies fast matrix multiplication to effective incident field
   Vector<t_complex> transpose(Vector<t_complex> const &in) const;
 
+  //! \brief Applies the multiplication one kernel at a time, counting operations and time
+  //! \details Gives the same result as `operator()`, or as `transpose` if `transposed` is true.
+  //! It is slower, since each kernel is timed separately for each particle pair.
+  roofline::Profile explain(Vector<t_complex> const &in, Vector<t_complex> &out,
+                            bool transposed = false) const;
+
   //! \brief computes conjugate operation
   void conjugate(Vector<t_complex> const &in, Vector<t_complex> &out) const {
     operator()(in.conjugate(), out);
@@ -114,6 +211,8 @@ public:
 
   //! Couplings that this object will compute
   Indices const &couplings() const { return indices_; }
+  //! Reconstructs the couplings matrix from the indices
+  Matrix<bool> couplings_matrix() const;
 
 protected:
   static int const nplus = 1;
@@ -125,31 +224,53 @@ protected:
   std::vector<Scatterer> const scatterers_;
   //! Couplings to compute in this instance
   std::vector<std::pair<t_uint, t_uint>> const indices_;
+  //! \brief Pairs for which rotations and co-axial translations are stored, possibly shared
+  //! \details Each unordered pair is stored once, with `first <= second`. The other direction
+  //! applies the same operators, see `is_reversed`.
+  std::shared_ptr<Indices const> const stored_;
+  //! Position of the rotation and co-axial translation of each coupling in the store
+  std::vector<t_uint> const operators_;
   //! Offsets for contiguous input vectors
   std::vector<t_uint> const incident_offsets_;
   //! Offsets for contiguous output vectors
   std::vector<t_uint> const translate_offsets_;
-  //! Rotations for owned objects
-  std::vector<Rotation> const rotations_;
-  //! Mie coefficients
+  //! Rotations of the stored pairs, shared between instances at different frequencies
+  std::shared_ptr<std::vector<Rotation> const> const rotations_;
+  //! Mie coefficients of incident particles, one TE and one TM value per degree
   Vector<t_complex> const mie_coefficients_;
-  //! Co-axial translations
-  std::vector<CachedCoAxialRecurrence::Functor> coaxial_translations_;
+  //! Co-axial translations of the stored pairs
+  std::shared_ptr<std::vector<CachedCoAxialRecurrence::Functor> const> const coaxial_translations_;
   //! Normalization factors between Gumerov and Stout
   Eigen::Array<t_real, Eigen::Dynamic, 2> const normalization_;
-
-  //! Computes index of each particle i in global input vector
-  static std::vector<std::pair<t_uint, t_uint>> compute_indices(Matrix<bool> const &couplings);
+  //! Memory held by the rotations, shared with them
+  std::shared_ptr<memory::Allocation const> rotations_memory_;
+  //! Memory held by the co-axial translations, shared with them
+  std::shared_ptr<memory::Allocation const> translations_memory_;
+
+  //! \brief Particle pairs, in the order in which they are traversed
+  //! \details Morton order, so that consecutive pairs involve nearby particles. Rotations and
+  //! co-axial translations are computed and stored in the same order.
+  static std::vector<std::pair<t_uint, t_uint>>
+  compute_indices(std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings);
   //! Computes offsets for output and input vectors
   static std::vector<t_uint>
   compute_offsets(std::vector<Scatterer> const &scatterers, Vector<bool> const &couplings);
   //! Computes rotations between relevant pairs of particles
-  static std::vector<Rotation>
-  compute_rotations(std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings);
-  //! Computes co-axial translations between relevant pairs of particles
+  static std::vector<Rotation> compute_rotations(std::vector<Scatterer> const &scatterers,
+                                                 Indices const &indices,
+                                                 Rotation::Storage storage);
+  //! \brief Computes co-axial translations between relevant pairs of particles
+  //! \details Recomputed pairs hold no coefficients, only their degree.
   static std::vector<CachedCoAxialRecurrence::Functor>
   compute_coaxial_translations(t_complex wavenumber_, std::vector<Scatterer> const &scatterers,
-                               Matrix<bool> const &couplings);
+                               Indices const &indices, std::vector<bool> const &recomputed);
+  //! \brief Pairs with co-axial translations recomputed during each multiplication
+  //! \details Pairs are stored nearest first, as long as their coefficients fit in `budget`.
+  static std::vector<bool> recomputed_translations(std::vector<Scatterer> const &scatterers,
+                                                   Indices const &indices, t_real budget);
+  //! Pairs of `translations` stored without coefficients
+  static std::vector<bool>
+  recomputed_translations(std::vector<CachedCoAxialRecurrence::Functor> const &translations);
   //! Computes mie coefficient for each particles
   static Vector<t_complex>
   compute_mie_coefficients(ElectroMagnetic const &background, t_real wavenumber,
@@ -158,6 +279,28 @@ protected:
   static Eigen::Array<t_real, Eigen::Dynamic, 2>
   compute_normalization(std::vector<Scatterer> const &scatterers);
 
+  //! Multiplies incident coefficients by the Mie coefficients, broadcasting each degree over m
+  void mie_multiply(Vector<t_complex> const &in, Vector<t_complex> &out) const;
+
+  //! Rotations stored by `operator_data`
+  static std::vector<Rotation> rotations_from_data(OperatorData const &data, t_uint ncouplings);
+  //! Co-axial translations stored by `operator_data`
+  static std::vector<CachedCoAxialRecurrence::Functor>
+  coaxial_translations_from_data(OperatorData const &data, t_uint ncouplings);
+
+  //! Records the memory held by rotations
+  static std::shared_ptr<memory::Allocation const>
+  rotations_memory(std::vector<Rotation> const &rotations);
+  //! Records the memory held by co-axial translations
+  static std::shared_ptr<memory::Allocation const>
+  translations_memory(std::vector<CachedCoAxialRecurrence::Functor> const &translations);
+
+  //! Each pair once, with `first <= second`, in order of first appearance
+  static Indices compute_stored(Indices const &indices);
+  //! \brief Position in the store of the operators of each pair
+  //! \details Throws `std::out_of_range` if a pair is not stored in either direction.
+  static std::vector<t_uint> operators(Indices const &stored, Indices const &pairs);
+
   //! Number of basis function for given nmax
   static constexpr t_int nfunctions(t_int nmax) { return nmax * (nmax + 2); }
 
@@ -177,10 +320,37 @@ protected:
     return translate_offsets_[indices_[j].first];
   }
 
+  //! \brief Whether coupling i applies the operators stored for the other direction
+  //! \details The co-axial translation coefficients only depend on the distance between the
+  //! particles, and the rotation of the other direction maps the z axis to the opposite of the
+  //! axis of this pair. The translation then goes along -z, i.e. through a change of parity.
+  bool is_reversed(Indices::size_type i) const { return indices_[i].first > indices_[i].second; }
+  //! Translation along the z axis of the rotated frame, negative for reversed pairs
   t_real tz(Indices::size_type i) const {
-    return (scatterers_[indices_[i].first].vR.toEigenCartesian() -
-            scatterers_[indices_[i].second].vR.toEigenCartesian())
-        .stableNorm();
+    auto const distance = (scatterers_[indices_[i].first].vR.toEigenCartesian() -
+                           scatterers_[indices_[i].second].vR.toEigenCartesian())
+                              .stableNorm();
+    return is_reversed(i) ? -distance : distance;
+  }
+
+  //! Rotation of coupling i
+  Rotation const &pair_rotation(Indices::size_type i) const {
+    return (*rotations_)[operators_[i]];
+  }
+  //! Co-axial translation of coupling i, as stored
+  CachedCoAxialRecurrence::Functor const &pair_coaxial(Indices::size_type i) const {
+    return (*coaxial_translations_)[operators_[i]];
+  }
+  //! Whether the co-axial translation of coupling i is recomputed during each multiplication
+  bool is_recomputed(Indices::size_type i) const {
+    return pair_coaxial(i).data().empty() and not is_self_interaction(i);
+  }
+  //! Co-axial translation of coupling i, recomputed with `sweep` if it is not stored
+  CachedCoAxialRecurrence::Functor const &pair_coaxial(Indices::size_type i,
+                                                       CoAxialSweep &sweep) const {
+    if(not is_recomputed(i))
+      return pair_coaxial(i);
+    return sweep(std::abs(tz(i)), wavenumber_, pair_coaxial(i).nmax(), false);
   }
 
   //! True if coupling particle with itself
@@ -188,106 +358,40 @@ protected:
     return indices_[i].first == indices_[i].second;
   }
 
-  //! Adds co-axial rotation/translation for a given particle pair
-  template <class T0, class T1, class T2>
-  void remove_translation(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &out,
-                          Eigen::MatrixBase<T2> const &work, Indices::size_type i) const;
-  //! Adds co-axial rotation/translation for a given particle pair
-  template <class T0, class T1, class T2>
-  void
-  remove_translation_transpose(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &out,
-                               Eigen::MatrixBase<T2> const &work, Indices::size_type i) const;
+  //! \brief Offsets of each particle in the layout of the kernels
+  //! \details Particles with coefficients in the solver layout, as given by `offsets`, hold
+  //! (Φ, Ψ) pairs for each (n, m) from n = 0 in the layout of the kernels.
+  std::vector<t_uint> packed_offsets(std::vector<t_uint> const &offsets) const;
+  //! \brief Packs coefficients from the solver layout to the layout of the kernels
+  //! \details Φ and Ψ are interleaved, the n = 0 term is zero, and the coefficients are changed to
+  //! Gumerov's normalization, or back from it for the transpose.
+  Vector<t_complex> pack(Vector<t_complex> const &in, std::vector<t_uint> const &offsets,
+                         std::vector<t_uint> const &packed, bool transposed) const;
+  //! Adds coefficients from the layout of the kernels back into the solver layout
+  void unpack(Vector<t_complex> const &in, std::vector<t_uint> const &offsets,
+              std::vector<t_uint> const &packed, bool transposed, Vector<t_complex> &out) const;
+  //! \brief Removes co-axial rotation/translation for a given particle pair
+  //! \details Input and output are packed coefficients from n = 1. `alpha` and `beta` are work
+  //! buffers with enough rows for the pair, including the n = 0 term. `sweep` recomputes the
+  //! co-axial translation if it is not stored.
+  void remove_translation(kernels::ConstPotentials const &input, kernels::Potentials out,
+                          kernels::Interleaved &alpha, kernels::Interleaved &beta,
+                          CoAxialSweep &sweep, Indices::size_type i) const;
+  //! Removes transposed co-axial rotation/translation for a given particle pair
+  void remove_translation_transpose(kernels::ConstPotentials const &input, kernels::Potentials out,
+                                    kernels::Interleaved &alpha, kernels::Interleaved &beta,
+                                    CoAxialSweep &sweep, Indices::size_type i) const;
+  //! Asks for the operators and the packed input of a pair to be brought into cache
+  void prefetch(Indices::size_type i, t_complex const *input) const;
   //! Apply translation to each particle pair
   void translation(Vector<t_complex> const &in, Vector<t_complex> &out) const;
   //! Apply translation to each particle pair
   void translation_transpose(Vector<t_complex> const &in, Vector<t_complex> &out) const;
+  //! Same as `translation` or `translation_transpose`, with each kernel added to a profile
+  void explain_translation(Vector<t_complex> const &in, Vector<t_complex> &out, bool transposed,
+                           roofline::Profile &profile) const;
 };
 
-template <class T0, class T1, class T2>
-void FastMatrixMultiply::remove_translation(Eigen::MatrixBase<T0> const &input,
-                                            Eigen::MatrixBase<T1> const &out,
-                                            Eigen::MatrixBase<T2> const &work,
-                                            Indices::size_type i) const {
-  auto const in_rows = input.rows();
-  auto const out_rows = out.rows();
-
-  auto const max_rows =
-      nfunctions(std::lround(std::sqrt(std::max(in_rows, out_rows) + 1)) - 1 + nplus) + 1;
-  assert(work.rows() >= max_rows);
-  assert(work.cols() == 4);
-  const_cast<Eigen::MatrixBase<T2> &>(work).fill(0);
-
-  // work matrices: we will alternatively use one then the other for input and output
-  auto alpha = const_cast<Eigen::MatrixBase<T2> &>(work).leftCols(2).topRows(max_rows);
-  auto beta = const_cast<Eigen::MatrixBase<T2> &>(work).rightCols(2).topRows(max_rows);
-
-  // First, we take into account Gumerov's very special normalization and notations
-  // It adds +/-1 factors, as well as normalization constants
-  // But appears when comparing to original calculation
-  // We add it second since: (i) the normalization is same for the same n, (ii) it avoids a copy
-  // There is no n=0 term at this juncture
-  alpha.middleRows(1, in_rows) = input.array() * normalization_.topRows(in_rows).array();
-
-  // Then we apply the rotation - without n=0 term
-  rotations_[i](alpha.middleRows(1, in_rows), beta.middleRows(1, in_rows));
-
-  // Then perform co-axial translation - this may create n=0 term
-  coaxial_translations_[i](beta, alpha);
-
-  // Then apply field-coaxial-tranlation transform thing - n=0 term may be used to create n=1 term.
-  // n=0 term itself becomes zero (thereby choosing a gauge, apparently)
-  rotation_coaxial_decomposition(wavenumber_, tz(i), alpha, beta);
-
-  // // Rotate back - remove n=0 term since it is zero
-  rotations_[i].adjoint(beta.middleRows(1, out_rows), alpha.middleRows(1, out_rows));
-
-  // Finally, add back into output vector with normalization
-  const_cast<Eigen::MatrixBase<T1> &>(out).array() -=
-      alpha.middleRows(1, out_rows).array() / normalization_.topRows(out_rows).array();
-}
-
-template <class T0, class T1, class T2>
-void FastMatrixMultiply::remove_translation_transpose(Eigen::MatrixBase<T0> const &input,
-                                                      Eigen::MatrixBase<T1> const &out,
-                                                      Eigen::MatrixBase<T2> const &work,
-                                                      t_uint i) const {
-  auto const in_rows = input.rows();
-  auto const out_rows = out.rows();
-
-  auto const max_rows =
-      nfunctions(std::lround(std::sqrt(std::max(in_rows, out_rows) + 1)) - 1 + nplus) + 1;
-  assert(work.rows() >= max_rows);
-  assert(work.cols() == 4);
-  const_cast<Eigen::MatrixBase<T2> &>(work).fill(0);
-
-  // work matrices: we will alternatively use one then the other for input and output
-  auto alpha = const_cast<Eigen::MatrixBase<T2> &>(work).leftCols(2).topRows(max_rows);
-  auto beta = const_cast<Eigen::MatrixBase<T2> &>(work).rightCols(2).topRows(max_rows);
-
-  // First, we take into account Gumerov's very special normalization and notations
-  // It adds +/-1 factors, as well as normalization constants
-  // But appears when comparing to original calculation
-  // We add it second since: (i) the normalization is same for the same n, (ii) it avoids a copy
-  // There is no n=0 term at this juncture
-  alpha.middleRows(1, in_rows) = input.array() / normalization_.topRows(in_rows).array();
-
-  // Then we apply the rotation - without n=0 term
-  rotations_[i].conjugate(alpha.middleRows(1, in_rows), beta.middleRows(1, in_rows));
-
-  // Then apply field-coaxial-tranlation transform thing - n=0 term may be used to create n=1 term.
-  // n=0 term itself becomes zero (thereby choosing a gauge, apparently)
-  rotation_coaxial_decomposition_transpose(wavenumber_, tz(i), beta, alpha);
-
-  // Then perform co-axial translation - this may create n=0 term
-  coaxial_translations_[i].transpose(alpha, beta);
-
-  // Rotate back - remove n=0 term since it is zero
-  rotations_[i].transpose(beta.middleRows(1, out_rows), alpha.middleRows(1, out_rows));
-
-  // Finally, add back into output vector
-  const_cast<Eigen::MatrixBase<T1> &>(out).array() -=
-      alpha.middleRows(1, out_rows).array() * normalization_.topRows(out_rows).array();
-}
 }
 
 #endif
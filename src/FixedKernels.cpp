@@ -0,0 +1,316 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "FixedKernels.h"
+#include "Coefficients.h"
+#include "RotationCoaxialDecomposition.h"
+#include <array>
+
+namespace optimet {
+namespace kernels {
+namespace {
+//! Compile-time sequence of integers, to build tables
+template <t_int... I> struct Sequence {};
+template <t_int N, t_int... I> struct MakeSequence : MakeSequence<N - 1, N - 1, I...> {};
+template <t_int... I> struct MakeSequence<0, I...> { typedef Sequence<I...> type; };
+
+//! Row of (n, m) when the rows start at n = 0
+constexpr t_int index(t_int n, t_int m) { return n * (n + 1) + m; }
+//! Number of rows from n = 0 to nmax
+constexpr t_int rows_with_n0(t_int nmax) { return (nmax + 1) * (nmax + 1); }
+//! Number of rows from n = 1 to nmax
+constexpr t_int rows_without_n0(t_int nmax) { return nmax * (nmax + 2); }
+//! Degree n of a row, when the rows start at n = 0
+constexpr t_int degree(t_int row, t_int n = 0) {
+  return row < rows_with_n0(n) ? n : degree(row, n + 1);
+}
+constexpr t_int absolute(t_int m) { return m < 0 ? -m : m; }
+
+//! Offsets of each row of a co-axial functor of degree N, the same for m and -m
+template <t_int N, class SEQUENCE> struct CoaxialOffsets;
+template <t_int N, t_int... I> struct CoaxialOffsets<N, Sequence<I...>> {
+  static constexpr t_int values[sizeof...(I)] = {CachedCoAxialRecurrence::Functor::offset(
+      N, degree(I), I - index(degree(I), 0))...};
+};
+template <t_int N, t_int... I>
+constexpr t_int CoaxialOffsets<N, Sequence<I...>>::values[sizeof...(I)];
+//! Offsets of each (n, m) of a co-axial functor of degree N, indexed by row
+template <t_int N> t_int coaxial_offset(t_int row) {
+  return CoaxialOffsets<N, typename MakeSequence<rows_with_n0(N)>::type>::values[row];
+}
+
+//! \brief Applies one product of the rotation matrices
+//! \details Products by the matrix go through its columns, products by its transpose take the dot
+//! products of its columns, so that the matrix is always read contiguously.
+template <Rotate WHICH> struct RotationProduct {
+  template <class M, class I, class O> static void apply(M const &m, I const &in, O &&out) {
+    typedef Eigen::Matrix<t_complex, M::RowsAtCompileTime, 1> Column;
+    for(t_int j(0); j < 2; ++j) {
+      Column result = Column::Zero();
+      for(t_int k(0); k < m.cols(); ++k)
+        if(WHICH == Rotate::direct)
+          result += m.col(k) * in(k, j);
+        else
+          result += m.col(k).conjugate() * in(k, j);
+      out.col(j) = result;
+    }
+  }
+};
+template <> struct RotationProduct<Rotate::adjoint> {
+  template <class M, class I, class O> static void apply(M const &m, I const &in, O &&out) {
+    for(t_int j(0); j < 2; ++j)
+      for(t_int k(0); k < m.cols(); ++k)
+        out(k, j) = m.col(k).dot(in.col(j));
+  }
+};
+template <> struct RotationProduct<Rotate::transpose> {
+  template <class M, class I, class O> static void apply(M const &m, I const &in, O &&out) {
+    for(t_int j(0); j < 2; ++j)
+      for(t_int k(0); k < m.cols(); ++k)
+        out(k, j) = m.col(k).conjugate().dot(in.col(j));
+  }
+};
+
+//! Rotates degrees n to N, each with a fixed-size matrix
+template <t_int n, t_int N, Rotate WHICH, bool END = (n > N)> struct RotationDegrees {
+  static void apply(std::vector<Matrix<t_complex>> const &matrices, ConstPotentials const &in,
+                    Potentials &out) {
+    constexpr t_int size = 2 * n + 1;
+    Eigen::Map<Eigen::Matrix<t_complex, size, size> const> const matrix(matrices[n].data());
+    RotationProduct<WHICH>::apply(matrix, in.template middleRows<size>(n * n - 1),
+                                  out.template middleRows<size>(n * n - 1));
+    RotationDegrees<n + 1, N, WHICH>::apply(matrices, in, out);
+  }
+};
+template <t_int n, t_int N, Rotate WHICH> struct RotationDegrees<n, N, WHICH, true> {
+  static void apply(std::vector<Matrix<t_complex>> const &, ConstPotentials const &,
+                    Potentials &) {}
+};
+
+template <t_int N, Rotate WHICH>
+void fixed_rotation(Rotation const &rotation, ConstPotentials const &in, Potentials out) {
+  RotationDegrees<1, N, WHICH>::apply(rotation.matrices(), in, out);
+}
+
+//! \brief Co-axial translation of degree N
+//! \details Same order of operations as the generic functor, accumulated in a fixed-size matrix
+//! and without bounds checks.
+template <t_int N>
+void fixed_coaxial(t_complex const *coefficients, ConstPotentials const &in, Potentials out) {
+  Eigen::Matrix<t_complex, rows_with_n0(N), 2> result = decltype(result)::Zero();
+  for(t_int n(0); n <= N; ++n) {
+    // m = 0, then m and -m together, each coefficient being read once
+    t_complex const *c = coefficients + coaxial_offset<N>(index(n, 0));
+    t_complex const phi = in(index(n, 0), 0), psi = in(index(n, 0), 1);
+    for(t_int l(0); l <= N; ++l) {
+      result(index(l, 0), 0) += c[l] * phi;
+      result(index(l, 0), 1) += c[l] * psi;
+    }
+    for(t_int m(1); m <= n; ++m) {
+      c = coefficients + coaxial_offset<N>(index(n, m)) - m;
+      t_complex const plus_phi = in(index(n, m), 0), plus_psi = in(index(n, m), 1);
+      t_complex const minus_phi = in(index(n, -m), 0), minus_psi = in(index(n, -m), 1);
+      for(t_int l(m); l <= N; ++l) {
+        result(index(l, m), 0) += c[l] * plus_phi;
+        result(index(l, m), 1) += c[l] * plus_psi;
+        result(index(l, -m), 0) += c[l] * minus_phi;
+        result(index(l, -m), 1) += c[l] * minus_psi;
+      }
+    }
+  }
+  out = result;
+}
+
+//! Transpose of the co-axial translation of degree N
+template <t_int N>
+void fixed_coaxial_transpose(t_complex const *coefficients, ConstPotentials const &in,
+                             Potentials out) {
+  for(t_int n(0); n <= N; ++n) {
+    // m = 0, then m and -m together, each coefficient being read once
+    t_complex const *c = coefficients + coaxial_offset<N>(index(n, 0));
+    t_complex phi(0), psi(0);
+    for(t_int l(0); l <= N; ++l) {
+      phi += c[l] * in(index(l, 0), 0);
+      psi += c[l] * in(index(l, 0), 1);
+    }
+    out(index(n, 0), 0) = phi;
+    out(index(n, 0), 1) = psi;
+    for(t_int m(1); m <= n; ++m) {
+      c = coefficients + coaxial_offset<N>(index(n, m)) - m;
+      phi = psi = 0;
+      t_complex minus_phi(0), minus_psi(0);
+      for(t_int l(m); l <= N; ++l) {
+        phi += c[l] * in(index(l, m), 0);
+        psi += c[l] * in(index(l, m), 1);
+        minus_phi += c[l] * in(index(l, -m), 0);
+        minus_psi += c[l] * in(index(l, -m), 1);
+      }
+      out(index(n, m), 0) = phi;
+      out(index(n, m), 1) = psi;
+      out(index(n, -m), 0) = minus_phi;
+      out(index(n, -m), 1) = minus_psi;
+    }
+  }
+}
+
+//! \brief Factors of the rotation-coaxial decomposition, per row, without the translation
+//! \details Same products as in `rotation_coaxial_decomposition`.
+template <t_int N> struct DecompositionFactors {
+  //! n a(n, m)
+  std::array<t_real, rows_with_n0(N)> up;
+  //! (n + 1) a(n - 1, m)
+  std::array<t_real, rows_with_n0(N)> down;
+  DecompositionFactors() {
+    using coefficient::a;
+    up.fill(0);
+    down.fill(0);
+    for(t_int n(1); n <= N; ++n)
+      for(t_int m(-n); m <= n; ++m) {
+        up[index(n, m)] = n * a<t_real>(n, m);
+        down[index(n, m)] = (n + 1) * a<t_real>(n - 1, m);
+      }
+  }
+};
+template <t_int N> DecompositionFactors<N> const &decomposition_factors() {
+  static DecompositionFactors<N> const factors;
+  return factors;
+}
+
+//! Rotation-coaxial decomposition of degree N, or its transpose
+template <t_int N, bool TRANSPOSE>
+void fixed_decomposition(t_real wavenumber, t_real tz, ConstPotentials const &in, Potentials out) {
+  auto const &factors = decomposition_factors<N>();
+  for(t_int n(1); n <= N; ++n) {
+    auto const factor = tz * wavenumber / static_cast<t_real>(n * n + n);
+    for(t_int m(-n); m <= n; ++m) {
+      auto const i = index(n, m);
+      t_complex const cm(0, m * factor);
+      auto const c_up = factors.up[i] * factor;
+      auto const c_down = factors.down[i] * factor;
+      // the transpose ignores n = 0
+      bool const has_down = n - 1 >= absolute(m) and (not TRANSPOSE or n > 1);
+      for(t_int j(0); j < 2; ++j) {
+        t_complex const up = n < N ? c_up * in(index(n + 1, m), j) : t_complex(0);
+        t_complex const down = has_down ? c_down * in(index(n - 1, m), j) : t_complex(0);
+        // same order of summation as the generic kernels
+        out(i, j) =
+            in(i, j) + cm * in(i, 1 - j) + (TRANSPOSE ? down : up) + (TRANSPOSE ? up : down);
+      }
+    }
+  }
+  if(TRANSPOSE) {
+    out(0, 0) = tz * wavenumber * coefficient::a<t_real>(0, 0) * in(index(1, 0), 0);
+    out(0, 1) = tz * wavenumber * coefficient::a<t_real>(0, 0) * in(index(1, 0), 1);
+  } else
+    out.row(0).fill(0);
+}
+
+//! Tables of kernels, indexed by degree - min_degree()
+template <class SEQUENCE> struct Tables;
+template <t_int... I> struct Tables<Sequence<I...>> {
+  typedef void (*RotationKernel)(Rotation const &, ConstPotentials const &, Potentials);
+  typedef void (*CoaxialKernel)(t_complex const *, ConstPotentials const &, Potentials);
+  typedef void (*DecompositionKernel)(t_real, t_real, ConstPotentials const &, Potentials);
+
+  static constexpr RotationKernel rotations[4][sizeof...(I)] = {
+      {&fixed_rotation<min_degree() + I, Rotate::direct>...},
+      {&fixed_rotation<min_degree() + I, Rotate::adjoint>...},
+      {&fixed_rotation<min_degree() + I, Rotate::transpose>...},
+      {&fixed_rotation<min_degree() + I, Rotate::conjugate>...}};
+  static constexpr CoaxialKernel coaxials[2][sizeof...(I)] = {
+      {&fixed_coaxial<min_degree() + I>...}, {&fixed_coaxial_transpose<min_degree() + I>...}};
+  static constexpr DecompositionKernel decompositions[2][sizeof...(I)] = {
+      {&fixed_decomposition<min_degree() + I, false>...},
+      {&fixed_decomposition<min_degree() + I, true>...}};
+};
+template <t_int... I>
+constexpr typename Tables<Sequence<I...>>::RotationKernel
+    Tables<Sequence<I...>>::rotations[4][sizeof...(I)];
+template <t_int... I>
+constexpr typename Tables<Sequence<I...>>::CoaxialKernel
+    Tables<Sequence<I...>>::coaxials[2][sizeof...(I)];
+template <t_int... I>
+constexpr typename Tables<Sequence<I...>>::DecompositionKernel
+    Tables<Sequence<I...>>::decompositions[2][sizeof...(I)];
+typedef Tables<MakeSequence<max_degree() - min_degree() + 1>::type> Table;
+
+//! \brief Specialised degree given the number of rows, or -1
+//! \details Integer comparisons only, rather than the square roots of the generic kernels.
+t_int specialised_degree(t_int rows, bool with_n0) {
+  for(t_int n(min_degree()); n <= max_degree(); ++n)
+    if(rows == (with_n0 ? rows_with_n0(n) : rows_without_n0(n)))
+      return n;
+  return -1;
+}
+} // namespace
+
+void rotation(Rotation const &rotation, Rotate which, ConstPotentials const &in, Potentials out) {
+  // factored rotations have no matrices to specialise
+  auto const n = rotation.storage() == Rotation::Storage::dense ?
+                     specialised_degree(in.rows(), false) :
+                     -1;
+  if(n > 0 and out.rows() == in.rows() and static_cast<t_int>(rotation.nmax()) >= n)
+    return Table::rotations[static_cast<t_int>(which)][n - min_degree()](rotation, in, out);
+  switch(which) {
+  case Rotate::direct:
+    return rotation(in, out);
+  case Rotate::adjoint:
+    return rotation.adjoint(in, out);
+  case Rotate::transpose:
+    return rotation.transpose(in, out);
+  case Rotate::conjugate:
+    return rotation.conjugate(in, out);
+  }
+}
+
+void coaxial(CachedCoAxialRecurrence::Functor const &functor, ConstPotentials const &in,
+             Potentials out) {
+  auto const n = specialised_degree(in.rows(), true);
+  if(n > 0 and out.rows() == in.rows() and functor.nmax() == n)
+    return Table::coaxials[0][n - min_degree()](functor.data().data(), in, out);
+  functor(in, out);
+}
+
+void coaxial_transpose(CachedCoAxialRecurrence::Functor const &functor, ConstPotentials const &in,
+                       Potentials out) {
+  auto const n = specialised_degree(in.rows(), true);
+  if(n > 0 and out.rows() == in.rows() and functor.nmax() == n)
+    return Table::coaxials[1][n - min_degree()](functor.data().data(), in, out);
+  functor.transpose(in, out);
+}
+
+void parity(Potentials inout) {
+  // degree n starts at row n * n
+  for(t_int n(1); n * n < inout.rows(); n += 2)
+    inout.middleRows(n * n, std::min<t_int>(2 * n + 1, inout.rows() - n * n)) *= -1;
+}
+
+void decomposition(t_real wavenumber, t_real tz, ConstPotentials const &in, Potentials out) {
+  auto const n = specialised_degree(in.rows(), true);
+  if(n > 0 and out.rows() == in.rows())
+    return Table::decompositions[0][n - min_degree()](wavenumber, tz, in, out);
+  rotation_coaxial_decomposition(wavenumber, tz, in, out);
+}
+
+void decomposition_transpose(t_real wavenumber, t_real tz, ConstPotentials const &in,
+                             Potentials out) {
+  auto const n = specialised_degree(in.rows(), true);
+  if(n > 0 and out.rows() == in.rows())
+    return Table::decompositions[1][n - min_degree()](wavenumber, tz, in, out);
+  rotation_coaxial_decomposition_transpose(wavenumber, tz, in, out);
+}
+} // namespace kernels
+} // namespace optimet
@@ -0,0 +1,86 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_FIXED_KERNELS_H
+#define OPTIMET_FIXED_KERNELS_H
+
+#include "CoAxialTranslationCoefficients.h"
+#include "RotationCoefficients.h"
+#include "Types.h"
+
+namespace optimet {
+//! \brief Kernels of the fast matrix multiplication, specialised for common degrees
+//! \details Each kernel is instantiated for every degree from `min_degree` to `max_degree`, with
+//! fixed-size blocks, compile-time loop bounds and index tables. The instance is picked at runtime
+//! from the number of rows of the input. Other degrees fall back on the generic implementations
+//! in `Rotation`, `CachedCoAxialRecurrence::Functor` and `rotation_coaxial_decomposition`, which
+//! give the same results up to rounding.
+//!
+//! Inputs and outputs are (Φ, Ψ) pairs interleaved for each coefficient, as packed by the FMM, so
+//! that each kernel streams through contiguous memory. Rotations act on coefficients from n = 1 to
+//! nmax, whereas co-axial translations and decompositions act on coefficients from n = 0 to nmax,
+//! as they do in the FMM.
+namespace kernels {
+//! Smallest degree with specialised kernels
+constexpr t_int min_degree() { return 3; }
+//! \brief Largest degree with specialised kernels
+//! \details Co-axial translations carry one more degree than the particles, so this covers
+//! particles with nMax from 3 to 12 throughout.
+constexpr t_int max_degree() { return 13; }
+//! Whether there are specialised kernels for this degree
+constexpr bool is_specialised(t_int nmax) { return nmax >= min_degree() and nmax <= max_degree(); }
+
+//! (Φ, Ψ) coefficients, interleaved
+typedef Eigen::Matrix<t_complex, Eigen::Dynamic, 2, Eigen::RowMajor> Interleaved;
+//! View of interleaved coefficients
+typedef Eigen::Map<Interleaved> Potentials;
+//! Constant view of interleaved coefficients
+typedef Eigen::Map<Interleaved const> ConstPotentials;
+
+//! Views interleaved coefficients, e.g. a range of rows of an `Interleaved` matrix
+template <class T> ConstPotentials view(Eigen::MatrixBase<T> const &input) {
+  assert(input.derived().outerStride() == 2 and input.derived().innerStride() == 1);
+  return ConstPotentials(input.derived().data(), input.rows(), 2);
+}
+//! Views interleaved coefficients, for writing
+template <class T> Potentials mutable_view(Eigen::MatrixBase<T> const &output) {
+  auto &derived = const_cast<Eigen::MatrixBase<T> &>(output).derived();
+  assert(derived.outerStride() == 2 and derived.innerStride() == 1);
+  return Potentials(derived.data(), derived.rows(), 2);
+}
+
+//! Which product of the rotation matrices to apply
+enum class Rotate { direct, adjoint, transpose, conjugate };
+
+//! Applies the rotation, or its adjoint, transpose or conjugate
+void rotation(Rotation const &rotation, Rotate which, ConstPotentials const &in, Potentials out);
+//! Applies the co-axial translation
+void coaxial(CachedCoAxialRecurrence::Functor const &functor, ConstPotentials const &in,
+             Potentials out);
+//! Applies the transpose of the co-axial translation
+void coaxial_transpose(CachedCoAxialRecurrence::Functor const &functor, ConstPotentials const &in,
+                       Potentials out);
+//! \brief Changes the sign of the coefficients of odd degrees, from n = 0
+//! \details A co-axial translation along -z is the translation along +z between two such changes.
+void parity(Potentials inout);
+//! Applies the rotation-coaxial decomposition
+void decomposition(t_real wavenumber, t_real tz, ConstPotentials const &in, Potentials out);
+//! Applies the transpose of the rotation-coaxial decomposition
+void decomposition_transpose(t_real wavenumber, t_real tz, ConstPotentials const &in,
+                             Potentials out);
+} // namespace kernels
+} // namespace optimet
+#endif
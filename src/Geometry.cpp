@@ -17,17 +17,20 @@
 #include "Coupling.h"
 #include "Geometry.h"
 
-#include "Algebra.h"
 #include "Bessel.h"
 #include "CompoundIterator.h"
 #include "HarmonicsIterator.h"
 #include "Symbol.h"
+#include "Timing.h"
 #include "Tools.h"
 #include "Types.h"
 #include "constants.h"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <iostream>
+#include <map>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
@@ -36,29 +39,76 @@
 Geometry::~Geometry() {}
 Geometry::Geometry() {}
 
+namespace {
+std::string overlap_message(Scatterer const &a, Scatterer const &b) {
+  std::ostringstream sstr;
+  sstr << "The sphere at (" << Tools::toCartesian(a.vR).x << ", " << Tools::toCartesian(a.vR).y
+       << ", " << Tools::toCartesian(a.vR).z << ") "
+       << "overlaps with the one at (" << Tools::toCartesian(b.vR).x << ", "
+       << Tools::toCartesian(b.vR).y << ", " << Tools::toCartesian(b.vR).z << "), "
+       << "with radii " << a.radius << " and " << b.radius;
+  return sstr.str();
+}
+
+//! \brief Finds two overlapping spheres
+//! \details Spheres are binned into cubic cells as wide as the largest diameter, so that each
+//! sphere only needs checking against those in the same and neighbouring cells.
+//! \returns indices of the overlapping spheres, or (-1, -1) if none overlap
+std::pair<optimet::t_int, optimet::t_int> find_overlap(std::vector<Scatterer> const &objects) {
+  using namespace optimet;
+  if(objects.size() < 2)
+    return {-1, -1};
+  auto const largest = std::max_element(
+      objects.begin(), objects.end(),
+      [](Scatterer const &a, Scatterer const &b) { return a.radius < b.radius; });
+  auto const width = largest->radius > 0 ? 2 * largest->radius : 1e0;
+
+  typedef std::array<t_int, 3> Cell;
+  std::map<Cell, std::vector<t_int>> grid;
+  for(t_int i(0); i < static_cast<t_int>(objects.size()); ++i) {
+    auto const position = Tools::toCartesian(objects[i].vR);
+    Cell const cell = {{static_cast<t_int>(std::floor(position.x / width)),
+                        static_cast<t_int>(std::floor(position.y / width)),
+                        static_cast<t_int>(std::floor(position.z / width))}};
+    for(t_int x(cell[0] - 1); x <= cell[0] + 1; ++x)
+      for(t_int y(cell[1] - 1); y <= cell[1] + 1; ++y)
+        for(t_int z(cell[2] - 1); z <= cell[2] + 1; ++z) {
+          auto const neighbours = grid.find({{x, y, z}});
+          if(neighbours == grid.end())
+            continue;
+          for(auto const j : neighbours->second)
+            if(Tools::findDistance(objects[j].vR, objects[i].vR) <=
+               objects[i].radius + objects[j].radius)
+              return {j, i};
+        }
+    grid[cell].push_back(i);
+  }
+  return {-1, -1};
+}
+} // namespace
+
 void Geometry::pushObject(Scatterer const &object_) {
   for(auto const &obj : objects)
-    if(Tools::findDistance(obj.vR, object_.vR) <= (object_.radius + obj.radius)) {
-      std::ostringstream sstr;
-      sstr << "The sphere at (" << Tools::toCartesian(object_.vR).x << ", "
-           << Tools::toCartesian(object_.vR).y << ", " << Tools::toCartesian(object_.vR).z << ") "
-           << "overlaps with the one at (" << Tools::toCartesian(obj.vR).x << ", "
-           << Tools::toCartesian(obj.vR).y << ", " << Tools::toCartesian(obj.vR).z << "), "
-           << "with radii " << object_.radius << " and " << obj.radius;
-      throw std::runtime_error(sstr.str());
-    }
+    if(Tools::findDistance(obj.vR, object_.vR) <= (object_.radius + obj.radius))
+      throw std::runtime_error(overlap_message(object_, obj));
   objects.emplace_back(object_);
 }
 
+void Geometry::pushObjects(std::vector<Scatterer> const &objects_) {
+  optimet::timing::Timer const timer(optimet::timing::Phase::validation);
+  auto const n = objects.size();
+  objects.insert(objects.end(), objects_.begin(), objects_.end());
+  auto const overlap = find_overlap(objects);
+  if(overlap.first >= 0) {
+    auto const message = overlap_message(objects[overlap.second], objects[overlap.first]);
+    objects.erase(objects.begin() + n, objects.end());
+    throw std::runtime_error(message);
+  }
+}
+
 bool Geometry::is_valid() const {
-  using namespace optimet;
-  if(objects.size() == 0)
-    return false;
-  for(t_uint i(0); i < objects.size(); ++i)
-    for(t_uint j(0); j < objects.size(); ++j)
-      if(Tools::findDistance(objects[i].vR, objects[j].vR) <= objects[i].radius + objects[j].radius)
-        return false;
-  return true;
+  optimet::timing::Timer const timer(optimet::timing::Phase::validation);
+  return objects.size() > 0 and find_overlap(objects).first < 0;
 }
 
 void Geometry::initBground(ElectroMagnetic bground_) { bground = bground_; }
@@ -87,10 +137,10 @@ int Geometry::getNLSources(double omega_, int objectIndex_, int nMax_,
                            std::complex<double> *sourceU, std::complex<double> *sourceV) const {
   double R = objects[objectIndex_].radius;
 
-  std::complex<double> mu_b = bground.mu;
-  std::complex<double> eps_b = bground.epsilon;
-  std::complex<double> mu_j2 = objects[objectIndex_].elmag.mu;       /* AJ - SH sphere eps - AJ */
-  std::complex<double> eps_j2 = objects[objectIndex_].elmag.epsilon; /* AJ - SH sphere eps - AJ */
+  std::complex<double> mu_b = bground.mu_SH;
+  std::complex<double> eps_b = bground.epsilon_SH;
+  std::complex<double> mu_j2 = objects[objectIndex_].elmag.mu_SH;  /* AJ - SH sphere eps - AJ */
+  std::complex<double> eps_j2 = objects[objectIndex_].elmag.epsilon_SH; /* AJ - SH sphere eps */
 
   // T_2w_ Auxiliary variables
   // --------------------------------------------------------------------------------
@@ -145,61 +195,21 @@ int Geometry::getNLSources(double omega_, int objectIndex_, int nMax_,
 }
 
 int Geometry::getCabsAux(double omega_, int objectIndex_, int nMax_, double *Cabs_aux_) {
-
-  std::complex<double> temp1(0., 0.);
-  double temp2(0.);
-  std::complex<double> k_s =
-      omega_ * std::sqrt(objects[objectIndex_].elmag.epsilon * objects[objectIndex_].elmag.mu);
-  std::complex<double> k_b = omega_ * std::sqrt(bground.epsilon * bground.mu);
-
-  std::complex<double> rho = k_s / k_b;
-
-  std::complex<double> r_0 = k_b * objects[objectIndex_].radius;
-
-  std::complex<double> mu_j = objects[objectIndex_].elmag.mu;
-  std::complex<double> mu_0 = bground.mu;
-
-  std::complex<double> psi(0., 0.), ksi(0., 0.);
-  std::complex<double> dpsi(0., 0.), dksi(0., 0.);
-  std::complex<double> psirho(0., 0.);
-  std::complex<double> dpsirho(0., 0.);
-
-  std::vector<std::complex<double>> J_n_data, J_n_ddata;
-  std::vector<std::complex<double>> Jrho_n_data, Jrho_n_ddata;
-
+  optimet::Vector<optimet::t_real> factors;
   try {
-    std::tie(J_n_data, J_n_ddata) = optimet::bessel<optimet::Bessel>(r_0, nMax_);
-    std::tie(Jrho_n_data, Jrho_n_ddata) = optimet::bessel<optimet::Bessel>(rho * r_0, nMax_);
+    factors = objects[objectIndex_].getCabsAux(omega_, bground);
   } catch(std::range_error &e) {
     std::cerr << e.what() << std::endl;
     return 1;
   }
 
-  CompoundIterator p;
-
-  int pMax = p.max(nMax_);
-
-  for(p = 0; (int)p < pMax; p++) {
-    // obtain Riccati-Bessel functions
-    psi = r_0 * J_n_data[p.first];
-    dpsi = r_0 * J_n_ddata[p.first] + J_n_data[p.first];
-
-    psirho = r_0 * rho * Jrho_n_data[p.first];
-    dpsirho = r_0 * rho * Jrho_n_ddata[p.first] + Jrho_n_data[p.first];
-
-    // Stout 2002 - from scattered
-    // TE Part
-    temp1 = std::complex<double>(0., 1.) * rho * mu_0 * conj(mu_j) * conj(psirho) * dpsirho;
-    temp2 = abs((mu_j * psirho * dpsi - mu_0 * rho * dpsirho * psi));
-    temp2 *= temp2;
-    Cabs_aux_[p] = real(temp1) / temp2;
-
-    // TM part
-    temp1 = std::complex<double>(0., 1.) * conj(rho) * mu_0 * mu_j * conj(psirho) * dpsirho;
-    temp2 = abs((mu_0 * rho * psirho * dpsi - mu_j * dpsirho * psi));
-    temp2 *= temp2;
-    Cabs_aux_[(int)p + pMax] = real(temp1) / temp2;
-  }
+  int const pMax = CompoundIterator::max(nMax_);
+  int const nObject = objects[objectIndex_].nMax;
+  for(int n = 1, p = 0; n <= nMax_; p += 2 * n + 1, ++n)
+    for(int i = p; i < p + 2 * n + 1; ++i) {
+      Cabs_aux_[i] = factors(n - 1);
+      Cabs_aux_[i + pMax] = factors(nObject + n - 1);
+    }
   return 0;
 }
 
@@ -222,105 +232,82 @@ int Geometry::checkInner(Spherical<double> R_) {
   return -1;
 }
 
-int Geometry::setSourcesSingle(std::shared_ptr<optimet::Excitation const> incWave_,
-                               std::complex<double> const *internalCoef_FF_, int nMax_) {
-  CompoundIterator p;
-  int pMax = p.max(nMax_);
-
-  std::complex<double> *sourceU = new std::complex<double>[2 * pMax];
-  std::complex<double> *sourceV = new std::complex<double>[2 * pMax];
+optimet::Vector<optimet::t_complex>
+Geometry::getSourcesSingle(double omega_, int objectIndex_, int nMax_,
+                           optimet::Vector<optimet::t_complex> const &internalCoef_FF_) const {
+  auto const &object = objects[objectIndex_];
+  auto const pMax = CompoundIterator::max(nMax_);
+
+  std::vector<std::complex<double>> sourceU(2 * pMax), sourceV(2 * pMax);
+  getNLSources(omega_, objectIndex_, nMax_, sourceU.data(), sourceV.data());
+
+  auto const coeffs =
+      optimet::symbol::source_coefficients(internalCoef_FF_, omega_, object, bground, nMax_);
+  optimet::Vector<optimet::t_complex> result(2 * pMax);
+  for(int p = 0; p < pMax; p++) {
+    result(p) = sourceU[p] * coeffs.up(p) + sourceV[p] * coeffs.vp(p);
+    result(p + pMax) = sourceU[p + pMax] * coeffs.upp(p) + sourceV[p + pMax]; //<- this last bit is zero for the moment
+  }
+  return result;
+}
 
-  auto const omega = incWave_->omega();
+int Geometry::setSourcesSingle(std::shared_ptr<optimet::Excitation const> incWave_,
+                               optimet::Vector<optimet::t_complex> const &internalCoef_FF_) {
+  auto const n = 2 * CompoundIterator::max(nMax());
+  if(static_cast<optimet::t_uint>(internalCoef_FF_.size()) != n * objects.size())
+    throw std::runtime_error("Inconsistent number of internal coefficients");
   for(size_t j = 0; j < objects.size(); j++) {
-    getNLSources(omega, j, nMax_, sourceU, sourceV);
-
-    for(p = 0; p < pMax; p++) {
-      objects[j].sourceCoef[static_cast<int>(p)] =
-          sourceU[p] * optimet::symbol::up_mn(p.second, p.first, nMax_,
-                                              internalCoef_FF_[j * 2 * pMax + p.compound],
-                                              internalCoef_FF_[pMax + j * 2 * pMax + p.compound],
-                                              omega, objects[j], bground) +
-          sourceV[p] * optimet::symbol::vp_mn(p.second, p.first, nMax_,
-                                              internalCoef_FF_[j * 2 * pMax + p.compound],
-                                              internalCoef_FF_[pMax + j * 2 * pMax + p.compound],
-                                              omega, objects[j], bground);
-
-      objects[j].sourceCoef[static_cast<int>(p) + pMax] =
-          sourceU[p + pMax] *
-              optimet::symbol::upp_mn(
-                  p.second, p.first, nMax_, internalCoef_FF_[j * 2 * pMax + p.compound],
-                  internalCoef_FF_[pMax + j * 2 * pMax + p.compound], omega, objects[j]) +
-          sourceV[p + pMax]; //<- this last bit is zero for the moment
-    }
+    auto const sources =
+        getSourcesSingle(incWave_->omega(), j, nMax(), internalCoef_FF_.segment(j * n, n));
+    std::copy(sources.data(), sources.data() + sources.size(), objects[j].sourceCoef.begin());
   }
 
-  delete[] sourceU;
-  delete[] sourceV;
-
   return 0;
 }
 
-optimet::Vector<optimet::t_complex> Geometry::getTLocal(optimet::t_real omega_,
-                                                        optimet::t_int objectIndex_,
-                                                        optimet::t_uint nMax_) const {
-  if(objectIndex_ >= static_cast<int>(objects.size()))
-    std::out_of_range("Object index out of range");
-  if(nMax_ != static_cast<optimet::t_uint>(objects[objectIndex_].nMax))
-    std::runtime_error("Internal inconsistency");
-  return objects[objectIndex_].getTLocal(omega_, bground);
+void Geometry::setSourcesSingle(optimet::Vector<optimet::t_complex> const &sources_) {
+  auto const n = 2 * CompoundIterator::max(nMax());
+  if(static_cast<optimet::t_uint>(sources_.size()) != n * objects.size())
+    throw std::runtime_error("Inconsistent number of source coefficients");
+  for(size_t j = 0; j < objects.size(); j++)
+    std::copy(sources_.data() + j * n, sources_.data() + (j + 1) * n,
+              objects[j].sourceCoef.begin());
+}
+
+Geometry Geometry::secondHarmonic() const {
+  auto const to_SH = [](ElectroMagnetic &elmag) {
+    elmag.epsilon = elmag.epsilon_SH;
+    elmag.mu = elmag.mu_SH;
+    elmag.epsilon_r = elmag.epsilon_r_SH;
+    elmag.mu_r = elmag.mu_r_SH;
+  };
+  Geometry result(*this);
+  to_SH(result.bground);
+  for(auto &object : result.objects)
+    to_SH(object.elmag);
+  return result;
 }
 
 int Geometry::getSourceLocal(int objectIndex_, std::shared_ptr<optimet::Excitation const> incWave_,
                              int nMax_, std::complex<double> *Q_SH_local_) const {
-  CompoundIterator p;
-  CompoundIterator q;
+  int const pMax = CompoundIterator::max(nMax_);
 
-  int pMax = p.max(nMax_);
-  int qMax = q.max(nMax_);
-
-  // Make sure Q_SH_local_ is zero
-  for(p = 0; p < pMax; p++) {
-    Q_SH_local_[p] = std::complex<double>(0.0, 0.0);
-    Q_SH_local_[p + pMax] = std::complex<double>(0.0, 0.0);
-  }
-
-  std::complex<double> **T_AB = Tools::Get_2D_c_double(2 * pMax, 2 * qMax);
-  std::complex<double> *Q_interm = new std::complex<double>[pMax + qMax];
+  Eigen::Map<optimet::Vector<optimet::t_complex>> Q_SH_local(Q_SH_local_, 2 * pMax);
+  Q_SH_local.fill(0);
 
   for(size_t j = 0; j < objects.size(); j++) {
     if(static_cast<int>(j) == objectIndex_)
       continue;
 
-    // Build the T_AB matrix
+    // Translate the single sources of object j onto this object
     optimet::Coupling const AB(objects[objectIndex_].vR - objects[j].vR, incWave_->waveK, nMax_);
+    Eigen::Map<optimet::Vector<optimet::t_complex> const> const source(
+        objects[j].sourceCoef.data(), 2 * pMax);
 
-    for(p = 0; p < pMax; p++) {
-      for(q = 0; q < qMax; q++) {
-        T_AB[p][q] = AB.diagonal(p, q);
-        T_AB[p + pMax][q + qMax] = AB.diagonal(p, q);
-        T_AB[p + pMax][q] = AB.offdiagonal(p, q);
-        T_AB[p][q + qMax] = AB.offdiagonal(p, q);
-      }
-    }
-
-    // Multiply T_AB with the single local sources
-    Algebra::multiplyVectorMatrix(T_AB, 2 * pMax, 2 * qMax, objects[j].sourceCoef.data(), Q_interm,
-                                  consC1, consC1);
-
-    // Finally, add Q_interm to Q_SH_local
-    for(p = 0; p < pMax; p++) {
-      Q_SH_local_[p] += Q_interm[p];
-      Q_SH_local_[p + pMax] += Q_interm[p + pMax];
-    }
+    Q_SH_local.head(pMax) += AB.diagonal * source.head(pMax) + AB.offdiagonal * source.tail(pMax);
+    Q_SH_local.tail(pMax) += AB.offdiagonal * source.head(pMax) + AB.diagonal * source.tail(pMax);
   }
 
-  // Clear up the memory
-  for(int i = 0; i < 2 * pMax; i++)
-    delete[] T_AB[i];
-
-  delete[] T_AB;
-  delete[] Q_interm;
-
   return 0;
 }
 
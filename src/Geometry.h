@@ -83,19 +83,19 @@ public:
    */
   void pushObject(Scatterer const &object_);
 
-  //! \brief Validate geometry
-  //! \details Fails if no objects, or if two objects overlap.
-  bool is_valid() const;
   /**
-   * Returns the single object local scattering matrix T_j.
-   * Currently implements the scattering matrix for spherical objects.
-   * @param omega_ the angular frequency of the simulation.
-   * @param objectIndex_ the index of the object for which T_j is calculated.
-   * @param nMax_ the maximum value of the n iterator.
+   * Adds many objects to the Geometry at once.
+   * Overlaps are checked in linear time using a spatial grid, rather than
+   * against every object in turn as in pushObject.
+   * @param objects_ the Scatterer objects to be added.
+   * @throws std::runtime_error if any two objects overlap, in which case the
+   * Geometry is left unchanged.
    */
-  optimet::Vector<optimet::t_complex>
-  getTLocal(optimet::t_real omega_, optimet::t_int objectIndex_, optimet::t_uint nMax_) const;
+  void pushObjects(std::vector<Scatterer> const &objects_);
 
+  //! \brief Validate geometry
+  //! \details Fails if no objects, or if two objects overlap.
+  bool is_valid() const;
   int getCabsAux(double omega_, int objectIndex_, int nMax_, double *Cabs_aux_);
 
   int getNLSources(double omega_, int objectIndex_, int nMax_, std::complex<double> *sourceU,
@@ -129,8 +129,45 @@ public:
   int getSourceLocal(int objectIndex_, std::shared_ptr<optimet::Excitation const> incWave_,
                      int nMax_, std::complex<double> *Q_SH_local_) const;
 
+  /**
+   * Calculates the second harmonic single sources of one object.
+   * @param omega_ the angular frequency of the second harmonic, i.e. twice that
+   * of the fundamental.
+   * @param objectIndex_ the index of the object.
+   * @param nMax_ the maximum value of the n iterator.
+   * @param internalCoef_FF_ the internal coefficients of this object only,
+   * for the FF case.
+   * @return the source coefficients, TE then TM.
+   */
+  optimet::Vector<optimet::t_complex>
+  getSourcesSingle(double omega_, int objectIndex_, int nMax_,
+                   optimet::Vector<optimet::t_complex> const &internalCoef_FF_) const;
+
+  /**
+   * Calculates and sets the second harmonic single sources of all objects.
+   * @param incWave_ pointer to the excitation at the second harmonic frequency.
+   * @param internalCoef_FF_ the internal coefficients of all objects for the
+   * FF case.
+   * @return 0 if successful, 1 otherwise.
+   */
   int setSourcesSingle(std::shared_ptr<optimet::Excitation const> incWave_,
-                       std::complex<double> const *internalCoef_FF_, int nMax_);
+                       optimet::Vector<optimet::t_complex> const &internalCoef_FF_);
+
+  /**
+   * Sets the second harmonic single sources of all objects.
+   * @param sources_ the source coefficients of each object, TE then TM,
+   * contiguous in the order of the objects.
+   */
+  void setSourcesSingle(optimet::Vector<optimet::t_complex> const &sources_);
+
+  /**
+   * Returns the geometry at the second harmonic frequency.
+   * Objects keep their positions, radii and number of harmonics. The
+   * permittivity and permeability of the objects and of the background are
+   * replaced by their second harmonic values.
+   * @return the second harmonic geometry.
+   */
+  Geometry secondHarmonic() const;
 
   /**
    * Updates the Geometry object to a new Excitation.
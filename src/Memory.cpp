@@ -0,0 +1,389 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Memory.h"
+#include "Run.h"
+#include "Solver.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace optimet {
+namespace memory {
+namespace {
+constexpr t_uint ncomponents = static_cast<t_uint>(Component::size);
+//! Bytes currently held by each component on this process
+std::array<t_real, ncomponents> currents = {{}};
+//! Largest number of bytes held by each component on this process
+std::array<t_real, ncomponents> peaks = {{}};
+
+//! Size of a complex number in bytes
+constexpr t_real complex_bytes() { return sizeof(t_complex); }
+//! Default number of Krylov vectors kept by Belos' GMRES
+constexpr t_int default_num_blocks() { return 300; }
+//! Extra degree of the co-axial translations, as in FastMatrixMultiply
+constexpr t_int nplus() { return 1; }
+
+//! Number of Krylov vectors stored by the iterative solvers
+t_int num_blocks(Run const &run) {
+#ifdef OPTIMET_BELOS
+  if(not run.belos_params.is_null() and run.belos_params->isParameter("Num Blocks"))
+    return run.belos_params->get<int>("Num Blocks");
+#else
+  (void)run;
+#endif
+  return default_num_blocks();
+}
+
+//! Number of coefficients of each object
+std::vector<t_real> object_sizes(Run const &run) {
+  std::vector<t_real> result;
+  for(auto const &object : run.geometry->objects)
+    result.push_back(2 * object.nMax * (object.nMax + 2));
+  return result;
+}
+
+//! Process owning each object, as in mpi::details::vector_distribution
+std::vector<t_uint> owners(t_uint nobjects, t_uint nprocs) {
+  std::vector<t_uint> result(nobjects, 0);
+  auto const N = std::max<t_uint>(1, std::min(nobjects, nprocs));
+  auto const divided = nobjects / N;
+  auto const remainder = nobjects % N;
+  for(t_uint i(0), first(0); i < N; ++i) {
+    auto const size = divided + (remainder > i ? 1 : 0);
+    std::fill(result.begin() + first, result.begin() + first + size, i);
+    first += size;
+  }
+  return result;
+}
+
+//! Largest local block of a N by N matrix distributed with Scalapack
+t_real scalapack_local_elements(t_real N, t_uint nprocs, scalapack::Parameters const &params) {
+  auto grid = params.grid;
+  if(grid.rows * grid.cols == 0 or grid.rows * grid.cols > nprocs) {
+    grid.rows = std::max<t_uint>(1, std::sqrt(static_cast<t_real>(nprocs)));
+    grid.cols = std::max<t_uint>(1, nprocs / grid.rows);
+  }
+  auto const block = static_cast<t_real>(std::max<t_uint>(1, params.block_size));
+  auto const blocks = std::ceil(N / block);
+  auto const rows = std::min(N, std::ceil(blocks / grid.rows) * block);
+  auto const cols = std::min(N, std::ceil(blocks / grid.cols) * block);
+  return rows * cols;
+}
+
+//! Footprint of the FMM on the busiest process
+Footprint fmm_footprint(Run const &run, t_uint nprocs) {
+  auto const &objects = run.geometry->objects;
+  auto const nobjects = static_cast<t_int>(objects.size());
+  auto const owner = owners(nobjects, nprocs);
+  auto const sizes = object_sizes(run);
+
+  // same pairs and degrees as FastMatrixMultiply::compute_rotations and compute_translations
+  auto const nmax = nobjects == 0 ? 0 : std::max_element(objects.begin(), objects.end(),
+                                                          [](Scatterer const &a,
+                                                             Scatterer const &b) {
+                                                            return a.nMax < b.nMax;
+                                                          })->nMax;
+  // factored rotations hold no per-pair matrices, only the flips shared by the whole process
+  auto const factored = run.fmm_factored_rotations;
+  std::vector<t_real> rotations(std::max(1, nmax + 1)), translations(std::max(1, nmax + 1));
+  for(t_int n(0); n <= nmax; ++n) {
+    rotations[n] = factored ? 0 : rotation_bytes(n);
+    translations[n] = coaxial_bytes(n + nplus());
+  }
+  std::vector<Footprint> footprints(nprocs);
+  // translations between different particles, stored only up to the budget
+  std::vector<t_real> pairs(nprocs, 0);
+  if(factored)
+    for(auto &footprint : footprints)
+      footprint[Component::rotations] = flip_bytes(std::max(1, nmax));
+  for(t_int i(0); i < nobjects; ++i)
+    for(t_int j(i); j < nobjects; ++j) {
+      // self-interactions hold an identity rotation and a degree one translation
+      auto const degree = std::max(objects[i].nMax, objects[j].nMax);
+      auto const rotation = i == j ? (factored ? 0 : rotation_bytes(1)) : rotations[degree];
+      auto const translation = i == j ? coaxial_bytes(1) : translations[degree];
+      // whatever the diagonals, the forward and transpose directions of (i, j) and (j, i) are
+      // computed by the owners of i and j, each storing the operators of the pair once
+      footprints[owner[i]][Component::rotations] += rotation;
+      if(i == j)
+        footprints[owner[i]][Component::translations] += translation;
+      else
+        pairs[owner[i]] += translation;
+      if(owner[j] != owner[i]) {
+        footprints[owner[j]][Component::rotations] += rotation;
+        pairs[owner[j]] += translation;
+      }
+    }
+  for(t_uint rank(0); rank < nprocs; ++rank)
+    footprints[rank][Component::translations] += std::min(pairs[rank], run.fmm_translations_budget);
+
+  std::vector<t_real> owned(nprocs, 0);
+  for(t_int i(0); i < nobjects; ++i)
+    owned[owner[i]] += sizes[i];
+  for(t_uint rank(0); rank < nprocs; ++rank)
+    footprints[rank][Component::krylov] = (num_blocks(run) + 1) * owned[rank] * complex_bytes();
+  return *std::max_element(
+      footprints.begin(), footprints.end(),
+      [](Footprint const &a, Footprint const &b) { return a.total() < b.total(); });
+}
+} // namespace
+
+char const *name(Component component) {
+  static char const *const names[ncomponents] = {"rotations", "translations", "matrix", "krylov",
+                                                 "vectors"};
+  return names[static_cast<t_uint>(component)];
+}
+
+t_real Footprint::total() const {
+  t_real result(0);
+  for(auto const bytes : bytes_)
+    result += bytes;
+  return result;
+}
+
+t_real rotation_bytes(t_int nmax) {
+  t_real result(0);
+  for(t_int n(0); n <= nmax; ++n)
+    result += (2 * n + 1) * (2 * n + 1);
+  return result * complex_bytes();
+}
+
+t_real flip_bytes(t_int nmax) { return rotation_bytes(nmax) * sizeof(t_real) / complex_bytes(); }
+
+t_real coaxial_bytes(t_int nmax) {
+  t_real result(0);
+  // coefficients of -m are those of m
+  for(t_int n(0); n <= nmax; ++n)
+    for(t_int m(0); m <= n; ++m)
+      result += nmax - m + 1;
+  return result * complex_bytes();
+}
+
+Footprint predict(solver::Kind kind, Run const &run, t_uint nprocs) {
+  nprocs = std::max<t_uint>(1, nprocs);
+  auto const sizes = object_sizes(run);
+  t_real N(0);
+  for(auto const size : sizes)
+    N += size;
+
+  Footprint result;
+  switch(kind) {
+  case solver::Kind::eigen:
+    // the matrix and the copy factorized by Eigen
+    result[Component::matrix] = 2 * N * N * complex_bytes();
+    break;
+  case solver::Kind::scalapack:
+    // the local blocks and the copy factorized by Scalapack
+    result[Component::matrix] =
+        2 * scalapack_local_elements(N, nprocs, run.parallel_params) * complex_bytes();
+    break;
+  case solver::Kind::belos:
+    result[Component::matrix] =
+        scalapack_local_elements(N, nprocs, run.parallel_params) * complex_bytes();
+    result[Component::krylov] =
+        (num_blocks(run) + 1) * std::ceil(N / nprocs) * complex_bytes();
+    break;
+  case solver::Kind::fmm:
+    result = fmm_footprint(run, nprocs);
+    break;
+  }
+  // sources, scattered and internal coefficients, and a work vector, all of full size
+  result[Component::vectors] = 4 * N * complex_bytes();
+  return result;
+}
+
+std::vector<std::pair<solver::Kind, Footprint>> predict(Run const &run, t_uint nprocs) {
+  std::vector<std::pair<solver::Kind, Footprint>> result;
+  for(auto const kind : solver::available())
+    result.emplace_back(kind, predict(kind, run, nprocs));
+  return result;
+}
+
+solver::Kind recommend(Run const &run, t_uint nprocs, t_real budget) {
+  auto const footprints = predict(run, nprocs);
+  auto const smallest = std::min_element(
+      footprints.begin(), footprints.end(),
+      [](std::pair<solver::Kind, Footprint> const &a, std::pair<solver::Kind, Footprint> const &b) {
+        return a.second.total() < b.second.total();
+      });
+  if(smallest == footprints.end() or smallest->second.total() > budget) {
+    std::ostringstream sstr;
+    sstr << "No solver fits in " << format_bytes(budget) << " per process";
+    if(smallest != footprints.end())
+      sstr << ": the smallest, " << solver::name(smallest->first) << ", needs "
+           << format_bytes(smallest->second.total());
+    throw std::runtime_error(sstr.str());
+  }
+  return smallest->first;
+}
+
+t_real budget(Run const &run, mpi::Communicator const &comm) {
+  if(run.memory_budget > 0)
+    return run.memory_budget;
+  auto const pages = sysconf(_SC_PHYS_PAGES);
+  auto const page_size = sysconf(_SC_PAGE_SIZE);
+  t_int nlocals = 1;
+#ifdef OPTIMET_MPI
+  MPI_Comm node;
+  MPI_Comm_split_type(*comm, MPI_COMM_TYPE_SHARED, comm.rank(), MPI_INFO_NULL, &node);
+  MPI_Comm_size(node, &nlocals);
+  MPI_Comm_free(&node);
+#endif
+  // processes which cannot tell their memory do not constrain the others
+  t_real result = pages > 0 and page_size > 0 ?
+                      static_cast<t_real>(pages) * static_cast<t_real>(page_size) / nlocals :
+                      std::numeric_limits<t_real>::infinity();
+#ifdef OPTIMET_MPI
+  // all processes must agree, so that they all take the same decisions from the budget
+  result = comm.all_reduce(result, MPI_MIN);
+#else
+  (void)comm;
+#endif
+  return std::isinf(result) ? 0 : result;
+}
+
+void check(Run const &run, mpi::Communicator const &comm) {
+  auto const available = budget(run, comm);
+  if(available <= 0)
+    return;
+  auto const kind = solver::kind(run);
+  auto const needed = predict(kind, run, comm.size()).total();
+  if(needed <= available)
+    return;
+  std::ostringstream sstr;
+  sstr << "The " << solver::name(kind) << " solver needs " << format_bytes(needed)
+       << " per process, but only " << format_bytes(available) << " are available";
+  try {
+    auto const recommended = recommend(run, comm.size(), available);
+    sstr << ". The " << solver::name(recommended) << " solver would fit, with "
+         << format_bytes(predict(recommended, run, comm.size()).total());
+  } catch(std::runtime_error const &) {
+    sstr << ", and no other solver fits either";
+  }
+  throw std::runtime_error(sstr.str());
+}
+
+void write(std::ostream &stream, Run const &run, t_uint nprocs, t_real budget) {
+  stream << "Predicted memory per process, on the busiest of " << nprocs << " processes";
+  if(budget > 0)
+    stream << ", for a budget of " << format_bytes(budget);
+  stream << ":\n" << std::setw(10) << std::left << "solver" << std::right;
+  for(t_uint i(0); i < ncomponents; ++i)
+    stream << std::setw(14) << name(static_cast<Component>(i));
+  stream << std::setw(14) << "total"
+         << "\n";
+  for(auto const &prediction : predict(run, nprocs)) {
+    stream << std::setw(10) << std::left << solver::name(prediction.first) << std::right;
+    for(t_uint i(0); i < ncomponents; ++i)
+      stream << std::setw(14) << format_bytes(prediction.second[static_cast<Component>(i)]);
+    stream << std::setw(14) << format_bytes(prediction.second.total()) << "\n";
+  }
+  if(budget > 0) {
+    try {
+      stream << "Recommended solver: " << solver::name(recommend(run, nprocs, budget)) << "\n";
+    } catch(std::runtime_error const &e) {
+      stream << e.what() << "\n";
+    }
+  }
+}
+
+t_real parse_bytes(std::string const &bytes) {
+  std::istringstream sstr(bytes);
+  t_real result;
+  if(not(sstr >> result) or result <= 0)
+    throw std::runtime_error("Expected a positive number of bytes, got " + bytes);
+  std::string suffix;
+  sstr >> suffix;
+  std::transform(suffix.begin(), suffix.end(), suffix.begin(),
+                 [](char c) { return static_cast<char>(std::toupper(c)); });
+  std::string const prefixes = "KMGT";
+  auto const prefix = suffix.empty() ? std::string::npos : prefixes.find(suffix[0]);
+  if(prefix != std::string::npos)
+    result *= std::pow(1024e0, prefix + 1);
+  auto const unit = suffix.substr(prefix == std::string::npos ? 0 : 1);
+  if(unit != "" and unit != "B" and unit != "IB")
+    throw std::runtime_error("Unknown unit in number of bytes " + bytes);
+  std::string rest;
+  if(sstr >> rest)
+    throw std::runtime_error("Unexpected characters in number of bytes " + bytes);
+  return result;
+}
+
+std::string format_bytes(t_real bytes) {
+  char const *const units[] = {"B", "KB", "MB", "GB", "TB", "PB"};
+  t_uint unit(0);
+  while(std::abs(bytes) >= 1024 and unit + 1 < sizeof(units) / sizeof(units[0])) {
+    bytes /= 1024;
+    ++unit;
+  }
+  std::ostringstream sstr;
+  sstr << std::setprecision(unit == 0 ? 0 : 3) << std::fixed << bytes;
+  auto result = sstr.str();
+  // trailing zeros only make the tables harder to read
+  if(result.find('.') != std::string::npos) {
+    result.erase(result.find_last_not_of('0') + 1);
+    if(result.back() == '.')
+      result.pop_back();
+  }
+  return result + " " + units[unit];
+}
+
+void allocate(Component component, t_real bytes) {
+  if(component == Component::size)
+    return;
+  auto const i = static_cast<t_uint>(component);
+  currents[i] += bytes;
+  peaks[i] = std::max(peaks[i], currents[i]);
+}
+
+void release(Component component, t_real bytes) {
+  if(component != Component::size)
+    currents[static_cast<t_uint>(component)] -= bytes;
+}
+
+t_real current(Component component) { return currents[static_cast<t_uint>(component)]; }
+
+t_real peak(Component component) { return peaks[static_cast<t_uint>(component)]; }
+
+void reset() { peaks = currents; }
+
+void write_peaks(std::ostream &stream, mpi::Communicator const &comm) {
+  Vector<t_real> const local = Vector<t_real>::Map(peaks.data(), ncomponents);
+#ifdef OPTIMET_MPI
+  auto const maximum = comm.all_reduce(local, MPI_MAX);
+#else
+  auto const &maximum = local;
+#endif
+  if(comm.rank() != comm.root_id())
+    return;
+  stream << "Peak memory per process:";
+  for(t_uint i(0), first(1); i < ncomponents; ++i) {
+    if(maximum(i) <= 0)
+      continue;
+    stream << (first ? " " : ", ") << name(static_cast<Component>(i)) << " "
+           << format_bytes(maximum(i));
+    first = 0;
+  }
+  stream << "\n";
+}
+} // namespace memory
+} // namespace optimet
@@ -0,0 +1,143 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_MEMORY_H
+#define OPTIMET_MEMORY_H
+
+#include "Types.h"
+#include "mpi/Communicator.h"
+#include <array>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace optimet {
+class Run;
+namespace solver {
+enum class Kind : t_uint;
+}
+
+//! \brief Memory footprint of the solvers, predicted before a run and tracked during it
+//! \details Predictions are made from the geometry, the number of harmonics and the number of
+//! processes only, so that a configuration can be checked before any large allocation. At
+//! runtime, the large objects record their size on creation and release it on destruction.
+namespace memory {
+//! Large components of the solvers
+enum class Component : t_uint {
+  rotations,    //!< Rotation matrices of the FMM
+  translations, //!< Co-axial translation coefficients of the FMM
+  matrix,       //!< Scattering matrix, full or distributed, and its factorization
+  krylov,       //!< Krylov basis of the iterative solvers
+  vectors,      //!< Source and solution vectors
+  size          //!< Number of components
+};
+//! Name of a component, as it appears in reports
+char const *name(Component component);
+
+//! Bytes held by each component
+class Footprint {
+public:
+  Footprint() : bytes_{{}} {}
+
+  t_real &operator[](Component component) { return bytes_[static_cast<t_uint>(component)]; }
+  t_real operator[](Component component) const { return bytes_[static_cast<t_uint>(component)]; }
+  //! Sum over all components
+  t_real total() const;
+
+private:
+  std::array<t_real, static_cast<t_uint>(Component::size)> bytes_;
+};
+
+//! Bytes in the rotation matrices of degrees 0 to nmax
+t_real rotation_bytes(t_int nmax);
+//! Bytes in the real flips of degrees 0 to nmax, shared by all factored rotations of a process
+t_real flip_bytes(t_int nmax);
+//! Bytes in the co-axial translation coefficients up to degree nmax
+t_real coaxial_bytes(t_int nmax);
+
+//! \brief Predicted footprint of a solver on the busiest process
+//! \details The FMM follows the distribution of `mpi::FastMatrixMultiply`, including the operators
+//! for the transpose product. Dense matrices are counted with the copy made for their
+//! factorization, and the Krylov basis with the "Num Blocks" parameter of Belos.
+Footprint predict(solver::Kind kind, Run const &run, t_uint nprocs);
+//! Predicted footprints of the solvers available in this build
+std::vector<std::pair<solver::Kind, Footprint>> predict(Run const &run, t_uint nprocs);
+//! \brief Solver with the smallest predicted footprint that fits in the budget
+//! \details Throws if none of the solvers available in this build fit.
+solver::Kind recommend(Run const &run, t_uint nprocs, t_real budget);
+
+//! \brief Memory available to each process, in bytes
+//! \details The budget given in the input, if any. Otherwise, the physical memory of the node
+//! divided between the processes running on it, minimum over all processes. Zero if unknown.
+//! Collective.
+t_real budget(Run const &run, mpi::Communicator const &comm);
+//! \brief Throws if the solver chosen for the run is predicted not to fit in the budget
+//! \details Collective. Either all processes throw, or none does.
+void check(Run const &run, mpi::Communicator const &comm);
+//! Writes the predicted footprint of each solver, and the recommended one
+void write(std::ostream &stream, Run const &run, t_uint nprocs, t_real budget);
+
+//! \brief Parses a number of bytes, e.g. "512MB" or "4 GB"
+//! \details Suffixes are powers of 1024. Throws if the string is not a positive size.
+t_real parse_bytes(std::string const &bytes);
+//! Formats a number of bytes with a suffix, e.g. "1.5 GB"
+std::string format_bytes(t_real bytes);
+
+//! Records an allocation
+void allocate(Component component, t_real bytes);
+//! Records a deallocation
+void release(Component component, t_real bytes);
+//! Bytes currently held by a component on this process
+t_real current(Component component);
+//! Largest number of bytes held by a component on this process since the last reset
+t_real peak(Component component);
+//! Sets peaks back to the current allocations
+void reset();
+//! Writes the peak of each component, maximum over processes. Collective.
+void write_peaks(std::ostream &stream, mpi::Communicator const &comm);
+
+//! \brief Records the memory of an object for its lifetime
+//! \details Copies record the memory again, as the object they are attached to is copied too.
+class Allocation {
+public:
+  Allocation() : component_(Component::size), bytes_(0) {}
+  Allocation(Component component, t_real bytes) : component_(component), bytes_(bytes) {
+    allocate(component_, bytes_);
+  }
+  Allocation(Allocation const &other) : Allocation(other.component_, other.bytes_) {}
+  Allocation(Allocation &&other) : component_(other.component_), bytes_(other.bytes_) {
+    other.bytes_ = 0;
+  }
+  Allocation &operator=(Allocation other) {
+    std::swap(component_, other.component_);
+    std::swap(bytes_, other.bytes_);
+    return *this;
+  }
+  ~Allocation() {
+    if(bytes_ > 0)
+      release(component_, bytes_);
+  }
+
+  t_real bytes() const { return bytes_; }
+
+private:
+  Component component_;
+  t_real bytes_;
+};
+} // namespace memory
+} // namespace optimet
+#endif
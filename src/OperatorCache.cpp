@@ -0,0 +1,185 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "OperatorCache.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace optimet {
+namespace {
+//! Identifies cache files
+char const magic[8] = {'O', 'P', 'T', 'I', 'M', 'E', 'T', 'C'};
+//! Bumped whenever the layout of the operator data changes
+std::uint32_t const version = 4;
+
+//! 64-bit FNV-1a hash
+class Hash {
+public:
+  Hash &operator<<(t_real value) { return bytes(&value, sizeof(value)); }
+  Hash &operator<<(t_complex value) { return *this << value.real() << value.imag(); }
+  Hash &operator<<(t_int value) { return bytes(&value, sizeof(value)); }
+  Hash &operator<<(ElectroMagnetic const &elmag) {
+    return *this << elmag.epsilon << elmag.mu << elmag.epsilon_SH << elmag.mu_SH;
+  }
+  Hash &operator<<(Geometry const &geometry) {
+    *this << geometry.bground << static_cast<t_int>(geometry.objects.size());
+    for(auto const &object : geometry.objects)
+      *this << object.vR.rrr << object.vR.the << object.vR.phi << object.radius << object.elmag
+            << static_cast<t_int>(object.nMax);
+    return *this;
+  }
+
+  std::string str() const {
+    std::ostringstream sstr;
+    sstr << std::hex << std::setw(16) << std::setfill('0') << value;
+    return sstr.str();
+  }
+
+private:
+  std::uint64_t value = 14695981039346656037ull;
+
+  Hash &bytes(void const *data, std::size_t n) {
+    auto const chars = static_cast<unsigned char const *>(data);
+    for(std::size_t i(0); i < n; ++i)
+      value = (value ^ chars[i]) * 1099511628211ull;
+    return *this;
+  }
+};
+
+template <class T> void write(std::ostream &stream, T const &value) {
+  stream.write(reinterpret_cast<char const *>(&value), sizeof(value));
+}
+void write(std::ostream &stream, std::string const &value) {
+  write(stream, static_cast<std::uint64_t>(value.size()));
+  stream.write(value.data(), value.size());
+}
+//! Bytes left to read in a stream, so that sizes read from a file are checked before allocating
+std::uint64_t remaining(std::istream &stream) {
+  auto const position = stream.tellg();
+  if(position < 0)
+    return 0;
+  stream.seekg(0, std::ios::end);
+  auto const end = stream.tellg();
+  stream.seekg(position);
+  return end > position ? static_cast<std::uint64_t>(end - position) : 0;
+}
+template <class T> bool read(std::istream &stream, T &value) {
+  return static_cast<bool>(stream.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+bool read(std::istream &stream, std::string &value) {
+  std::uint64_t n;
+  if(not read(stream, n) or n > remaining(stream))
+    return false;
+  value.resize(n);
+  return n == 0 or static_cast<bool>(stream.read(&value[0], n));
+}
+} // namespace
+
+std::string operator_hash(Geometry const &geometry, t_real wavenumber) {
+  return (Hash() << geometry << wavenumber).str();
+}
+
+std::string coefficients_hash(Geometry const &geometry, Excitation const &excitation) {
+  auto const &E = excitation.Einc;
+  auto const &k = excitation.vKInc;
+  return (Hash() << geometry << excitation.wavenumber() << static_cast<t_int>(excitation.type)
+                 << static_cast<t_int>(excitation.nMax) << k.rrr << k.the << k.phi << E.rrr
+                 << E.the << E.phi)
+      .str();
+}
+
+std::string OperatorCache::filename(std::string const &hash, std::string const &kind) const {
+  return directory_ + "/" + hash + "." + kind + ".cache";
+}
+
+bool OperatorCache::load(std::string const &hash, std::string const &kind,
+                         OperatorData &data) const {
+  if(not enabled())
+    return false;
+  std::ifstream file(filename(hash, kind), std::ios::binary);
+  if(not file)
+    return false;
+
+  char header[sizeof(magic)];
+  std::uint32_t file_version;
+  std::string file_hash, file_kind;
+  std::uint64_t nblocks;
+  if(not(file.read(header, sizeof(header)) and std::equal(magic, magic + sizeof(magic), header)))
+    return false;
+  if(not(read(file, file_version) and file_version == version))
+    return false;
+  if(not(read(file, file_hash) and file_hash == hash and read(file, file_kind) and
+         file_kind == kind and read(file, nblocks)))
+    return false;
+  // a corrupted or truncated file must not trigger huge allocations: each block holds at least
+  // its two dimensions, and its data cannot extend past the end of the file
+  if(nblocks > remaining(file) / (2 * sizeof(std::int64_t)))
+    return false;
+
+  OperatorData result(nblocks);
+  for(auto &block : result) {
+    std::int64_t rows, cols;
+    if(not(read(file, rows) and read(file, cols)) or rows < 0 or cols < 0)
+      return false;
+    auto const available = remaining(file) / sizeof(t_complex);
+    if(rows > 0 and static_cast<std::uint64_t>(cols) > available / static_cast<std::uint64_t>(rows))
+      return false;
+    block.resize(rows, cols);
+    if(not file.read(reinterpret_cast<char *>(block.data()), block.size() * sizeof(t_complex)))
+      return false;
+  }
+  data = std::move(result);
+  return true;
+}
+
+void OperatorCache::save(std::string const &hash, std::string const &kind,
+                         OperatorData const &data) const {
+  if(not enabled())
+    return;
+  // write to a temporary file first, so that readers never see a partial entry
+  auto const path = filename(hash, kind);
+  auto const temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(magic, sizeof(magic));
+    write(file, version);
+    write(file, hash);
+    write(file, kind);
+    write(file, static_cast<std::uint64_t>(data.size()));
+    for(auto const &block : data) {
+      write(file, static_cast<std::int64_t>(block.rows()));
+      write(file, static_cast<std::int64_t>(block.cols()));
+      file.write(reinterpret_cast<char const *>(block.data()), block.size() * sizeof(t_complex));
+    }
+    if(file)
+      file.close();
+    if(not file) {
+      std::cerr << "Could not write operator cache " << temporary << std::endl;
+      std::remove(temporary.c_str());
+      return;
+    }
+  }
+  if(std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::cerr << "Could not write operator cache " << path << std::endl;
+    std::remove(temporary.c_str());
+  }
+}
+}
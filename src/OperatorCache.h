@@ -0,0 +1,68 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_OPERATOR_CACHE_H
+#define OPTIMET_OPERATOR_CACHE_H
+
+#include "Excitation.h"
+#include "Geometry.h"
+#include "Types.h"
+#include <string>
+#include <vector>
+
+namespace optimet {
+//! Blocks of complex data, as stored in an operator cache file
+typedef std::vector<Matrix<t_complex>> OperatorData;
+
+//! \brief Content hash of the inputs defining the scattering operator
+//! \details Covers the background, and the position, radius, materials (fundamental and second
+//! harmonic) and number of harmonics of each object, as well as the wavenumber.
+std::string operator_hash(Geometry const &geometry, t_real wavenumber);
+//! \brief Content hash of the inputs defining the solved coefficients
+//! \details Same as operator_hash, plus the type, direction and polarization of the incident wave.
+std::string coefficients_hash(Geometry const &geometry, Excitation const &excitation);
+
+//! \brief Precomputed operator data stored on disk
+//! \details Each entry is a binary file in the cache directory, named after a content hash and
+//! the kind of data it holds. The blocks follow a small header, each stored contiguously in
+//! column-major order, so that they can be read back (or mapped) without parsing. A cache with an
+//! empty directory is disabled: nothing is ever loaded or saved.
+class OperatorCache {
+public:
+  //! Cache in the given directory, which should exist
+  OperatorCache(std::string const &directory = "") : directory_(directory) {}
+
+  //! Whether anything is loaded or saved
+  bool enabled() const { return not directory_.empty(); }
+  //! Directory holding the cache files
+  std::string const &directory() const { return directory_; }
+  //! File holding a given entry
+  std::string filename(std::string const &hash, std::string const &kind) const;
+
+  //! \brief Loads an entry
+  //! \returns false if the cache is disabled, or if the entry is missing or invalid
+  bool load(std::string const &hash, std::string const &kind, OperatorData &data) const;
+  //! \brief Saves an entry
+  //! \details Does nothing if the cache is disabled. Failing to write the entry is not an error,
+  //! since it will simply be recomputed in the next run.
+  void save(std::string const &hash, std::string const &kind, OperatorData const &data) const;
+
+private:
+  //! Directory holding the cache files
+  std::string directory_;
+};
+}
+#endif
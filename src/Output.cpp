@@ -38,6 +38,14 @@ hid_t Output::init(std::string const &outputFileName_) {
       H5Gcreate(outputFile, "Field_H", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
   H5Gclose(auxGroupID);
 
+  auxGroupID =
+      H5Gcreate(outputFile, "Field_E_SH", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Gclose(auxGroupID);
+
+  auxGroupID =
+      H5Gcreate(outputFile, "Field_H_SH", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Gclose(auxGroupID);
+
   auxGroupID =
       H5Gcreate(outputFile, "CS_Sca", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
   H5Gclose(auxGroupID);
@@ -14,10 +14,14 @@
 // You should have received a copy of the GNU General Public License
 // along with Optimet. If not, see <http://www.gnu.org/licenses/>.
 
+#include "CompoundIterator.h"
 #include "Coupling.h"
 #include "PreconditionedMatrix.h"
+#include "Timing.h"
 #include "Types.h"
 #include "scalapack/BroadcastToOutOfContext.h"
+#include <algorithm>
+#include <utility>
 
 namespace optimet {
 #ifdef OPTIMET_SCALAPACK
@@ -67,6 +71,7 @@ preconditioned_scattering_matrix(std::vector<Scatterer>::const_iterator const &f
                                  std::vector<Scatterer>::const_iterator const &end_second,
                                  ElectroMagnetic const &bground,
                                  std::shared_ptr<Excitation const> incWave) {
+  timing::Timer const timer(timing::Phase::translations);
   auto const nMax = first->nMax;
   auto const n = nMax * (nMax + 2);
   if(first == end_first or second == end_second)
@@ -178,6 +183,7 @@ Matrix<t_complex> preconditioned_scattering_matrix(Geometry const &geometry,
 Vector<t_complex> source_vector(std::vector<Scatterer>::const_iterator first,
                                 std::vector<Scatterer>::const_iterator const &last,
                                 std::shared_ptr<Excitation const> incWave) {
+  timing::Timer const timer(timing::Phase::sources);
   if(first == last)
     return Vector<t_complex>::Zero(0);
   auto const nMax = first->nMax;
@@ -205,27 +211,112 @@ source_vector(Geometry const &geometry, std::shared_ptr<Excitation const> incWav
   return source_vector(geometry.objects, incWave);
 }
 
-Vector<t_complex> local_source_vector(Geometry const &geometry,
-                                      std::shared_ptr<Excitation const> incWave,
-                                      Vector<t_complex> const &input_coeffs) {
-  if(geometry.objects.size() == 0)
-    return Vector<t_complex>(0, 0);
-  // Check nMax is same accross all objects
+namespace {
+//! Checks nMax is same accross all objects
+t_uint common_nmax(Geometry const &geometry) {
   auto const nMax = geometry.objects.front().nMax;
   for(auto const &scatterer : geometry.objects)
     if(scatterer.nMax != nMax)
       throw std::runtime_error("All objects must have same number of harmonics");
+  return nMax;
+}
 
-  Geometry copy_geometry(geometry);
-  copy_geometry.setSourcesSingle(incWave, input_coeffs.data(), nMax);
-  // Get the IncLocal matrices
+#ifdef OPTIMET_MPI
+//! Contiguous block of objects owned by a process
+std::pair<t_uint, t_uint> object_range(t_uint nobjects, mpi::Communicator const &communicator) {
+  return {(communicator.rank() * nobjects) / communicator.size(),
+          ((communicator.rank() + 1) * nobjects) / communicator.size()};
+}
+#endif
+
+Vector<t_complex> single_source_vector(Geometry const &geometry,
+                                       std::shared_ptr<Excitation const> incWave,
+                                       Vector<t_complex> const &input_coeffs, t_uint first,
+                                       t_uint last) {
+  timing::Timer const timer(timing::Phase::sources);
+  auto const nMax = common_nmax(geometry);
+  auto const flatMax = CompoundIterator::max(nMax);
+  if(static_cast<t_uint>(input_coeffs.size()) != 2 * flatMax * geometry.objects.size())
+    throw std::runtime_error("Inconsistent number of internal coefficients");
+  Vector<t_complex> result(2 * flatMax * (last - first));
+  for(auto i = first; i < last; ++i)
+    result.segment((i - first) * 2 * flatMax, 2 * flatMax) = geometry.getSourcesSingle(
+        incWave->omega(), i, nMax, input_coeffs.segment(i * 2 * flatMax, 2 * flatMax));
+  return result;
+}
+
+Vector<t_complex> translated_source_vector(Geometry const &geometry,
+                                           std::shared_ptr<Excitation const> incWave,
+                                           t_uint first, t_uint last) {
   // These correspond directly to the Beta*a in Stout2002 Eq. 10 as
   // they are already translated.
-  // we are in the SH case -> get the local sources from the geometry
-  auto const flatMax = nMax * (nMax + 2);
-  Vector<t_complex> result(flatMax * 2 * copy_geometry.objects.size());
-  for(size_t i = 0; i < copy_geometry.objects.size(); i++)
-    copy_geometry.getSourceLocal(i, incWave, nMax, result.data() + i * 2 * flatMax);
+  timing::Timer const timer(timing::Phase::sources);
+  auto const nMax = common_nmax(geometry);
+  auto const flatMax = CompoundIterator::max(nMax);
+  Vector<t_complex> result(2 * flatMax * (last - first));
+  for(auto i = first; i < last; ++i)
+    geometry.getSourceLocal(i, incWave, nMax, result.data() + (i - first) * 2 * flatMax);
   return result;
 }
 }
+
+Vector<t_complex> single_source_vector(Geometry const &geometry,
+                                       std::shared_ptr<Excitation const> incWave,
+                                       Vector<t_complex> const &input_coeffs) {
+  if(geometry.objects.size() == 0)
+    return Vector<t_complex>(0, 0);
+  return single_source_vector(geometry, incWave, input_coeffs, 0, geometry.objects.size());
+}
+
+Vector<t_complex> translated_source_vector(Geometry const &geometry,
+                                           std::shared_ptr<Excitation const> incWave) {
+  if(geometry.objects.size() == 0)
+    return Vector<t_complex>(0, 0);
+  return translated_source_vector(geometry, incWave, 0, geometry.objects.size());
+}
+
+Vector<t_complex> local_source_vector(Geometry const &geometry,
+                                      std::shared_ptr<Excitation const> incWave,
+                                      Vector<t_complex> const &input_coeffs) {
+  if(geometry.objects.size() == 0)
+    return Vector<t_complex>(0, 0);
+  Geometry copy_geometry(geometry);
+  copy_geometry.setSourcesSingle(single_source_vector(geometry, incWave, input_coeffs));
+  return translated_source_vector(copy_geometry, incWave);
+}
+
+#ifdef OPTIMET_MPI
+Vector<t_complex> single_source_vector(Geometry const &geometry,
+                                       std::shared_ptr<Excitation const> incWave,
+                                       Vector<t_complex> const &input_coeffs,
+                                       mpi::Communicator const &communicator) {
+  if(geometry.objects.size() == 0)
+    return Vector<t_complex>(0, 0);
+  auto const range = object_range(geometry.objects.size(), communicator);
+  return communicator.all_gather(
+      single_source_vector(geometry, incWave, input_coeffs, range.first, range.second));
+}
+
+Vector<t_complex> translated_source_vector(Geometry const &geometry,
+                                           std::shared_ptr<Excitation const> incWave,
+                                           mpi::Communicator const &communicator) {
+  if(geometry.objects.size() == 0)
+    return Vector<t_complex>(0, 0);
+  auto const range = object_range(geometry.objects.size(), communicator);
+  return communicator.all_gather(
+      translated_source_vector(geometry, incWave, range.first, range.second));
+}
+
+Vector<t_complex> local_source_vector(Geometry const &geometry,
+                                      std::shared_ptr<Excitation const> incWave,
+                                      Vector<t_complex> const &input_coeffs,
+                                      mpi::Communicator const &communicator) {
+  if(geometry.objects.size() == 0)
+    return Vector<t_complex>(0, 0);
+  Geometry copy_geometry(geometry);
+  copy_geometry.setSourcesSingle(
+      single_source_vector(geometry, incWave, input_coeffs, communicator));
+  return translated_source_vector(copy_geometry, incWave, communicator);
+}
+#endif
+}
@@ -20,6 +20,7 @@
 #include "Excitation.h"
 #include "Geometry.h"
 #include "Types.h"
+#include "mpi/Communicator.h"
 #include "scalapack/Context.h"
 #include "scalapack/Matrix.h"
 
@@ -31,10 +32,41 @@ source_vector(Geometry const &geometry, std::shared_ptr<Excitation const> incWav
 Vector<t_complex> source_vector(std::vector<Scatterer>::const_iterator first,
                                 std::vector<Scatterer>::const_iterator const &last,
                                 std::shared_ptr<Excitation const> incWave);
+//! \brief Second harmonic sources of each object, before translation to other objects
+//! \param[in] geometry: the geometry at the fundamental frequency
+//! \param[in] incWave: the excitation at the second harmonic frequency
+//! \param[in] input_coeffs: the internal coefficients at the fundamental frequency
+Vector<t_complex> single_source_vector(Geometry const &geometry,
+                                       std::shared_ptr<Excitation const> incWave,
+                                       Vector<t_complex> const &input_coeffs);
+//! \brief Second harmonic sources translated to each object
+//! \details The single sources of the objects are those set in the geometry.
+Vector<t_complex> translated_source_vector(Geometry const &geometry,
+                                           std::shared_ptr<Excitation const> incWave);
 //! \brief Computes source vector from fundamental frequency
 Vector<t_complex> local_source_vector(Geometry const &geometry,
                                       std::shared_ptr<Excitation const> incWave,
                                       Vector<t_complex> const &input_coeffs);
+#ifdef OPTIMET_MPI
+//! \brief Second harmonic sources of each object, splitting objects across processes
+//! \details Each process computes the sources of a contiguous block of objects. The result is
+//! the full vector on all processes.
+Vector<t_complex> single_source_vector(Geometry const &geometry,
+                                       std::shared_ptr<Excitation const> incWave,
+                                       Vector<t_complex> const &input_coeffs,
+                                       mpi::Communicator const &communicator);
+//! \brief Second harmonic sources translated to each object, splitting objects across processes
+Vector<t_complex> translated_source_vector(Geometry const &geometry,
+                                           std::shared_ptr<Excitation const> incWave,
+                                           mpi::Communicator const &communicator);
+//! \brief Computes source vector from fundamental frequency, splitting objects across processes
+//! \details Each process computes the sources of a contiguous block of objects. The result is
+//! the full source vector on all processes.
+Vector<t_complex> local_source_vector(Geometry const &geometry,
+                                      std::shared_ptr<Excitation const> incWave,
+                                      Vector<t_complex> const &input_coeffs,
+                                      mpi::Communicator const &communicator);
+#endif
 
 //! Computes preconditioned scattering matrix
 Matrix<t_complex> preconditioned_scattering_matrix(Geometry const &geometry,
@@ -17,6 +17,8 @@
 #ifndef OPTIMET_PRECONDITIONNED_MATRIX_SOLVER_H
 #define OPTIMET_PRECONDITIONNED_MATRIX_SOLVER_H
 
+#include "Memory.h"
+#include "OperatorCache.h"
 #include "PreconditionedMatrix.h"
 #include "Solver.h"
 #include "Types.h"
@@ -34,17 +36,27 @@ public:
       : AbstractSolver(geometry, incWave, communicator) {
     update();
   }
-  PreconditionedMatrix(Run const &run)
-      : PreconditionedMatrix(run.geometry, run.excitation, run.communicator) {}
+  PreconditionedMatrix(Run const &run) : AbstractSolver(run) { update(); }
 
   void solve(Vector<t_complex> &X_sca_, Vector<t_complex> &X_int_) const override {
+    memory::Allocation const factorization(memory::Component::matrix, S.size() * sizeof(t_complex));
     X_sca_ = S.colPivHouseholderQr().solve(Q);
     unprecondition(X_sca_, X_int_);
   }
 
   void update() override {
-    Q = source_vector(*geometry, incWave);
-    S = preconditioned_scattering_matrix(*geometry, incWave);
+    Q = sources();
+    // the matrix only depends on the geometry and frequency
+    auto const hash = operator_hash(*geometry, incWave->wavenumber());
+    OperatorData data;
+    if(cache().load(hash, "matrix", data) and data.size() == 1)
+      S = std::move(data.front());
+    else {
+      S = preconditioned_scattering_matrix(*geometry, incWave);
+      if(communicator().rank() == communicator().root_id())
+        cache().save(hash, "matrix", {S});
+    }
+    matrix_memory_ = memory::Allocation(memory::Component::matrix, S.size() * sizeof(t_complex));
   }
 
 protected:
@@ -52,6 +64,8 @@ protected:
   Matrix<t_complex> S;
   //! The local field matrix Q = T*AB*a
   Vector<t_complex> Q;
+  //! Memory held by the scattering matrix
+  memory::Allocation matrix_memory_;
 
   //! Unpreconditions the result of preconditioned computation
   void unprecondition(Vector<t_complex> &X_sca_, Vector<t_complex> &X_int_) const {
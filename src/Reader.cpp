@@ -18,12 +18,16 @@
 
 #include "Cartesian.h"
 #include "Geometry.h"
+#include "Memory.h"
+#include "RunSerialization.h"
 #include "Scatterer.h"
 #include "Spherical.h"
 #include "Tools.h"
 #include "constants.h"
 #include "mpi/Communicator.h"
+#include <cstdint>
 #include <cstring>
+#include <hdf5.h>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
@@ -40,15 +44,27 @@ using namespace pugi;
 namespace optimet {
 namespace {
 std::shared_ptr<Geometry> read_geometry(pugi::xml_document const &node);
+std::vector<Scatterer> read_geometry_file(pugi::xml_node const &geo_node, t_int nMax);
+Matrix<t_real> read_geometry_arrays(std::string const &filename);
 Scatterer read_spherical_scatterer(pugi::xml_node const &node, t_int nMax);
 std::shared_ptr<Geometry> read_structure(pugi::xml_node const &inputFile, t_int nMax);
 std::shared_ptr<Excitation> read_excitation(pugi::xml_document const &inputFile, t_int nMax);
 scalapack::Parameters read_parallel(const pugi::xml_node &node);
+std::tuple<OperatorCache, bool> read_cache(pugi::xml_node const &node);
+std::tuple<std::string, std::string> read_coefficients_files(pugi::xml_node const &node);
+std::tuple<t_real, bool> read_memory(pugi::xml_node const &node);
+std::tuple<bool, std::string, t_int> read_autotune(pugi::xml_node const &node) {
+  if(not node)
+    return std::make_tuple(false, std::string("autotune.txt"), 0);
+  return std::make_tuple(true, std::string(node.attribute("file").as_string("autotune.txt")),
+                         node.attribute("objects").as_int(0));
+}
+
 #ifdef OPTIMET_BELOS
 Teuchos::RCP<Teuchos::ParameterList> read_parameter_list(pugi::xml_document const &root_node);
-std::tuple<bool, t_int> read_fmm_input(pugi::xml_node const &node);
+std::tuple<bool, t_int, bool, t_real> read_fmm_input(pugi::xml_node const &node);
 #endif
-Run simulation_input(pugi::xml_document const &inputFile);
+void simulation_input(pugi::xml_document const &inputFile, Run &result);
 
 std::shared_ptr<Geometry> read_geometry(pugi::xml_document const &inputFile) {
   // Find the simulation node
@@ -70,9 +86,12 @@ std::shared_ptr<Geometry> read_geometry(pugi::xml_document const &inputFile) {
   auto result = std::make_shared<Geometry>();
   result->structureType = 0;
 
-  // Find all scattering objects
+  // Find all scattering objects, from an HDF5 file and/or listed in the input
+  auto objects = geo_node.attribute("src") ? read_geometry_file(geo_node, nMax) :
+                                             std::vector<Scatterer>();
   for(xml_node node = geo_node.child("object"); node; node = node.next_sibling("object"))
-    result->pushObject(read_spherical_scatterer(node, nMax));
+    objects.push_back(read_spherical_scatterer(node, nMax));
+  result->pushObjects(objects);
 
   // Add the background properties
   if(geo_node.child("background")) {
@@ -95,6 +114,88 @@ std::shared_ptr<Geometry> read_geometry(pugi::xml_document const &inputFile) {
   return result;
 }
 
+//! \brief Reads spheres from the HDF5 file given by the src attribute of the geometry
+//! \details The file holds an N x 3 "positions" dataset of cartesian coordinates and an N
+//! "radii" dataset, both in nm, and optionally an N "materials" dataset of indices into the
+//! <material> elements of the geometry (default 0). Material elements are specified as for
+//! objects.
+std::vector<Scatterer> read_geometry_file(pugi::xml_node const &geo_node, t_int nMax) {
+  // Materials are listed in the input, and referenced by index in the file
+  std::vector<ElectroMagnetic> materials;
+  for(xml_node node = geo_node.child("material"); node; node = node.next_sibling("material"))
+    materials.push_back(read_spherical_scatterer(node, nMax).elmag);
+  if(materials.size() == 0)
+    throw std::runtime_error("Geometry files require at least one material");
+
+  auto const arrays = read_geometry_arrays(geo_node.attribute("src").value());
+  std::vector<Scatterer> result;
+  result.reserve(arrays.cols());
+  for(t_int i(0); i < arrays.cols(); ++i) {
+    auto const material = static_cast<t_int>(arrays(4, i));
+    if(material < 0 or material >= static_cast<t_int>(materials.size()))
+      throw std::runtime_error("Unknown material index in geometry file");
+    result.emplace_back(Tools::toSpherical({arrays(0, i) * consFrnmTom, arrays(1, i) * consFrnmTom,
+                                            arrays(2, i) * consFrnmTom}),
+                        materials[material], arrays(3, i) * consFrnmTom, nMax);
+  }
+  return result;
+}
+
+//! Reads an n x ncols dataset of reals, or a one dimensional dataset when ncols is 1
+Matrix<t_real> read_dataset(hid_t file, std::string const &name, t_uint ncols) {
+  auto const dataset = H5Dopen(file, name.c_str(), H5P_DEFAULT);
+  if(dataset < 0)
+    throw std::runtime_error("Missing dataset " + name + " in geometry file");
+  auto const space = H5Dget_space(dataset);
+  auto const ndims = H5Sget_simple_extent_ndims(space);
+  hsize_t dims[2] = {0, 1};
+  if(ndims < 1 or ndims > 2 or H5Sget_simple_extent_dims(space, dims, nullptr) < 0 or
+     dims[1] != ncols) {
+    H5Sclose(space);
+    H5Dclose(dataset);
+    throw std::runtime_error("Unexpected shape of dataset " + name + " in geometry file");
+  }
+  // HDF5 is row-major, so each row of the dataset becomes a column of the matrix
+  Matrix<t_real> result(ncols, dims[0]);
+  auto const error =
+      H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, result.data());
+  H5Sclose(space);
+  H5Dclose(dataset);
+  if(error < 0)
+    throw std::runtime_error("Could not read dataset " + name + " in geometry file");
+  return result;
+}
+
+Matrix<t_real> read_geometry_arrays(std::string const &filename) {
+  auto const file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  if(file < 0)
+    throw std::runtime_error("Could not open geometry file " + filename);
+  // x, y, z, radius, material
+  Matrix<t_real> result;
+  try {
+    auto const positions = read_dataset(file, "positions", 3);
+    auto const radii = read_dataset(file, "radii", 1);
+    if(radii.cols() != positions.cols())
+      throw std::runtime_error("Inconsistent number of positions and radii in " + filename);
+    result = Matrix<t_real>::Zero(5, positions.cols());
+    result.topRows(3) = positions;
+    result.row(3) = radii;
+    if(H5Lexists(file, "materials", H5P_DEFAULT) > 0) {
+      auto const materials = read_dataset(file, "materials", 1);
+      if(materials.cols() != positions.cols())
+        throw std::runtime_error("Inconsistent number of positions and materials in " + filename);
+      result.row(4) = materials;
+    }
+  } catch(...) {
+    H5Fclose(file);
+    throw;
+  }
+  H5Fclose(file);
+  if(result.cols() == 0)
+    throw std::runtime_error("No scatterers in geometry file " + filename);
+  return result;
+}
+
 std::shared_ptr<Geometry> read_structure(xml_node const &geo_node_, t_int nMax) {
   auto geometry = std::make_shared<Geometry>();
   xml_node struct_node = geo_node_.child("structure");
@@ -309,6 +410,9 @@ void read_output(pugi::xml_document const &inputFile, Run &run) {
   if(!out_node)
     throw std::runtime_error("Output not defined!");
 
+  // Second harmonic results are computed on top of the fundamental frequency ones
+  run.do_sh = out_node.attribute("secondharmonic").as_bool(false);
+
   // Determine type
   if(!std::strcmp(out_node.attribute("type").value(), "coefficients"))
     run.outputType = 2;
@@ -383,6 +487,27 @@ scalapack::Parameters read_parallel(const pugi::xml_node &node) {
   return result;
 }
 
+std::tuple<OperatorCache, bool> read_cache(pugi::xml_node const &node) {
+  if(not node)
+    return std::make_tuple(OperatorCache(), false);
+  if(not node.attribute("directory"))
+    throw std::runtime_error("Cache requires a directory");
+  return std::make_tuple(OperatorCache(node.attribute("directory").value()),
+                         node.attribute("coefficients").as_bool(false));
+}
+
+std::tuple<std::string, std::string> read_coefficients_files(pugi::xml_node const &node) {
+  return std::make_tuple(node.attribute("save").value(), node.attribute("load").value());
+}
+
+std::tuple<t_real, bool> read_memory(pugi::xml_node const &node) {
+  if(not node)
+    return std::make_tuple(0e0, false);
+  auto const budget =
+      node.attribute("budget") ? memory::parse_bytes(node.attribute("budget").value()) : 0e0;
+  return std::make_tuple(budget, node.attribute("dry_run").as_bool(false));
+}
+
 #ifdef OPTIMET_BELOS
 Teuchos::RCP<Teuchos::ParameterList> read_parameter_list(pugi::xml_document const &root_node) {
   auto const xml_params = root_node.child("ParameterList");
@@ -397,17 +522,24 @@ Teuchos::RCP<Teuchos::ParameterList> read_parameter_list(pugi::xml_document cons
   return result;
 }
 
-std::tuple<bool, t_int> read_fmm_input(pugi::xml_node const &node) {
+std::tuple<bool, t_int, bool, t_real> read_fmm_input(pugi::xml_node const &node) {
+  auto const infinity = std::numeric_limits<t_real>::infinity();
   if(not node)
-    return std::make_tuple(false, 1);
+    return std::make_tuple(false, 1, false, infinity);
+  auto const rotations = std::string(node.attribute("rotations").as_string("dense"));
+  if(rotations != "dense" and rotations != "factored")
+    throw std::runtime_error("FMM rotations should be one of dense or factored");
+  auto const factored = rotations == "factored";
+  auto const translations = node.attribute("translations") ?
+                                memory::parse_bytes(node.attribute("translations").value()) :
+                                infinity;
   if(not node.attribute("subdiagonals"))
-    return std::make_tuple(true, std::numeric_limits<t_int>::max());
-  return std::make_tuple(true, node.attribute("subdiagonals").as_int());
+    return std::make_tuple(true, std::numeric_limits<t_int>::max(), factored, translations);
+  return std::make_tuple(true, node.attribute("subdiagonals").as_int(), factored, translations);
 }
 #endif
 
-Run simulation_input(pugi::xml_document const &inputFile) {
-  Run result;
+void simulation_input(pugi::xml_document const &inputFile, Run &result) {
   result.geometry = read_geometry(inputFile);
   result.nMax = result.geometry->nMax();
 
@@ -420,24 +552,69 @@ Run simulation_input(pugi::xml_document const &inputFile) {
   read_output(inputFile, result);
 
   result.parallel_params = read_parallel(inputFile.child("parallel"));
+  std::tie(result.cache, result.cache_coefficients) = read_cache(inputFile.child("cache"));
+  std::tie(result.coefficients_output, result.coefficients_input) =
+      read_coefficients_files(inputFile.child("coefficients"));
+  std::tie(result.memory_budget, result.dry_run) = read_memory(inputFile.child("memory"));
+  std::tie(result.autotune, result.autotune_file, result.autotune_objects) =
+      read_autotune(inputFile.child("autotune"));
 #ifdef OPTIMET_BELOS
   result.belos_params = read_parameter_list(inputFile);
-  std::tie(result.do_fmm, result.fmm_subdiagonals) = read_fmm_input(inputFile.child("FMM"));
+  std::tie(result.do_fmm, result.fmm_subdiagonals, result.fmm_factored_rotations,
+           result.fmm_translations_budget) = read_fmm_input(inputFile.child("FMM"));
 #endif
-
-  return result;
-}
 }
 
-Run simulation_input(std::string const &fileName_) {
-  pugi::xml_document inputFile;
+void load_input(std::string const &fileName_, pugi::xml_document &inputFile) {
   auto const fileResult = inputFile.load_file(fileName_.c_str());
   if(!fileResult) {
     std::ostringstream msg;
     msg << "Error reading or parsing input file " << fileName_ << "!";
     throw std::runtime_error(msg.str());
   }
-  return simulation_input(inputFile);
+}
+}
+
+Run simulation_input(std::string const &fileName_) {
+  pugi::xml_document inputFile;
+  load_input(fileName_, inputFile);
+  Run result;
+  simulation_input(inputFile, result);
+  return result;
+}
+
+Run simulation_input(std::string const &fileName_, mpi::Communicator const &comm) {
+#ifdef OPTIMET_MPI
+  if(comm.size() > 1) {
+    // An empty buffer tells other processes that root failed to read the input
+    typedef Vector<std::int8_t> Buffer;
+    // Each process creates exactly one run, hence one (collective) scalapack context, and does so
+    // before the broadcast so that all processes enter the collectives in the same order
+    Run result;
+    if(comm.rank() == comm.root_id()) {
+      try {
+        pugi::xml_document inputFile;
+        load_input(fileName_, inputFile);
+        simulation_input(inputFile, result);
+      } catch(...) {
+        comm.broadcast(Buffer());
+        throw;
+      }
+      auto const buffer = serialize(result);
+      comm.broadcast(
+          Buffer::Map(reinterpret_cast<std::int8_t const *>(buffer.data()), buffer.size()).eval());
+      return result;
+    }
+    auto const buffer = comm.broadcast<Buffer>();
+    if(buffer.size() == 0)
+      throw std::runtime_error("Root process could not read input file " + fileName_);
+    deserialize(std::string(reinterpret_cast<char const *>(buffer.data()), buffer.size()), result);
+    return result;
+  }
+#else
+  (void)comm;
+#endif
+  return simulation_input(fileName_);
 }
 
 Run simulation_input(std::istream &buffer) {
@@ -445,6 +622,8 @@ Run simulation_input(std::istream &buffer) {
   auto const fileResult = inputFile.load(buffer);
   if(!fileResult)
     throw std::runtime_error("Error reading or parsing istream input");
-  return simulation_input(inputFile);
+  Run result;
+  simulation_input(inputFile, result);
+  return result;
 }
 }
@@ -18,6 +18,7 @@
 #define READER_H_
 
 #include "Run.h"
+#include "mpi/Communicator.h"
 #include "pugi/pugixml.hpp"
 #include <string>
 
@@ -28,6 +29,11 @@
 namespace optimet {
 //! Reads simulation configuration from input
 Run simulation_input(std::string const &filename);
+//! \brief Reads simulation configuration from input on root, then broadcasts it
+//! \details Only the root process opens and parses the input, and any geometry file. Other
+//! processes recreate the run from its serialized form. The communicator and scalapack context
+//! of the result are left as default, and are created on all processes before the broadcast.
+Run simulation_input(std::string const &filename, mpi::Communicator const &comm);
 //! Reads simulation configuration from string buffer
 Run simulation_input(std::istream &buffer);
 }
@@ -14,7 +14,6 @@
 // You should have received a copy of the GNU General Public License
 // along with Optimet. If not, see <http://www.gnu.org/licenses/>.
 
-#include "Algebra.h"
 #include "AuxCoefficients.h"
 #include "Coupling.h"
 #include "Result.h"
@@ -25,6 +24,7 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 namespace optimet {
 Result::Result(std::shared_ptr<Geometry> geometry_, std::shared_ptr<Excitation> excitation_)
@@ -449,49 +449,65 @@ SphericalP<std::complex<double>> Result::getEFieldC(Spherical<double> R_, bool p
   return Einc + Efield;
 }
 
-double Result::getExtinctionCrossSection() {
-  CompoundIterator p;
-  int pMax = Tools::iteratorMax(nMax);
+double Result::extinction(t_uint first, t_uint last) const {
+  if(flagSH)
+    throw std::runtime_error("Extinction is not defined without an incident wave");
 
+  auto const pMax = Tools::iteratorMax(nMax);
+  Vector<t_complex> Q_local(2 * pMax);
   double Cext(0.);
-  std::complex<double> *Q_local = new std::complex<double>[2 * pMax];
-
-  for(size_t j = 0; j < geometry->objects.size(); j++) {
-    excitation->getIncLocal(geometry->objects[j].vR, Q_local, nMax);
-    for(p = 0; p < pMax; p++) {
-      Cext += std::real(std::conj(Q_local[p]) * scatter_coef[j * 2 * pMax + p.compound] +
-                        std::conj(Q_local[p.compound + pMax]) *
-                            scatter_coef[pMax + j * 2 * pMax + p.compound]);
-    }
+  for(auto j = first; j < last; ++j) {
+    excitation->getIncLocal(geometry->objects[j].vR, Q_local.data(), nMax);
+    Cext += std::real(Q_local.dot(scatter_coef.segment(j * 2 * pMax, 2 * pMax)));
   }
-
-  delete[] Q_local;
-  return (-1. / (std::real(waveK) * std::real(waveK))) * Cext;
+  return Cext;
 }
 
-double Result::getAbsorptionCrossSection() {
-  CompoundIterator p;
-  int pMax = Tools::iteratorMax(nMax);
-
+double Result::absorption(t_uint first, t_uint last) const {
+  auto const pMax = Tools::iteratorMax(nMax);
+  auto const omega = excitation->omega();
   double Cabs(0.);
-  double temp1(0.), temp2(0.);
-  double *Cabs_aux = new double[2 * pMax];
+  for(auto j = first; j < last; ++j) {
+    auto const &object = geometry->objects[j];
+    auto const factors = object.getCabsAux(omega, geometry->bground);
+    auto const TE = scatter_coef.segment(j * 2 * pMax, pMax);
+    auto const TM = scatter_coef.segment(j * 2 * pMax + pMax, pMax);
+    // factors depend only on n: sum |a_nm|^2 over m first
+    for(t_uint n = 1, p = 0; n <= nMax; p += 2 * n + 1, ++n)
+      Cabs += TE.segment(p, 2 * n + 1).squaredNorm() * factors(n - 1) +
+              TM.segment(p, 2 * n + 1).squaredNorm() * factors(object.nMax + n - 1);
+  }
+  return Cabs;
+}
 
-  auto const omega = excitation->omega();
-  for(size_t j = 0; j < geometry->objects.size(); j++) {
+double Result::getExtinctionCrossSection() {
+  return (-1. / (std::real(waveK) * std::real(waveK))) * extinction(0, geometry->objects.size());
+}
 
-    geometry->getCabsAux(omega, j, nMax, Cabs_aux);
+double Result::getExtinctionCrossSection(mpi::Communicator const &communicator) {
+  auto const nobj = geometry->objects.size();
+  auto const Cext = extinction(nobj * communicator.rank() / communicator.size(),
+                               nobj * (communicator.rank() + 1) / communicator.size());
+#ifdef OPTIMET_MPI
+  return (-1. / (std::real(waveK) * std::real(waveK))) * communicator.all_reduce(Cext, MPI_SUM);
+#else
+  return (-1. / (std::real(waveK) * std::real(waveK))) * Cext;
+#endif
+}
 
-    for(p = 0; p < pMax; p++) {
-      temp1 = abs(scatter_coef[j * 2 * pMax + p.compound]);
-      temp1 *= temp1;
-      temp2 = abs(scatter_coef[pMax + j * 2 * pMax + p.compound]);
-      temp2 *= temp2;
-      Cabs += temp1 * Cabs_aux[p.compound] + temp2 * Cabs_aux[pMax + p.compound];
-    }
-  }
-  delete[] Cabs_aux;
+double Result::getAbsorptionCrossSection() {
+  return (1 / (std::real(waveK) * std::real(waveK))) * absorption(0, geometry->objects.size());
+}
+
+double Result::getAbsorptionCrossSection(mpi::Communicator const &communicator) {
+  auto const nobj = geometry->objects.size();
+  auto const Cabs = absorption(nobj * communicator.rank() / communicator.size(),
+                               nobj * (communicator.rank() + 1) / communicator.size());
+#ifdef OPTIMET_MPI
+  return (1 / (std::real(waveK) * std::real(waveK))) * communicator.all_reduce(Cabs, MPI_SUM);
+#else
   return (1 / (std::real(waveK) * std::real(waveK))) * Cabs;
+#endif
 }
 
 int Result::setFields(OutputGrid &oEGrid_, OutputGrid &oHGrid_, bool projection_) {
@@ -541,56 +557,21 @@ int Result::setFieldsModal(OutputGrid &oEGrid_, OutputGrid &oHGrid_, bool projec
 }
 
 void Result::centerScattering() {
-  CompoundIterator p, q;
-
-  int pMax = p.max(nMax);
-  int qMax = q.max(nMax);
-
-  for(p = 0; p < 2 * p.max(nMax); p++) {
-    c_scatter_coef[p] = std::complex<double>(0.0, 0.0);
-  }
-
-  std::complex<double> **T_AB = new std::complex<double> *[2 * (p.max(nMax))];
-  std::complex<double> *scatter_aux = new std::complex<double>[2 * p.max(nMax)];
-  std::complex<double> *scatter_fin = new std::complex<double>[2 * p.max(nMax)];
-
-  for(p = 0; p < (int)(2 * p.max(nMax)); p++) {
-    T_AB[p] = new std::complex<double>[2 * p.max(nMax)];
-  }
+  int const pMax = CompoundIterator::max(nMax);
 
+  c_scatter_coef.fill(0);
   for(size_t i = 0; i < geometry->objects.size(); i++) {
     Spherical<double> Rrel =
         Tools::toPoint(Spherical<double>(0.0, 0.0, 0.0), geometry->objects[i].vR);
 
     optimet::Coupling const coupling(Rrel, excitation->waveK, nMax);
 
-    for(p = 0; p < pMax; p++)
-      for(q = 0; q < qMax; q++) {
-        T_AB[p][q] = coupling.diagonal(p, q);
-        T_AB[p + pMax][q + qMax] = coupling.diagonal(p, q);
-        T_AB[p + pMax][q] = coupling.offdiagonal(p, q);
-        T_AB[p][q + qMax] = coupling.offdiagonal(p, q);
-      }
-
-    for(p = 0; p < 2 * p.max(nMax); p++) {
-      scatter_aux[p] += scatter_coef[p.compound + i * 2 * pMax * geometry->objects.size()];
-    }
-
-    Algebra::multiplyVectorMatrix(T_AB, 2 * pMax, 2 * pMax, scatter_aux, scatter_fin, consC1,
-                                  consC0);
-
-    for(p = 0; p < 2 * pMax; p++) {
-      c_scatter_coef[p] += scatter_fin[p];
-    }
-  }
-
-  for(p = 0; p < (int)(2 * p.max(nMax)); p++) {
-    delete[] T_AB[p];
+    auto const scatter = scatter_coef.segment(i * 2 * pMax, 2 * pMax);
+    c_scatter_coef.head(pMax) +=
+        coupling.diagonal * scatter.head(pMax) + coupling.offdiagonal * scatter.tail(pMax);
+    c_scatter_coef.tail(pMax) +=
+        coupling.offdiagonal * scatter.head(pMax) + coupling.diagonal * scatter.tail(pMax);
   }
-
-  delete[] T_AB;
-  delete[] scatter_aux;
-  delete[] scatter_fin;
 }
 
 CompoundIterator Result::getDominant() {
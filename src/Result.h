@@ -23,6 +23,7 @@
 #include "OutputGrid.h"
 #include "Spherical.h"
 #include "SphericalP.h"
+#include "mpi/Communicator.h"
 
 #include <complex>
 
@@ -43,6 +44,12 @@ private:
   Result *result_FF;                      /**< The Fundamental Frequency results vector. */
   //! Maximum nMax
   optimet::t_uint nMax;
+
+  //! Extinction summed over objects [first, last), without the 1/k^2 prefactor
+  double extinction(t_uint first, t_uint last) const;
+  //! Absorption summed over objects [first, last), without the 1/k^2 prefactor
+  double absorption(t_uint first, t_uint last) const;
+
 public:
   Vector<t_complex> scatter_coef;   /**< The scattering coefficients. */
   Vector<t_complex> internal_coef;  /**< The internal coefficients. */
@@ -150,16 +157,35 @@ public:
 
   /**
    * Returns the Extinction Cross Section.
+   * Only defined for Fundamental Frequency results.
    * @return the extinction cross section.
    */
   double getExtinctionCrossSection();
 
+  /**
+   * Returns the Extinction Cross Section.
+   * Each process sums over its own slice of objects, and the partial sums are
+   * reduced over the communicator. Must be called by all processes.
+   * @param communicator processes sharing the work.
+   * @return the extinction cross section.
+   */
+  double getExtinctionCrossSection(mpi::Communicator const &communicator);
+
   /**
    * Returns the Absorption Cross Section.
    * @return the absorptions cross section.
    */
   double getAbsorptionCrossSection();
 
+  /**
+   * Returns the Absorption Cross Section.
+   * Each process sums over its own slice of objects, and the partial sums are
+   * reduced over the communicator. Must be called by all processes.
+   * @param communicator processes sharing the work.
+   * @return the absorptions cross section.
+   */
+  double getAbsorptionCrossSection(mpi::Communicator const &communicator);
+
   /**
    * Populate a grid with E and H fields.
    * @param oEGrid_ the OutputGrid object for the E fields.
@@ -0,0 +1,140 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Roofline.h"
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+
+namespace optimet {
+namespace roofline {
+namespace {
+//! Runs a function repeatedly for at least the given time, and returns its fastest run
+template <class FUNCTOR> t_real fastest(FUNCTOR const &functor, t_real seconds) {
+  auto result = std::numeric_limits<t_real>::infinity();
+  t_real total(0);
+  for(t_uint i(0); i < 3 or total < seconds; ++i) {
+    auto const start = std::chrono::steady_clock::now();
+    functor();
+    std::chrono::duration<t_real> const elapsed = std::chrono::steady_clock::now() - start;
+    result = std::min(result, elapsed.count());
+    total += elapsed.count();
+  }
+  return result;
+}
+} // namespace
+
+char const *name(Kernel kernel) {
+  static char const *const names[static_cast<t_uint>(Kernel::size)] = {
+      "mie",           "normalization", "rotation",     "translation",  "recurrence",
+      "decomposition", "back_rotation", "accumulation", "communication"};
+  return names[static_cast<t_uint>(kernel)];
+}
+
+Profile &Profile::operator+=(Profile const &other) {
+  for(t_uint i(0); i < nkernels; ++i) {
+    flops_[i] += other.flops_[i];
+    bytes_[i] += other.bytes_[i];
+    seconds_[i] += other.seconds_[i];
+  }
+  return *this;
+}
+
+Profile Profile::reduce(mpi::Communicator const &comm) const {
+#ifdef OPTIMET_MPI
+  Profile result;
+  Vector<t_real>::Map(result.flops_.data(), nkernels) =
+      comm.all_reduce(Vector<t_real>::Map(flops_.data(), nkernels).eval(), MPI_SUM);
+  Vector<t_real>::Map(result.bytes_.data(), nkernels) =
+      comm.all_reduce(Vector<t_real>::Map(bytes_.data(), nkernels).eval(), MPI_SUM);
+  Vector<t_real>::Map(result.seconds_.data(), nkernels) =
+      comm.all_reduce(Vector<t_real>::Map(seconds_.data(), nkernels).eval(), MPI_MAX);
+  return result;
+#else
+  (void)comm;
+  return *this;
+#endif
+}
+
+Machine probe(mpi::Communicator const &comm, t_real seconds) {
+#ifdef OPTIMET_MPI
+  comm.barrier();
+#else
+  (void)comm;
+#endif
+  // STREAM triad, on arrays much larger than the caches. Bytes are counted as in STREAM,
+  // i.e. without the write-allocate traffic.
+  t_uint const n = 1u << 22;
+  Vector<t_real> a = Vector<t_real>::Zero(n);
+  Vector<t_real> const b = Vector<t_real>::Constant(n, 1);
+  Vector<t_real> const c = Vector<t_real>::Constant(n, 2);
+  auto const triad = fastest([&a, &b, &c]() { a.noalias() = b + 3e0 * c; }, seconds);
+
+  // DGEMM with matrices that fit in cache
+  t_uint const m = 256;
+  Matrix<t_real> const A = Matrix<t_real>::Random(m, m);
+  Matrix<t_real> const B = Matrix<t_real>::Random(m, m);
+  Matrix<t_real> C(m, m);
+  auto const gemm = fastest([&A, &B, &C]() { C.noalias() = A * B; }, seconds);
+
+  Machine const result{3e0 * sizeof(t_real) * n / triad, 2e0 * m * m * m / gemm};
+#ifdef OPTIMET_MPI
+  return {comm.all_reduce(result.bandwidth, MPI_SUM), comm.all_reduce(result.flops, MPI_SUM)};
+#else
+  return result;
+#endif
+}
+
+void write(std::ostream &stream, Profile const &profile, Machine const &machine) {
+  auto const giga = 1e-9;
+  auto const flags = stream.flags();
+  auto const precision = stream.precision();
+  stream << std::setprecision(4);
+  stream << "roofline:\n"
+         << "    bandwidth (GB/s): " << machine.bandwidth * giga << "\n"
+         << "    peak (GFLOP/s): " << machine.flops * giga << "\n"
+         << "    ridge (flop/byte): " << machine.flops / machine.bandwidth << "\n";
+  stream << "    " << std::left << std::setw(14) << "kernel" << std::right << std::setw(11)
+         << "GFLOP" << std::setw(11) << "GB" << std::setw(11) << "seconds" << std::setw(11)
+         << "GFLOP/s" << std::setw(11) << "GB/s" << std::setw(11) << "flop/byte"
+         << std::setw(11) << "% roof" << "\n";
+  auto const line = [&stream, &machine, giga](std::string const &name, t_real flops,
+                                               t_real bytes, t_real seconds) {
+    auto const intensity = bytes > 0 ? flops / bytes : 0;
+    auto const attainable = std::min(machine.flops, intensity * machine.bandwidth);
+    auto const achieved = seconds > 0 ? flops / seconds : 0;
+    stream << "    " << std::left << std::setw(14) << name << std::right << std::setw(11)
+           << flops * giga << std::setw(11) << bytes * giga << std::setw(11) << seconds
+           << std::setw(11) << achieved * giga << std::setw(11)
+           << (seconds > 0 ? bytes / seconds * giga : 0) << std::setw(11) << intensity
+           << std::setw(11) << (attainable > 0 ? 100 * achieved / attainable : 0) << "\n";
+  };
+  t_real flops(0), bytes(0), seconds(0);
+  for(t_uint i(0); i < static_cast<t_uint>(Kernel::size); ++i) {
+    auto const kernel = static_cast<Kernel>(i);
+    if(profile.seconds(kernel) == 0 and profile.bytes(kernel) == 0)
+      continue;
+    line(name(kernel), profile.flops(kernel), profile.bytes(kernel), profile.seconds(kernel));
+    flops += profile.flops(kernel);
+    bytes += profile.bytes(kernel);
+    seconds += profile.seconds(kernel);
+  }
+  line("total", flops, bytes, seconds);
+  stream.flags(flags);
+  stream.precision(precision);
+}
+} // namespace roofline
+} // namespace optimet
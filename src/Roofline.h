@@ -0,0 +1,114 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_ROOFLINE_H
+#define OPTIMET_ROOFLINE_H
+
+#include "Types.h"
+#include "mpi/Communicator.h"
+#include <array>
+#include <chrono>
+#include <ostream>
+
+namespace optimet {
+//! \brief Roofline model of the FMM matrix-vector product
+//! \details The product is broken into its kernels. For each, the floating point operations and
+//! bytes moved are counted from the sizes of the operands, and compared to the peaks of the
+//! machine measured by small STREAM and DGEMM probes.
+namespace roofline {
+//! Kernels of the FMM matrix-vector product, in the order they are applied
+enum class Kernel : t_uint {
+  mie,           //!< Multiplication of the input by the Mie coefficients
+  normalization, //!< Change to Gumerov's normalization, including clearing the work buffers
+  rotation,      //!< Rotation onto the axis joining a pair of particles
+  translation,   //!< Co-axial translation
+  recurrence,    //!< Co-axial translation coefficients recomputed during the multiplication
+  decomposition, //!< Rotation-coaxial decomposition of the vector potentials
+  back_rotation, //!< Rotation back from the axis joining a pair of particles
+  accumulation,  //!< Change back to Stout's normalization and addition into the output
+  communication, //!< Waiting on MPI messages, bytes only
+  size           //!< Number of kernels
+};
+//! Name of a kernel, as it appears in reports
+char const *name(Kernel kernel);
+
+//! Operations, bytes and time of each kernel
+class Profile {
+public:
+  Profile() : flops_{{}}, bytes_{{}}, seconds_{{}} {}
+
+  //! Adds operations, bytes and time to a kernel
+  void add(Kernel kernel, t_real flops, t_real bytes, t_real seconds) {
+    flops_[static_cast<t_uint>(kernel)] += flops;
+    bytes_[static_cast<t_uint>(kernel)] += bytes;
+    seconds_[static_cast<t_uint>(kernel)] += seconds;
+  }
+  t_real flops(Kernel kernel) const { return flops_[static_cast<t_uint>(kernel)]; }
+  t_real bytes(Kernel kernel) const { return bytes_[static_cast<t_uint>(kernel)]; }
+  t_real seconds(Kernel kernel) const { return seconds_[static_cast<t_uint>(kernel)]; }
+
+  //! Adds the operations, bytes and times of another profile
+  Profile &operator+=(Profile const &other);
+  //! \brief Aggregates the profiles of all processes
+  //! \details Collective. Operations and bytes are summed, times are the maximum over processes.
+  Profile reduce(mpi::Communicator const &comm) const;
+
+private:
+  static constexpr t_uint nkernels = static_cast<t_uint>(Kernel::size);
+  std::array<t_real, nkernels> flops_, bytes_, seconds_;
+};
+
+//! \brief Times a section of a kernel and adds it to a profile
+//! \details The lifetime of the object is added to the kernel's time.
+class Section {
+public:
+  Section(Profile &profile, Kernel kernel, t_real flops, t_real bytes)
+      : profile_(profile), kernel_(kernel), flops_(flops), bytes_(bytes),
+        start_(std::chrono::steady_clock::now()) {}
+  Section(Section const &) = delete;
+  Section &operator=(Section const &) = delete;
+  ~Section() {
+    std::chrono::duration<t_real> const elapsed = std::chrono::steady_clock::now() - start_;
+    profile_.add(kernel_, flops_, bytes_, elapsed.count());
+  }
+
+private:
+  Profile &profile_;
+  Kernel kernel_;
+  t_real flops_, bytes_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+//! Measured peaks of the machine
+struct Machine {
+  //! Memory bandwidth from a STREAM triad, in bytes per second
+  t_real bandwidth;
+  //! Floating point rate from a double precision matrix-matrix product, in flops per second
+  t_real flops;
+};
+
+//! \brief Measures memory bandwidth and floating point peak
+//! \details Collective: all processes run the probes at the same time, so that the result is the
+//! aggregate peak of the processes sharing the machine. Each probe runs for about `seconds`.
+Machine probe(mpi::Communicator const &comm, t_real seconds = 0.2);
+
+//! \brief Writes the roofline report
+//! \details For each kernel: operations, bytes, time, achieved rates, arithmetic intensity, and
+//! the fraction of the attainable rate, min(peak flops, intensity × bandwidth), achieved.
+void write(std::ostream &stream, Profile const &profile, Machine const &machine);
+} // namespace roofline
+} // namespace optimet
+#endif
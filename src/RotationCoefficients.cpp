@@ -15,11 +15,13 @@
 // along with Optimet. If not, see <http://www.gnu.org/licenses/>.
 
 #include "RotationCoefficients.h"
+#include "Memory.h"
 #include <Coefficients.h>
 #include <Eigen/Geometry>
 #include <algorithm>
 #include <cmath>
 #include <iterator>
+#include <mutex>
 
 namespace optimet {
 
@@ -76,14 +78,48 @@ Matrix<t_complex> RotationCoefficients::matrix(t_uint n) {
   return result;
 }
 
-Rotation::Rotation(t_real const &theta, t_real const &phi, t_real const &chi, t_uint nmax)
+Rotation::Rotation(t_real const &theta, t_real const &phi, t_real const &chi, t_uint nmax,
+                   Storage storage)
     : theta_(theta), phi_(phi), chi_(chi), nmax_(nmax) {
+  if(storage == Storage::factored) {
+    flips_ = flips(nmax);
+    return;
+  }
   order.reserve(nmax + 1);
   RotationCoefficients coeffs(theta, phi, chi);
   for(t_uint i(0); i <= nmax; ++i)
     order.push_back(coeffs.matrix(i));
 }
 
+namespace {
+//! Flips with their memory recorded
+struct TrackedFlips : public Rotation::Flips {
+  TrackedFlips(Rotation::Flips const &flips) : Rotation::Flips(flips) {
+    t_real bytes(0);
+    for(auto const &flip : *this)
+      bytes += flip.size() * sizeof(t_real);
+    allocation = memory::Allocation(memory::Component::rotations, bytes);
+  }
+  memory::Allocation allocation;
+};
+}
+
+std::shared_ptr<Rotation::Flips const> Rotation::flips(t_uint nmax) {
+  static std::mutex mutex;
+  static std::shared_ptr<Flips const> largest;
+  std::lock_guard<std::mutex> const lock(mutex);
+  if(largest and largest->size() > nmax)
+    return largest;
+
+  // rotations created earlier keep the smaller table alive
+  Flips result = largest ? *largest : Flips();
+  RotationCoefficients coeffs(constant::pi / 2, 0, 0);
+  for(t_uint n(result.size()); n <= nmax; ++n)
+    result.push_back(coeffs.matrix(n).real());
+  largest = std::make_shared<TrackedFlips const>(result);
+  return largest;
+}
+
 Eigen::Matrix<t_real, 3, 3>
     RotationCoefficients::basis_rotation(Eigen::Matrix<t_real, 3, 1> const &axis) {
   if(axis.stableNorm() < 1e-8)
@@ -20,6 +20,7 @@
 #include "Types.h"
 #include "constants.h"
 #include <map>
+#include <memory>
 #include <tuple>
 
 #include <boost/math/special_functions/spherical_harmonic.hpp>
@@ -137,22 +138,54 @@ protected:
 };
 
 //! \brief Rotation by (phi, psi, chi) for orders up to nmax
+//! \details Rotations are stored either as dense matrices for each degree, or factored into
+//! rotations around the z axis and a fixed flip per degree:
+//!
+//!   T_n(ϑ, φ, χ) = Z_n(χ + π/2) G_n Z_n(ϑ) G_n Z_n(π/2 - φ),
+//!
+//! where Z_n(α) = diag(exp(i k α)) for k = -n to n, and G_n = T_n(π/2, 0, 0) is real, symmetric
+//! and its own inverse. The flips are computed once and shared by all factored rotations, so that
+//! each factored rotation only holds its angles. Applying it costs two real matrix products per
+//! degree, instead of one complex product.
 class Rotation {
 public:
+  //! How the rotation is stored
+  enum class Storage {
+    dense,   //!< One complex matrix per degree
+    factored //!< Angles only, with the flips shared between rotations
+  };
+  //! Fixed flips G_n for each degree from 0 to nmax
+  typedef std::vector<Matrix<t_real>> Flips;
+
   //! Rotation coefficients for given angles
-  Rotation(t_real const &theta, t_real const &phi, t_real const &chi, t_uint nmax);
+  Rotation(t_real const &theta, t_real const &phi, t_real const &chi, t_uint nmax,
+           Storage storage = Storage::dense);
   //! Rotation coefficients for given angles
-  Rotation(std::tuple<t_real, t_real, t_real> const &angles, t_uint nmax)
-      : Rotation(std::get<0>(angles), std::get<1>(angles), std::get<2>(angles), nmax) {}
+  Rotation(std::tuple<t_real, t_real, t_real> const &angles, t_uint nmax,
+           Storage storage = Storage::dense)
+      : Rotation(std::get<0>(angles), std::get<1>(angles), std::get<2>(angles), nmax, storage) {}
   //! Rotation coefficients for given axis or rotation matrix
   template <class T>
-  Rotation(Eigen::MatrixBase<T> const &axis_or_matrix, t_uint nmax)
-      : Rotation(RotationCoefficients::rotation_angles(axis_or_matrix), nmax) {}
+  Rotation(Eigen::MatrixBase<T> const &axis_or_matrix, t_uint nmax,
+           Storage storage = Storage::dense)
+      : Rotation(RotationCoefficients::rotation_angles(axis_or_matrix), nmax, storage) {}
+  //! Rotation from precomputed matrices, one per degree from 0 to nmax
+  Rotation(t_real const &theta, t_real const &phi, t_real const &chi,
+           std::vector<Matrix<t_complex>> const &matrices)
+      : theta_(theta), phi_(phi), chi_(chi), nmax_(matrices.size() - 1), order(matrices) {}
 
   t_real theta() const { return theta_; }
   t_real phi() const { return phi_; }
   t_real chi() const { return chi_; }
   t_uint nmax() const { return nmax_; }
+  //! How the rotation is stored
+  Storage storage() const { return flips_ ? Storage::factored : Storage::dense; }
+  //! Matrices for each degree from 0 to nmax, empty for factored rotations
+  std::vector<Matrix<t_complex>> const &matrices() const { return order; }
+  //! \brief Flips of degrees 0 to at least nmax, shared by the factored rotations
+  //! \details Computed on the first call for a given degree, then kept for the lifetime of the
+  //! program. Their memory is recorded with the rotations.
+  static std::shared_ptr<Flips const> flips(t_uint nmax);
 
   //! creates a rotation matrix for the given input
   Matrix<t_complex> rotation_matrix(t_real n) {
@@ -243,10 +276,54 @@ protected:
   t_uint const nmax_;
   //! Matrices for each spherical harmonic up to given order
   std::vector<Matrix<t_complex>> order;
+  //! Flips shared with other rotations, for factored rotations only
+  std::shared_ptr<Flips const> flips_;
+
+  //! \brief Applies Z(last) G Z(middle) G Z(first) to each degree
+  //! \details The four products of the factored rotation differ only by the angles, since the
+  //! flips are real and symmetric.
+  template <class T0, class T1>
+  void factored(Eigen::MatrixBase<T0> const &in, Eigen::MatrixBase<T1> const &out, t_real first,
+                t_real middle, t_real last) const;
 };
 
+template <class T0, class T1>
+void Rotation::factored(Eigen::MatrixBase<T0> const &in, Eigen::MatrixBase<T1> const &out,
+                        t_real first, t_real middle, t_real last) const {
+  const_cast<Eigen::MatrixBase<T1> &>(out).resize(in.rows(), in.cols());
+  t_uint const nmax = std::lround(std::sqrt(in.rows()) - 1.0);
+  assert(nmax * (nmax + 2) == in.rows());
+  assert(nmax >= 1 and nmax <= nmax_ and nmax < flips_->size());
+  // exp(i k α) from k = -n, by recurrence over k and n rather than one exponential each
+  t_complex const steps[3] = {std::polar(1e0, first), std::polar(1e0, middle),
+                              std::polar(1e0, last)};
+  t_complex starts[3] = {1, 1, 1};
+  Vector<t_complex> phases[3];
+  auto const fill = [](Vector<t_complex> &phase, t_complex start, t_complex step) {
+    phase(0) = start;
+    for(t_int k(1); k < phase.size(); ++k)
+      phase(k) = phase(k - 1) * step;
+  };
+  Matrix<t_complex> work(2 * nmax + 1, in.cols());
+  for(t_uint n(1), i(0); n <= nmax; i += 2 * n + 1, ++n) {
+    auto const size = 2 * n + 1;
+    for(t_uint j(0); j < 3; ++j) {
+      starts[j] *= std::conj(steps[j]);
+      phases[j].resize(size);
+      fill(phases[j], starts[j], steps[j]);
+    }
+    auto const &flip = (*flips_)[n];
+    work.topRows(size) = phases[0].asDiagonal() * in.block(i, 0, size, in.cols());
+    work.topRows(size) = phases[1].asDiagonal() * (flip * work.topRows(size));
+    const_cast<Eigen::MatrixBase<T1> &>(out).block(i, 0, size, in.cols()) =
+        phases[2].asDiagonal() * (flip * work.topRows(size));
+  }
+}
+
 template <class T0, class T1>
 void Rotation::operator()(Eigen::MatrixBase<T0> const &in, Eigen::MatrixBase<T1> const &out) const {
+  if(flips_)
+    return factored(in, out, constant::pi / 2 - phi_, theta_, chi_ + constant::pi / 2);
   const_cast<Eigen::MatrixBase<T1> &>(out).resize(in.rows(), in.cols());
   t_uint const nmax = std::lround(std::sqrt(in.rows()) - 1.0);
   assert(nmax * (nmax + 2) == in.rows());
@@ -270,6 +347,8 @@ Matrix<typename T0::Scalar> Rotation::operator()(Eigen::MatrixBase<T0> const &in
 
 template <class T0, class T1>
 void Rotation::adjoint(Eigen::MatrixBase<T0> const &in, Eigen::MatrixBase<T1> const &out) const {
+  if(flips_)
+    return factored(in, out, -chi_ - constant::pi / 2, -theta_, phi_ - constant::pi / 2);
   const_cast<Eigen::MatrixBase<T1> &>(out).resize(in.rows(), in.cols());
   t_uint const nmax = std::lround(std::sqrt(in.rows()) - 1.0);
   assert(nmax * (nmax + 2) == in.rows());
@@ -292,6 +371,8 @@ Matrix<typename T0::Scalar> Rotation::adjoint(Eigen::MatrixBase<T0> const &in) c
 
 template <class T0, class T1>
 void Rotation::transpose(Eigen::MatrixBase<T0> const &in, Eigen::MatrixBase<T1> const &out) const {
+  if(flips_)
+    return factored(in, out, chi_ + constant::pi / 2, theta_, constant::pi / 2 - phi_);
   const_cast<Eigen::MatrixBase<T1> &>(out).resize(in.rows(), in.cols());
   t_uint const nmax = std::lround(std::sqrt(in.rows()) - 1.0);
   assert(nmax * (nmax + 2) == in.rows());
@@ -313,6 +394,8 @@ Matrix<typename T0::Scalar> Rotation::transpose(Eigen::MatrixBase<T0> const &in)
 
 template <class T0, class T1>
 void Rotation::conjugate(Eigen::MatrixBase<T0> const &in, Eigen::MatrixBase<T1> const &out) const {
+  if(flips_)
+    return factored(in, out, phi_ - constant::pi / 2, -theta_, -chi_ - constant::pi / 2);
   const_cast<Eigen::MatrixBase<T1> &>(out).resize(in.rows(), in.cols());
   t_uint const nmax = std::lround(std::sqrt(in.rows()) - 1.0);
   assert(nmax * (nmax + 2) == in.rows());
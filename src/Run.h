@@ -20,12 +20,15 @@
 #include "CompoundIterator.h"
 #include "Excitation.h"
 #include "Geometry.h"
+#include "OperatorCache.h"
 #include "Types.h"
 #include "mpi/Communicator.h"
 #include "scalapack/Context.h"
 #include "scalapack/Parameters.h"
 #include <array>
+#include <limits>
 #include <memory>
+#include <string>
 
 #ifdef OPTIMET_BELOS
 #include <Teuchos_ParameterList.hpp>
@@ -76,6 +79,31 @@ public:
   bool do_fmm;
   //! Number of subdiagonals when setting up fmm local vs non-local mpi distribution
   t_int fmm_subdiagonals;
+  //! Whether FMM rotations are stored as phases and shared flips, rather than dense matrices
+  bool fmm_factored_rotations;
+  //! \brief Bytes of co-axial translation coefficients stored by each process, infinite by default
+  //! \details The coefficients of the farther pairs are recomputed during each multiplication.
+  t_real fmm_translations_budget;
+  //! Whether to also solve the second harmonic problem after the fundamental frequency
+  bool do_sh;
+  //! Precomputed operators stored on disk, disabled unless a directory is given
+  OperatorCache cache;
+  //! Whether solved coefficients are also read from and saved to the cache
+  bool cache_coefficients;
+  //! HDF5 file to which solved coefficients are written, if any
+  std::string coefficients_output;
+  //! HDF5 file from which to restart, instead of solving for the coefficients
+  std::string coefficients_input;
+  //! Memory available to each process in bytes, or zero to use the physical memory of the node
+  t_real memory_budget;
+  //! Whether to only predict the memory footprint of the solvers, without solving
+  bool dry_run;
+  //! Whether to choose the solver and its parameters from short calibration trials
+  bool autotune;
+  //! File recording the decisions of the autotuner, per class of problem
+  std::string autotune_file;
+  //! Number of objects in the calibration trials, or zero to choose from the degree
+  t_int autotune_objects;
 
   /**
    * Params:
@@ -88,7 +116,14 @@ public:
    * Default constructor for the Case class.
    * Does NOT initialize the instance.
    */
-  Run() : geometry(new Geometry), context(scalapack::Context::Squarest()){};
+  Run()
+      : geometry(new Geometry), nMax(0), projection(0), params{{0, 0, 0, 0, 0, 0, 0, 0, 0}},
+        outputType(-1), singleMode(false), dominantAuto(false), singleComponent(0),
+        context(scalapack::Context::Squarest()), do_fmm(false), fmm_subdiagonals(1),
+        fmm_factored_rotations(false),
+        fmm_translations_budget(std::numeric_limits<t_real>::infinity()), do_sh(false),
+        cache_coefficients(false), memory_budget(0), dry_run(false),
+        autotune(false), autotune_file("autotune.txt"), autotune_objects(0){};
 
   /**
    * Default destructor for the Case class.
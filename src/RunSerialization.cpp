@@ -0,0 +1,233 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "RunSerialization.h"
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef OPTIMET_BELOS
+#include <Teuchos_XMLParameterListCoreHelpers.hpp>
+#endif
+
+namespace optimet {
+namespace {
+//! Identifies serialized runs
+std::uint32_t const magic = 0x4f505452;
+
+//! Writes values as raw bytes
+class Packer {
+public:
+  Packer &operator<<(t_real value) { return bytes(&value, sizeof(value)); }
+  Packer &operator<<(t_complex value) { return *this << value.real() << value.imag(); }
+  Packer &operator<<(std::int64_t value) { return bytes(&value, sizeof(value)); }
+  Packer &operator<<(std::string const &value) {
+    *this << static_cast<std::int64_t>(value.size());
+    return bytes(value.data(), value.size());
+  }
+  Packer &operator<<(Spherical<t_real> const &value) {
+    return *this << value.rrr << value.the << value.phi;
+  }
+  Packer &operator<<(SphericalP<t_complex> const &value) {
+    return *this << value.rrr << value.the << value.phi;
+  }
+  Packer &operator<<(ElectroMagnetic const &elmag) {
+    *this << static_cast<std::int64_t>(elmag.modelType) << elmag.B1 << elmag.C1 << elmag.B2
+          << elmag.C2 << elmag.B3 << elmag.C3 << elmag.B4 << elmag.C4 << elmag.B5 << elmag.C5
+          << elmag.lambda << elmag.plasma_freq << elmag.damping_freq;
+    *this << elmag.epsilon << elmag.mu << elmag.epsilon_r << elmag.mu_r;
+    return *this << elmag.a_SH << elmag.b_SH << elmag.d_SH << elmag.epsilon_SH << elmag.mu_SH
+                 << elmag.epsilon_r_SH << elmag.mu_r_SH;
+  }
+
+  std::string str() const { return stream.str(); }
+
+private:
+  std::ostringstream stream;
+  Packer &bytes(void const *data, std::size_t n) {
+    stream.write(static_cast<char const *>(data), n);
+    return *this;
+  }
+};
+
+//! Reads back values written by the packer
+class Unpacker {
+public:
+  Unpacker(std::string const &buffer) : stream(buffer) {}
+  Unpacker &operator>>(t_real &value) { return bytes(&value, sizeof(value)); }
+  Unpacker &operator>>(t_complex &value) {
+    t_real real, imag;
+    *this >> real >> imag;
+    value = t_complex(real, imag);
+    return *this;
+  }
+  Unpacker &operator>>(std::int64_t &value) { return bytes(&value, sizeof(value)); }
+  Unpacker &operator>>(std::string &value) {
+    value.resize(integer());
+    return bytes(&value[0], value.size());
+  }
+  Unpacker &operator>>(Spherical<t_real> &value) {
+    return *this >> value.rrr >> value.the >> value.phi;
+  }
+  Unpacker &operator>>(SphericalP<t_complex> &value) {
+    return *this >> value.rrr >> value.the >> value.phi;
+  }
+  Unpacker &operator>>(ElectroMagnetic &elmag) {
+    elmag.modelType = integer();
+    *this >> elmag.B1 >> elmag.C1 >> elmag.B2 >> elmag.C2 >> elmag.B3 >> elmag.C3 >> elmag.B4 >>
+        elmag.C4 >> elmag.B5 >> elmag.C5 >> elmag.lambda >> elmag.plasma_freq >>
+        elmag.damping_freq;
+    *this >> elmag.epsilon >> elmag.mu >> elmag.epsilon_r >> elmag.mu_r;
+    return *this >> elmag.a_SH >> elmag.b_SH >> elmag.d_SH >> elmag.epsilon_SH >> elmag.mu_SH >>
+           elmag.epsilon_r_SH >> elmag.mu_r_SH;
+  }
+
+  std::int64_t integer() {
+    std::int64_t result;
+    *this >> result;
+    return result;
+  }
+  t_real real() {
+    t_real result;
+    *this >> result;
+    return result;
+  }
+
+private:
+  std::istringstream stream;
+  Unpacker &bytes(void *data, std::size_t n) {
+    if(n > 0 and not stream.read(static_cast<char *>(data), n))
+      throw std::runtime_error("Serialized run is corrupted");
+    return *this;
+  }
+};
+} // namespace
+
+std::string serialize(Run const &run) {
+  Packer packer;
+  packer << static_cast<std::int64_t>(magic);
+
+  auto const &geometry = *run.geometry;
+  packer << geometry.bground << static_cast<std::int64_t>(geometry.structureType)
+         << geometry.spiralSeparation << static_cast<std::int64_t>(geometry.normalToSpiral);
+  packer << static_cast<std::int64_t>(geometry.objects.size());
+  for(auto const &object : geometry.objects)
+    packer << object.vR << object.elmag << object.radius << static_cast<std::int64_t>(object.nMax);
+
+  auto const &excitation = *run.excitation;
+  packer << static_cast<std::int64_t>(excitation.type) << excitation.Einc << excitation.vKInc
+         << static_cast<std::int64_t>(excitation.nMax);
+
+  packer << static_cast<std::int64_t>(run.nMax) << static_cast<std::int64_t>(run.projection);
+  for(auto const param : run.params)
+    packer << param;
+  packer << static_cast<std::int64_t>(run.outputType) << static_cast<std::int64_t>(run.singleMode)
+         << static_cast<std::int64_t>(run.singleModeIndex.compound)
+         << static_cast<std::int64_t>(run.singleModeIndex.first)
+         << static_cast<std::int64_t>(run.singleModeIndex.second)
+         << static_cast<std::int64_t>(run.dominantAuto)
+         << static_cast<std::int64_t>(run.singleComponent);
+  packer << static_cast<std::int64_t>(run.parallel_params.block_size)
+         << static_cast<std::int64_t>(run.parallel_params.grid.rows)
+         << static_cast<std::int64_t>(run.parallel_params.grid.cols);
+  packer << static_cast<std::int64_t>(run.do_fmm) << static_cast<std::int64_t>(run.fmm_subdiagonals)
+         << static_cast<std::int64_t>(run.fmm_factored_rotations) << run.fmm_translations_budget
+         << static_cast<std::int64_t>(run.do_sh);
+  packer << run.cache.directory() << static_cast<std::int64_t>(run.cache_coefficients)
+         << run.coefficients_output << run.coefficients_input;
+  packer << run.memory_budget << static_cast<std::int64_t>(run.dry_run);
+  packer << static_cast<std::int64_t>(run.autotune) << run.autotune_file
+         << static_cast<std::int64_t>(run.autotune_objects);
+#ifdef OPTIMET_BELOS
+  std::ostringstream belos;
+  if(not run.belos_params.is_null())
+    Teuchos::writeParameterListToXmlOStream(*run.belos_params, belos);
+  packer << belos.str();
+#endif
+  return packer.str();
+}
+
+Run deserialize(std::string const &buffer) {
+  Run result;
+  deserialize(buffer, result);
+  return result;
+}
+
+void deserialize(std::string const &buffer, Run &result) {
+  Unpacker unpacker(buffer);
+  if(unpacker.integer() != magic)
+    throw std::runtime_error("Not a serialized run");
+
+  result.geometry = std::make_shared<Geometry>();
+  auto &geometry = *result.geometry;
+  unpacker >> geometry.bground;
+  geometry.structureType = unpacker.integer();
+  geometry.spiralSeparation = unpacker.real();
+  geometry.normalToSpiral = unpacker.integer();
+  auto const nobjects = unpacker.integer();
+  geometry.objects.reserve(nobjects);
+  for(std::int64_t i(0); i < nobjects; ++i) {
+    Spherical<t_real> vR;
+    ElectroMagnetic elmag;
+    unpacker >> vR >> elmag;
+    auto const radius = unpacker.real();
+    geometry.objects.emplace_back(vR, elmag, radius, unpacker.integer());
+  }
+
+  auto const type = unpacker.integer();
+  SphericalP<t_complex> Einc;
+  Spherical<t_real> vKInc;
+  unpacker >> Einc >> vKInc;
+  result.excitation = std::make_shared<Excitation>(type, Einc, vKInc, unpacker.integer());
+  result.excitation->populate();
+
+  result.nMax = unpacker.integer();
+  result.projection = unpacker.integer();
+  for(auto &param : result.params)
+    unpacker >> param;
+  result.outputType = unpacker.integer();
+  result.singleMode = unpacker.integer();
+  result.singleModeIndex.compound = unpacker.integer();
+  result.singleModeIndex.first = unpacker.integer();
+  result.singleModeIndex.second = unpacker.integer();
+  result.dominantAuto = unpacker.integer();
+  result.singleComponent = unpacker.integer();
+  result.parallel_params.block_size = unpacker.integer();
+  result.parallel_params.grid.rows = unpacker.integer();
+  result.parallel_params.grid.cols = unpacker.integer();
+  result.do_fmm = unpacker.integer();
+  result.fmm_subdiagonals = unpacker.integer();
+  result.fmm_factored_rotations = unpacker.integer();
+  unpacker >> result.fmm_translations_budget;
+  result.do_sh = unpacker.integer();
+  std::string directory;
+  unpacker >> directory;
+  result.cache = OperatorCache(directory);
+  result.cache_coefficients = unpacker.integer();
+  unpacker >> result.coefficients_output >> result.coefficients_input;
+  unpacker >> result.memory_budget;
+  result.dry_run = unpacker.integer();
+  result.autotune = unpacker.integer();
+  unpacker >> result.autotune_file;
+  result.autotune_objects = unpacker.integer();
+#ifdef OPTIMET_BELOS
+  std::string belos;
+  unpacker >> belos;
+  result.belos_params = belos.empty() ? Teuchos::rcp(new Teuchos::ParameterList) :
+                                        Teuchos::getParametersFromXmlString(belos);
+#endif
+}
+}
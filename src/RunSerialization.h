@@ -0,0 +1,35 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_RUN_SERIALIZATION_H
+#define OPTIMET_RUN_SERIALIZATION_H
+
+#include "Run.h"
+#include "Types.h"
+#include <string>
+
+namespace optimet {
+//! \brief Packs the parsed input of a run into a compact binary buffer
+//! \details Holds everything read from the input file: geometry, excitation, output and solver
+//! parameters, cache settings. The communicator and scalapack context are not included.
+std::string serialize(Run const &run);
+//! Recreates a run from its binary form
+Run deserialize(std::string const &buffer);
+//! \brief Reads the binary form of a run into an existing run
+//! \details Keeps the communicator and scalapack context of the run.
+void deserialize(std::string const &buffer, Run &run);
+}
+#endif
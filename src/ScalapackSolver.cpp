@@ -36,6 +36,8 @@ Scalapack::parallel_input() const {
 
 void Scalapack::solve(Vector<t_complex> &X_sca_, Vector<t_complex> &X_int_) const {
   if(context().is_valid()) {
+    memory::Allocation const factorization(memory::Component::matrix,
+                                           S.size() * sizeof(t_complex));
     auto input = parallel_input();
     // Now the actual work
     auto const gls_result =
@@ -53,8 +55,9 @@ void Scalapack::solve(Vector<t_complex> &X_sca_, Vector<t_complex> &X_int_) cons
 }
 
 void Scalapack::update() {
-  Q = distributed_source_vector(source_vector(*geometry, incWave), context(), block_size());
+  Q = distributed_source_vector(sources(), context(), block_size());
   S = preconditioned_scattering_matrix(*geometry, incWave, context(), block_size());
+  matrix_memory_ = memory::Allocation(memory::Component::matrix, S.size() * sizeof(t_complex));
 }
 }
 }
@@ -15,9 +15,9 @@
 // along with Optimet. If not, see <http://www.gnu.org/licenses/>.
 
 #include "Bessel.h"
-#include "HarmonicsIterator.h"
 #include "Scatterer.h"
 #include "Tools.h"
+#include <cassert>
 
 Scatterer::Scatterer(Spherical<double> vR_, ElectroMagnetic elmag_, double radius_, int nMax_)
     : vR(vR_), elmag(elmag_), radius(radius_), nMax(nMax_),
@@ -27,74 +27,169 @@ Scatterer::Scatterer(int nMax) : Scatterer({0, 0, 0}, {0, 0}, 0e0, nMax) {}
 
 Scatterer::~Scatterer() {}
 
+//! Riccati-Bessel functions at the surface of the sphere, indexed by the degree n
+struct Scatterer::RiccatiBessel {
+  //! Parameters of the evaluation
+  optimet::t_real omega;
+  optimet::t_complex epsilon, mu, bground_epsilon, bground_mu;
+  double radius;
+  int nMax;
+
+  //! Relative wavenumber k_s / k_b
+  optimet::t_complex rho;
+  //! k_b * radius
+  optimet::t_complex r_0;
+  //! Functions and derivatives of r_0 and of rho * r_0
+  std::vector<optimet::t_complex> psi, dpsi, ksi, dksi, psirho, dpsirho;
+
+  RiccatiBessel(optimet::t_real omega_, Scatterer const &object, ElectroMagnetic const &bground)
+      : omega(omega_), epsilon(object.elmag.epsilon), mu(object.elmag.mu),
+        bground_epsilon(bground.epsilon), bground_mu(bground.mu), radius(object.radius),
+        nMax(object.nMax), psi(nMax + 1), dpsi(nMax + 1), ksi(nMax + 1), dksi(nMax + 1),
+        psirho(nMax + 1), dpsirho(nMax + 1) {
+    using namespace optimet;
+    auto const k_s = omega * std::sqrt(epsilon * mu);
+    auto const k_b = omega * std::sqrt(bground_epsilon * bground_mu);
+    rho = k_s / k_b;
+    r_0 = k_b * radius;
+
+    auto const Jn = bessel<Bessel>(r_0, nMax);
+    auto const Jrho = bessel<Bessel>(rho * r_0, nMax);
+    auto const Hn = bessel<Hankel1>(r_0, nMax);
+    for(int n(1); n <= nMax; ++n) {
+      psi[n] = r_0 * std::get<0>(Jn)[n];
+      dpsi[n] = r_0 * std::get<1>(Jn)[n] + std::get<0>(Jn)[n];
+      ksi[n] = r_0 * std::get<0>(Hn)[n];
+      dksi[n] = r_0 * std::get<1>(Hn)[n] + std::get<0>(Hn)[n];
+      psirho[n] = r_0 * rho * std::get<0>(Jrho)[n];
+      dpsirho[n] = r_0 * rho * std::get<1>(Jrho)[n] + std::get<0>(Jrho)[n];
+    }
+  }
+
+  //! True if computed for the same sphere, frequency and background
+  bool matches(optimet::t_real omega_, Scatterer const &object,
+               ElectroMagnetic const &bground) const {
+    return omega == omega_ and epsilon == object.elmag.epsilon and mu == object.elmag.mu and
+           bground_epsilon == bground.epsilon and bground_mu == bground.mu and
+           radius == object.radius and nMax == object.nMax;
+  }
+};
+
+std::shared_ptr<Scatterer::RiccatiBessel const>
+Scatterer::riccati_bessel(optimet::t_real omega_, ElectroMagnetic const &bground) const {
+  auto result = riccati_bessel_;
+  if(not(result and result->matches(omega_, *this, bground))) {
+    result = std::make_shared<RiccatiBessel const>(omega_, *this, bground);
+    riccati_bessel_ = result;
+  }
+  return result;
+}
+
 optimet::Vector<optimet::t_complex>
-Scatterer::getTLocal(optimet::t_real omega_, ElectroMagnetic const &bground) const {
+Scatterer::getTLocalDegrees(optimet::t_real omega_, ElectroMagnetic const &bground) const {
   using namespace optimet;
-  auto const k_s = omega_ * std::sqrt(elmag.epsilon * elmag.mu);
-  auto const k_b = omega_ * std::sqrt(bground.epsilon * bground.mu);
-
-  auto const rho = k_s / k_b;
-  auto const r_0 = k_b * radius;
+  auto const rb = riccati_bessel(omega_, bground);
+  auto const rho = rb->rho;
   auto const mu_sob = elmag.mu / bground.mu;
 
-  auto const Jn = bessel<Bessel>(r_0, nMax);
-  auto const Jrho = bessel<Bessel>(rho * r_0, nMax);
-  auto const Hn = bessel<Hankel1>(r_0, nMax);
-
-  auto const N = HarmonicsIterator::max_flat(nMax) - 1;
-  Vector<t_complex> result = Vector<t_complex>::Zero(2 * N);
-  for(t_uint n(1), current(0); n <= nMax; current += 2 * n + 1, ++n) {
-    auto const psi = r_0 * std::get<0>(Jn)[n];
-    auto const dpsi = r_0 * std::get<1>(Jn)[n] + std::get<0>(Jn)[n];
-
-    auto const ksi = r_0 * std::get<0>(Hn)[n];
-    auto const dksi = r_0 * std::get<1>(Hn)[n] + std::get<0>(Hn)[n];
-
-    auto const psirho = r_0 * rho * std::get<0>(Jrho)[n];
-    auto const dpsirho = r_0 * rho * std::get<1>(Jrho)[n] + std::get<0>(Jrho)[n];
+  Vector<t_complex> result(2 * nMax);
+  for(auto n = 1; n <= nMax; ++n) {
+    auto const psi = rb->psi[n];
+    auto const dpsi = rb->dpsi[n];
+    auto const ksi = rb->ksi[n];
+    auto const dksi = rb->dksi[n];
+    auto const psirho = rb->psirho[n];
+    auto const dpsirho = rb->dpsirho[n];
 
     // TE Part
-    auto const TE = (psi / ksi) * (mu_sob * dpsi / psi - rho * dpsirho / psirho) /
+    result(n - 1) = (psi / ksi) * (mu_sob * dpsi / psi - rho * dpsirho / psirho) /
                     (rho * dpsirho / psirho - mu_sob * dksi / ksi);
-    result.segment(current, 2 * n + 1).fill(TE);
 
     // TM part
-    auto const TM = (psi / ksi) * (mu_sob * dpsirho / psirho - rho * dpsi / psi) /
-                    (rho * dksi / ksi - mu_sob * dpsirho / psirho);
-    result.segment(current + N, 2 * n + 1).fill(TM);
+    result(nMax + n - 1) = (psi / ksi) * (mu_sob * dpsirho / psirho - rho * dpsi / psi) /
+                           (rho * dksi / ksi - mu_sob * dpsirho / psirho);
   }
 
   return result;
 }
 
+optimet::Vector<optimet::t_complex>
+Scatterer::getTLocal(optimet::t_real omega_, ElectroMagnetic const &bground) const {
+  optimet::Vector<optimet::t_complex> result =
+      optimet::Vector<optimet::t_complex>::Ones(2 * nMax * (nMax + 2));
+  optimet::multiply_by_degree(getTLocalDegrees(omega_, bground), result, result);
+  return result;
+}
+
+optimet::Vector<optimet::t_complex>
+Scatterer::getIauxDegrees(optimet::t_real omega_, ElectroMagnetic const &bground) const {
+  auto const rb = riccati_bessel(omega_, bground);
+  auto const rho = rb->rho;
+  auto const mu_j = elmag.mu;
+  auto const mu_0 = bground.mu;
+
+  optimet::Vector<optimet::t_complex> result(2 * nMax);
+  for(auto n = 1; n <= nMax; ++n) {
+    auto const psi = rb->psi[n];
+    auto const dpsi = rb->dpsi[n];
+    auto const psirho = rb->psirho[n];
+    auto const dpsirho = rb->dpsirho[n];
+
+    result(n - 1) = (mu_j * rho) / (mu_0 * rho * dpsirho * psi - mu_j * psirho * dpsi) *
+                    std::complex<double>(0., 1.);
+    result(nMax + n - 1) = (mu_j * rho) / (mu_j * psi * dpsirho - mu_0 * rho * psirho * dpsi) *
+                           std::complex<double>(0., 1.);
+  }
+  return result;
+}
+
 optimet::Vector<optimet::t_complex>
 Scatterer::getIaux(optimet::t_real omega_, ElectroMagnetic const &bground) const {
-  auto const k_s = omega_ * std::sqrt(elmag.epsilon * elmag.mu);
-  auto const k_b = omega_ * std::sqrt(bground.epsilon * bground.mu);
-  auto const rho = k_s / k_b;
-  auto const r_0 = k_b * radius;
+  optimet::Vector<optimet::t_complex> result =
+      optimet::Vector<optimet::t_complex>::Ones(2 * nMax * (nMax + 2));
+  optimet::multiply_by_degree(getIauxDegrees(omega_, bground), result, result);
+  return result;
+}
+
+optimet::Vector<optimet::t_real>
+Scatterer::getCabsAux(optimet::t_real omega_, ElectroMagnetic const &bground) const {
+  auto const rb = riccati_bessel(omega_, bground);
+  auto const rho = rb->rho;
   auto const mu_j = elmag.mu;
   auto const mu_0 = bground.mu;
 
-  auto Jdata = optimet::bessel<optimet::Bessel>(r_0, nMax);
-  auto const Jrho = optimet::bessel<optimet::Bessel>(rho * r_0, nMax);
-
-  optimet::Vector<optimet::t_complex> result(2 * nMax * (nMax + 2));
-  auto TE = result.head(nMax * (nMax + 2));
-  auto TM = result.tail(nMax * (nMax + 2));
-  for(auto n = 1, i = 0; n <= nMax; ++n) {
-    // obtain Riccati-Bessel functions
-    auto const psi = r_0 * std::get<0>(Jdata)[n];
-    auto const dpsi = r_0 * std::get<1>(Jdata)[n] + std::get<0>(Jdata)[n];
-    auto const psirho = r_0 * rho * std::get<0>(Jrho)[n];
-    auto const dpsirho = r_0 * rho * std::get<1>(Jrho)[n] + std::get<0>(Jrho)[n];
-
-    for(auto m = -n; m <= n; ++m, ++i) {
-      TE(i) = (mu_j * rho) / (mu_0 * rho * dpsirho * psi - mu_j * psirho * dpsi) *
-              std::complex<double>(0., 1.);
-      TM(i) = (mu_j * rho) / (mu_j * psi * dpsirho - mu_0 * rho * psirho * dpsi) *
-              std::complex<double>(0., 1.);
-    }
+  optimet::Vector<optimet::t_real> result(2 * nMax);
+  for(auto n = 1; n <= nMax; ++n) {
+    auto const psi = rb->psi[n];
+    auto const dpsi = rb->dpsi[n];
+    auto const psirho = rb->psirho[n];
+    auto const dpsirho = rb->dpsirho[n];
+
+    // Stout 2002 - from scattered
+    // TE Part
+    auto const TE = std::complex<double>(0., 1.) * rho * mu_0 * std::conj(mu_j) *
+                    std::conj(psirho) * dpsirho;
+    result(n - 1) = std::real(TE) / std::norm(mu_j * psirho * dpsi - mu_0 * rho * dpsirho * psi);
+
+    // TM part
+    auto const TM = std::complex<double>(0., 1.) * std::conj(rho) * mu_0 * mu_j *
+                    std::conj(psirho) * dpsirho;
+    result(nMax + n - 1) =
+        std::real(TM) / std::norm(mu_0 * rho * psirho * dpsi - mu_j * dpsirho * psi);
   }
   return result;
 }
+
+namespace optimet {
+void multiply_by_degree(Eigen::Ref<Vector<t_complex> const> const &degrees,
+                        Eigen::Ref<Vector<t_complex> const> const &in,
+                        Eigen::Ref<Vector<t_complex>> out) {
+  auto const nMax = degrees.size() / 2;
+  auto const N = nMax * (nMax + 2);
+  assert(in.size() == 2 * N and out.size() == 2 * N);
+  for(t_int n(1), i(0); n <= nMax; i += 2 * n + 1, ++n) {
+    out.segment(i, 2 * n + 1) = in.segment(i, 2 * n + 1) * degrees(n - 1);
+    out.segment(N + i, 2 * n + 1) = in.segment(N + i, 2 * n + 1) * degrees(nMax + n - 1);
+  }
+}
+} // namespace optimet
@@ -20,6 +20,7 @@
 #include "ElectroMagnetic.h"
 #include "Spherical.h"
 #include "Types.h"
+#include <memory>
 #include <vector>
 
 /**
@@ -90,6 +91,53 @@ public:
   //! Coefficients for field inside a sphere
   optimet::Vector<optimet::t_complex>
   getIaux(optimet::t_real omega_, ElectroMagnetic const &bground) const;
+
+  /**
+   * Compact form of getTLocal: the coefficients of a sphere depend only on
+   * the degree n, so only one value per degree is stored.
+   * @param omega_ the angular frequency of the simulation
+   * @param bground background electromagnetic medium
+   * @return TE coefficients for n = 1..nMax, followed by the TM coefficients.
+   * @see optimet::multiply_by_degree
+   */
+  optimet::Vector<optimet::t_complex>
+  getTLocalDegrees(optimet::t_real omega_, ElectroMagnetic const &bground) const;
+
+  //! Compact form of getIaux, with one TE and one TM value per degree n
+  optimet::Vector<optimet::t_complex>
+  getIauxDegrees(optimet::t_real omega_, ElectroMagnetic const &bground) const;
+
+  /**
+   * Returns the factors relating the scattering coefficients to the power
+   * absorbed by the sphere. The factors depend only on the degree n.
+   * @param omega_ the angular frequency of the simulation
+   * @param bground background electromagnetic medium
+   * @return TE factors for n = 1..nMax, followed by the TM factors.
+   */
+  optimet::Vector<optimet::t_real>
+  getCabsAux(optimet::t_real omega_, ElectroMagnetic const &bground) const;
+
+  //! Riccati-Bessel functions at the surface of the sphere, per degree n
+  struct RiccatiBessel;
+
+private:
+  //! \brief Riccati-Bessel functions for a given frequency and background
+  //! \details The last evaluation is kept, so that the T-matrix, the internal and the absorption
+  //! factors of a sphere share the same Bessel evaluations.
+  std::shared_ptr<RiccatiBessel const>
+  riccati_bessel(optimet::t_real omega_, ElectroMagnetic const &bground) const;
+  //! Last evaluation of the Riccati-Bessel functions
+  mutable std::shared_ptr<RiccatiBessel const> riccati_bessel_;
 };
 
+namespace optimet {
+//! \brief Multiplies the coefficients of a sphere by factors depending only on the degree n
+//! \param[in] degrees: TE factors for n = 1..nMax, followed by the TM factors
+//! \param[in] in: TE then TM coefficients of the sphere, 2 nMax (nMax + 2) elements
+//! \param[out] out: product of `in` with the factors broadcast over m. It can alias `in`.
+void multiply_by_degree(Eigen::Ref<Vector<t_complex> const> const &degrees,
+                        Eigen::Ref<Vector<t_complex> const> const &in,
+                        Eigen::Ref<Vector<t_complex>> out);
+} // namespace optimet
+
 #endif /* SCATTERER_H_ */
@@ -17,8 +17,12 @@
 #include "Simulation.h"
 
 #include "Aliases.h"
+#include "Autotune.h"
+#include "CoefficientsFile.h"
 #include "CompoundIterator.h"
+#include "Memory.h"
 #include "Output.h"
+#include "PreconditionedMatrix.h"
 #include "Reader.h"
 #include "Result.h"
 #include "Run.h"
@@ -27,19 +31,52 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 
 namespace optimet {
 int Simulation::run() {
 
-  // Read the case file
-  auto run = simulation_input(caseFile + ".xml");
+  // Read the case file on root and share it with other processes
+  timing::reset();
+  memory::reset();
+  auto run = [this]() {
+    timing::Timer const timer(timing::Phase::input);
+    return simulation_input(caseFile + ".xml", communicator());
+  }();
+  if(communicator().rank() == communicator().root_id())
+    std::cout << "Read input in " << timing::seconds(timing::Phase::input) << " seconds\n";
 #ifdef OPTIMET_MPI
   run.parallel_params.grid = scalapack::squarest_largest_grid(communicator().size());
   run.communicator = communicator();
 #endif
-
-  // Initialize the solver
-  auto const solver = optimet::solver::factory(run);
+  bool const is_root = communicator().rank() == communicator().root_id();
+
+  // Predict the memory needed by each solver before allocating anything large
+  if(run.dry_run) {
+    auto const budget = memory::budget(run, communicator());
+    if(is_root)
+      memory::write(std::cout, run, communicator().size(), budget);
+    return 0;
+  }
+  // Choose the solver from calibration trials, or from earlier runs of the same class of problem
+  if(run.autotune and run.coefficients_input.empty())
+    autotune::tune(run, communicator());
+  if(run.coefficients_input.empty())
+    memory::check(run, communicator());
+
+  // Open the coefficients files on root
+  if(is_root and not run.coefficients_input.empty())
+    coefficients_input_ = std::make_shared<CoefficientsFile>(run.coefficients_input, false);
+  if(is_root and run.coefficients_output.empty() and run.outputType == 2)
+    run.coefficients_output = caseFile + "_coefficients.h5";
+  if(is_root and not run.coefficients_output.empty())
+    coefficients_output_ = std::make_shared<CoefficientsFile>(run.coefficients_output, true);
+
+  // Initialize the solver, unless restarting from solved coefficients
+  auto const solver = run.coefficients_input.empty() ?
+                          optimet::solver::factory(run) :
+                          std::shared_ptr<optimet::solver::AbstractSolver>();
 
   switch(run.outputType) {
   case 0:
@@ -61,47 +98,211 @@ int Simulation::run() {
     std::cerr << "Nothing to do?\n";
     return 1;
   }
+
+  if(communicator().rank() == communicator().root_id()) {
+    std::ofstream timings(caseFile + "_timings.json");
+    timings_.write(timings, communicator());
+  }
+  memory::write_peaks(std::cout, communicator());
   return 0;
 }
 
+namespace {
+//! Reads solved coefficients from the cache, if allowed and available on all processes
+bool load_coefficients(Run const &run, mpi::Communicator const &communicator,
+                       Geometry const &geometry, Excitation const &excitation,
+                       std::string const &kind, Result &result) {
+  if(not run.cache_coefficients)
+    return false;
+  OperatorData data;
+  t_int loaded = run.cache.load(coefficients_hash(geometry, excitation), kind, data) and
+                 data.size() == 2 and data[0].size() == result.scatter_coef.size() and
+                 data[1].size() == result.internal_coef.size();
+#ifdef OPTIMET_MPI
+  loaded = communicator.all_reduce(loaded, MPI_MIN);
+#else
+  (void)communicator;
+#endif
+  if(not loaded)
+    return false;
+  result.scatter_coef = Vector<t_complex>::Map(data[0].data(), data[0].size());
+  result.internal_coef = Vector<t_complex>::Map(data[1].data(), data[1].size());
+  return true;
+}
+
+//! Saves solved coefficients to the cache, if allowed
+void save_coefficients(Run const &run, mpi::Communicator const &communicator,
+                       Geometry const &geometry, Excitation const &excitation,
+                       std::string const &kind, Result const &result) {
+  if(run.cache_coefficients and communicator.rank() == communicator.root_id())
+    run.cache.save(coefficients_hash(geometry, excitation), kind,
+                   {result.scatter_coef, result.internal_coef});
+}
+
+//! Labels a step of a scan
+std::string step_label(std::string const &name, t_real value) {
+  std::ostringstream sstr;
+  sstr << name << "=" << value;
+  return sstr.str();
+}
+
+void write_fields(Run const &run, Result &result, OutputGrid &oEGrid, OutputGrid &oHGrid) {
+  timing::Timer const timer(timing::Phase::fields);
+  if(run.singleMode) {
+    if(run.dominantAuto) {
+      CompoundIterator p;
+      p = result.getDominant();
+      result.setFieldsModal(oEGrid, oHGrid, run.projection, p, run.singleComponent);
+      std::cout << "Field output finished. Mode given is for n = " << p.first
+                << " and m = " << p.second << "." << std::endl;
+    } else {
+      result.setFieldsModal(oEGrid, oHGrid, run.projection, run.singleModeIndex,
+                            run.singleComponent);
+    }
+  } else {
+    result.setFields(oEGrid, oHGrid, run.projection);
+  }
+}
+}
+
+bool Simulation::restore(Run const &run, Geometry const &geometry, Excitation const &excitation,
+                         std::string const &kind, Result &result) const {
+  if(run.coefficients_input.empty())
+    return load_coefficients(run, communicator(), geometry, excitation, kind, result);
+
+  bool const is_root = communicator().rank() == communicator().root_id();
+  auto const nscatter = result.scatter_coef.size(), ninternal = result.internal_coef.size();
+  t_int found = 0;
+  if(is_root)
+    found = coefficients_input_->read(kind, coefficients_hash(geometry, excitation),
+                                      result.scatter_coef, result.internal_coef) and
+            result.scatter_coef.size() == nscatter and result.internal_coef.size() == ninternal;
+#ifdef OPTIMET_MPI
+  found = communicator().broadcast(found);
+#endif
+  if(not found)
+    throw std::runtime_error("No " + kind + " coefficients for this geometry and excitation in " +
+                             run.coefficients_input);
+#ifdef OPTIMET_MPI
+  if(is_root) {
+    communicator().broadcast(result.scatter_coef);
+    communicator().broadcast(result.internal_coef);
+  } else {
+    result.scatter_coef = communicator().broadcast<Vector<t_complex>>();
+    result.internal_coef = communicator().broadcast<Vector<t_complex>>();
+  }
+#endif
+  return true;
+}
+
+void Simulation::store(Run const &run, Geometry const &geometry, Excitation const &excitation,
+                       std::string const &kind, Result const &result) const {
+  if(coefficients_output_) {
+    timing::Timer const timer(timing::Phase::output);
+    coefficients_output_->write(kind, coefficients_hash(geometry, excitation), excitation.lambda(),
+                                geometry.nMax(), geometry.objects.size(), result.scatter_coef,
+                                result.internal_coef);
+  }
+  save_coefficients(run, communicator(), geometry, excitation, kind, result);
+}
+
+void Simulation::run_solver(solver::AbstractSolver const &solver, Geometry const &geometry,
+                            Excitation const &excitation, std::string const &kind,
+                            Result &result) const {
+  auto const write_convergence = [&]() {
+    if(coefficients_output_ and not solver.convergence().empty()) {
+      timing::Timer const timer(timing::Phase::output);
+      coefficients_output_->write(kind, coefficients_hash(geometry, excitation),
+                                  excitation.lambda(), solver.convergence());
+    }
+  };
+  timing::Timer const timer(timing::Phase::solve);
+  try {
+    solver.solve(result.scatter_coef, result.internal_coef);
+  } catch(...) {
+    write_convergence();
+    throw;
+  }
+  write_convergence();
+}
+
+void Simulation::solve(Run const &run, std::shared_ptr<solver::AbstractSolver> solver,
+                       Result &result) {
+  if(restore(run, *run.geometry, *run.excitation, "FF", result))
+    return;
+  run_solver(*solver, *run.geometry, *run.excitation, "FF", result);
+  store(run, *run.geometry, *run.excitation, "FF", result);
+}
+
 void Simulation::field_simulation(Run &run, std::shared_ptr<solver::AbstractSolver> solver) {
   // Determine the simulation type and proceed accordingly
 
   Result result(run.geometry, run.excitation);
-  solver->solve(result.scatter_coef, result.internal_coef);
+  solve(run, solver, result);
+
+  std::unique_ptr<Result> result_SH;
+  if(run.do_sh)
+    result_SH.reset(new Result(second_harmonic(run, solver, result)));
 
   if(communicator().rank() == communicator().root_id()) {
     Output oFile(caseFile + ".h5");
     OutputGrid oEGrid(O3DCartesianRegular, run.params, oFile.getHandle("Field_E"));
     OutputGrid oHGrid(O3DCartesianRegular, run.params, oFile.getHandle("Field_H"));
 
-    if(run.singleMode) {
-      if(run.dominantAuto) {
-        CompoundIterator p;
-        p = result.getDominant();
-        result.setFieldsModal(oEGrid, oHGrid, run.projection, p, run.singleComponent);
-        std::cout << "Field output finished. Mode given is for n = " << p.first
-                  << " and m = " << p.second << "." << std::endl;
-      } else {
-        result.setFieldsModal(oEGrid, oHGrid, run.projection, run.singleModeIndex,
-                              run.singleComponent);
-      }
-    } else {
-      result.setFields(oEGrid, oHGrid, run.projection);
-    }
+    write_fields(run, result, oEGrid, oHGrid);
 
     oEGrid.close();
     oHGrid.close();
+
+    if(result_SH) {
+      OutputGrid oEGrid_SH(O3DCartesianRegular, run.params, oFile.getHandle("Field_E_SH"));
+      OutputGrid oHGrid_SH(O3DCartesianRegular, run.params, oFile.getHandle("Field_H_SH"));
+
+      write_fields(run, *result_SH, oEGrid_SH, oHGrid_SH);
+
+      oEGrid_SH.close();
+      oHGrid_SH.close();
+    }
     oFile.close();
   }
+  timings_.step("field", communicator());
+}
+
+Result Simulation::second_harmonic(Run const &run, std::shared_ptr<solver::AbstractSolver> solver,
+                                   Result &result_FF) {
+  // Same incident wave at twice the frequency
+  auto const excitation_SH = std::make_shared<Excitation>(*run.excitation);
+  excitation_SH->updateWavelength(0.5 * run.excitation->lambda());
+  auto const geometry_SH = std::make_shared<Geometry>(run.geometry->secondHarmonic());
+  Result result(geometry_SH, excitation_SH, &result_FF);
+  if(restore(run, *geometry_SH, *excitation_SH, "SH", result))
+    return result;
+
+  // Sources of each object, then translated to the other objects
+#ifdef OPTIMET_MPI
+  geometry_SH->setSourcesSingle(single_source_vector(*run.geometry, excitation_SH,
+                                                     result_FF.internal_coef, communicator()));
+  auto const sources = translated_source_vector(*geometry_SH, excitation_SH, communicator());
+#else
+  geometry_SH->setSourcesSingle(
+      single_source_vector(*run.geometry, excitation_SH, result_FF.internal_coef));
+  auto const sources = translated_source_vector(*geometry_SH, excitation_SH);
+#endif
+
+  solver->update(geometry_SH, excitation_SH, sources);
+  run_solver(*solver, *geometry_SH, *excitation_SH, "SH", result);
+  store(run, *geometry_SH, *excitation_SH, "SH", result);
+  return result;
 }
 
 void Simulation::scan_wavelengths(Run &run, std::shared_ptr<solver::AbstractSolver> solver) {
-  std::ofstream outASec, outESec;
+  std::ofstream outASec, outESec, outASec_SH;
 
   if(communicator().rank() == communicator().root_id()) {
     outASec.open(caseFile + "_AbsorptionCS.dat");
     outESec.open(caseFile + "_ExtinctionCS.dat");
+    if(run.do_sh)
+      outASec_SH.open(caseFile + "_AbsorptionCS_SH.dat");
   }
 
   // Now scan over the wavelengths given in params
@@ -121,29 +322,44 @@ void Simulation::scan_wavelengths(Run &run, std::shared_ptr<solver::AbstractSolv
 
     run.excitation->updateWavelength(lam);
     run.geometry->update(run.excitation);
-    solver->update(run);
+    if(solver)
+      solver->update(run);
 
     Result result(run.geometry, run.excitation);
-    solver->solve(result.scatter_coef, result.internal_coef);
+    solve(run, solver, result);
 
+    auto const Cabs = result.getAbsorptionCrossSection(communicator());
+    auto const Cext = result.getExtinctionCrossSection(communicator());
     if(communicator().rank() == communicator().root_id()) {
-      outASec << lam << "\t" << result.getAbsorptionCrossSection() << std::endl;
-      outESec << lam << "\t" << result.getExtinctionCrossSection() << std::endl;
+      outASec << lam << "\t" << Cabs << std::endl;
+      outESec << lam << "\t" << Cext << std::endl;
+    }
+
+    if(run.do_sh) {
+      auto result_SH = second_harmonic(run, solver, result);
+      auto const Cabs_SH = result_SH.getAbsorptionCrossSection(communicator());
+      if(communicator().rank() == communicator().root_id())
+        outASec_SH << lam << "\t" << Cabs_SH << std::endl;
     }
+    timings_.step(step_label("lambda", lam), communicator());
   }
 
   if(communicator().rank() == communicator().root_id()) {
     outASec.close();
     outESec.close();
+    if(run.do_sh)
+      outASec_SH.close();
   }
 }
 
 void Simulation::radius_scan(Run &run, std::shared_ptr<solver::AbstractSolver> solver) {
-  std::ofstream outASec, outESec;
+  std::ofstream outASec, outESec, outASec_SH;
 
   if(communicator().rank() == communicator().root_id()) {
     outASec.open(caseFile + "_AbsorptionCS.dat");
     outESec.open(caseFile + "_ExtinctionCS.dat");
+    if(run.do_sh)
+      outASec_SH.open(caseFile + "_AbsorptionCS_SH.dat");
   }
 
   // Now scan over the wavelengths given in params
@@ -174,30 +390,45 @@ void Simulation::radius_scan(Run &run, std::shared_ptr<solver::AbstractSolver> s
       exit(1);
     }
 
-    solver->update(run);
+    if(solver)
+      solver->update(run);
 
     Result result(run.geometry, run.excitation);
-    solver->solve(result.scatter_coef, result.internal_coef);
+    solve(run, solver, result);
 
+    auto const Cabs = result.getAbsorptionCrossSection(communicator());
+    auto const Cext = result.getExtinctionCrossSection(communicator());
     if(communicator().rank() == communicator().root_id()) {
-      outASec << rad << "\t" << result.getAbsorptionCrossSection() << std::endl;
-      outESec << rad << "\t" << result.getExtinctionCrossSection() << std::endl;
+      outASec << rad << "\t" << Cabs << std::endl;
+      outESec << rad << "\t" << Cext << std::endl;
+    }
+
+    if(run.do_sh) {
+      auto result_SH = second_harmonic(run, solver, result);
+      auto const Cabs_SH = result_SH.getAbsorptionCrossSection(communicator());
+      if(communicator().rank() == communicator().root_id())
+        outASec_SH << rad << "\t" << Cabs_SH << std::endl;
     }
+    timings_.step(step_label("radius", rad), communicator());
   }
 
   if(communicator().rank() == communicator().root_id()) {
     outASec.close();
     outESec.close();
+    if(run.do_sh)
+      outASec_SH.close();
   }
 }
 
 void Simulation::radius_and_wavelength_scan(Run &run,
                                             std::shared_ptr<solver::AbstractSolver> solver) {
-  std::ofstream outASec, outESec, outParams;
+  std::ofstream outASec, outESec, outASec_SH, outParams;
 
   if(communicator().rank() == communicator().root_id()) {
     outASec.open(caseFile + "_AbsorptionCS.dat");
     outESec.open(caseFile + "_ExtinctionCS.dat");
+    if(run.do_sh)
+      outASec_SH.open(caseFile + "_AbsorptionCS_SH.dat");
     outParams.open(caseFile + "_RadiusLambda.dat");
   }
 
@@ -238,22 +469,35 @@ void Simulation::radius_and_wavelength_scan(Run &run,
         exit(1);
       }
 
-      solver->update(run);
+      if(solver)
+        solver->update(run);
 
       Result result(run.geometry, run.excitation);
-      solver->solve(result.scatter_coef, result.internal_coef);
+      solve(run, solver, result);
 
+      auto const Cabs = result.getAbsorptionCrossSection(communicator());
+      auto const Cext = result.getExtinctionCrossSection(communicator());
       if(communicator().rank() == communicator().root_id()) {
-        outASec << result.getAbsorptionCrossSection() << "\t";
-        outESec << result.getExtinctionCrossSection() << "\t";
+        outASec << Cabs << "\t";
+        outESec << Cext << "\t";
         outParams << "(" << rad * 1e9 << " , " << lam * 1e9 << ")"
                   << "\t";
       }
+
+      if(run.do_sh) {
+        auto result_SH = second_harmonic(run, solver, result);
+        auto const Cabs_SH = result_SH.getAbsorptionCrossSection(communicator());
+        if(communicator().rank() == communicator().root_id())
+          outASec_SH << Cabs_SH << "\t";
+      }
+      timings_.step(step_label("lambda", lam) + ", " + step_label("radius", rad), communicator());
     }
 
     if(communicator().rank() == communicator().root_id()) {
       outASec << std::endl;
       outESec << std::endl;
+      if(run.do_sh)
+        outASec_SH << std::endl;
       outParams << std::endl;
     }
   }
@@ -261,6 +505,8 @@ void Simulation::radius_and_wavelength_scan(Run &run,
   if(communicator().rank() == communicator().root_id()) {
     outASec.close();
     outESec.close();
+    if(run.do_sh)
+      outASec_SH.close();
     outParams.close();
   }
 }
@@ -269,9 +515,10 @@ void Simulation::coefficients(Run &run, std::shared_ptr<solver::AbstractSolver>
   // Scattering coefficients requests
 
   Result result(run.geometry, run.excitation);
-  solver->solve(result.scatter_coef, result.internal_coef);
+  solve(run, solver, result);
 
   if(communicator().rank() == communicator().root_id()) {
+    timing::Timer const timer(timing::Phase::output);
     std::ofstream outPCoef(caseFile + "_pCoefficients.dat");
     std::ofstream outQCoef(caseFile + "_qCoefficients.dat");
 
@@ -286,6 +533,7 @@ void Simulation::coefficients(Run &run, std::shared_ptr<solver::AbstractSolver>
     outPCoef.close();
     outQCoef.close();
   }
+  timings_.step("coefficients", communicator());
 }
 
 int Simulation::done() {
@@ -17,11 +17,16 @@
 #ifndef SIMULATION_H_
 #define SIMULATION_H_
 
+#include "Timing.h"
 #include "mpi/Communicator.h"
 #include <memory>
 #include <string>
 
+class Geometry;
 namespace optimet {
+class CoefficientsFile;
+class Excitation;
+class Result;
 class Run;
 namespace solver {
 class AbstractSolver;
@@ -71,11 +76,37 @@ protected:
   void radius_scan(Run &run, std::shared_ptr<solver::AbstractSolver> solver);
   void radius_and_wavelength_scan(Run &run, std::shared_ptr<solver::AbstractSolver> solver);
   void coefficients(Run &run, std::shared_ptr<solver::AbstractSolver> solver);
+  //! \brief Solves the second harmonic problem from the fundamental frequency results
+  //! \details The solver is updated to the second harmonic problem. It should be updated back to
+  //! the fundamental frequency problem before being used again.
+  Result second_harmonic(Run const &run, std::shared_ptr<solver::AbstractSolver> solver,
+                         Result &result_FF);
+  //! \brief Solves for the coefficients of the fundamental frequency
+  //! \details Unless they can be restored from a coefficients file or the cache.
+  void solve(Run const &run, std::shared_ptr<solver::AbstractSolver> solver, Result &result);
+  //! \brief Reads solved coefficients from the input coefficients file or from the cache
+  //! \details Throws if restarting from a coefficients file which does not hold this solution.
+  bool restore(Run const &run, Geometry const &geometry, Excitation const &excitation,
+               std::string const &kind, Result &result) const;
+  //! \brief Solves with the current state of the solver
+  //! \details The convergence history, if any, is written to the output coefficients file, even
+  //! when the solve fails.
+  void run_solver(solver::AbstractSolver const &solver, Geometry const &geometry,
+                  Excitation const &excitation, std::string const &kind, Result &result) const;
+  //! Writes solved coefficients to the output coefficients file and to the cache
+  void store(Run const &run, Geometry const &geometry, Excitation const &excitation,
+             std::string const &kind, Result const &result) const;
 
 private:
   std::string caseFile; /**< Name of the case without extensions. */
   //! \details Fake if not compiled with MPI
   mpi::Communicator communicator_;
+  //! Coefficients to restart from, only opened on the root process
+  std::shared_ptr<CoefficientsFile> coefficients_input_;
+  //! Where to write the solved coefficients, only opened on the root process
+  std::shared_ptr<CoefficientsFile> coefficients_output_;
+  //! Time spent in each phase, step by step
+  timing::Report timings_;
 };
 }
 #endif /* SIMULATION_H_ */
@@ -19,6 +19,7 @@
 #include "ElectroMagnetic.h"
 #include "FMMBelosSolver.h"
 #include "MatrixBelosSolver.h"
+#include "PreconditionedMatrix.h"
 #include "PreconditionedMatrixSolver.h"
 #include "ScalapackSolver.h"
 #include "Scatterer.h"
@@ -27,35 +28,90 @@
 
 namespace optimet {
 namespace solver {
-std::shared_ptr<AbstractSolver> factory(Run const &run) {
+char const *name(Kind kind) {
+  static char const *const names[] = {"eigen", "scalapack", "belos", "fmm"};
+  return names[static_cast<t_uint>(kind)];
+}
+
+Kind kind(Run const &run) {
 #ifndef OPTIMET_MPI
-  return std::make_shared<PreconditionedMatrix>(run);
+  (void)run;
+  return Kind::eigen;
 #elif defined(OPTIMET_SCALAPACK) && !defined(OPTIMET_BELOS)
   if(run.do_fmm)
     throw std::runtime_error("Scalapack and Fast Matrix Multiplication are not compatible");
-  return std::make_shared<Scalapack>(run);
+  return Kind::scalapack;
 #elif defined(OPTIMET_BELOS) && defined(OPTIMET_SCALAPACK)
   if((run.belos_params()->get<std::string>("Solver") == "scalapack" or
       run.belos_params()->get<std::string>("Solver") == "eigen") and
      run.do_fmm)
     throw std::runtime_error("Cannot run FMM with scalapack or eigen solver");
   if(run.belos_params()->get<std::string>("Solver") == "eigen")
-    return std::make_shared<PreconditionedMatrix>(run);
+    return Kind::eigen;
   if(run.belos_params()->get<std::string>("Solver") == "scalapack")
-    return std::make_shared<Scalapack>(run);
+    return Kind::scalapack;
   if(run.do_fmm)
-    return std::make_shared<FMMBelos>(run);
-  return std::make_shared<MatrixBelos>(run);
+    return Kind::fmm;
+  return Kind::belos;
 #elif defined(OPTIMET_BELOS)
   if(run.belos_params()->get<std::string>("Solver") == "scalapack")
     throw std::runtime_error("Optimet was not compiled with scalapack");
   if(not run.do_fmm)
     throw std::runtime_error("Optimet was not compiled with scalapack, please choose FMM matrix");
-  return std::make_shared<FMMBelos>(run);
+  return Kind::fmm;
 #else
 #error Need at least Belos to run MPI solvers
 #endif
 }
+
+std::vector<Kind> available() {
+#ifndef OPTIMET_MPI
+  return {Kind::eigen};
+#elif defined(OPTIMET_SCALAPACK) && defined(OPTIMET_BELOS)
+  return {Kind::eigen, Kind::scalapack, Kind::belos, Kind::fmm};
+#elif defined(OPTIMET_SCALAPACK)
+  return {Kind::scalapack};
+#else
+  return {Kind::fmm};
+#endif
+}
+
+std::shared_ptr<AbstractSolver> factory(Run const &run) {
+  switch(kind(run)) {
+#if defined(OPTIMET_MPI) && defined(OPTIMET_SCALAPACK)
+  case Kind::scalapack:
+    return std::make_shared<Scalapack>(run);
+#endif
+#if defined(OPTIMET_MPI) && defined(OPTIMET_BELOS) && defined(OPTIMET_SCALAPACK)
+  case Kind::belos:
+    return std::make_shared<MatrixBelos>(run);
+#endif
+#if defined(OPTIMET_MPI) && defined(OPTIMET_BELOS)
+  case Kind::fmm:
+    return std::make_shared<FMMBelos>(run);
+#endif
+  default:
+    return std::make_shared<PreconditionedMatrix>(run);
+  }
+}
+
+Vector<t_complex> AbstractSolver::sources(t_uint first, t_uint last) const {
+  if(not is_second_harmonic())
+    return source_vector(geometry->objects.begin() + first, geometry->objects.begin() + last,
+                         incWave);
+  if(last > geometry->objects.size() or first > last)
+    throw std::out_of_range("Range of objects is out of bounds");
+  auto const n = 2 * geometry->nMax() * (geometry->nMax() + 2);
+  if(static_cast<t_uint>(sources_.size()) != n * geometry->objects.size())
+    throw std::runtime_error("Second harmonic sources do not match the geometry");
+  return sources_.segment(first * n, (last - first) * n);
+}
+
+Vector<t_complex> AbstractSolver::sources() const {
+  if(not is_second_harmonic())
+    return source_vector(*geometry, incWave);
+  return sources(0, geometry->objects.size());
+}
 } // namespace solver
 
 Vector<t_complex> convertInternal(Vector<t_complex> const &scattered, t_real const &omega,
@@ -65,8 +121,8 @@ Vector<t_complex> convertInternal(Vector<t_complex> const &scattered, t_real con
   size_t i = 0;
   for(auto const &object : objects) {
     auto const N = 2 * object.nMax * (object.nMax + 2);
-    result.segment(i, N).array() =
-        scattered.segment(i, N).array() * object.getIaux(omega, bground).array();
+    multiply_by_degree(object.getIauxDegrees(omega, bground), scattered.segment(i, N),
+                       result.segment(i, N));
     i += N;
   }
   return result;
@@ -79,8 +135,8 @@ Vector<t_complex> convertIndirect(Vector<t_complex> const &scattered, t_real con
   size_t i(0);
   for(auto const &object : objects) {
     auto const N = 2 * object.nMax * (object.nMax + 2);
-    result.segment(i, N) =
-        object.getTLocal(omega, bground).array() * scattered.segment(i, N).array();
+    multiply_by_degree(object.getTLocalDegrees(omega, bground), scattered.segment(i, N),
+                       result.segment(i, N));
     i += N;
   }
   return result;
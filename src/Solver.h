@@ -17,9 +17,11 @@
 #ifndef SOLVER_H_
 #define SOLVER_H_
 
+#include "Convergence.h"
 #include "Coupling.h"
 #include "Excitation.h"
 #include "Geometry.h"
+#include "OperatorCache.h"
 #include "Result.h"
 #include "Run.h"
 #include "Types.h"
@@ -31,6 +33,7 @@
 #include <complex>
 #include <exception>
 #include <memory>
+#include <vector>
 
 #ifdef OPTIMET_BELOS
 #include <Teuchos_ParameterList.hpp>
@@ -55,9 +58,12 @@ public:
    * @param method_ the solver method to be used.
    */
   AbstractSolver(std::shared_ptr<Geometry> geometry, std::shared_ptr<Excitation const> incWave,
-                 mpi::Communicator const &communicator = mpi::Communicator())
-      : geometry(geometry), incWave(incWave), communicator_(communicator), nMax(0) {}
-  AbstractSolver(Run const &run) : AbstractSolver(run.geometry, run.excitation, run.communicator) {}
+                 mpi::Communicator const &communicator = mpi::Communicator(),
+                 OperatorCache const &cache = OperatorCache())
+      : geometry(geometry), incWave(incWave), communicator_(communicator), nMax(0),
+        cache_(cache) {}
+  AbstractSolver(Run const &run)
+      : AbstractSolver(run.geometry, run.excitation, run.communicator, run.cache) {}
 
   ~AbstractSolver(){};
 
@@ -79,6 +85,24 @@ public:
   update(std::shared_ptr<Geometry> geometry_, std::shared_ptr<Excitation const> incWave_) {
     geometry = geometry_;
     incWave = incWave_;
+    sources_ = Vector<t_complex>::Zero(0);
+    update();
+  }
+  /**
+   * Update to a second harmonic problem.
+   * The right-hand side is given by the second harmonic sources rather than by
+   * the incident field. The scatterers should be at the same positions as in
+   * the current problem, so that solvers may reuse geometry-only data.
+   * @param geometry_ the geometry at the second harmonic frequency.
+   * @param incWave_ the excitation at the second harmonic frequency.
+   * @param sources the translated second harmonic sources of all objects.
+   */
+  virtual void update(std::shared_ptr<Geometry> geometry_,
+                      std::shared_ptr<Excitation const> incWave_,
+                      Vector<t_complex> const &sources) {
+    geometry = geometry_;
+    incWave = incWave_;
+    sources_ = sources;
     update();
   }
   void update(Run const &run) { return update(run.geometry, run.excitation); }
@@ -105,14 +129,47 @@ public:
   }
 
   mpi::Communicator const &communicator() const { return communicator_; }
+  //! Precomputed operators stored on disk
+  OperatorCache const &cache() const { return cache_; }
+
+  //! True if solving for second harmonic sources rather than an incident field
+  bool is_second_harmonic() const { return sources_.size() != 0; }
+
+  //! Iterations of the last solve, empty for direct solvers
+  ConvergenceHistory const &convergence() const { return convergence_; }
 
 protected:
   std::shared_ptr<Geometry> geometry;        /**< Pointer to the geometry. */
   std::shared_ptr<Excitation const> incWave; /**< Pointer to the incoming excitation. */
   mpi::Communicator communicator_;
   t_uint nMax;
+  //! Second harmonic sources, empty when solving for the incident field
+  Vector<t_complex> sources_;
+  //! Precomputed operators stored on disk
+  OperatorCache cache_;
+  //! Iterations of the last solve, recorded by iterative solvers
+  mutable ConvergenceHistory convergence_;
+
+  //! Right-hand side of objects in [first, last): incident field or second harmonic sources
+  Vector<t_complex> sources(t_uint first, t_uint last) const;
+  //! Right-hand side for all objects
+  Vector<t_complex> sources() const;
 };
 
+//! Solvers the factory can create
+enum class Kind : t_uint {
+  eigen,     //!< Full matrix on each process, solved with Eigen
+  scalapack, //!< Distributed matrix, solved with Scalapack
+  belos,     //!< Distributed matrix, solved iteratively with Belos
+  fmm        //!< Fast matrix multiplication, solved iteratively with Belos
+};
+//! Name of a solver, as it appears in reports
+char const *name(Kind kind);
+//! \brief Solver created by the factory for a given run
+//! \details Throws if the run requests a solver that is not available in this build.
+Kind kind(Run const &run);
+//! Solvers the factory can create in this build
+std::vector<Kind> available();
 //! A factory function for solvers
 std::shared_ptr<AbstractSolver> factory(Run const &run);
 }
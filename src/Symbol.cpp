@@ -17,6 +17,9 @@
 #include "Symbol.h"
 
 #include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
 #include "constants.h"
 #include "Bessel.h"
 #include "CompoundIterator.h"
@@ -134,187 +137,167 @@ double C_11m1(int J1, int M1, int J2, int M2, int J, int M) {
               std::sqrt((J + 1) / (2.0 * J + 1.0)));
 }
 
-// A numbers
-std::complex<double> A_0(int n, double R, const std::complex<double> &waveK_i,
-                         const std::complex<double> &cmn_1) {
-  std::vector<std::complex<double>> data, ddata;
-  std::tie(data, ddata) = bessel<Hankel1, false>(R * waveK_i, n);
+double W(int L1, int J1, int M1, int L2, int J2, int M2, int L, int M) {
+  return std::pow(-1.0, J2 + L1 + L) *
+         std::sqrt((2.0 * J1 + 1.0) * (2.0 * J2 + 1.0) * (2.0 * L1 + 1.0) *
+                   (2.0 * L2 + 1.0) / (4 / consPi / (2.0 * L + 1))) *
+         Wigner6j(L1, L2, L, J2, J1, 1) * CleGor(L, 0, L1, 0, L2, 0) *
+         CleGor(L, M, J1, M1, J2, M2);
+}
 
-  return data[n] * cmn_1;
+// Combination of W numbers multiplying A_m1 * A_m1 in upp_mn
+double g_W(int p, int mp, int q, int mq, int n, int m) {
+  return std::sqrt(p / (2.0 * p + 1.0)) * std::sqrt(q / (2.0 * q + 1.0)) *
+             W(p - 1, p, mp, q - 1, q, mq, n, m) +
+         std::sqrt((p + 1) / (2.0 * p + 1.0)) *
+             std::sqrt((q + 1) / (2.0 * q + 1.0)) *
+             W(p + 1, p, mp, q + 1, q, mq, n, m) -
+         std::sqrt(p / (2.0 * p + 1.0)) * std::sqrt((q + 1) / (2.0 * q + 1.0)) *
+             W(p - 1, p, mp, q + 1, q, mq, n, m) -
+         std::sqrt((p + 1) / (2.0 * p + 1.0)) * std::sqrt(q / (2.0 * q + 1.0)) *
+             W(p + 1, p, mp, q - 1, q, mq, n, m);
 }
 
-std::complex<double> A_1(int n, double R, const std::complex<double> &waveK_i,
-                         const std::complex<double> &dmn_1) {
-  std::vector<std::complex<double>> data, ddata;
-  std::tie(data, ddata) = bessel<Hankel1, false>(R * waveK_i, n);
-  // to be double checked - d/dr(J(kr))
-  return std::complex<double>(0.0, 1.0) * (1.0 / waveK_i) *
-         (waveK_i * ddata[n] + data[n] / R) * dmn_1;
+// Combination of W numbers multiplying A_1 * A_1 in upp_mn
+double f_W(int p, int mp, int q, int mq, int n, int m) {
+  return std::sqrt((p + 1) / (2.0 * p + 1.0)) *
+             std::sqrt((q + 1) / (2.0 * q + 1.0)) *
+             W(p - 1, p, mp, q - 1, q, mq, n, m) +
+         std::sqrt(p / (2.0 * p + 1.0)) * std::sqrt(q / (2.0 * q + 1.0)) *
+             W(p + 1, p, mp, q + 1, q, mq, n, m) -
+         std::sqrt((p + 1) / (2.0 * p + 1.0)) * std::sqrt(q / (2.0 * q + 1.0)) *
+             W(p - 1, p, mp, q + 1, q, mq, n, m) -
+         std::sqrt(p / (2.0 * p + 1.0)) * std::sqrt((q + 1) / (2.0 * q + 1.0)) *
+             W(p + 1, p, mp, q - 1, q, mq, n, m);
+}
+
+// Combination of W numbers multiplying A_1 * A_0 in upp_mn
+double f10_W(int p, int mp, int q, int mq, int n, int m) {
+  return std::sqrt((p + 1) / (2.0 * p + 1.0)) *
+             W(p - 1, p, mp, q, q, mq, n, m) +
+         std::sqrt(p / (2.0 * p + 1.0)) * W(p + 1, p, mp, q, q, mq, n, m);
+}
+
+// Combination of W numbers multiplying A_0 * A_1 in upp_mn
+double f01_W(int p, int mp, int q, int mq, int n, int m) {
+  return std::sqrt((p + 1) / (2.0 * p + 1.0)) *
+             W(p, p, mp, q - 1, q, mq, n, m) +
+         std::sqrt(q / (2.0 * p + 1.0)) * W(p, p, mp, q + 1, q, mq, n, m);
 }
 
-std::complex<double> A_m1(int n, double R, const std::complex<double> &waveK_i,
-                          const std::complex<double> &dmn_1) {
+// Radial parts of the A numbers, for all degrees up to nMax.
+// A_0 = a0[n] * cmn_1, A_1 = a1[n] * dmn_1 and A_m1 = am1[n] * dmn_1.
+struct RadialFactors {
+  std::vector<std::complex<double>> a0, a1, am1;
+};
+
+RadialFactors radial_factors(int nMax, double R,
+                             const std::complex<double> &waveK_i) {
   std::vector<std::complex<double>> data, ddata;
-  std::tie(data, ddata) = bessel<Hankel1, false>(R * waveK_i, n);
+  std::tie(data, ddata) = bessel<Hankel1, false>(R * waveK_i, nMax);
+
+  RadialFactors result;
+  result.a0.resize(nMax + 1);
+  result.a1.resize(nMax + 1);
+  result.am1.resize(nMax + 1);
+  for (int n = 0; n <= nMax; ++n) {
+    result.a0[n] = data[n];
+    // to be double checked - d/dr(J(kr))
+    result.a1[n] = std::complex<double>(0.0, 1.0) * (1.0 / waveK_i) *
+                   (waveK_i * ddata[n] + data[n] / R);
+    result.am1[n] = std::complex<double>(0.0, 1.0) * std::sqrt(n * (n + 1.0)) *
+                    (1.0 / waveK_i / R) * data[n];
+  }
+  return result;
+}
 
-  return std::complex<double>(0.0, 1.0) * std::sqrt(n * (n + 1.0)) *
-         (1.0 / waveK_i / R) * data[n] * dmn_1;
+// Sum over the couplings of a single output harmonic in up_mn
+std::complex<double> up_sum(CouplingTable::const_iterator entry,
+                            CouplingTable::const_iterator const &end,
+                            RadialFactors const &A,
+                            const std::complex<double> &cmn_1,
+                            const std::complex<double> &dmn_1) {
+  std::complex<double> sum(0.0, 0.0);
+  for (; entry != end; ++entry)
+    sum += A.a1[entry->np] * dmn_1 * A.am1[entry->nq] * dmn_1 * entry->c10m1 +
+           A.a0[entry->np] * cmn_1 * A.am1[entry->nq] * dmn_1 * entry->c11m1;
+  return sum;
 }
 
-double W(int L1, int J1, int M1, int L2, int J2, int M2, int L, int M) {
-  return std::pow(-1.0, J2 + L1 + L) *
-         std::sqrt((2.0 * J1 + 1.0) * (2.0 * J2 + 1.0) * (2.0 * L1 + 1.0) *
-                   (2.0 * L2 + 1.0) / (4 / consPi / (2.0 * L + 1))) *
-         Wigner6j(L1, L2, L, J2, J1, 1) * CleGor(L, 0, L1, 0, L2, 0) *
-         CleGor(L, M, J1, M1, J2, M2);
+// Sum over the couplings of a single output harmonic in vp_mn
+std::complex<double> vp_sum(CouplingTable::const_iterator entry,
+                            CouplingTable::const_iterator const &end,
+                            RadialFactors const &A,
+                            const std::complex<double> &cmn_1,
+                            const std::complex<double> &dmn_1) {
+  std::complex<double> sum(0.0, 0.0);
+  for (; entry != end; ++entry)
+    sum += A.a1[entry->np] * dmn_1 * A.am1[entry->nq] * dmn_1 * entry->c00m1 +
+           A.a0[entry->np] * cmn_1 * A.am1[entry->nq] * dmn_1 * entry->c01m1;
+  return sum;
 }
 
-} // namespace
+// Sums over the couplings of a single output harmonic in upp_mn
+std::pair<std::complex<double>, std::complex<double>>
+upp_sums(CouplingTable::const_iterator entry,
+         CouplingTable::const_iterator const &end, RadialFactors const &A,
+         const std::complex<double> &cmn_1, const std::complex<double> &dmn_1) {
+  std::complex<double> gmn(0.0, 0.0);
+  std::complex<double> fmn(0.0, 0.0);
+  for (; entry != end; ++entry) {
+    auto const A_0p = A.a0[entry->np] * cmn_1;
+    auto const A_0q = A.a0[entry->nq] * cmn_1;
+    auto const A_1p = A.a1[entry->np] * dmn_1;
+    auto const A_1q = A.a1[entry->nq] * dmn_1;
+    gmn += A.am1[entry->np] * dmn_1 * A.am1[entry->nq] * dmn_1 * entry->g;
+    fmn += A_1p * A_1q *
+           (entry->f + A_0p * A_0q * entry->f00 + A_1p * A_0q * entry->f10 +
+            A_0p * A_1q * entry->f01);
+  }
+  return {gmn, fmn};
+}
 
-// In what follows, need to devise CompoundIterator to start from n=0.
-// otherwise, use double for loops
+// Wavenumber of the fundamental frequency inside the sphere
+std::complex<double> fundamental_wavenumber(double omega,
+                                            const Scatterer &object) {
+  return (omega / 2.0) * std::sqrt(object.elmag.epsilon * object.elmag.mu);
+}
 
-std::complex<double> up_mn(int m, int n, int nMax,
-                           const std::complex<double> &cmn_1,
-                           const std::complex<double> &dmn_1, double omega,
-                           const Scatterer &object,
-                           const ElectroMagnetic &bground) {
-  // Basic relations
-  const double R = object.radius;
+// Factor multiplying the sum in up_mn
+std::complex<double> up_prefactor(const Scatterer &object,
+                                  const ElectroMagnetic &bground) {
   const std::complex<double> mu_0 = consMu0;
   const std::complex<double> mu_b = bground.mu;
   const std::complex<double> eps_b = bground.epsilon;
-  // SH Basic relations
   const std::complex<double> b_non = object.elmag.b_SH;
-
-  // Auxiliary variables
-  const std::complex<double> waveK_j1 =
-      (omega / 2.0) * std::sqrt(object.elmag.epsilon * object.elmag.mu);
-  std::complex<double> sum(0.0, 0.0);
-
-  for (CompoundIterator p(nMax, nMax); p < p.max(nMax); ++p) {
-    for (CompoundIterator q(nMax, nMax); q < q.max(nMax); ++q)
-      sum +=
-          A_1(p.first, R, waveK_j1, dmn_1) * A_m1(q.first, R, waveK_j1, dmn_1) *
-              C_10m1(p.first, p.second, q.first, q.second, n, m) +
-          A_0(p.first, R, waveK_j1, cmn_1) * A_m1(q.first, R, waveK_j1, dmn_1) *
-              C_11m1(p.first, p.second, q.first, q.second, n, m);
-  }
-
-  return sum * std::complex<double>(0.0, 1.0) * (-b_non / 2.0) *
+  return std::complex<double>(0.0, 1.0) * (-b_non / 2.0) *
          std::sqrt(mu_b / eps_b) / std::sqrt(mu_0 / eps_b);
 }
 
-std::complex<double> vp_mn(int m, int n, int nMax,
-                           const std::complex<double> &cmn_1,
-                           const std::complex<double> &dmn_1, double omega,
-                           const Scatterer &object,
-                           const ElectroMagnetic &bground) {
-  // Basic relations
-  const double R = object.radius;
+// Factor multiplying the sum in vp_mn
+std::complex<double> vp_prefactor(const Scatterer &object,
+                                  const ElectroMagnetic &bground) {
   const std::complex<double> mu_0 = consMu0;
   const std::complex<double> eps_0 = consEpsilon0;
   const std::complex<double> mu_b = bground.mu;
   const std::complex<double> eps_b = bground.epsilon;
-  // SH Basic relations
   const std::complex<double> b_non = object.elmag.b_SH;
-
-  // Auxiliary variables
-  const std::complex<double> waveK_j1 =
-      (omega / 2.0) * std::sqrt(object.elmag.epsilon * object.elmag.mu);
-
-  std::complex<double> sum(0.0, 0.0);
-  for (CompoundIterator p(nMax, nMax); p < p.max(nMax); ++p) {
-    for (CompoundIterator q(nMax, nMax); q < q.max(nMax); ++q)
-      sum +=
-          A_1(p.first, R, waveK_j1, dmn_1) * A_m1(q.first, R, waveK_j1, dmn_1) *
-              C_00m1(p.first, p.second, q.first, q.second, n, m) +
-          A_0(p.first, R, waveK_j1, cmn_1) * A_m1(q.first, R, waveK_j1, dmn_1) *
-              C_01m1(p.first, p.second, q.first, q.second, n, m);
-  }
-  return sum * std::complex<double>(-2.0, 0.0) * (-b_non / 2.0) *
+  return std::complex<double>(-2.0, 0.0) * (-b_non / 2.0) *
          std::sqrt(mu_b / eps_b) / std::sqrt(mu_0 / eps_0);
 }
 
-std::complex<double> upp_mn(int m, int n, int nMax,
-                            const std::complex<double> &cmn_1,
-                            const std::complex<double> &dmn_1, double omega,
-                            const Scatterer &object) {
-
-  // Basic relations
+// Combines the sums of upp_mn into the final coefficient
+std::complex<double>
+upp_combine(int n, std::pair<std::complex<double>, std::complex<double>> const &sums,
+            double omega, const Scatterer &object) {
   const double R = object.radius;
   const std::complex<double> eps_0 = consEpsilon0;
-  const std::complex<double> mu_j = object.elmag.mu;
-  const std::complex<double> eps_j = object.elmag.epsilon;
-  // SH Basic relations
   const std::complex<double> a_non = object.elmag.a_SH;
   const std::complex<double> d_non = object.elmag.d_SH;
   const std::complex<double> eps_j2 = object.elmag.epsilon_SH;
-
-  // Auxiliary variables
-  const std::complex<double> waveK_01 = (omega / 2.0) * std::sqrt(eps_j * mu_j);
-  const std::complex<double> waveK_j1 = (omega / 2.0) * std::sqrt(eps_j * mu_j);
-
-  std::complex<double> gmn(0.0, 0.0);
-  std::complex<double> fmn(0.0, 0.0);
-
-  for (CompoundIterator p(nMax, nMax); p < p.max(nMax); ++p) {
-    for (CompoundIterator q(nMax, nMax); q < q.max(nMax); ++q) {
-      gmn += A_m1(p.first, R, waveK_j1, dmn_1) *
-             A_m1(q.first, R, waveK_j1, dmn_1) *
-             (std::sqrt(p.first / (2.0 * p.first + 1.0)) *
-                  std::sqrt(q.first / (2.0 * q.first + 1.0)) *
-                  W(p.first - 1, p.first, p.second, q.first - 1, q.first,
-                    q.second, n, m) +
-              std::sqrt((p.first + 1) / (2.0 * p.first + 1.0)) *
-                  std::sqrt((q.first + 1) / (2.0 * q.first + 1.0)) *
-                  W(p.first + 1, p.first, p.second, q.first + 1, q.first,
-                    q.second, n, m) -
-              std::sqrt(p.first / (2.0 * p.first + 1.0)) *
-                  std::sqrt((q.first + 1) / (2.0 * q.first + 1.0)) *
-                  W(p.first - 1, p.first, p.second, q.first + 1, q.first,
-                    q.second, n, m) -
-              std::sqrt((p.first + 1) / (2.0 * p.first + 1.0)) *
-                  std::sqrt(q.first / (2.0 * q.first + 1.0)) *
-                  W(p.first + 1, p.first, p.second, q.first - 1, q.first,
-                    q.second, n, m));
-
-      fmn +=
-          A_1(p.first, R, waveK_j1, dmn_1) * A_1(q.first, R, waveK_j1, dmn_1) *
-          (std::sqrt((p.first + 1) / (2.0 * p.first + 1.0)) *
-               std::sqrt((q.first + 1) / (2.0 * q.first + 1.0)) *
-               W(p.first - 1, p.first, p.second, q.first - 1, q.first, q.second,
-                 n, m) +
-           std::sqrt(p.first / (2.0 * p.first + 1.0)) *
-               std::sqrt(q.first / (2.0 * q.first + 1.0)) *
-               W(p.first + 1, p.first, p.second, q.first + 1, q.first, q.second,
-                 n, m) -
-           std::sqrt((p.first + 1) / (2.0 * p.first + 1.0)) *
-               std::sqrt(q.first / (2.0 * q.first + 1.0)) *
-               W(p.first - 1, p.first, p.second, q.first + 1, q.first, q.second,
-                 n, m) -
-           std::sqrt(p.first / (2.0 * p.first + 1.0)) *
-               std::sqrt((q.first + 1) / (2.0 * q.first + 1.0)) *
-               W(p.first + 1, p.first, p.second, q.first - 1, q.first, q.second,
-                 n, m) +
-           A_0(p.first, R, waveK_j1, cmn_1) * A_0(q.first, R, waveK_j1, cmn_1) *
-               W(p.first, p.first, p.second, q.first, q.first, q.second, n, m) +
-           A_1(p.first, R, waveK_j1, dmn_1) * A_0(q.first, R, waveK_j1, cmn_1) *
-               (std::sqrt((p.first + 1) / (2.0 * p.first + 1.0)) *
-                    W(p.first - 1, p.first, p.second, q.first, q.first,
-                      q.second, n, m) +
-                std::sqrt(p.first / (2.0 * p.first + 1.0)) *
-                    W(p.first + 1, p.first, p.second, q.first, q.first,
-                      q.second, n, m)) +
-           A_0(p.first, R, waveK_j1, cmn_1) * A_1(q.first, R, waveK_j1, dmn_1) *
-               (std::sqrt((p.first + 1) / (2.0 * p.first + 1.0)) *
-                    W(p.first, p.first, p.second, q.first - 1, q.first,
-                      q.second, n, m) +
-                std::sqrt(q.first / (2.0 * p.first + 1.0)) *
-                    W(p.first, p.first, p.second, q.first + 1, q.first,
-                      q.second, n, m)));
-    }
-  }
+  const std::complex<double> waveK_01 = fundamental_wavenumber(omega, object);
+  auto const &gmn = sums.first;
+  auto const &fmn = sums.second;
 
   return std::complex<double>(0.0, 1.0) * (-a_non / 4.0) *
              std::sqrt(n * (n + 1)) * gmn / waveK_01 / R +
@@ -322,5 +305,124 @@ std::complex<double> upp_mn(int m, int n, int nMax,
              std::sqrt(n * (n + 1)) * (gmn + fmn) / waveK_01 / R;
 }
 
+} // namespace
+
+CouplingTable::CouplingTable(t_int nMax) : nMax_(nMax) {
+  offsets_.reserve(CompoundIterator::max(nMax) + 1);
+  offsets_.push_back(0);
+  for (CompoundIterator k(0); k < k.max(nMax); ++k) {
+    int const n = k.first, m = k.second;
+    // In what follows, need to devise CompoundIterator to start from n=0.
+    // otherwise, use double for loops
+    for (CompoundIterator p(nMax, nMax); p < p.max(nMax); ++p)
+      for (CompoundIterator q(nMax, nMax); q < q.max(nMax); ++q) {
+        // Selection rules of the Clebsch-Gordan coefficient common to all terms
+        if (p.second + q.second != m or n < std::abs(p.first - q.first) or
+            n > p.first + q.first)
+          continue;
+        Entry const entry{
+            p.compound,
+            q.compound,
+            p.first,
+            q.first,
+            C_10m1(p.first, p.second, q.first, q.second, n, m),
+            C_11m1(p.first, p.second, q.first, q.second, n, m),
+            C_00m1(p.first, p.second, q.first, q.second, n, m),
+            C_01m1(p.first, p.second, q.first, q.second, n, m),
+            g_W(p.first, p.second, q.first, q.second, n, m),
+            f_W(p.first, p.second, q.first, q.second, n, m),
+            W(p.first, p.first, p.second, q.first, q.first, q.second, n, m),
+            f10_W(p.first, p.second, q.first, q.second, n, m),
+            f01_W(p.first, p.second, q.first, q.second, n, m)};
+        if (entry.c10m1 == 0 and entry.c11m1 == 0 and entry.c00m1 == 0 and
+            entry.c01m1 == 0 and entry.g == 0 and entry.f == 0 and
+            entry.f00 == 0 and entry.f10 == 0 and entry.f01 == 0)
+          continue;
+        entries_.push_back(entry);
+      }
+    offsets_.push_back(entries_.size());
+  }
+}
+
+std::shared_ptr<CouplingTable const> CouplingTable::get(t_int nMax) {
+  static std::map<t_int, std::shared_ptr<CouplingTable const>> cache;
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto const found = cache.find(nMax);
+  if (found != cache.end())
+    return found->second;
+  auto const result = std::make_shared<CouplingTable const>(nMax);
+  cache.emplace(nMax, result);
+  return result;
+}
+
+std::complex<double> up_mn(int m, int n, int nMax,
+                           const std::complex<double> &cmn_1,
+                           const std::complex<double> &dmn_1, double omega,
+                           const Scatterer &object,
+                           const ElectroMagnetic &bground) {
+  auto const table = CouplingTable::get(nMax);
+  auto const A = radial_factors(nMax, object.radius,
+                                fundamental_wavenumber(omega, object));
+  return up_sum(table->begin(n, m), table->end(n, m), A, cmn_1, dmn_1) *
+         up_prefactor(object, bground);
+}
+
+std::complex<double> vp_mn(int m, int n, int nMax,
+                           const std::complex<double> &cmn_1,
+                           const std::complex<double> &dmn_1, double omega,
+                           const Scatterer &object,
+                           const ElectroMagnetic &bground) {
+  auto const table = CouplingTable::get(nMax);
+  auto const A = radial_factors(nMax, object.radius,
+                                fundamental_wavenumber(omega, object));
+  return vp_sum(table->begin(n, m), table->end(n, m), A, cmn_1, dmn_1) *
+         vp_prefactor(object, bground);
+}
+
+std::complex<double> upp_mn(int m, int n, int nMax,
+                            const std::complex<double> &cmn_1,
+                            const std::complex<double> &dmn_1, double omega,
+                            const Scatterer &object) {
+  auto const table = CouplingTable::get(nMax);
+  auto const A = radial_factors(nMax, object.radius,
+                                fundamental_wavenumber(omega, object));
+  return upp_combine(
+      n, upp_sums(table->begin(n, m), table->end(n, m), A, cmn_1, dmn_1),
+      omega, object);
+}
+
+SourceCoefficients
+source_coefficients(Vector<t_complex> const &internal_coef_FF, double omega,
+                    const Scatterer &object, const ElectroMagnetic &bground,
+                    int nMax) {
+  auto const pMax = CompoundIterator::max(nMax);
+  if (internal_coef_FF.size() != 2 * pMax)
+    throw std::runtime_error("Inconsistent number of internal coefficients");
+
+  // Everything that does not depend on the output harmonic is computed once
+  auto const table = CouplingTable::get(nMax);
+  auto const A = radial_factors(nMax, object.radius,
+                                fundamental_wavenumber(omega, object));
+  auto const up_factor = up_prefactor(object, bground);
+  auto const vp_factor = vp_prefactor(object, bground);
+
+  SourceCoefficients result;
+  result.up.resize(pMax);
+  result.vp.resize(pMax);
+  result.upp.resize(pMax);
+  for (CompoundIterator k(0); k < pMax; ++k) {
+    auto const &cmn_1 = internal_coef_FF(k.compound);
+    auto const &dmn_1 = internal_coef_FF(pMax + k.compound);
+    auto const first = table->begin(k.first, k.second);
+    auto const last = table->end(k.first, k.second);
+    result.up(k.compound) = up_sum(first, last, A, cmn_1, dmn_1) * up_factor;
+    result.vp(k.compound) = vp_sum(first, last, A, cmn_1, dmn_1) * vp_factor;
+    result.upp(k.compound) = upp_combine(
+        k.first, upp_sums(first, last, A, cmn_1, dmn_1), omega, object);
+  }
+  return result;
+}
+
 } // namespace symbol
 } // namespace optimet
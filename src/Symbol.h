@@ -23,8 +23,12 @@
 #ifndef OPTIMET_SYMBOL_H
 #define OPTIMET_SYMBOL_H
 
-#include "Scatterer.h"
+#include "CompoundIterator.h"
 #include "ElectroMagnetic.h"
+#include "Scatterer.h"
+#include "Types.h"
+#include <memory>
+#include <vector>
 
 namespace optimet {
 namespace symbol {
@@ -43,6 +47,59 @@ namespace symbol {
  */
 double Wigner3j(int j1, int j2, int j3, int m1, int m2, int m3);
 
+/**
+ * Tabulated coupling coefficients of the second harmonic source terms.
+ * For each second harmonic output (n, m), only the pairs of fundamental
+ * harmonics (p, q) allowed by the selection rules m = m_p + m_q and
+ * |n_p - n_q| <= n <= n_p + n_q are stored. The table depends only on nMax: it
+ * is built once per nMax and shared read-only through CouplingTable::get.
+ */
+class CouplingTable {
+public:
+  //! Non-zero coupling between two fundamental harmonics and one SH harmonic
+  struct Entry {
+    //! Flat indices of the fundamental harmonics
+    t_int p, q;
+    //! Degrees of the fundamental harmonics
+    t_int np, nq;
+    //! C numbers entering up_mn and vp_mn
+    t_real c10m1, c11m1, c00m1, c01m1;
+    //! Combinations of W numbers entering upp_mn
+    t_real g, f, f00, f10, f01;
+  };
+  typedef std::vector<Entry>::const_iterator const_iterator;
+
+  /**
+   * Computes all the coupling coefficients for a given nMax.
+   * @param nMax the maximum value of the n iterator.
+   */
+  CouplingTable(t_int nMax);
+
+  //! Maximum degree of the harmonics
+  t_int nMax() const { return nMax_; }
+  //! Number of non-zero entries over all outputs
+  t_uint size() const { return entries_.size(); }
+  //! First entry contributing to output harmonic (n, m)
+  const_iterator begin(t_int n, t_int m) const {
+    return entries_.begin() + offsets_[flatten_indices(n, m)];
+  }
+  //! End of the entries contributing to output harmonic (n, m)
+  const_iterator end(t_int n, t_int m) const {
+    return entries_.begin() + offsets_[flatten_indices(n, m) + 1];
+  }
+
+  //! Table for a given nMax, computed on first request and cached afterwards
+  static std::shared_ptr<CouplingTable const> get(t_int nMax);
+
+private:
+  //! Maximum degree of the harmonics
+  t_int nMax_;
+  //! Non-zero entries, grouped by output harmonic
+  std::vector<Entry> entries_;
+  //! Offsets of each output harmonic into entries_
+  std::vector<t_uint> offsets_;
+};
+
 std::complex<double> up_mn(int m, int n, int nMax,
                            const std::complex<double> &cmn_1,
                            const std::complex<double> &dmn_1, double omega,
@@ -60,6 +117,34 @@ std::complex<double> upp_mn(int m, int n, int nMax,
                             const std::complex<double> &dmn_1, double omega,
                             const Scatterer &object);
 
+//! Second harmonic source coefficients u', v' and u'' of a single sphere
+struct SourceCoefficients {
+  //! Multiplies the U auxiliary sources in the TE source terms
+  Vector<t_complex> up;
+  //! Multiplies the V auxiliary sources in the TE source terms
+  Vector<t_complex> vp;
+  //! Multiplies the U auxiliary sources in the TM source terms
+  Vector<t_complex> upp;
+};
+
+/**
+ * Computes up_mn, vp_mn and upp_mn for all harmonics of one sphere in a single
+ * sweep over the coupling table. The radial factors and prefactors are
+ * evaluated once for the sphere rather than once per harmonic.
+ * @param internal_coef_FF internal coefficients of the sphere at the
+ * fundamental frequency, TE then TM, up to degree nMax.
+ * @param omega the angular frequency of the second harmonic, i.e. twice that of
+ * the fundamental.
+ * @param object the sphere.
+ * @param bground the background medium.
+ * @param nMax the maximum value of the n iterator.
+ * @return up_mn, vp_mn and upp_mn indexed by the flat harmonic index.
+ */
+SourceCoefficients
+source_coefficients(Vector<t_complex> const &internal_coef_FF, double omega,
+                    const Scatterer &object, const ElectroMagnetic &bground,
+                    int nMax);
+
 } // namespace symbol
 } // namespace optimet
 
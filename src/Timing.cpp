@@ -0,0 +1,107 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Timing.h"
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+
+namespace optimet {
+namespace timing {
+namespace {
+constexpr t_uint nphases = static_cast<t_uint>(Phase::size);
+//! Time spent in each phase on this process
+std::array<t_real, nphases> times = {{}};
+//! Number of calls to each phase on this process
+std::array<t_uint, nphases> counts = {{}};
+
+//! Escapes a label for use inside a JSON string
+std::string escape(std::string const &label) {
+  std::ostringstream sstr;
+  for(auto const c : label) {
+    if(c == '"' or c == '\\')
+      sstr << '\\' << c;
+    else if(static_cast<unsigned char>(c) < 0x20)
+      sstr << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+           << std::dec;
+    else
+      sstr << c;
+  }
+  return sstr.str();
+}
+} // namespace
+
+char const *name(Phase phase) {
+  static char const *const names[nphases] = {
+      "input",  "validation", "t_matrix",   "rotations",     "translations", "sources",
+      "solve",  "matvec",     "iterations", "communication", "fields",       "output"};
+  return names[static_cast<t_uint>(phase)];
+}
+
+void add(Phase phase, t_real seconds, t_uint count) {
+  times[static_cast<t_uint>(phase)] += seconds;
+  counts[static_cast<t_uint>(phase)] += count;
+}
+
+void count(Phase phase, t_uint count) { counts[static_cast<t_uint>(phase)] += count; }
+
+t_real seconds(Phase phase) { return times[static_cast<t_uint>(phase)]; }
+
+t_uint calls(Phase phase) { return counts[static_cast<t_uint>(phase)]; }
+
+void reset() {
+  times.fill(0);
+  counts.fill(0);
+}
+
+void Report::step(std::string const &label, mpi::Communicator const &comm) {
+  Vector<t_real> const local = Vector<t_real>::Map(times.data(), nphases);
+  Vector<t_real> const ncalls_local = Vector<t_uint>::Map(counts.data(), nphases).cast<t_real>();
+#ifdef OPTIMET_MPI
+  auto const minimum = comm.all_reduce(local, MPI_MIN);
+  auto const maximum = comm.all_reduce(local, MPI_MAX);
+  auto const total = comm.all_reduce(local, MPI_SUM);
+  auto const ncalls = comm.all_reduce(ncalls_local, MPI_SUM);
+#else
+  auto const &minimum = local, &maximum = local, &total = local, &ncalls = ncalls_local;
+#endif
+  reset();
+
+  std::ostringstream sstr;
+  sstr << std::setprecision(6);
+  sstr << "    {\n      \"step\": \"" << escape(label) << "\",\n      \"phases\": {";
+  for(t_uint i(0), first(1); i < nphases; ++i) {
+    if(ncalls(i) == 0 and maximum(i) == 0)
+      continue;
+    sstr << (first ? "\n" : ",\n") << "        \"" << escape(name(static_cast<Phase>(i)))
+         << "\": {\"count\": " << static_cast<std::uint64_t>(ncalls(i))
+         << ", \"min\": " << minimum(i) << ", \"max\": " << maximum(i)
+         << ", \"mean\": " << total(i) / comm.size() << "}";
+    first = 0;
+  }
+  sstr << "\n      }\n    }";
+  steps_.push_back(sstr.str());
+}
+
+void Report::write(std::ostream &stream, mpi::Communicator const &comm) const {
+  stream << "{\n  \"nprocs\": " << comm.size() << ",\n  \"steps\": [";
+  for(std::size_t i(0); i < steps_.size(); ++i)
+    stream << (i == 0 ? "\n" : ",\n") << steps_[i];
+  stream << "\n  ]\n}\n";
+}
+} // namespace timing
+} // namespace optimet
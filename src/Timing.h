@@ -0,0 +1,93 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_TIMING_H
+#define OPTIMET_TIMING_H
+
+#include "Types.h"
+#include "mpi/Communicator.h"
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace optimet {
+namespace timing {
+//! \brief Phases of a simulation which are timed and counted
+//! \details Each phase accumulates time and a number of calls. Iterations only counts.
+enum class Phase : t_uint {
+  input,         //!< Reading and broadcasting the input
+  validation,    //!< Checking spheres do not overlap
+  t_matrix,      //!< Mie coefficients of the spheres
+  rotations,     //!< Rotation matrices of the FMM
+  translations,  //!< Coaxial translations of the FMM, or the full scattering matrix
+  sources,       //!< Incident and second harmonic source vectors
+  solve,         //!< Linear solves, including any matrix-vector products
+  matvec,        //!< Distributed FMM matrix-vector products, less their communication waits
+  iterations,    //!< Iterations of the iterative solvers
+  communication, //!< Waiting on MPI communications in the FMM
+  fields,        //!< Field evaluation on the output grid, including writing it
+  output,        //!< Writing coefficients to file
+  size           //!< Number of phases
+};
+//! Name of a phase, as it appears in reports
+char const *name(Phase phase);
+
+//! Adds time spent in a phase
+void add(Phase phase, t_real seconds, t_uint count = 1);
+//! Adds to the number of calls or iterations of a phase, without time
+void count(Phase phase, t_uint count = 1);
+//! Time spent in a phase since the last reset
+t_real seconds(Phase phase);
+//! Number of calls or iterations of a phase since the last reset
+t_uint calls(Phase phase);
+//! Sets all times and counts back to zero
+void reset();
+
+//! Adds the lifetime of this object to a phase
+class Timer {
+public:
+  Timer(Phase phase) : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+  Timer(Timer const &) = delete;
+  Timer &operator=(Timer const &) = delete;
+  ~Timer() {
+    std::chrono::duration<t_real> const elapsed = std::chrono::steady_clock::now() - start_;
+    add(phase_, elapsed.count());
+  }
+
+private:
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+//! \brief Times and counts of each phase of a run, step by step
+//! \details Each step records the phases since the previous step, aggregated over processes.
+class Report {
+public:
+  //! \brief Records the phases since the last step, then resets them
+  //! \details Collective over the communicator: time is reduced to its minimum, maximum and mean
+  //! over processes, and counts are summed.
+  void step(std::string const &label, mpi::Communicator const &comm);
+  //! Writes the report as JSON. Only meaningful on the root process.
+  void write(std::ostream &stream, mpi::Communicator const &comm) const;
+
+private:
+  //! Steps already formatted as JSON objects
+  std::vector<std::string> steps_;
+};
+} // namespace timing
+} // namespace optimet
+#endif
@@ -0,0 +1,103 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Traversal.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+
+namespace optimet {
+namespace traversal {
+namespace {
+//! Spreads the lower 21 bits of an integer, with two zero bits between each
+std::uint64_t spread_by_two(std::uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8) & 0x100f00f00f00f00full;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2) & 0x1249249249249249ull;
+  return x;
+}
+//! Spreads the lower 32 bits of an integer, with one zero bit between each
+std::uint64_t spread_by_one(std::uint64_t x) {
+  x &= 0xffffffffull;
+  x = (x | x << 16) & 0x0000ffff0000ffffull;
+  x = (x | x << 8) & 0x00ff00ff00ff00ffull;
+  x = (x | x << 4) & 0x0f0f0f0f0f0f0f0full;
+  x = (x | x << 2) & 0x3333333333333333ull;
+  x = (x | x << 1) & 0x5555555555555555ull;
+  return x;
+}
+}
+
+Pairs row_major(Matrix<bool> const &couplings) {
+  Pairs result;
+  for(t_int i(0); i < couplings.rows(); ++i)
+    for(t_int j(0); j < couplings.cols(); ++j)
+      if(couplings(i, j))
+        result.emplace_back(i, j);
+  return result;
+}
+
+std::vector<t_uint> morton_ranks(std::vector<Scatterer> const &scatterers) {
+  std::vector<t_uint> result(scatterers.size());
+  if(scatterers.size() == 0)
+    return result;
+
+  // quantizes positions within the bounding box
+  Eigen::Matrix<t_real, 3, Eigen::Dynamic> positions(3, scatterers.size());
+  for(std::size_t i(0); i < scatterers.size(); ++i)
+    positions.col(i) = scatterers[i].vR.toEigenCartesian();
+  Eigen::Matrix<t_real, 3, 1> const lower = positions.rowwise().minCoeff();
+  t_real const extent = (positions.rowwise().maxCoeff() - lower).maxCoeff();
+  t_real const scale = extent > 0 ? static_cast<t_real>(0x1fffff) / extent : 0;
+  std::vector<std::uint64_t> codes(scatterers.size());
+  for(std::size_t i(0); i < scatterers.size(); ++i) {
+    auto const x = ((positions.col(i) - lower) * scale).array().round().cast<std::uint64_t>();
+    codes[i] = spread_by_two(x(0)) | spread_by_two(x(1)) << 1 | spread_by_two(x(2)) << 2;
+  }
+
+  std::vector<t_uint> order(scatterers.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&codes](t_uint a, t_uint b) { return codes[a] < codes[b]; });
+  for(std::size_t i(0); i < order.size(); ++i)
+    result[order[i]] = i;
+  return result;
+}
+
+Pairs morton(std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings) {
+  if(couplings.rows() != static_cast<t_int>(scatterers.size()) or
+     couplings.cols() != static_cast<t_int>(scatterers.size()))
+    throw std::out_of_range("Size of couplings and scatterers do not match");
+  auto const ranks = morton_ranks(scatterers);
+  // both directions of a pair have the same key, and are ordered by output
+  auto const key = [&ranks](Pairs::value_type const &pair) {
+    auto const ranked = std::minmax(ranks[pair.first], ranks[pair.second]);
+    return std::make_pair(spread_by_one(ranked.second) << 1 | spread_by_one(ranked.first),
+                          ranks[pair.first]);
+  };
+  auto result = row_major(couplings);
+  std::sort(result.begin(), result.end(),
+            [&key](Pairs::value_type const &a, Pairs::value_type const &b) {
+              return key(a) < key(b);
+            });
+  return result;
+}
+} // namespace traversal
+} // namespace optimet
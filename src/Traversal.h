@@ -0,0 +1,46 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OPTIMET_TRAVERSAL_H
+#define OPTIMET_TRAVERSAL_H
+
+#include "Scatterer.h"
+#include "Types.h"
+#include <utility>
+#include <vector>
+
+namespace optimet {
+//! \brief Order in which the fast matrix multiplication visits pairs of particles
+//! \details Pairs are given as (output, input) particle indices.
+namespace traversal {
+//! Pairs of particles, `first` is the output and `second` the input
+typedef std::vector<std::pair<t_uint, t_uint>> Pairs;
+
+//! All the inputs of the first output, then all the inputs of the second output, and so on
+Pairs row_major(Matrix<bool> const &couplings);
+
+//! \brief Rank of each particle along a Morton (Z-order) curve through their positions
+//! \details Particles close in rank are close in space. Ties are broken by index.
+std::vector<t_uint> morton_ranks(std::vector<Scatterer> const &scatterers);
+
+//! \brief Pairs in Morton order of their output and input ranks
+//! \details The pairs are recursively tiled into blocks of nearby outputs and nearby inputs, so
+//! that consecutive pairs share particles and their coefficients stay in cache. The two directions
+//! of a pair are visited one after the other, since they apply the same operators.
+Pairs morton(std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings);
+} // namespace traversal
+} // namespace optimet
+#endif
@@ -109,6 +109,14 @@ public:
     MPI_Allreduce(&value, &result, 1, registered_type(value), operation, **this);
     return result;
   }
+  //! Reduces a vector element-wise over all processes
+  template <class T>
+  typename std::enable_if<is_registered_type<T>::value, Vector<T>>::type
+  all_reduce(Vector<T> const &values, MPI_Op operation) const {
+    Vector<T> result(values.size());
+    MPI_Allreduce(values.data(), result.data(), values.size(), Type<T>::value, operation, **this);
+    return result;
+  }
 
   void barrier() const { return optimet::mpi::barrier(*this); }
 
@@ -14,12 +14,36 @@
 // You should have received a copy of the GNU General Public License
 // along with Optimet. If not, see <http://www.gnu.org/licenses/>.
 
+#include "Timing.h"
 #include "Types.h"
 #include "mpi/FastMatrixMultiply.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
 namespace optimet {
 namespace mpi {
+namespace {
+//! Adds the lifetime of this object to the matvec phase, less the time spent waiting on messages
+class MatvecTimer {
+public:
+  MatvecTimer()
+      : start_(std::chrono::steady_clock::now()),
+        communication_(timing::seconds(timing::Phase::communication)) {}
+  MatvecTimer(MatvecTimer const &) = delete;
+  MatvecTimer &operator=(MatvecTimer const &) = delete;
+  ~MatvecTimer() {
+    std::chrono::duration<t_real> const elapsed = std::chrono::steady_clock::now() - start_;
+    auto const waiting = timing::seconds(timing::Phase::communication) - communication_;
+    timing::add(timing::Phase::matvec, std::max<t_real>(0, elapsed.count() - waiting));
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+  t_real communication_;
+};
+} // namespace
+
 namespace details {
 Matrix<bool> local_interactions(t_int nscatterers, t_int diagonal) {
   assert(nscatterers >= 0);
@@ -83,6 +107,7 @@ Vector<t_complex> FastMatrixMultiply::transpose(Vector<t_complex> const &in) con
 }
 
 void FastMatrixMultiply::operator()(Vector<t_complex> const &input, Vector<t_complex> &out) const {
+  MatvecTimer const timer;
   out.fill(0);
   /************* START FIRST COMMUNICATION **********/
   // first communicate input data to other processes
@@ -98,7 +123,10 @@ void FastMatrixMultiply::operator()(Vector<t_complex> const &input, Vector<t_com
   auto reduction_request =
       reduce_computation_.send(nl_computations, send_buffer, computation_buffer);
   // now we get the inputs from other processes
-  mpi::wait(std::move(distribute_request));
+  {
+    timing::Timer const timer(timing::Phase::communication);
+    mpi::wait(std::move(distribute_request));
+  }
   /************* FINISHED FIRST COMMUNICATION **********/
 
   // And synthesize the input for non-local fmm
@@ -110,7 +138,10 @@ void FastMatrixMultiply::operator()(Vector<t_complex> const &input, Vector<t_com
   reconstruct(nonlocal_indices_, nl_out, out);
 
   // we receive the stuff computed elsewhere
-  mpi::wait(std::move(reduction_request));
+  {
+    timing::Timer const timer(timing::Phase::communication);
+    mpi::wait(std::move(reduction_request));
+  }
   /************* FINISHED SECOND COMMUNICATION **********/
 
   // and reduce over all results
@@ -118,6 +149,7 @@ void FastMatrixMultiply::operator()(Vector<t_complex> const &input, Vector<t_com
 }
 
 void FastMatrixMultiply::transpose(Vector<t_complex> const &input, Vector<t_complex> &out) const {
+  MatvecTimer const timer;
   out.fill(0);
   /************* START FIRST COMMUNICATION **********/
   // first communicate input data to other processes
@@ -133,7 +165,10 @@ void FastMatrixMultiply::transpose(Vector<t_complex> const &input, Vector<t_comp
   auto reduction_request =
       reduce_computation_.send(nl_computations, send_buffer, computation_buffer);
   // now we get the inputs from other processes
-  mpi::wait(std::move(distribute_request));
+  {
+    timing::Timer const timer(timing::Phase::communication);
+    mpi::wait(std::move(distribute_request));
+  }
   /************* FINISHED FIRST COMMUNICATION **********/
 
   // And synthesize the input for non-local fmm
@@ -145,13 +180,67 @@ void FastMatrixMultiply::transpose(Vector<t_complex> const &input, Vector<t_comp
   reconstruct(nonlocal_indices_, nl_out, out);
 
   // we receive the stuff computed elsewhere
-  mpi::wait(std::move(reduction_request));
+  {
+    timing::Timer const timer(timing::Phase::communication);
+    mpi::wait(std::move(reduction_request));
+  }
   /************* FINISHED SECOND COMMUNICATION **********/
 
   // and reduce over all results
   reduce_computation_.reduce(out, computation_buffer);
 }
 
+roofline::Profile FastMatrixMultiply::explain(Vector<t_complex> const &input,
+                                              Vector<t_complex> &out, bool transposed) const {
+  using roofline::Kernel;
+  using roofline::Section;
+  auto const &local_fmm = transposed ? transpose_local_fmm_ : local_fmm_;
+  auto const &nonlocal_fmm = transposed ? transpose_nonlocal_fmm_ : nonlocal_fmm_;
+  auto const complex_bytes = static_cast<t_real>(sizeof(t_complex));
+  roofline::Profile profile;
+  out.fill(0);
+
+  Vector<t_complex> distribute_buffer;
+  auto distribute_request = distribute_input_.send(input, distribute_buffer);
+  Vector<t_complex> local_input, nl_computations;
+  {
+    Section const section(profile, Kernel::accumulation, 0, 2 * complex_bytes * input.size());
+    reconstruct(local_indices_, input, local_input);
+  }
+  profile += local_fmm.explain(local_input, nl_computations, transposed);
+
+  Vector<t_complex> send_buffer, computation_buffer;
+  auto reduction_request =
+      reduce_computation_.send(nl_computations, send_buffer, computation_buffer);
+  {
+    Section const section(profile, Kernel::communication, 0,
+                          complex_bytes * distribute_buffer.size());
+    mpi::wait(std::move(distribute_request));
+  }
+
+  Vector<t_complex> nonlocal_input, nl_out;
+  {
+    Section const section(profile, Kernel::accumulation, 0,
+                          2 * complex_bytes * distribute_buffer.size());
+    distribute_input_.synthesize(distribute_buffer, nonlocal_input);
+  }
+  profile += nonlocal_fmm.explain(nonlocal_input, nl_out, transposed);
+  {
+    Section const section(profile, Kernel::accumulation, 0, 2 * complex_bytes * nl_out.size());
+    reconstruct(nonlocal_indices_, nl_out, out);
+  }
+
+  {
+    Section const section(profile, Kernel::communication, 0,
+                          complex_bytes * computation_buffer.size());
+    mpi::wait(std::move(reduction_request));
+  }
+  Section const section(profile, Kernel::accumulation, 2 * computation_buffer.size(),
+                        3 * complex_bytes * computation_buffer.size());
+  reduce_computation_.reduce(out, computation_buffer);
+  return profile;
+}
+
 namespace {
 Vector<int> compute_sizes(std::vector<Scatterer> const &scatterers) {
   Vector<int> result(scatterers.size());
@@ -159,6 +248,47 @@ Vector<int> compute_sizes(std::vector<Scatterer> const &scatterers) {
     result(i) = 2 * scatterers[i].nMax * (scatterers[i].nMax + 2);
   return result;
 }
+
+//! \brief Pairs computed by one of the serial operators of this process
+//! \details In order: local, non-local, transpose local and transpose non-local operators.
+Matrix<bool> serial_couplings(Matrix<bool> const &locals, Vector<t_int> const &distribution,
+                              t_int rank, t_uint which) {
+  auto const n = distribution.size();
+  auto const rows = (distribution.array() == rank).replicate(1, n).eval();
+  auto const cols = (distribution.transpose().array() == rank).replicate(n, 1).eval();
+  switch(which) {
+  case 0:
+    return locals.array() && cols;
+  case 1:
+    return (locals.array() == false) && rows;
+  case 2:
+    return locals.transpose().array() && rows;
+  case 3:
+    return (locals.transpose().array() == false) && cols;
+  default:
+    throw std::out_of_range("Unknown serial operator");
+  }
+}
+
+//! Pairs computed by any of the serial operators of this process
+Matrix<bool> stored_couplings(Matrix<bool> const &locals, Vector<t_int> const &distribution,
+                              t_int rank) {
+  Matrix<bool> result = serial_couplings(locals, distribution, rank, 0);
+  for(t_uint which(1); which < 4; ++which)
+    result = result.array() || serial_couplings(locals, distribution, rank, which).array();
+  return result;
+}
+
+//! Serial operator over given couplings, read from `data` unless it is empty
+optimet::FastMatrixMultiply
+serial_fmm(ElectroMagnetic const &em_background, t_real wavenumber,
+           std::vector<Scatterer> const &scatterers, Matrix<bool> const &couplings,
+           OperatorData const &data, Rotation::Storage storage, t_real translations_budget) {
+  if(data.empty())
+    return optimet::FastMatrixMultiply(em_background, wavenumber, scatterers, couplings, storage,
+                                       translations_budget);
+  return optimet::FastMatrixMultiply(em_background, wavenumber, scatterers, couplings, data);
+}
 }
 
 FastMatrixMultiply::FastMatrixMultiply(ElectroMagnetic const &em_background, t_real wavenumber,
@@ -167,23 +297,16 @@ FastMatrixMultiply::FastMatrixMultiply(ElectroMagnetic const &em_background, t_r
                                        GraphCommunicator const &distribute_comm,
                                        GraphCommunicator const &reduce_comm,
                                        Vector<t_int> const &vector_distribution,
-                                       Communicator const &comm)
-    : local_fmm_(em_background, wavenumber, scatterers,
-                 locals.array() &&
-                     (vector_distribution.transpose().array() == comm.rank())
-                         .replicate(vector_distribution.size(), 1)),
-      nonlocal_fmm_(em_background, wavenumber, scatterers,
-                    (locals.array() == false) &&
-                        (vector_distribution.array() == comm.rank())
-                            .replicate(1, vector_distribution.size())),
-      transpose_local_fmm_(em_background, wavenumber, scatterers,
-                           locals.transpose().array() &&
-                               (vector_distribution.array() == comm.rank())
-                                   .replicate(1, vector_distribution.size())),
-      transpose_nonlocal_fmm_(em_background, wavenumber, scatterers,
-                              (locals.transpose().array() == false) &&
-                                  (vector_distribution.transpose().array() == comm.rank())
-                                      .replicate(vector_distribution.size(), 1)),
+                                       Communicator const &comm, OperatorData const &data,
+                                       Rotation::Storage storage, t_real translations_budget)
+    : store_(serial_fmm(em_background, wavenumber, scatterers,
+                        stored_couplings(locals, vector_distribution, comm.rank()), data,
+                        storage, translations_budget)),
+      local_fmm_(store_, serial_couplings(locals, vector_distribution, comm.rank(), 0)),
+      nonlocal_fmm_(store_, serial_couplings(locals, vector_distribution, comm.rank(), 1)),
+      transpose_local_fmm_(store_, serial_couplings(locals, vector_distribution, comm.rank(), 2)),
+      transpose_nonlocal_fmm_(store_,
+                              serial_couplings(locals, vector_distribution, comm.rank(), 3)),
       distribute_input_(distribute_comm, locals.array() == false, vector_distribution, scatterers),
       reduce_computation_(reduce_comm, locals.array(), vector_distribution, scatterers) {
 
@@ -22,6 +22,7 @@
 #ifdef OPTIMET_MPI
 #include "mpi/GraphCommunicator.h"
 #include <array>
+#include <limits>
 #include <utility>
 #include <vector>
 
@@ -105,10 +106,17 @@ public:
   //! \param[in] diagonal: In some constructors, the `locals` matrix is constructed as a diagonal
   //!                      banded matrix with this number of subdiagonals set to local (computations
   //!                      from locally available input data).
+  //! \param[in] data: Output of `operator_data`, if not empty. See the corresponding constructor.
+  //! \param[in] storage: Whether the rotations are stored as dense matrices or factored.
+  //! \param[in] translations_budget: Bytes of co-axial translation coefficients stored by this
+  //!                                 process. Those of the other pairs are recomputed.
   FastMatrixMultiply(ElectroMagnetic const &em_background, t_real wavenumber,
                      std::vector<Scatterer> const &scatterers, Matrix<bool> const &locals,
                      Vector<t_int> const &vector_distribution,
-                     Communicator const &comm = Communicator())
+                     Communicator const &comm = Communicator(),
+                     OperatorData const &data = OperatorData(),
+                     Rotation::Storage storage = Rotation::Storage::dense,
+                     t_real translations_budget = std::numeric_limits<t_real>::infinity())
       : FastMatrixMultiply(
             em_background, wavenumber, scatterers, locals,
             // reordering in graph communicators would require re-mapping vector_distribution
@@ -116,7 +124,7 @@ public:
                 comm, details::graph_edges(locals.array() == false, vector_distribution), false),
             // reordering in graph communicators would require re-mapping vector_distribution
             GraphCommunicator(comm, details::graph_edges(locals, vector_distribution), false),
-            vector_distribution, comm) {}
+            vector_distribution, comm, data, storage, translations_budget) {}
   FastMatrixMultiply(ElectroMagnetic const &em_background, t_real wavenumber,
                      std::vector<Scatterer> const &scatterers, t_int diagonal,
                      Vector<t_int> const &vector_distribution,
@@ -156,6 +164,31 @@ public:
                      Matrix<bool> const &local_nonlocal, Communicator const &comm = Communicator())
       : FastMatrixMultiply(wavenumber, scatterers, local_nonlocal,
                            details::vector_distribution(scatterers.size(), comm.size()), comm) {}
+  //! \brief Creates the operator from the output of `operator_data`
+  //! \details The arguments should be the same as when the data was computed, including the
+  //! number and rank of the processes. The operator is computed anew if the data is empty.
+  FastMatrixMultiply(ElectroMagnetic const &em_background, t_real wavenumber,
+                     std::vector<Scatterer> const &scatterers, t_int diagonal,
+                     Communicator const &comm, OperatorData const &data,
+                     Rotation::Storage storage = Rotation::Storage::dense,
+                     t_real translations_budget = std::numeric_limits<t_real>::infinity())
+      : FastMatrixMultiply(em_background, wavenumber, scatterers,
+                           details::local_interactions(scatterers.size(), diagonal),
+                           details::vector_distribution(scatterers.size(), comm.size()), comm,
+                           data, storage, translations_budget) {}
+  //! \brief Same distribution and particle pairs as `other`, at another frequency
+  //! \details The scatterers should be at the same positions as in `other`. Communicators,
+  //! reconstruction indices and rotations are shared with `other`. Only the frequency-dependent
+  //! parts of the store are recomputed.
+  FastMatrixMultiply(FastMatrixMultiply const &other, ElectroMagnetic const &em_background,
+                     t_real wavenumber, std::vector<Scatterer> const &scatterers)
+      : store_(other.store_, em_background, wavenumber, scatterers),
+        local_fmm_(store_, other.local_fmm_.couplings_matrix()),
+        nonlocal_fmm_(store_, other.nonlocal_fmm_.couplings_matrix()),
+        transpose_local_fmm_(store_, other.transpose_local_fmm_.couplings_matrix()),
+        transpose_nonlocal_fmm_(store_, other.transpose_nonlocal_fmm_.couplings_matrix()),
+        distribute_input_(other.distribute_input_), reduce_computation_(other.reduce_computation_),
+        nonlocal_indices_(other.nonlocal_indices_), local_indices_(other.local_indices_) {}
 
   //! \brief Applies fast matrix multiplication to effective incident field
   void operator()(Vector<t_complex> const &in, Vector<t_complex> &out) const;
@@ -165,6 +198,11 @@ public:
   Vector<t_complex> operator*(Vector<t_complex> const &in) const { return operator()(in); }
   //! \brief Applies transpose fast matrix multiplication to effective incident field
   void transpose(Vector<t_complex> const &in, Vector<t_complex> &out) const;
+  //! \brief Applies the multiplication one kernel at a time, counting operations and time
+  //! \details Gives the same result as `operator()`, or as `transpose` if `transposed` is true.
+  //! The profile is that of this process only, see roofline::Profile::reduce.
+  roofline::Profile explain(Vector<t_complex> const &in, Vector<t_complex> &out,
+                            bool transposed = false) const;
   //! \brief Applies transpose fast matrix multiplication to effective incident field
   Vector<t_complex> transpose(Vector<t_complex> const &in) const;
   //! \brief Applies conjugate fast matrix multiplication to effective incident field
@@ -186,6 +224,10 @@ public:
     return transpose(in.conjugate()).conjugate();
   }
 
+  //! \brief Geometry-dependent data of this process, e.g. to store in an operator cache
+  //! \details The data of the store shared by the serial operators.
+  OperatorData operator_data() const { return store_.operator_data(); }
+
   //! Local rows
   t_uint rows() const { return nonlocal_fmm_.rows(); }
   //! Local cols
@@ -272,6 +314,11 @@ public:
   };
 
 private:
+  //! \brief Rotations and co-axial translations of all the pairs computed by this process
+  //! \details The forward and transpose operators below apply subsets of these pairs. Pairs
+  //! between two particles owned by this process are computed both by the forward and by the
+  //! transpose operators, but stored only once.
+  optimet::FastMatrixMultiply store_;
   //! Computed with local input vector
   optimet::FastMatrixMultiply local_fmm_;
   //! Computed with non-local input vector
@@ -294,7 +341,10 @@ private:
                      std::vector<Scatterer> const &scatterers, Matrix<bool> const &locals,
                      GraphCommunicator const &distribute_comm, GraphCommunicator const &reduce_comm,
                      Vector<t_int> const &vector_distribution,
-                     Communicator const &comm = Communicator());
+                     Communicator const &comm = Communicator(),
+                     OperatorData const &data = OperatorData(),
+                     Rotation::Storage storage = Rotation::Storage::dense,
+                     t_real translations_budget = std::numeric_limits<t_real>::infinity());
 };
 
 template <class T0, class T1>
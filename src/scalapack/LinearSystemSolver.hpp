@@ -17,6 +17,7 @@
 #ifndef OPTIMET_SCALAPACK_LINEAR_SYSTEM_SOLVER_HPP_
 #define OPTIMET_SCALAPACK_LINEAR_SYSTEM_SOLVER_HPP_
 
+#include "Timing.h"
 #include "scalapack/Blacs.h"
 #include "scalapack/InitExit.h"
 #include "scalapack/LinearSystemSolver.h"
@@ -134,6 +135,7 @@ gmres_linear_system(Matrix<SCALARA> const &A, Matrix<SCALARB> const &b,
   // means that it was solved to the desired tolerance.  This call
   // overwrites X with the computed approximate solution.
   int info = solver->solve() == Belos::Converged ? 0 : 1;
+  timing::count(timing::Phase::iterations, solver->getNumIters());
 
   auto const view = as_matrix(*X, b);
   ConcreteMatrix result(b.context(), b.sizes(), b.blocks());
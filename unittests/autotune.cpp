@@ -0,0 +1,106 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "Autotune.h"
+#include "Excitation.h"
+#include "Run.h"
+#include "Tools.h"
+#include "Types.h"
+#include "constants.h"
+#include <cstdio>
+#include <string>
+
+using namespace optimet;
+
+namespace {
+Run small_run(t_uint nobjects) {
+  ElectroMagnetic const silicon{13.1, 1.0};
+  Run run;
+  for(t_uint i(0); i < nobjects; ++i)
+    run.geometry->pushObject({{1500e-9 * i, 0, 0}, silicon, 500e-9, 3});
+  run.nMax = run.geometry->nMax();
+  Spherical<t_real> const vKinc{2 * constant::pi / 1200e-9, 0, 0};
+  SphericalP<t_complex> const Eaux{0e0, 1e0, 0e0};
+  run.excitation =
+      std::make_shared<Excitation>(0, Tools::toProjection(vKinc, Eaux), vKinc, run.nMax);
+  run.excitation->populate();
+  run.geometry->update(run.excitation);
+  return run;
+}
+} // namespace
+
+TEST_CASE("Configurations round-trip through strings") {
+  autotune::Configuration const expected{solver::Kind::fmm, 3, 64, 100, 2};
+  auto const string = autotune::to_string(expected);
+  CHECK(string == "solver=fmm subdiagonals=3 block_size=64 num_blocks=100 threads=2");
+  auto const actual = autotune::configuration(string);
+  CHECK(actual.kind == expected.kind);
+  CHECK(actual.subdiagonals == expected.subdiagonals);
+  CHECK(actual.block_size == expected.block_size);
+  CHECK(actual.num_blocks == expected.num_blocks);
+  CHECK(actual.threads == expected.threads);
+  CHECK_THROWS_AS(autotune::configuration("solver=fmm"), std::runtime_error);
+  CHECK_THROWS_AS(autotune::configuration(
+                      "solver=lu subdiagonals=1 block_size=64 num_blocks=100 threads=2"),
+                  std::runtime_error);
+}
+
+TEST_CASE("Classes of problems") {
+  CHECK(autotune::problem_class(small_run(3), 2) == "objects<=4 nmax=3 processes=2");
+  CHECK(autotune::problem_class(small_run(4), 2) == autotune::problem_class(small_run(3), 2));
+  CHECK(autotune::problem_class(small_run(5), 2) != autotune::problem_class(small_run(4), 2));
+  CHECK(autotune::problem_class(small_run(4), 1) != autotune::problem_class(small_run(4), 2));
+}
+
+TEST_CASE("Decisions are recorded per class") {
+  std::string const filename = "autotune_decisions.txt";
+  std::remove(filename.c_str());
+  autotune::Configuration decision;
+  CHECK_FALSE(autotune::load(filename, "objects<=4 nmax=3 processes=1", decision));
+
+  autotune::Configuration const first{solver::Kind::eigen, 1, 64, 300, 1};
+  autotune::Configuration const second{solver::Kind::eigen, 1, 64, 300, 4};
+  autotune::Configuration const other{solver::Kind::eigen, 1, 32, 300, 2};
+  autotune::save(filename, "objects<=4 nmax=3 processes=1", {{first, 1, 2, 3, true}}, first);
+  autotune::save(filename, "objects<=8 nmax=3 processes=1", {}, other);
+  autotune::save(filename, "objects<=4 nmax=3 processes=1", {}, second);
+
+  REQUIRE(autotune::load(filename, "objects<=4 nmax=3 processes=1", decision));
+  CHECK(decision.threads == 4);
+  REQUIRE(autotune::load(filename, "objects<=8 nmax=3 processes=1", decision));
+  CHECK(decision.block_size == 32);
+  CHECK_FALSE(autotune::load(filename, "objects<=4 nmax=3 processes=2", decision));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("Calibration of the serial solver") {
+  auto run = small_run(4);
+  auto const candidates = autotune::candidates(run, 1, 0);
+  REQUIRE(not candidates.empty());
+  CHECK(candidates.front().kind == solver::Kind::eigen);
+  CHECK(autotune::candidates(run, 1, 1).empty());
+
+  auto const trials = autotune::calibrate(run, candidates, 2, mpi::Communicator());
+  REQUIRE(trials.size() == candidates.size());
+  for(auto const &trial : trials) {
+    CHECK(trial.setup > 0);
+    CHECK(trial.solve > 0);
+    CHECK(trial.footprint > 0);
+    CHECK(trial.converged);
+  }
+}
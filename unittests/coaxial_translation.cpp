@@ -506,3 +506,47 @@ TEST_CASE("Transpose operation") {
   }
   CHECK(actual.transpose().isApprox(expected));
 }
+
+TEST_CASE("Co-axial coefficients in a single sweep") {
+  CoAxialSweep sweep;
+  for(auto const regular : {true, false})
+    for(auto const N : {0, 1, 6, 12, 3}) {
+      auto const tz = std::uniform_real_distribution<t_real>(1, 20)(*mersenne);
+      t_complex const waveK(std::uniform_real_distribution<t_real>(0.1, 2)(*mersenne), 0);
+      auto const expected = CachedCoAxialRecurrence(tz, waveK, regular).functor(N);
+      // the same sweep is reused for all degrees
+      auto const &actual = sweep(tz, waveK, N, regular);
+      INFO("N " << N << " regular " << regular << " tz " << tz << " waveK " << waveK);
+      CHECK(actual.nmax() == N);
+      REQUIRE(actual.data().size() == expected.data().size());
+      auto const ncoeffs = expected.data().size();
+      CHECK(Vector<t_complex>::Map(actual.data().data(), ncoeffs)
+                .isApprox(Vector<t_complex>::Map(expected.data().data(), ncoeffs), 1e-12));
+      auto const size = N * (N + 2) + 1;
+      Vector<t_complex> const input = Vector<t_complex>::Random(size);
+      CHECK(actual(input).isApprox(expected(input), 1e-12));
+      CHECK(actual.transpose(input).isApprox(expected.transpose(input), 1e-12));
+    }
+}
+
+TEST_CASE("Co-axial functor shares the coefficients of m and -m") {
+  auto const N = 8;
+  CachedCoAxialRecurrence tca(5e0, 0.3, false);
+  auto const functor = tca.functor(N);
+  // only orders m >= 0 are stored
+  CHECK(functor.data().size() == static_cast<size_t>((N + 1) * (N + 2) * (2 * N + 3) / 6));
+
+  auto const size = N * (N + 2) + 1;
+  Vector<t_complex> const input = Vector<t_complex>::Random(size);
+  // same coefficients, same order of operations as the recurrence itself
+  Vector<t_complex> const direct = tca(input);
+  CHECK(functor(input) == direct);
+  CHECK(functor(input.tail(size - 1)) == tca(input.tail(size - 1)));
+
+  Vector<t_complex> transpose = Vector<t_complex>::Zero(size);
+  for(t_int n(0); n <= N; ++n)
+    for(t_int m(-n); m <= n; ++m)
+      for(t_int l(std::abs(m)); l <= N; ++l)
+        transpose(n * (n + 1) + m) += tca(n, m, l) * input(l * (l + 1) + m);
+  CHECK(functor.transpose(input) == transpose);
+}
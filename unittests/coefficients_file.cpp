@@ -0,0 +1,152 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "CoefficientsFile.h"
+#include "Convergence.h"
+#include "OperatorCache.h"
+#include "Reader.h"
+#include "Result.h"
+#include "Run.h"
+#include "Simulation.h"
+#include "Types.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace optimet;
+
+TEST_CASE("Coefficients file") {
+  std::string const filename = "coefficients_file.h5";
+  Vector<t_complex> const ff_scatter = Vector<t_complex>::Random(16);
+  Vector<t_complex> const ff_internal = Vector<t_complex>::Random(16);
+  Vector<t_complex> const sh_scatter = Vector<t_complex>::Random(24);
+  Vector<t_complex> const sh_internal = Vector<t_complex>::Random(24);
+  ConvergenceHistory history;
+  history.start();
+  history.record(1, 0.5);
+  history.record(2, 1e-3);
+  history.finish(true);
+  {
+    CoefficientsFile file(filename, true);
+    file.write("FF", "hash", 1e-6, 2, 2, ff_scatter, ff_internal);
+    file.write("SH", "hash", 1e-6, 3, 1, sh_scatter, sh_internal);
+    file.write("FF", "hash", 1e-6, history);
+    // a solution is only written once
+    file.write("FF", "hash", 1e-6, 2, 2, sh_scatter, sh_internal);
+  }
+
+  CoefficientsFile const file(filename, false);
+  Vector<t_complex> scatter, internal;
+  SECTION("Solutions are found by kind and hash") {
+    REQUIRE(file.read("FF", "hash", scatter, internal));
+    CHECK(scatter == ff_scatter);
+    CHECK(internal == ff_internal);
+    REQUIRE(file.read("SH", "hash", scatter, internal));
+    CHECK(scatter == sh_scatter);
+    CHECK(internal == sh_internal);
+    CHECK_FALSE(file.read("FF", "other", scatter, internal));
+    CHECK_FALSE(file.read("SH", "other", scatter, internal));
+  }
+
+  SECTION("Convergence history") {
+    auto const file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    REQUIRE(file_id >= 0);
+    auto const dataset = H5Dopen(file_id, "convergence_FF_hash", H5P_DEFAULT);
+    REQUIRE(dataset >= 0);
+    auto const space = H5Dget_space(dataset);
+    hsize_t dims[2] = {0, 0};
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    REQUIRE(dims[0] == 2);
+    REQUIRE(dims[1] == 5);
+    Eigen::Matrix<t_real, 2, 5, Eigen::RowMajor> data;
+    H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data());
+    int converged = 0;
+    auto const attribute = H5Aopen(dataset, "converged", H5P_DEFAULT);
+    H5Aread(attribute, H5T_NATIVE_INT, &converged);
+    H5Aclose(attribute);
+    H5Sclose(space);
+    H5Dclose(dataset);
+    H5Fclose(file_id);
+
+    CHECK(converged == 1);
+    for(std::size_t i(0); i < history.iterations().size(); ++i) {
+      CHECK(data(i, 0) == history.iterations()[i].iteration);
+      CHECK(data(i, 1) == history.iterations()[i].residual);
+      CHECK(data(i, 2) == history.iterations()[i].seconds);
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("Restart from a coefficients file") {
+  std::string const input = "coefficients_restart_input.h5";
+  std::string const casename = "coefficients_restart";
+  {
+    std::ofstream xml(casename + ".xml");
+    xml << "<simulation>\n"
+           "  <harmonics nmax=\"2\" />\n"
+           "</simulation>\n"
+           "<source type=\"planewave\">\n"
+           "  <wavelength value=\"1460\" />\n"
+           "  <propagation theta=\"90\" phi=\"90\" />\n"
+           "  <polarization Etheta.real=\"1.0\" Etheta.imag=\"0.0\" Ephi.real=\"0.0\" "
+           "Ephi.imag=\"0.0\" />\n"
+           "</source>\n"
+           "<geometry>\n"
+           "  <object type=\"sphere\">\n"
+           "    <cartesian x=\"0.0\" y=\"0.0\" z=\"0.0\" />\n"
+           "    <properties radius=\"500.0\" />\n"
+           "    <epsilon type=\"relative\" value.real=\"13.0\" value.imag=\"0.0\" />\n"
+           "    <mu type=\"relative\" value.real=\"1.0\" value.imag=\"0.0\" />\n"
+           "  </object>\n"
+           "</geometry>\n"
+           "<output type=\"coefficients\" />\n"
+           "<coefficients load=\""
+        << input << "\" />\n";
+  }
+  auto const run = simulation_input(casename + ".xml");
+  Result const sizes(run.geometry, run.excitation);
+
+  SECTION("Missing solution") {
+    CoefficientsFile(input, true).write("FF", "unrelated", 1e-6, 2, 1, sizes.scatter_coef,
+                                        sizes.internal_coef);
+    CHECK_THROWS_WITH(Simulation(casename).run(),
+                      Catch::Contains("No FF coefficients for this geometry"));
+  }
+
+  SECTION("Solution from the file") {
+    auto const hash = coefficients_hash(*run.geometry, *run.excitation);
+    Vector<t_complex> const scatter = Vector<t_complex>::Random(sizes.scatter_coef.size());
+    Vector<t_complex> const internal = Vector<t_complex>::Random(sizes.internal_coef.size());
+    CoefficientsFile(input, true).write("FF", hash, 1e-6, 2, 1, scatter, internal);
+    CHECK(Simulation(casename).run() == 0);
+
+    // the output is computed from the restored coefficients, without solving
+    std::ifstream coefficients(casename + "_pCoefficients.dat");
+    t_int n, m, i(0);
+    t_real value;
+    while(coefficients >> n >> m >> value)
+      CHECK(value == Approx(std::abs(scatter(i++))).epsilon(1e-5));
+    CHECK(i == 8);
+  }
+
+  for(auto const &filename :
+      {input, casename + ".xml", casename + "_coefficients.h5", casename + "_pCoefficients.dat",
+       casename + "_qCoefficients.dat", casename + "_timings.json"})
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,64 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "Convergence.h"
+#include "Timing.h"
+#include "Types.h"
+#include <memory>
+#include <sstream>
+
+using namespace optimet;
+
+TEST_CASE("Convergence history") {
+  timing::reset();
+  ConvergenceHistory history;
+  CHECK(history.empty());
+  auto const stream = std::make_shared<std::ostringstream>();
+  history.stream(stream);
+
+  history.start();
+  timing::add(timing::Phase::matvec, 0.5, 2);
+  timing::add(timing::Phase::communication, 0.25);
+  history.record(1, 1e-1);
+  timing::add(timing::Phase::matvec, 0.5, 1);
+  history.record(2, 1e-3);
+  // the same iteration recorded twice is overwritten
+  history.record(2, 1e-4);
+  history.finish(true);
+
+  REQUIRE(history.iterations().size() == 2);
+  CHECK(history.converged());
+  CHECK(history.iterations()[0].iteration == 1);
+  CHECK(history.iterations()[0].matvecs == 2);
+  CHECK(history.iterations()[0].communication == Approx(0.25));
+  CHECK(history.iterations()[1].residual == Approx(1e-4));
+  CHECK(history.iterations()[1].matvecs == 3);
+  CHECK(history.iterations()[1].seconds >= history.iterations()[0].seconds);
+  CHECK(stream->str().find("# solve 1") == 0);
+  CHECK(stream->str().find("converged") != std::string::npos);
+
+  SECTION("A new solve starts from scratch") {
+    history.start();
+    CHECK(history.empty());
+    CHECK(not history.converged());
+    history.record(1, 0.5);
+    CHECK(history.iterations()[0].matvecs == 0);
+    history.finish(false);
+    CHECK(stream->str().find("# solve 2 did not converge") != std::string::npos);
+  }
+}
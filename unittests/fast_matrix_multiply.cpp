@@ -22,7 +22,12 @@
 #include "PreconditionedMatrix.h"
 #include "Tools.h"
 #include "catch.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 
 ElectroMagnetic const silicon{13.1, 1.0};
 auto const wavenumber = 2 * optimet::constant::pi / (1200 * 1e-9);
@@ -241,3 +246,198 @@ TEST_CASE("Ranged matrices") {
     CHECK(reconstructed.isApprox(matrix_whole));
   }
 }
+
+TEST_CASE("Fast matrix multiply at another frequency") {
+  using namespace optimet;
+  auto const radius = 500.0e-9;
+  Eigen::Matrix<t_real, 3, 1> const direction = Vector<t_real>::Random(3).normalized();
+  ElectroMagnetic const other{9, 2.0};
+
+  std::vector<Scatterer> scatterers;
+  scatterers.emplace_back(Vector<t_real>::Zero(3), silicon, radius, nHarmonics);
+  scatterers.emplace_back(direction * 3 * radius * 1.500001, silicon, 2 * radius, nHarmonics);
+  auto const x = Eigen::Matrix<t_real, 3, 1>::Unit(0).eval();
+  scatterers.emplace_back(direction * 1.5 * radius * 1.500001 + x * radius * 8, other, 0.5 * radius,
+                          nHarmonics);
+  ElectroMagnetic const bground;
+
+  Matrix<bool> couplings = Matrix<bool>::Ones(scatterers.size(), scatterers.size());
+  couplings(0, 1) = false;
+  couplings(2, 2) = false;
+  optimet::FastMatrixMultiply const fundamental(bground, wavenumber, scatterers, couplings);
+  optimet::FastMatrixMultiply const expected(bground, 2 * wavenumber, scatterers, couplings);
+  optimet::FastMatrixMultiply const actual(fundamental, bground, 2 * wavenumber, scatterers);
+
+  CHECK(actual.couplings() == expected.couplings());
+  CHECK(actual.rows() == expected.rows());
+  CHECK(actual.cols() == expected.cols());
+  Vector<t_complex> const input = Vector<t_complex>::Random(expected.cols());
+  CHECK(actual(input).isApprox(expected(input)));
+  CHECK(not actual(input).isApprox(fundamental(input)));
+  Vector<t_complex> const transpose_input = Vector<t_complex>::Random(expected.rows());
+  CHECK(actual.transpose(transpose_input).isApprox(expected.transpose(transpose_input)));
+}
+
+TEST_CASE("Fast matrix multiply from cached operator data") {
+  using namespace optimet;
+  auto const radius = 500.0e-9;
+  Eigen::Matrix<t_real, 3, 1> const direction = Vector<t_real>::Random(3).normalized();
+
+  Geometry geometry;
+  geometry.pushObject({Vector<t_real>::Zero(3), silicon, radius, nHarmonics});
+  geometry.pushObject({direction * 3 * radius * 1.500001, silicon, 2 * radius, nHarmonics});
+  auto const &scatterers = geometry.objects;
+
+  Matrix<bool> couplings = Matrix<bool>::Ones(scatterers.size(), scatterers.size());
+  couplings(0, 1) = false;
+  optimet::FastMatrixMultiply const expected(geometry.bground, wavenumber, scatterers, couplings);
+
+  OperatorCache const cache(".");
+  auto const hash = operator_hash(geometry, wavenumber);
+  CHECK(hash != operator_hash(geometry, 2 * wavenumber));
+  cache.save(hash, "fmm", expected.operator_data());
+  OperatorData data;
+  REQUIRE(cache.load(hash, "fmm", data));
+  CHECK(not cache.load(hash, "matrix", data));
+  std::remove(cache.filename(hash, "fmm").c_str());
+
+  optimet::FastMatrixMultiply const actual(geometry.bground, wavenumber, scatterers, couplings,
+                                           data);
+  CHECK(actual.couplings() == expected.couplings());
+  Vector<t_complex> const input = Vector<t_complex>::Random(expected.cols());
+  CHECK(actual(input).isApprox(expected(input)));
+  Vector<t_complex> const transpose_input = Vector<t_complex>::Random(expected.rows());
+  CHECK(actual.transpose(transpose_input).isApprox(expected.transpose(transpose_input)));
+  // both directions of a pair share their operators, so the diagonal alone stores fewer pairs
+  CHECK_THROWS_AS(optimet::FastMatrixMultiply(geometry.bground, wavenumber, scatterers,
+                                              Matrix<bool>::Identity(2, 2), data),
+                  std::runtime_error);
+}
+
+TEST_CASE("Corrupted operator cache entries are rejected") {
+  using namespace optimet;
+  OperatorCache const cache(".");
+  std::string const hash = "corrupted";
+  auto const filename = cache.filename(hash, "fmm");
+  cache.save(hash, "fmm", {Matrix<t_complex>::Random(2, 3)});
+  std::string valid;
+  {
+    std::ifstream file(filename, std::ios::binary);
+    valid.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  // magic, version, then hash and kind each preceded by their size
+  auto const nblocks = 8 + 4 + (8 + hash.size()) + (8 + 3);
+  auto const rows = nblocks + 8;
+  auto const load = [&](std::string const &content) {
+    std::ofstream(filename, std::ios::binary) << content;
+    OperatorData data;
+    return cache.load(hash, "fmm", data);
+  };
+  auto const overwrite = [&valid](std::size_t offset, std::int64_t value) {
+    auto result = valid;
+    std::memcpy(&result[offset], &value, sizeof(value));
+    return result;
+  };
+
+  CHECK(load(valid));
+  CHECK(not load(valid.substr(0, valid.size() - 1)));
+  CHECK(not load(overwrite(nblocks, std::int64_t(1) << 60)));
+  CHECK(not load(overwrite(rows, -1)));
+  CHECK(not load(overwrite(rows, std::int64_t(1) << 40)));
+  CHECK(not load(overwrite(rows + 8, std::int64_t(1) << 40)));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("Fast matrix multiply over a subset of a store") {
+  using namespace optimet;
+  auto const radius = 500.0e-9;
+  Eigen::Matrix<t_real, 3, 1> const direction = Vector<t_real>::Random(3).normalized();
+  auto const x = Eigen::Matrix<t_real, 3, 1>::Unit(0).eval();
+  ElectroMagnetic const bground;
+
+  std::vector<Scatterer> scatterers;
+  scatterers.emplace_back(Vector<t_real>::Zero(3), silicon, radius, nHarmonics);
+  scatterers.emplace_back(direction * 3 * radius * 1.500001, silicon, 2 * radius, nHarmonics);
+  scatterers.emplace_back(direction * 1.5 * radius * 1.500001 + x * radius * 8, silicon,
+                          0.5 * radius, nHarmonics);
+
+  Matrix<bool> stored = Matrix<bool>::Ones(scatterers.size(), scatterers.size());
+  // pairs are stored in either direction
+  stored(2, 0) = false;
+  stored(0, 2) = false;
+  Matrix<bool> couplings = stored;
+  couplings(0, 1) = false;
+  couplings(1, 1) = false;
+  optimet::FastMatrixMultiply const store(bground, wavenumber, scatterers, stored);
+  optimet::FastMatrixMultiply const expected(bground, wavenumber, scatterers, couplings);
+  optimet::FastMatrixMultiply const actual(store, couplings);
+
+  CHECK(actual.couplings() == expected.couplings());
+  CHECK(actual.rows() == expected.rows());
+  CHECK(actual.cols() == expected.cols());
+  Vector<t_complex> const input = Vector<t_complex>::Random(expected.cols());
+  CHECK(actual(input).isApprox(expected(input)));
+  Vector<t_complex> const transpose_input = Vector<t_complex>::Random(expected.rows());
+  CHECK(actual.transpose(transpose_input).isApprox(expected.transpose(transpose_input)));
+  // the subset holds no operators of its own, and gives those of the store to the cache
+  CHECK(actual.operator_data().size() == store.operator_data().size());
+
+  // at another frequency, the subset still picks its operators from the store
+  optimet::FastMatrixMultiply const harmonic(actual, bground, 2 * wavenumber, scatterers);
+  optimet::FastMatrixMultiply const expected_harmonic(bground, 2 * wavenumber, scatterers,
+                                                      couplings);
+  CHECK(harmonic(input).isApprox(expected_harmonic(input)));
+
+  Matrix<bool> missing = couplings;
+  missing(2, 0) = true;
+  CHECK_THROWS_AS(optimet::FastMatrixMultiply(store, missing), std::out_of_range);
+}
+
+TEST_CASE("Fast matrix multiply with recomputed co-axial translations") {
+  using namespace optimet;
+  auto const radius = 500.0e-9;
+  Eigen::Matrix<t_real, 3, 1> const direction = Vector<t_real>::Random(3).normalized();
+  auto const x = Eigen::Matrix<t_real, 3, 1>::Unit(0).eval();
+  ElectroMagnetic const bground;
+
+  std::vector<Scatterer> scatterers;
+  scatterers.emplace_back(Vector<t_real>::Zero(3), silicon, radius, nHarmonics);
+  scatterers.emplace_back(direction * 3 * radius * 1.500001, silicon, 2 * radius, nHarmonics);
+  scatterers.emplace_back(direction * 1.5 * radius * 1.500001 + x * radius * 8, silicon,
+                          0.5 * radius, nHarmonics - 2);
+
+  Matrix<bool> couplings = Matrix<bool>::Ones(scatterers.size(), scatterers.size());
+  couplings(0, 1) = false;
+  optimet::FastMatrixMultiply const expected(bground, wavenumber, scatterers, couplings);
+  Vector<t_complex> const input = Vector<t_complex>::Random(expected.cols());
+  Vector<t_complex> const transpose_input = Vector<t_complex>::Random(expected.rows());
+  auto const stored = memory::coaxial_bytes(nHarmonics + 1);
+
+  // no budget recomputes all the pairs, a budget for the nearest pair recomputes the others
+  for(auto const budget : {0e0, stored}) {
+    auto const before = memory::current(memory::Component::translations);
+    optimet::FastMatrixMultiply const actual(bground, wavenumber, scatterers, couplings,
+                                             Rotation::Storage::dense, budget);
+    CAPTURE(budget);
+    // self-interactions are always stored
+    CHECK(memory::current(memory::Component::translations) - before ==
+          Approx(budget + 3 * memory::coaxial_bytes(1)));
+    CHECK(actual(input).isApprox(expected(input)));
+    CHECK(actual.transpose(transpose_input).isApprox(expected.transpose(transpose_input)));
+    Vector<t_complex> explained;
+    auto const profile = actual.explain(input, explained);
+    CHECK(explained.isApprox(expected(input)));
+    CHECK(profile.flops(roofline::Kernel::recurrence) > 0);
+
+    // recomputed pairs stay recomputed at another frequency, and in the cached data
+    optimet::FastMatrixMultiply const harmonic(actual, bground, 2 * wavenumber, scatterers);
+    CHECK(memory::current(memory::Component::translations) - before ==
+          Approx(2 * (budget + 3 * memory::coaxial_bytes(1))));
+    optimet::FastMatrixMultiply const expected_harmonic(bground, 2 * wavenumber, scatterers,
+                                                        couplings);
+    CHECK(harmonic(input).isApprox(expected_harmonic(input)));
+    optimet::FastMatrixMultiply const cached(bground, wavenumber, scatterers, couplings,
+                                             actual.operator_data());
+    CHECK(cached(input).isApprox(expected(input)));
+  }
+}
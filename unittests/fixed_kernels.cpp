@@ -0,0 +1,93 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "CoAxialTranslationCoefficients.h"
+#include "FixedKernels.h"
+#include "RotationCoaxialDecomposition.h"
+#include "RotationCoefficients.h"
+#include "Types.h"
+#include "constants.h"
+
+using namespace optimet;
+
+TEST_CASE("Specialised kernels match the generic ones") {
+  auto const wavenumber = 2 * constant::pi / 1200e-9;
+  auto const tz = 1.3e-6;
+  // degrees on either side of the specialised range use the generic fallback
+  for(t_int nmax(1); nmax <= kernels::max_degree() + 2; ++nmax) {
+    SECTION("Degree " + std::to_string(nmax)) {
+      t_int const rows = nmax * (nmax + 2);
+      // interleaved, as packed by the FMM
+      kernels::Interleaved const in = kernels::Interleaved::Random(rows + 1, 2);
+      kernels::Interleaved out(rows + 1, 2);
+
+      SECTION("Rotations") {
+        Rotation const rotation(0.3, 0.4, 0.5, nmax);
+        kernels::rotation(rotation, kernels::Rotate::direct, kernels::view(in.topRows(rows)),
+                          kernels::mutable_view(out.topRows(rows)));
+        CHECK(out.topRows(rows).isApprox(rotation(Matrix<t_complex>(in.topRows(rows)))));
+        kernels::rotation(rotation, kernels::Rotate::adjoint, kernels::view(in.topRows(rows)),
+                          kernels::mutable_view(out.topRows(rows)));
+        CHECK(out.topRows(rows).isApprox(rotation.adjoint(Matrix<t_complex>(in.topRows(rows)))));
+        kernels::rotation(rotation, kernels::Rotate::transpose, kernels::view(in.topRows(rows)),
+                          kernels::mutable_view(out.topRows(rows)));
+        CHECK(
+            out.topRows(rows).isApprox(rotation.transpose(Matrix<t_complex>(in.topRows(rows)))));
+        kernels::rotation(rotation, kernels::Rotate::conjugate, kernels::view(in.topRows(rows)),
+                          kernels::mutable_view(out.topRows(rows)));
+        CHECK(
+            out.topRows(rows).isApprox(rotation.conjugate(Matrix<t_complex>(in.topRows(rows)))));
+
+        // factored rotations go through the generic path, on the same views
+        Rotation const factored(0.3, 0.4, 0.5, nmax, Rotation::Storage::factored);
+        kernels::rotation(factored, kernels::Rotate::adjoint, kernels::view(in.topRows(rows)),
+                          kernels::mutable_view(out.topRows(rows)));
+        CHECK(out.topRows(rows).isApprox(rotation.adjoint(Matrix<t_complex>(in.topRows(rows)))));
+      }
+
+      SECTION("Co-axial translations") {
+        auto const functor = CachedCoAxialRecurrence(tz, wavenumber, false).functor(nmax);
+        Matrix<t_complex> const input = in;
+        kernels::coaxial(functor, kernels::view(in), kernels::mutable_view(out));
+        CHECK(out.isApprox(functor(input)));
+        kernels::coaxial_transpose(functor, kernels::view(in), kernels::mutable_view(out));
+        CHECK(out.isApprox(functor.transpose(input)));
+      }
+
+      SECTION("Changes of parity") {
+        kernels::Interleaved actual = in;
+        kernels::parity(kernels::mutable_view(actual));
+        for(t_int n(0); n <= nmax; ++n)
+          for(t_int m(-n); m <= n; ++m)
+            CHECK(actual.row(n * n + n + m).isApprox((n % 2 == 0 ? 1e0 : -1e0) *
+                                                     in.row(n * n + n + m)));
+        kernels::parity(kernels::mutable_view(actual));
+        CHECK(actual.isApprox(in));
+      }
+
+      SECTION("Rotation-coaxial decompositions") {
+        Matrix<t_complex> const input = in;
+        kernels::decomposition(wavenumber, tz, kernels::view(in), kernels::mutable_view(out));
+        CHECK(out.isApprox(rotation_coaxial_decomposition(wavenumber, tz, input)));
+        kernels::decomposition_transpose(wavenumber, tz, kernels::view(in),
+                                         kernels::mutable_view(out));
+        CHECK(out.isApprox(rotation_coaxial_decomposition_transpose(wavenumber, tz, input)));
+      }
+    }
+  }
+}
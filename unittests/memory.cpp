@@ -0,0 +1,152 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "FastMatrixMultiply.h"
+#include "Memory.h"
+#include "Run.h"
+#include "Solver.h"
+#include "Types.h"
+#include "constants.h"
+#include <sstream>
+
+using namespace optimet;
+
+TEST_CASE("Sizes of the FMM operators") {
+  SECTION("Rotations") {
+    for(t_int nmax(0); nmax < 6; ++nmax) {
+      Rotation const rotation(0.3, 0.4, 0.5, nmax);
+      t_real bytes(0);
+      for(auto const &matrix : rotation.matrices())
+        bytes += matrix.size() * sizeof(t_complex);
+      CHECK(memory::rotation_bytes(nmax) == Approx(bytes));
+    }
+  }
+  SECTION("Co-axial translations") {
+    for(t_int nmax(1); nmax < 6; ++nmax) {
+      auto const functor = CachedCoAxialRecurrence(1.5, 2.0, false).functor(nmax);
+      CHECK(memory::coaxial_bytes(nmax) == Approx(functor.data().size() * sizeof(t_complex)));
+    }
+  }
+}
+
+TEST_CASE("Tracked allocations") {
+  memory::reset();
+  auto const start = memory::current(memory::Component::matrix);
+  {
+    memory::Allocation const first(memory::Component::matrix, 100);
+    CHECK(memory::current(memory::Component::matrix) == Approx(start + 100));
+    {
+      auto const copy = first;
+      CHECK(memory::current(memory::Component::matrix) == Approx(start + 200));
+    }
+    auto moved = memory::Allocation(memory::Component::matrix, 50);
+    moved = memory::Allocation(memory::Component::matrix, 10);
+    CHECK(memory::current(memory::Component::matrix) == Approx(start + 110));
+  }
+  CHECK(memory::current(memory::Component::matrix) == Approx(start));
+  CHECK(memory::peak(memory::Component::matrix) == Approx(start + 200));
+  memory::reset();
+  CHECK(memory::peak(memory::Component::matrix) == Approx(start));
+}
+
+TEST_CASE("Predicted footprints") {
+  ElectroMagnetic const silicon{13.1, 1.0};
+  Run run;
+  run.geometry->objects = {{{0, 0, 0}, silicon, 500e-9, 3},
+                           {{1500e-9, 0, 0}, silicon, 500e-9, 4},
+                           {{0, 1500e-9, 800e-9}, silicon, 300e-9, 2}};
+  t_real const N = 2 * (3 * 5 + 4 * 6 + 2 * 4);
+
+  SECTION("Dense matrix") {
+    auto const footprint = memory::predict(solver::Kind::eigen, run, 1);
+    CHECK(footprint[memory::Component::matrix] == Approx(2 * N * N * sizeof(t_complex)));
+    CHECK(footprint[memory::Component::rotations] == 0);
+  }
+
+  SECTION("FMM matches the tracked operators") {
+    auto const before = memory::current(memory::Component::rotations) +
+                        memory::current(memory::Component::translations);
+    FastMatrixMultiply const fmm(2 * constant::pi / 1200e-9, run.geometry->objects);
+    auto const held = memory::current(memory::Component::rotations) +
+                      memory::current(memory::Component::translations) - before;
+    // on a single process, the transpose operators share the store of the forward operators
+    auto const footprint = memory::predict(solver::Kind::fmm, run, 1);
+    CHECK(footprint[memory::Component::rotations] + footprint[memory::Component::translations] ==
+          Approx(held));
+
+    // the busiest of several processes holds less than the whole
+    auto const distributed = memory::predict(solver::Kind::fmm, run, 3);
+    CHECK(distributed[memory::Component::rotations] < footprint[memory::Component::rotations]);
+  }
+
+  SECTION("FMM with factored rotations") {
+    auto const dense = memory::predict(solver::Kind::fmm, run, 1);
+    run.fmm_factored_rotations = true;
+    auto const footprint = memory::predict(solver::Kind::fmm, run, 1);
+    CHECK(footprint[memory::Component::rotations] == Approx(memory::flip_bytes(4)));
+    CHECK(footprint[memory::Component::rotations] < dense[memory::Component::rotations]);
+    CHECK(footprint[memory::Component::translations] ==
+          Approx(dense[memory::Component::translations]));
+
+    // the flips may already be held by other factored rotations
+    auto const before = memory::current(memory::Component::rotations);
+    FastMatrixMultiply const fmm(ElectroMagnetic(), 2 * constant::pi / 1200e-9,
+                                 run.geometry->objects,
+                                 Matrix<bool>::Ones(run.geometry->objects.size(),
+                                                    run.geometry->objects.size()),
+                                 Rotation::Storage::factored);
+    CHECK(memory::current(memory::Component::rotations) - before <=
+          footprint[memory::Component::rotations]);
+  }
+
+  SECTION("FMM with recomputed translations") {
+    auto const stored = memory::predict(solver::Kind::fmm, run, 1);
+    // self-interactions are always stored
+    run.fmm_translations_budget = 0;
+    auto const recomputed = memory::predict(solver::Kind::fmm, run, 1);
+    CHECK(recomputed[memory::Component::translations] == Approx(3 * memory::coaxial_bytes(1)));
+    CHECK(recomputed[memory::Component::rotations] ==
+          Approx(stored[memory::Component::rotations]));
+    // at most the budget is held by the pairs
+    run.fmm_translations_budget = memory::coaxial_bytes(5);
+    auto const budget = memory::predict(solver::Kind::fmm, run, 1);
+    CHECK(budget[memory::Component::translations] ==
+          Approx(memory::coaxial_bytes(5) + 3 * memory::coaxial_bytes(1)));
+    CHECK(budget[memory::Component::translations] < stored[memory::Component::translations]);
+  }
+
+  SECTION("Recommendation and report") {
+    CHECK_THROWS_AS(memory::recommend(run, 1, 1), std::runtime_error);
+    auto const budget = memory::parse_bytes("1GB");
+    auto const kind = memory::recommend(run, 1, budget);
+    std::ostringstream sstr;
+    memory::write(sstr, run, 1, budget);
+    CHECK(sstr.str().find(std::string("Recommended solver: ") + solver::name(kind)) !=
+          std::string::npos);
+  }
+}
+
+TEST_CASE("Numbers of bytes") {
+  CHECK(memory::parse_bytes("512") == Approx(512));
+  CHECK(memory::parse_bytes("2kb") == Approx(2048));
+  CHECK(memory::parse_bytes("1.5 GiB") == Approx(1.5 * 1024 * 1024 * 1024));
+  CHECK_THROWS_AS(memory::parse_bytes("-1GB"), std::runtime_error);
+  CHECK_THROWS_AS(memory::parse_bytes("1 parsec"), std::runtime_error);
+  CHECK(memory::format_bytes(512) == "512 B");
+  CHECK(memory::format_bytes(1.5 * 1024 * 1024) == "1.5 MB");
+}
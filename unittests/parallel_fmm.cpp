@@ -19,10 +19,15 @@
 #include "Geometry.h"
 #include "PreconditionedMatrixSolver.h"
 #include "Reader.h"
+#include "Timing.h"
 #include "catch.hpp"
 #include "mpi/FastMatrixMultiply.h"
 #include <BelosTypes.hpp>
+#include <Teuchos_TimeMonitor.hpp>
+#include <cmath>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 TEST_CASE("ReduceComputation") {
   using namespace optimet;
@@ -371,6 +376,42 @@ TEST_CASE("FMM solver vs serial solver") {
   CHECK(parallel.internal_coef.isApprox(serial.internal_coef, internal_tol));
 }
 
+TEST_CASE("FMM solver counts one matvec per Belos application") {
+  using namespace optimet;
+  auto const nHarmonics = 3;
+  auto geometry = std::make_shared<Geometry>();
+  for(t_uint i(0); i < 4; ++i)
+    geometry->pushObject(
+        {{static_cast<t_real>(i) * 1.5 * 2e-6, 0, 0}, {5e0, 1.1e0}, 0.5 * 2e-6, nHarmonics});
+  auto const wavelength = 14960e-9;
+  Spherical<t_real> const vKinc{2 * consPi / wavelength, 90 * consPi / 180.0, 90 * consPi / 180.0};
+  SphericalP<t_complex> const Eaux{0e0, 1e0, 0e0};
+  auto const excitation =
+      std::make_shared<Excitation>(0, Tools::toProjection(vKinc, Eaux), vKinc, nHarmonics);
+  excitation->populate();
+  geometry->update(excitation);
+
+  mpi::Communicator world;
+  Result result(geometry, excitation);
+  solver::FMMBelos solver(geometry, excitation, world);
+  solver.belos_parameters()->set("Solver", "GMRES");
+  solver.belos_parameters()->set<int>("Num Blocks", 500);
+  solver.belos_parameters()->set("Maximum Iterations", 4000);
+  solver.belos_parameters()->set("Convergence Tolerance", 1.0e-10);
+
+  // Belos times each application of the operator, whether by the solver or the linear problem
+  Teuchos::TimeMonitor::zeroOutTimers();
+  timing::reset();
+  solver.solve(result.scatter_coef, result.internal_coef);
+  auto const applications = Teuchos::TimeMonitor::lookupCounter("Belos: Operation Op*x");
+  REQUIRE(not applications.is_null());
+  auto const napplications = static_cast<t_uint>(applications->numCalls());
+  CHECK(napplications > 0);
+  CHECK(timing::calls(timing::Phase::matvec) == napplications);
+  REQUIRE(not solver.convergence().empty());
+  CHECK(solver.convergence().iterations().back().matvecs <= napplications);
+}
+
 TEST_CASE("Parallel matrix vs serial matrix") {
   using namespace optimet;
   mpi::Communicator const world;
@@ -450,3 +491,53 @@ TEST_CASE("Read XML") {
   auto const solver = optimet::solver::factory(run);
   CHECK_NOTHROW(std::dynamic_pointer_cast<optimet::solver::FMMBelos>(solver));
 }
+
+//! Reads a single sphere with the given FMM node
+optimet::Run fmm_input(std::string const &fmm) {
+  std::istringstream buffer(
+      "<simulation>\n"
+      "  <harmonics nmax=\"6\" />\n"
+      "</simulation>\n"
+      "<source type=\"planewave\">\n"
+      "  <wavelength value=\"1460\" />\n"
+      "  <propagation theta=\"90\" phi=\"90\" />\n"
+      "  <polarization Etheta.real=\"1.0\" Etheta.imag=\"0.0\" Ephi.real=\"0.0\" "
+      "Ephi.imag=\"0.0\" />\n"
+      "</source>\n"
+      "<geometry>\n"
+      "  <object type=\"sphere\">\n"
+      "    <cartesian x=\"0.0\" y=\"0.0\" z=\"0.0\" />\n"
+      "    <properties radius=\"500.0\" />\n"
+      "    <epsilon type=\"relative\" value.real=\"13.0\" value.imag=\"0.0\" />\n"
+      "    <mu type=\"relative\" value.real=\"1.0\" value.imag=\"0.0\" />\n"
+      "  </object>\n"
+      "</geometry>\n"
+      "<ParameterList name=\"Belos\">\n"
+      "  <Parameter name=\"Solver\" type=\"string\" value=\"GMRES\"/>\n"
+      "</ParameterList>\n" +
+      fmm);
+  return optimet::simulation_input(buffer);
+}
+
+TEST_CASE("Read FMM rotations from XML") {
+  CHECK(not fmm_input("<FMM/>\n").fmm_factored_rotations);
+  CHECK(not fmm_input("<FMM rotations=\"dense\"/>\n").fmm_factored_rotations);
+  CHECK_THROWS_AS(fmm_input("<FMM rotations=\"sparse\"/>\n"), std::runtime_error);
+
+  auto const run = fmm_input("<FMM rotations=\"factored\"/>\n");
+  CHECK(run.do_fmm);
+  CHECK(run.fmm_factored_rotations);
+  auto const solver = optimet::solver::factory(run);
+  CHECK_NOTHROW(std::dynamic_pointer_cast<optimet::solver::FMMBelos>(solver));
+}
+
+TEST_CASE("Read FMM translations budget from XML") {
+  auto const defaults = fmm_input("<FMM/>\n");
+  CHECK(std::isinf(defaults.fmm_translations_budget));
+
+  auto const run = fmm_input("<FMM translations=\"1MB\"/>\n");
+  CHECK(run.do_fmm);
+  CHECK(run.fmm_translations_budget == Approx(optimet::memory::parse_bytes("1MB")));
+  auto const solver = optimet::solver::factory(run);
+  CHECK_NOTHROW(std::dynamic_pointer_cast<optimet::solver::FMMBelos>(solver));
+}
@@ -0,0 +1,80 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "FastMatrixMultiply.h"
+#include "Roofline.h"
+#include "Types.h"
+#include "constants.h"
+#include <sstream>
+
+using namespace optimet;
+
+TEST_CASE("Explained multiplication") {
+  ElectroMagnetic const silicon{13.1, 1.0};
+  auto const wavenumber = 2 * constant::pi / (1200 * 1e-9);
+  std::vector<Scatterer> const scatterers{{{0, 0, 0}, silicon, 500e-9, 3},
+                                          {{1500e-9, 0, 0}, silicon, 500e-9, 4},
+                                          {{0, 1500e-9, 800e-9}, silicon, 300e-9, 2}};
+  FastMatrixMultiply const fmm(wavenumber, scatterers);
+  Vector<t_complex> const input = Vector<t_complex>::Random(fmm.cols());
+  Vector<t_complex> output;
+
+  SECTION("Same result as the multiplication") {
+    auto const profile = fmm.explain(input, output);
+    CHECK(output.isApprox(fmm(input)));
+    for(auto const kernel : {roofline::Kernel::mie, roofline::Kernel::normalization,
+                             roofline::Kernel::rotation, roofline::Kernel::translation,
+                             roofline::Kernel::decomposition, roofline::Kernel::back_rotation,
+                             roofline::Kernel::accumulation}) {
+      CHECK(profile.flops(kernel) > 0);
+      CHECK(profile.bytes(kernel) > 0);
+    }
+    CHECK(profile.bytes(roofline::Kernel::communication) == 0);
+
+    // 6 off-diagonal pairs, each rotating its incident coefficients from degree 1 to nMax
+    t_real rotation_flops(0);
+    for(auto const i : {3, 4, 2})
+      for(auto const j : {3, 4, 2})
+        for(t_int n(1); i != j and n <= i; ++n)
+          rotation_flops += 2 * 8 * (2 * n + 1) * (2 * n + 1);
+    CHECK(profile.flops(roofline::Kernel::rotation) == Approx(rotation_flops));
+  }
+
+  SECTION("Same result as the transpose") {
+    auto const profile = fmm.explain(input, output, true);
+    CHECK(output.isApprox(fmm.transpose(input)));
+    auto const direct = fmm.explain(input, output);
+    CHECK(profile.flops(roofline::Kernel::translation) ==
+          Approx(direct.flops(roofline::Kernel::translation)));
+  }
+
+  SECTION("Report") {
+    auto const profile = fmm.explain(input, output);
+    std::ostringstream sstr;
+    roofline::write(sstr, profile, {1e10, 1e10});
+    CHECK(sstr.str().find("back_rotation") != std::string::npos);
+    CHECK(sstr.str().find("communication") == std::string::npos);
+    CHECK(sstr.str().find("total") != std::string::npos);
+  }
+}
+
+TEST_CASE("Machine probe") {
+  auto const machine = roofline::probe(mpi::Communicator(), 1e-3);
+  CHECK(machine.bandwidth > 0);
+  CHECK(machine.flops > 0);
+}
@@ -349,3 +349,34 @@ TEST_CASE("Additivity, e.g. ϑ vs 2ϑ vs 3ϑ") {
     CHECK(twice.isApprox(direct * direct));
   }
 }
+
+TEST_CASE("Factored vs dense rotations") {
+  auto const N = 12;
+  auto const size = N * (N + 2);
+  for(auto const angles : std::vector<std::tuple<t_real, t_real, t_real>>{
+          std::make_tuple(0.3, 1.2, -2.0), std::make_tuple(2.9, -0.3, constant::pi),
+          std::make_tuple(0, 0.2, 0.3), std::make_tuple(constant::pi, 0.5, 0)}) {
+    Rotation const dense(angles, N);
+    Rotation const factored(angles, N, Rotation::Storage::factored);
+    CHECK(dense.storage() == Rotation::Storage::dense);
+    CHECK(factored.storage() == Rotation::Storage::factored);
+    CHECK(factored.matrices().size() == 0);
+
+    Matrix<t_complex> const input = Matrix<t_complex>::Random(size, 2);
+    CHECK(factored(input).isApprox(dense(input)));
+    CHECK(factored.adjoint(input).isApprox(dense.adjoint(input)));
+    CHECK(factored.transpose(input).isApprox(dense.transpose(input)));
+    CHECK(factored.conjugate(input).isApprox(dense.conjugate(input)));
+    // lower degrees use the same flips
+    Matrix<t_complex> const lower = input.topRows(3 * 5);
+    CHECK(factored(lower).isApprox(dense(lower)));
+  }
+
+  // flips are real, symmetric and their own inverse
+  auto const flips = Rotation::flips(N);
+  REQUIRE(flips->size() > static_cast<std::size_t>(N));
+  for(t_int n(0); n <= N; ++n) {
+    CHECK((*flips)[n].isApprox((*flips)[n].transpose()));
+    CHECK(((*flips)[n] * (*flips)[n]).isIdentity(1e-8));
+  }
+}
@@ -0,0 +1,111 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "Reader.h"
+#include "Run.h"
+#include "RunSerialization.h"
+#include "Types.h"
+#include <sstream>
+
+using namespace optimet;
+
+TEST_CASE("Serialize and deserialize a run") {
+  std::istringstream buffer(
+      "<simulation>\n"
+      "  <harmonics nmax=\"4\" />\n"
+      "</simulation>\n"
+      "<source type=\"planewave\">\n"
+      "  <wavelength value=\"1460\" />\n"
+      "  <propagation theta=\"45\" phi=\"90\" />\n"
+      "  <polarization Etheta.real=\"0.0\" Etheta.imag=\"0.0\" Ephi.real=\"1.0\" "
+      "Ephi.imag=\"0.5\" />\n"
+      "</source>\n"
+      "<geometry>\n"
+      "  <object type=\"sphere\">\n"
+      "    <cartesian x=\"0.0\" y=\"0.0\" z=\"0.0\" />\n"
+      "    <properties radius=\"500.0\" />\n"
+      "    <epsilon type=\"relative\" value.real=\"13.0\" value.imag=\"0.1\" />\n"
+      "    <mu type=\"relative\" value.real=\"1.0\" value.imag=\"0.0\" />\n"
+      "  </object>\n"
+      "  <object type=\"sphere\">\n"
+      "    <cartesian x=\"0.0\" y=\"1500\" z=\"1500\" />\n"
+      "    <properties radius=\"400.0\" />\n"
+      "    <epsilon type=\"DrudeModel\">\n"
+      "      <parameters plasma_frequency=\"2e15\" damping_frequency=\"1e14\" />\n"
+      "    </epsilon>\n"
+      "    <mu type=\"relative\" value.real=\"1.0\" value.imag=\"0.0\" />\n"
+      "  </object>\n"
+      "</geometry>\n"
+      "<output type=\"field\">\n"
+      "  <grid type=\"cartesian\">\n"
+      "    <x min=\"-1000\" max=\"1000\" steps=\"21\" />\n"
+      "    <y min=\"-0.1\" max=\"0.1\" steps=\"2\" />\n"
+      "    <z min=\"-1000\" max=\"1000\" steps=\"21\" />\n"
+      "  </grid>\n"
+      "  <singlemode n=\"2\" m=\"-1\" component=\"TE\" />\n"
+      "</output>\n"
+      "<cache directory=\"somewhere\" coefficients=\"true\"/>\n"
+      "<coefficients save=\"out.h5\" load=\"in.h5\"/>\n"
+      "<memory budget=\"2GB\" dry_run=\"true\"/>\n"
+      "<autotune file=\"tuned.txt\" objects=\"4\"/>\n");
+  auto const expected = simulation_input(buffer);
+  auto const actual = deserialize(serialize(expected));
+
+  REQUIRE(actual.geometry->objects.size() == expected.geometry->objects.size());
+  for(std::size_t i(0); i < expected.geometry->objects.size(); ++i) {
+    auto const &a = actual.geometry->objects[i];
+    auto const &e = expected.geometry->objects[i];
+    CHECK(a.vR.rrr == e.vR.rrr);
+    CHECK(a.vR.the == e.vR.the);
+    CHECK(a.vR.phi == e.vR.phi);
+    CHECK(a.radius == e.radius);
+    CHECK(a.nMax == e.nMax);
+    CHECK(a.elmag.modelType == e.elmag.modelType);
+    CHECK(a.elmag.epsilon == e.elmag.epsilon);
+    CHECK(a.elmag.mu == e.elmag.mu);
+    CHECK(a.elmag.epsilon_SH == e.elmag.epsilon_SH);
+    CHECK(a.elmag.plasma_freq == e.elmag.plasma_freq);
+  }
+  CHECK(actual.geometry->bground.epsilon == expected.geometry->bground.epsilon);
+  CHECK(actual.geometry->structureType == expected.geometry->structureType);
+
+  CHECK(actual.excitation->nMax == expected.excitation->nMax);
+  CHECK(actual.excitation->lambda() == expected.excitation->lambda());
+  CHECK(actual.excitation->Einc.phi == expected.excitation->Einc.phi);
+  CHECK(actual.excitation->dataIncAp.isApprox(expected.excitation->dataIncAp));
+  CHECK(actual.excitation->dataIncBp.isApprox(expected.excitation->dataIncBp));
+
+  CHECK(actual.nMax == expected.nMax);
+  CHECK(actual.outputType == expected.outputType);
+  CHECK(actual.params == expected.params);
+  CHECK(actual.singleMode == expected.singleMode);
+  CHECK(actual.singleModeIndex.compound == expected.singleModeIndex.compound);
+  CHECK(actual.singleComponent == expected.singleComponent);
+  CHECK(actual.do_sh == expected.do_sh);
+  CHECK(actual.cache.directory() == "somewhere");
+  CHECK(actual.cache_coefficients);
+  CHECK(actual.coefficients_output == "out.h5");
+  CHECK(actual.coefficients_input == "in.h5");
+  CHECK(actual.memory_budget == Approx(2.0 * 1024 * 1024 * 1024));
+  CHECK(actual.dry_run);
+  CHECK(actual.autotune);
+  CHECK(actual.autotune_file == "tuned.txt");
+  CHECK(actual.autotune_objects == 4);
+
+  CHECK_THROWS_AS(deserialize("not a run"), std::runtime_error);
+}
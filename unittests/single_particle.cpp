@@ -63,6 +63,38 @@ TEST_CASE("Add scatterers to geometry") {
   }
 }
 
+TEST_CASE("Add many scatterers at once") {
+  // cubic lattice with spacing 1 and radius 0.4
+  std::vector<Scatterer> lattice;
+  for(int i(0); i < 4; ++i)
+    for(int j(0); j < 4; ++j)
+      for(int k(0); k < 4; ++k)
+        lattice.push_back(
+            {Tools::toSpherical({i - 1.5, j - 1.5, k - 1.5}), {1.1e0, 1.2e0}, 0.4, 2});
+
+  Geometry geometry;
+  CHECK(not geometry.is_valid());
+  CHECK_NOTHROW(geometry.pushObjects(lattice));
+  CHECK(geometry.objects.size() == lattice.size());
+  CHECK(geometry.is_valid());
+
+  SECTION("Overlap with a new sphere") {
+    CHECK_THROWS_AS(geometry.pushObjects({{Tools::toSpherical({0.05, 0.05, 0.05}), {1.1e0, 1.2e0},
+                                           0.4, 2}}),
+                    std::runtime_error);
+    CHECK(geometry.objects.size() == lattice.size());
+    CHECK(geometry.is_valid());
+  }
+  SECTION("Overlap within the new spheres") {
+    Geometry other;
+    lattice[17].radius = 0.6;
+    CHECK_THROWS_AS(other.pushObjects(lattice), std::runtime_error);
+    CHECK(other.objects.size() == 0);
+    geometry.objects[17].radius = 0.6;
+    CHECK(not geometry.is_valid());
+  }
+}
+
 TEST_CASE("Two spheres") {
   auto geometry = std::make_shared<Geometry>();
   // spherical coords, ε, μ, radius, nmax
@@ -0,0 +1,67 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "Timing.h"
+#include "Types.h"
+#include <sstream>
+#include <thread>
+
+using namespace optimet;
+
+TEST_CASE("Phase timers and counters") {
+  timing::reset();
+  {
+    timing::Timer const timer(timing::Phase::matvec);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  timing::Timer(timing::Phase::matvec);
+  timing::count(timing::Phase::iterations, 42);
+  CHECK(timing::calls(timing::Phase::matvec) == 2);
+  CHECK(timing::seconds(timing::Phase::matvec) >= 1e-2);
+  CHECK(timing::calls(timing::Phase::iterations) == 42);
+  CHECK(timing::seconds(timing::Phase::iterations) == 0);
+  CHECK(timing::calls(timing::Phase::solve) == 0);
+
+  SECTION("Report steps") {
+    mpi::Communicator const world;
+    timing::Report report;
+    report.step("first", world);
+    CHECK(timing::calls(timing::Phase::matvec) == 0);
+    timing::add(timing::Phase::solve, 1.5, 3);
+    report.step("second", world);
+
+    std::ostringstream sstr;
+    report.write(sstr, world);
+    auto const json = sstr.str();
+    CHECK(json.find("\"step\": \"first\"") != std::string::npos);
+    CHECK(json.find("\"matvec\": {\"count\": " + std::to_string(2 * world.size())) !=
+          std::string::npos);
+    CHECK(json.find("\"iterations\"") < json.find("\"step\": \"second\""));
+    CHECK(json.find("\"solve\"") > json.find("\"step\": \"second\""));
+    CHECK(json.find("\"mean\": 1.5") != std::string::npos);
+  }
+
+  SECTION("Labels are escaped") {
+    mpi::Communicator const world;
+    timing::Report report;
+    report.step("say \"hi\" \\ bye\n", world);
+    std::ostringstream sstr;
+    report.write(sstr, world);
+    CHECK(sstr.str().find("\"step\": \"say \\\"hi\\\" \\\\ bye\\u000a\"") != std::string::npos);
+  }
+}
@@ -0,0 +1,86 @@
+// (C) University College London 2017
+// This file is part of Optimet, licensed under the terms of the GNU Public License
+//
+// Optimet is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Optimet is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Optimet. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catch.hpp"
+
+#include "Scatterer.h"
+#include "Traversal.h"
+#include "Types.h"
+#include <algorithm>
+#include <set>
+
+using namespace optimet;
+
+namespace {
+//! Particles on a cubic lattice, numbered along x first
+std::vector<Scatterer> lattice(t_int side) {
+  ElectroMagnetic const silicon{13.1, 1.0};
+  std::vector<Scatterer> result;
+  for(t_int k(0); k < side; ++k)
+    for(t_int j(0); j < side; ++j)
+      for(t_int i(0); i < side; ++i) {
+        Eigen::Matrix<t_real, 3, 1> const position(1.5e-6 * i, 1.5e-6 * j, 1.5e-6 * k);
+        result.emplace_back(position, silicon, 500e-9, 2);
+      }
+  return result;
+}
+}
+
+TEST_CASE("Morton ranks") {
+  auto const scatterers = lattice(4);
+  auto const ranks = traversal::morton_ranks(scatterers);
+  REQUIRE(ranks.size() == scatterers.size());
+  CHECK(std::set<t_uint>(ranks.begin(), ranks.end()).size() == scatterers.size());
+
+  // the first eight particles along the curve form the corner cube of the lattice
+  for(t_uint i(0); i < scatterers.size(); ++i) {
+    auto const position = scatterers[i].vR.toEigenCartesian();
+    auto const corner = (position.array() < 2e-6).all();
+    CHECK((ranks[i] < 8) == corner);
+  }
+
+  CHECK(traversal::morton_ranks({}).size() == 0);
+  CHECK(traversal::morton_ranks({scatterers.front()}) == std::vector<t_uint>{0});
+}
+
+TEST_CASE("Morton traversal of the pairs") {
+  auto const scatterers = lattice(3);
+  Matrix<bool> couplings = Matrix<bool>::Random(scatterers.size(), scatterers.size());
+  couplings.diagonal().fill(true);
+
+  auto const row_major = traversal::row_major(couplings);
+  CHECK(row_major.size() == static_cast<std::size_t>(couplings.count()));
+  CHECK(std::is_sorted(row_major.begin(), row_major.end()));
+
+  // same pairs, visited in another order
+  auto morton = traversal::morton(scatterers, couplings);
+  CHECK(morton.size() == row_major.size());
+  CHECK(morton != row_major);
+  std::sort(morton.begin(), morton.end());
+  CHECK(morton == row_major);
+
+  // both directions of a pair are consecutive
+  auto const pairs = traversal::morton(scatterers, couplings);
+  for(std::size_t i(0); i < pairs.size(); ++i) {
+    if(pairs[i].first == pairs[i].second or not couplings(pairs[i].second, pairs[i].first))
+      continue;
+    auto const reversed = std::make_pair(pairs[i].second, pairs[i].first);
+    CHECK(((i > 0 and pairs[i - 1] == reversed) or
+           (i + 1 < pairs.size() and pairs[i + 1] == reversed)));
+  }
+
+  CHECK_THROWS_AS(traversal::morton(lattice(2), couplings), std::out_of_range);
+}